@@ -0,0 +1,479 @@
+/*
+ *      smsdb-benchmark.c
+ *
+ *      Copyright 2026 Alex <alex@linuxonly.ru>
+ *
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "../smsdb.h"
+
+/*Default corpora sizes*/
+#define MMGUI_SMSDB_BENCHMARK_DEFAULT_CORPORA   "1000,10000,100000"
+/*Full list is read several times to get latency distribution*/
+#define MMGUI_SMSDB_BENCHMARK_LIST_ROUNDS       5
+/*Payload mix in percents*/
+#define MMGUI_SMSDB_BENCHMARK_UCS2_PERCENT      30
+#define MMGUI_SMSDB_BENCHMARK_BINARY_PERCENT    10
+/*Random generator seed, so corpora are the same between runs*/
+#define MMGUI_SMSDB_BENCHMARK_SEED              0x534d5342
+
+enum _mmgui_smsdb_benchmark_payload {
+	MMGUI_SMSDB_BENCHMARK_PAYLOAD_GSM7 = 0,
+	MMGUI_SMSDB_BENCHMARK_PAYLOAD_UCS2,
+	MMGUI_SMSDB_BENCHMARK_PAYLOAD_BINARY
+};
+
+struct _mmgui_smsdb_benchmark_result {
+	const gchar *operation;
+	guint corpus;
+	guint count;
+	gdouble seconds;
+	gdouble p50;
+	gdouble p99;
+	guint64 peakrss;
+};
+
+typedef struct _mmgui_smsdb_benchmark_result *mmgui_smsdb_benchmark_result_t;
+
+static const gchar *mmgui_smsdb_benchmark_gsm7_words[] = {
+	"Your", "code", "is", "order", "payment", "balance", "received", "tariff",
+	"call", "me", "back", "tomorrow", "meeting", "at", "delivery", "number",
+	"confirm", "account", "roaming", "bonus", "internet", "package", "expires", "today"
+};
+
+static const gchar *mmgui_smsdb_benchmark_ucs2_words[] = {
+	"Ваш", "код", "заказ", "оплата", "баланс", "получен", "тариф", "звонок",
+	"завтра", "встреча", "доставка", "номер", "подтвердите", "счёт", "роуминг", "бонус",
+	"残高", "注文", "配達", "確認", "Grüße", "Straße", "ĉambro", "ăâîșț"
+};
+
+static gboolean mmgui_smsdb_benchmark_json = FALSE;
+
+static gint64 mmgui_smsdb_benchmark_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (gint64)ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+static void mmgui_smsdb_benchmark_rss_reset(void)
+{
+	gint fd;
+
+	/*Resets peak resident set size (VmHWM), supported since Linux 4.0.
+	  File is written in place, procfs entries can not be replaced by rename*/
+	fd = open("/proc/self/clear_refs", O_WRONLY);
+	if (fd == -1) return;
+
+	if (write(fd, "5", 1) != 1) {
+		g_debug("Unable to reset peak resident set size\n");
+	}
+
+	close(fd);
+}
+
+static guint64 mmgui_smsdb_benchmark_rss_peak(void)
+{
+	gchar *status, *line;
+	guint64 peak;
+
+	peak = 0;
+
+	if (g_file_get_contents("/proc/self/status", &status, NULL, NULL)) {
+		line = strstr(status, "VmHWM:");
+		if (line != NULL) {
+			peak = g_ascii_strtoull(line + strlen("VmHWM:"), NULL, 10);
+		}
+		g_free(status);
+	}
+
+	return peak;
+}
+
+static gint mmgui_smsdb_benchmark_latency_compare(gconstpointer a, gconstpointer b)
+{
+	gint64 latency1, latency2;
+
+	latency1 = *(const gint64 *)a;
+	latency2 = *(const gint64 *)b;
+
+	if (latency1 < latency2) {
+		return -1;
+	} else if (latency1 > latency2) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+static gdouble mmgui_smsdb_benchmark_percentile(GArray *latencies, guint percent)
+{
+	guint index;
+
+	if (latencies->len == 0) return 0.0;
+
+	index = (latencies->len - 1) * percent / 100;
+
+	/*Latency is reported in microseconds*/
+	return (gdouble)g_array_index(latencies, gint64, index) / 1000.0;
+}
+
+static void mmgui_smsdb_benchmark_report(mmgui_smsdb_benchmark_result_t result)
+{
+	gdouble throughput;
+
+	if (result->seconds > 0.0) {
+		throughput = (gdouble)result->count / result->seconds;
+	} else {
+		throughput = 0.0;
+	}
+
+	if (mmgui_smsdb_benchmark_json) {
+		/*One object per line for regression tracking*/
+		printf("{\"corpus\": %u, \"operation\": \"%s\", \"count\": %u, \"seconds\": %.6f, \"ops_per_sec\": %.1f, \"p50_us\": %.3f, \"p99_us\": %.3f, \"peak_rss_kb\": %" G_GUINT64_FORMAT "}\n",
+				result->corpus, result->operation, result->count, result->seconds, throughput, result->p50, result->p99, result->peakrss);
+	} else {
+		printf("%-8u %-10s %8u %12.3f %14.1f %12.3f %12.3f %12" G_GUINT64_FORMAT "\n",
+				result->corpus, result->operation, result->count, result->seconds, throughput, result->p50, result->p99, result->peakrss);
+	}
+
+	fflush(stdout);
+}
+
+static void mmgui_smsdb_benchmark_finish(mmgui_smsdb_benchmark_result_t result, GArray *latencies, gint64 started)
+{
+	result->seconds = (gdouble)(mmgui_smsdb_benchmark_time_ns() - started) / 1000000000.0;
+
+	g_array_sort(latencies, mmgui_smsdb_benchmark_latency_compare);
+
+	result->p50 = mmgui_smsdb_benchmark_percentile(latencies, 50);
+	result->p99 = mmgui_smsdb_benchmark_percentile(latencies, 99);
+	result->peakrss = mmgui_smsdb_benchmark_rss_peak();
+
+	mmgui_smsdb_benchmark_report(result);
+
+	g_array_set_size(latencies, 0);
+}
+
+static mmgui_sms_message_t mmgui_smsdb_benchmark_message_generate(GRand *rand, guint index)
+{
+	mmgui_sms_message_t message;
+	GString *text;
+	gchar number[32];
+	guchar data[140];
+	const gchar **words;
+	guint payload, numwords, length, i;
+
+	message = mmgui_smsdb_message_create();
+
+	/*Limited set of senders, like real inbox*/
+	g_snprintf(number, sizeof(number), "+7916%07u", (guint)g_rand_int_range(rand, 0, 500));
+	mmgui_smsdb_message_set_number(message, number);
+	mmgui_smsdb_message_set_service_number(message, "+79168999100");
+	mmgui_smsdb_message_set_timestamp(message, (time_t)(1400000000 + index * 60));
+	mmgui_smsdb_message_set_read(message, g_rand_boolean(rand));
+
+	if (g_rand_int_range(rand, 0, 100) < 80) {
+		mmgui_smsdb_message_set_folder(message, MMGUI_SMSDB_SMS_FOLDER_INCOMING);
+	} else {
+		mmgui_smsdb_message_set_folder(message, MMGUI_SMSDB_SMS_FOLDER_SENT);
+	}
+
+	payload = (guint)g_rand_int_range(rand, 0, 100);
+
+	if (payload < MMGUI_SMSDB_BENCHMARK_BINARY_PERCENT) {
+		payload = MMGUI_SMSDB_BENCHMARK_PAYLOAD_BINARY;
+	} else if (payload < MMGUI_SMSDB_BENCHMARK_BINARY_PERCENT + MMGUI_SMSDB_BENCHMARK_UCS2_PERCENT) {
+		payload = MMGUI_SMSDB_BENCHMARK_PAYLOAD_UCS2;
+	} else {
+		payload = MMGUI_SMSDB_BENCHMARK_PAYLOAD_GSM7;
+	}
+
+	if (payload == MMGUI_SMSDB_BENCHMARK_PAYLOAD_BINARY) {
+		length = (guint)g_rand_int_range(rand, 16, sizeof(data) + 1);
+		for (i=0; i<length; i++) {
+			data[i] = (guchar)g_rand_int_range(rand, 0, 256);
+		}
+		mmgui_smsdb_message_set_binary(message, TRUE);
+		mmgui_smsdb_message_set_data(message, (const gchar *)data, length, FALSE);
+	} else {
+		if (payload == MMGUI_SMSDB_BENCHMARK_PAYLOAD_UCS2) {
+			/*UCS2 message holds up to 70 characters*/
+			words = mmgui_smsdb_benchmark_ucs2_words;
+			numwords = G_N_ELEMENTS(mmgui_smsdb_benchmark_ucs2_words);
+			length = 70;
+		} else {
+			/*GSM7 message holds up to 160 characters*/
+			words = mmgui_smsdb_benchmark_gsm7_words;
+			numwords = G_N_ELEMENTS(mmgui_smsdb_benchmark_gsm7_words);
+			length = 160;
+		}
+		text = g_string_new(NULL);
+		while (g_utf8_strlen(text->str, -1) < (glong)length - 16) {
+			g_string_append(text, words[g_rand_int_range(rand, 0, numwords)]);
+			g_string_append_c(text, ' ');
+		}
+		g_string_append_printf(text, "%06u", (guint)g_rand_int_range(rand, 0, 1000000));
+		mmgui_smsdb_message_set_text(message, text->str, FALSE);
+		g_string_free(text, TRUE);
+	}
+
+	return message;
+}
+
+static gboolean mmgui_smsdb_benchmark_run_corpus(guint corpus)
+{
+	smsdb_t smsdb;
+	GRand *rand;
+	GArray *messages, *ids, *latencies;
+	GSList *list;
+	mmgui_sms_message_t message;
+	struct _mmgui_smsdb_benchmark_result result;
+	gchar persistentid[64];
+	gint64 started, opstarted;
+	guint64 id;
+	guint i;
+
+	g_snprintf(persistentid, sizeof(persistentid), "benchmark-%u", corpus);
+
+	/*Corpus is generated before measurements*/
+	rand = g_rand_new_with_seed(MMGUI_SMSDB_BENCHMARK_SEED);
+	messages = g_array_sized_new(FALSE, FALSE, sizeof(mmgui_sms_message_t), corpus);
+	for (i=0; i<corpus; i++) {
+		message = mmgui_smsdb_benchmark_message_generate(rand, i);
+		g_array_append_val(messages, message);
+	}
+	g_rand_free(rand);
+
+	ids = g_array_sized_new(FALSE, FALSE, sizeof(guint64), corpus);
+	latencies = g_array_sized_new(FALSE, FALSE, sizeof(gint64), corpus);
+
+	memset(&result, 0, sizeof(result));
+	result.corpus = corpus;
+
+	/*Open empty database*/
+	smsdb = mmgui_smsdb_open(persistentid, NULL);
+	if (smsdb == NULL) {
+		g_printerr("Unable to open SMS database for corpus of %u messages\n", corpus);
+		g_array_free(latencies, TRUE);
+		g_array_free(ids, TRUE);
+		g_array_free(messages, TRUE);
+		return FALSE;
+	}
+
+	/*Add*/
+	mmgui_smsdb_benchmark_rss_reset();
+	started = mmgui_smsdb_benchmark_time_ns();
+	for (i=0; i<corpus; i++) {
+		message = g_array_index(messages, mmgui_sms_message_t, i);
+		opstarted = mmgui_smsdb_benchmark_time_ns();
+		if (mmgui_smsdb_add_sms(smsdb, message)) {
+			id = mmgui_smsdb_message_get_db_identifier(message);
+			g_array_append_val(ids, id);
+		}
+		opstarted = mmgui_smsdb_benchmark_time_ns() - opstarted;
+		g_array_append_val(latencies, opstarted);
+	}
+	mmgui_smsdb_flush(smsdb);
+	result.operation = "add";
+	result.count = corpus;
+	mmgui_smsdb_benchmark_finish(&result, latencies, started);
+
+	for (i=0; i<corpus; i++) {
+		mmgui_smsdb_message_free(g_array_index(messages, mmgui_sms_message_t, i));
+	}
+	g_array_free(messages, TRUE);
+
+	/*Reopen, so counters and indexes are loaded from disk*/
+	mmgui_smsdb_close(smsdb);
+	mmgui_smsdb_benchmark_rss_reset();
+	started = mmgui_smsdb_benchmark_time_ns();
+	opstarted = started;
+	smsdb = mmgui_smsdb_open(persistentid, NULL);
+	opstarted = mmgui_smsdb_benchmark_time_ns() - opstarted;
+	g_array_append_val(latencies, opstarted);
+	result.operation = "open";
+	result.count = 1;
+	mmgui_smsdb_benchmark_finish(&result, latencies, started);
+
+	if (smsdb == NULL) {
+		g_printerr("Unable to reopen SMS database for corpus of %u messages\n", corpus);
+		g_array_free(latencies, TRUE);
+		g_array_free(ids, TRUE);
+		return FALSE;
+	}
+
+	/*Read full list*/
+	mmgui_smsdb_benchmark_rss_reset();
+	started = mmgui_smsdb_benchmark_time_ns();
+	for (i=0; i<MMGUI_SMSDB_BENCHMARK_LIST_ROUNDS; i++) {
+		opstarted = mmgui_smsdb_benchmark_time_ns();
+		list = mmgui_smsdb_read_sms_list(smsdb);
+		opstarted = mmgui_smsdb_benchmark_time_ns() - opstarted;
+		g_array_append_val(latencies, opstarted);
+		mmgui_smsdb_message_free_list(list);
+	}
+	result.operation = "read_list";
+	result.count = MMGUI_SMSDB_BENCHMARK_LIST_ROUNDS;
+	mmgui_smsdb_benchmark_finish(&result, latencies, started);
+
+	/*Mark every message read*/
+	mmgui_smsdb_benchmark_rss_reset();
+	started = mmgui_smsdb_benchmark_time_ns();
+	for (i=0; i<ids->len; i++) {
+		opstarted = mmgui_smsdb_benchmark_time_ns();
+		mmgui_smsdb_set_message_read_status(smsdb, g_array_index(ids, guint64, i), TRUE);
+		opstarted = mmgui_smsdb_benchmark_time_ns() - opstarted;
+		g_array_append_val(latencies, opstarted);
+	}
+	mmgui_smsdb_flush(smsdb);
+	result.operation = "set_read";
+	result.count = ids->len;
+	mmgui_smsdb_benchmark_finish(&result, latencies, started);
+
+	/*Remove every message*/
+	mmgui_smsdb_benchmark_rss_reset();
+	started = mmgui_smsdb_benchmark_time_ns();
+	for (i=0; i<ids->len; i++) {
+		opstarted = mmgui_smsdb_benchmark_time_ns();
+		mmgui_smsdb_remove_sms_message(smsdb, g_array_index(ids, guint64, i));
+		opstarted = mmgui_smsdb_benchmark_time_ns() - opstarted;
+		g_array_append_val(latencies, opstarted);
+	}
+	mmgui_smsdb_flush(smsdb);
+	result.operation = "remove";
+	result.count = ids->len;
+	mmgui_smsdb_benchmark_finish(&result, latencies, started);
+
+	mmgui_smsdb_close(smsdb);
+
+	g_array_free(latencies, TRUE);
+	g_array_free(ids, TRUE);
+
+	return TRUE;
+}
+
+static void mmgui_smsdb_benchmark_remove_tree(const gchar *path)
+{
+	GDir *dir;
+	const gchar *name;
+	gchar *child;
+
+	if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+		dir = g_dir_open(path, 0, NULL);
+		if (dir != NULL) {
+			while ((name = g_dir_read_name(dir)) != NULL) {
+				child = g_build_filename(path, name, NULL);
+				mmgui_smsdb_benchmark_remove_tree(child);
+				g_free(child);
+			}
+			g_dir_close(dir);
+		}
+	}
+
+	g_remove(path);
+}
+
+int main(int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *error;
+	gchar *corporastr, *datadir;
+	gchar **corpora;
+	gboolean keep, res;
+	guint64 corpus;
+	gint i;
+
+	corporastr = NULL;
+	keep = FALSE;
+
+	GOptionEntry entries[] = {
+		{ "corpora", 'c', 0, G_OPTION_ARG_STRING, &corporastr, "Comma-separated corpora sizes (default: " MMGUI_SMSDB_BENCHMARK_DEFAULT_CORPORA ")", "SIZES" },
+		{ "json", 'j', 0, G_OPTION_ARG_NONE, &mmgui_smsdb_benchmark_json, "Print results as JSON lines", NULL },
+		{ "keep", 'k', 0, G_OPTION_ARG_NONE, &keep, "Keep generated databases", NULL },
+		{ NULL }
+	};
+
+	context = g_option_context_new("- SMS database benchmark");
+	g_option_context_add_main_entries(context, entries, NULL);
+
+	error = NULL;
+
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return EXIT_FAILURE;
+	}
+
+	g_option_context_free(context);
+
+	/*Databases are created in temporary XDG data directory*/
+	datadir = g_build_filename(g_get_tmp_dir(), "mmgui-smsdb-benchmark-XXXXXX", NULL);
+	if (g_mkdtemp(datadir) == NULL) {
+		g_printerr("Unable to create temporary directory\n");
+		g_free(datadir);
+		return EXIT_FAILURE;
+	}
+	g_setenv("XDG_DATA_HOME", datadir, TRUE);
+
+	if (!mmgui_smsdb_benchmark_json) {
+		printf("%-8s %-10s %8s %12s %14s %12s %12s %12s\n", "corpus", "operation", "count", "seconds", "ops/s", "p50, us", "p99, us", "peak RSS, kB");
+	}
+
+	if (corporastr != NULL) {
+		corpora = g_strsplit(corporastr, ",", -1);
+	} else {
+		corpora = g_strsplit(MMGUI_SMSDB_BENCHMARK_DEFAULT_CORPORA, ",", -1);
+	}
+
+	res = TRUE;
+
+	for (i=0; corpora[i] != NULL; i++) {
+		corpus = g_ascii_strtoull(corpora[i], NULL, 10);
+		if ((corpus == 0) || (corpus > G_MAXUINT)) {
+			g_printerr("Wrong corpus size: %s\n", corpora[i]);
+			res = FALSE;
+			continue;
+		}
+		if (!mmgui_smsdb_benchmark_run_corpus((guint)corpus)) {
+			res = FALSE;
+		}
+	}
+
+	g_strfreev(corpora);
+	g_free(corporastr);
+
+	if (!keep) {
+		mmgui_smsdb_benchmark_remove_tree(datadir);
+	} else {
+		g_printerr("Databases kept in %s\n", datadir);
+	}
+
+	g_free(datadir);
+
+	return res ? EXIT_SUCCESS : EXIT_FAILURE;
+}
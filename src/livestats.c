@@ -0,0 +1,326 @@
+/*
+ *      livestats.c
+ *      
+ *      Copyright 2026 Alex <alex@linuxonly.ru>
+ *      
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "livestats.h"
+
+/*Readers link this file without GLib, so only libc is used here*/
+
+static struct _mmgui_live_stats_slot *mmgui_live_stats_find_slot(mmgui_live_stats_segment_t segment, const char *persistentid, int allocate);
+static void mmgui_live_stats_slot_write(struct _mmgui_live_stats_slot *slot, const struct _mmgui_live_stats_device *device);
+static uint64_t mmgui_live_stats_realtime(void);
+
+
+mmgui_live_stats_publisher_t mmgui_live_stats_publisher_open(void)
+{
+	mmgui_live_stats_publisher_t publisher;
+	mmgui_live_stats_segment_t segment;
+	struct stat shmstat;
+	
+	publisher = calloc(1, sizeof(struct _mmgui_live_stats_publisher));
+	if (publisher == NULL) return NULL;
+	
+	snprintf(publisher->shmname, sizeof(publisher->shmname), MMGUI_LIVE_STATS_SEGMENT_NAME, (unsigned int)getuid());
+	
+	/*Segment left by previous run is replaced, segment of other user can not be removed and is never opened*/
+	shm_unlink(publisher->shmname);
+	
+	publisher->shmfd = shm_open(publisher->shmname, O_RDWR|O_CREAT|O_EXCL, MMGUI_LIVE_STATS_SEGMENT_PERM);
+	if (publisher->shmfd == -1) {
+		free(publisher);
+		return NULL;
+	}
+	
+	if ((fstat(publisher->shmfd, &shmstat) == -1) || (shmstat.st_uid != getuid())) {
+		close(publisher->shmfd);
+		free(publisher);
+		return NULL;
+	}
+	
+	/*Permissions are not changed by umask after fchmod*/
+	fchmod(publisher->shmfd, MMGUI_LIVE_STATS_SEGMENT_PERM);
+	
+	if (ftruncate(publisher->shmfd, sizeof(struct _mmgui_live_stats_segment)) == -1) {
+		close(publisher->shmfd);
+		shm_unlink(publisher->shmname);
+		free(publisher);
+		return NULL;
+	}
+	
+	segment = (mmgui_live_stats_segment_t)mmap(NULL, sizeof(struct _mmgui_live_stats_segment), PROT_READ|PROT_WRITE, MAP_SHARED, publisher->shmfd, 0);
+	if ((void *)segment == MAP_FAILED) {
+		close(publisher->shmfd);
+		shm_unlink(publisher->shmname);
+		free(publisher);
+		return NULL;
+	}
+	
+	/*Readers ignore segment until magic is set, so header goes last*/
+	__atomic_store_n(&segment->magic, 0, __ATOMIC_RELEASE);
+	memset(segment->slots, 0, sizeof(segment->slots));
+	segment->version = MMGUI_LIVE_STATS_VERSION;
+	segment->segmentsize = sizeof(struct _mmgui_live_stats_segment);
+	segment->slotsize = sizeof(struct _mmgui_live_stats_slot);
+	segment->maxdevices = MMGUI_LIVE_STATS_MAX_DEVICES;
+	segment->writerpid = (uint32_t)getpid();
+	__atomic_store_n(&segment->magic, MMGUI_LIVE_STATS_MAGIC, __ATOMIC_RELEASE);
+	
+	publisher->segment = segment;
+	
+	return publisher;
+}
+
+void mmgui_live_stats_publisher_close(mmgui_live_stats_publisher_t publisher)
+{
+	if (publisher == NULL) return;
+	
+	if (publisher->segment != NULL) {
+		__atomic_store_n(&publisher->segment->magic, 0, __ATOMIC_RELEASE);
+		munmap(publisher->segment, sizeof(struct _mmgui_live_stats_segment));
+	}
+	
+	if (publisher->shmfd != -1) {
+		close(publisher->shmfd);
+		shm_unlink(publisher->shmname);
+	}
+	
+	free(publisher);
+}
+
+int mmgui_live_stats_publish(mmgui_live_stats_publisher_t publisher, const struct _mmgui_live_stats_device *device)
+{
+	struct _mmgui_live_stats_slot *slot;
+	struct _mmgui_live_stats_device values;
+	
+	if ((publisher == NULL) || (publisher->segment == NULL) || (device == NULL)) return 0;
+	
+	slot = mmgui_live_stats_find_slot(publisher->segment, device->persistentid, 1);
+	if (slot == NULL) return 0;
+	
+	memcpy(&values, device, sizeof(values));
+	values.flags |= MMGUI_LIVE_STATS_FLAG_ACTIVE;
+	values.updated = mmgui_live_stats_realtime();
+	/*Strings are always terminated for readers*/
+	values.persistentid[MMGUI_LIVE_STATS_ID_LENGTH - 1] = '\0';
+	values.model[MMGUI_LIVE_STATS_NAME_LENGTH - 1] = '\0';
+	values.operatorname[MMGUI_LIVE_STATS_NAME_LENGTH - 1] = '\0';
+	values.interface[MMGUI_LIVE_STATS_IFNAME_LENGTH - 1] = '\0';
+	
+	mmgui_live_stats_slot_write(slot, &values);
+	
+	return 1;
+}
+
+int mmgui_live_stats_deactivate(mmgui_live_stats_publisher_t publisher, const char *persistentid)
+{
+	struct _mmgui_live_stats_slot *slot;
+	struct _mmgui_live_stats_device values;
+	
+	if ((publisher == NULL) || (publisher->segment == NULL) || (persistentid == NULL)) return 0;
+	
+	slot = mmgui_live_stats_find_slot(publisher->segment, persistentid, 0);
+	if (slot == NULL) return 0;
+	
+	/*Single writer may read its own slot without sequence check*/
+	memcpy(&values, &slot->device, sizeof(values));
+	values.flags &= ~(MMGUI_LIVE_STATS_FLAG_ACTIVE|MMGUI_LIVE_STATS_FLAG_CONNECTED);
+	values.rxspeed = 0.0;
+	values.txspeed = 0.0;
+	values.updated = mmgui_live_stats_realtime();
+	
+	mmgui_live_stats_slot_write(slot, &values);
+	
+	return 1;
+}
+
+mmgui_live_stats_reader_t mmgui_live_stats_reader_open(uid_t uid)
+{
+	mmgui_live_stats_reader_t reader;
+	char shmname[32];
+	struct stat shmstat;
+	mmgui_live_stats_segment_t segment;
+	
+	snprintf(shmname, sizeof(shmname), MMGUI_LIVE_STATS_SEGMENT_NAME, (unsigned int)uid);
+	
+	reader = calloc(1, sizeof(struct _mmgui_live_stats_reader));
+	if (reader == NULL) return NULL;
+	
+	reader->shmfd = shm_open(shmname, O_RDONLY, 0);
+	if (reader->shmfd == -1) {
+		free(reader);
+		return NULL;
+	}
+	
+	/*Segment created by another user is not trusted*/
+	if ((fstat(reader->shmfd, &shmstat) == -1) || (shmstat.st_uid != uid) || (shmstat.st_size < (off_t)sizeof(struct _mmgui_live_stats_segment))) {
+		close(reader->shmfd);
+		free(reader);
+		return NULL;
+	}
+	
+	segment = (mmgui_live_stats_segment_t)mmap(NULL, sizeof(struct _mmgui_live_stats_segment), PROT_READ, MAP_SHARED, reader->shmfd, 0);
+	if ((void *)segment == MAP_FAILED) {
+		close(reader->shmfd);
+		free(reader);
+		return NULL;
+	}
+	
+	/*Layout must match exactly, readers of other versions must not guess*/
+	if ((__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) != MMGUI_LIVE_STATS_MAGIC) || (segment->version != MMGUI_LIVE_STATS_VERSION) || (segment->slotsize != sizeof(struct _mmgui_live_stats_slot)) || (segment->maxdevices > MMGUI_LIVE_STATS_MAX_DEVICES)) {
+		munmap(segment, sizeof(struct _mmgui_live_stats_segment));
+		close(reader->shmfd);
+		free(reader);
+		return NULL;
+	}
+	
+	reader->segment = segment;
+	
+	return reader;
+}
+
+void mmgui_live_stats_reader_close(mmgui_live_stats_reader_t reader)
+{
+	if (reader == NULL) return;
+	
+	if (reader->segment != NULL) {
+		munmap(reader->segment, sizeof(struct _mmgui_live_stats_segment));
+	}
+	
+	if (reader->shmfd != -1) {
+		close(reader->shmfd);
+	}
+	
+	free(reader);
+}
+
+unsigned int mmgui_live_stats_reader_get_slots(mmgui_live_stats_reader_t reader)
+{
+	if ((reader == NULL) || (reader->segment == NULL)) return 0;
+	
+	return reader->segment->maxdevices;
+}
+
+int mmgui_live_stats_read(mmgui_live_stats_reader_t reader, unsigned int slot, struct _mmgui_live_stats_device *device)
+{
+	struct _mmgui_live_stats_slot *segslot;
+	uint32_t before, after;
+	unsigned int attempt;
+	
+	if ((reader == NULL) || (reader->segment == NULL) || (device == NULL)) return -1;
+	if (slot >= reader->segment->maxdevices) return -1;
+	
+	/*Writer closed or restarted segment*/
+	if (__atomic_load_n(&reader->segment->magic, __ATOMIC_ACQUIRE) != MMGUI_LIVE_STATS_MAGIC) return -1;
+	
+	segslot = &reader->segment->slots[slot];
+	
+	for (attempt = 0; attempt < MMGUI_LIVE_STATS_READ_RETRIES; attempt++) {
+		before = __atomic_load_n(&segslot->sequence, __ATOMIC_ACQUIRE);
+		if (before & 1) continue;
+		memcpy(device, (const void *)&segslot->device, sizeof(struct _mmgui_live_stats_device));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&segslot->sequence, __ATOMIC_RELAXED);
+		if (before == after) {
+			return (device->flags & MMGUI_LIVE_STATS_FLAG_ACTIVE) ? 1 : 0;
+		}
+	}
+	
+	return -1;
+}
+
+const char *mmgui_live_stats_mode_name(uint32_t mode)
+{
+	/*Short names in enum _mmgui_device_modes order*/
+	static const char *modenames[] = {"Unknown", "GSM", "GSM Compact", "GPRS", "EDGE", "UMTS", "HSDPA", "HSUPA", "HSPA", "HSPA+", "1xRTT", "EVDO0", "EVDOA", "EVDOB", "LTE"};
+	
+	if (mode >= sizeof(modenames) / sizeof(modenames[0])) return modenames[0];
+	
+	return modenames[mode];
+}
+
+const char *mmgui_live_stats_reg_status_name(uint32_t regstatus)
+{
+	/*Names in enum _mmgui_reg_status order*/
+	static const char *regnames[] = {"Idle", "Home", "Searching", "Denied", "Unknown", "Roaming"};
+	
+	if (regstatus >= sizeof(regnames) / sizeof(regnames[0])) return regnames[4];
+	
+	return regnames[regstatus];
+}
+
+static struct _mmgui_live_stats_slot *mmgui_live_stats_find_slot(mmgui_live_stats_segment_t segment, const char *persistentid, int allocate)
+{
+	unsigned int i;
+	struct _mmgui_live_stats_slot *freeslot, *oldestslot;
+	
+	if (persistentid == NULL) return NULL;
+	
+	freeslot = NULL;
+	oldestslot = NULL;
+	
+	for (i = 0; i < MMGUI_LIVE_STATS_MAX_DEVICES; i++) {
+		if (strncmp(segment->slots[i].device.persistentid, persistentid, MMGUI_LIVE_STATS_ID_LENGTH - 1) == 0) {
+			return &segment->slots[i];
+		}
+		if ((freeslot == NULL) && (segment->slots[i].device.persistentid[0] == '\0')) {
+			freeslot = &segment->slots[i];
+		}
+		if ((!(segment->slots[i].device.flags & MMGUI_LIVE_STATS_FLAG_ACTIVE)) && ((oldestslot == NULL) || (segment->slots[i].device.updated < oldestslot->device.updated))) {
+			oldestslot = &segment->slots[i];
+		}
+	}
+	
+	if (!allocate) return NULL;
+	
+	/*Slot of device not seen for longest time is reused*/
+	return (freeslot != NULL) ? freeslot : oldestslot;
+}
+
+static void mmgui_live_stats_slot_write(struct _mmgui_live_stats_slot *slot, const struct _mmgui_live_stats_device *device)
+{
+	uint32_t sequence;
+	
+	sequence = slot->sequence;
+	
+	/*Odd sequence marks slot busy before any value changes*/
+	__atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	
+	memcpy(&slot->device, device, sizeof(struct _mmgui_live_stats_device));
+	
+	__atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+static uint64_t mmgui_live_stats_realtime(void)
+{
+	struct timespec ts;
+	
+	if (clock_gettime(CLOCK_REALTIME, &ts) != 0) return 0;
+	
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
@@ -0,0 +1,116 @@
+/*
+ *      livestats.h
+ *      
+ *      Copyright 2026 Alex <alex@linuxonly.ru>
+ *      
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIVESTATS_H__
+#define __LIVESTATS_H__
+
+/*Segment is read by external programs, so only fixed-width C types are used here*/
+#include <stdint.h>
+#include <sys/types.h>
+
+#define MMGUI_LIVE_STATS_SEGMENT_NAME   "/mmgui_live_%u"
+/*Segment shows modem, operator and traffic data, so only owner may read it*/
+#define MMGUI_LIVE_STATS_SEGMENT_PERM   0600
+#define MMGUI_LIVE_STATS_MAGIC          0x534c4d4d
+#define MMGUI_LIVE_STATS_VERSION        1
+#define MMGUI_LIVE_STATS_MAX_DEVICES    8
+#define MMGUI_LIVE_STATS_ID_LENGTH      64
+#define MMGUI_LIVE_STATS_NAME_LENGTH    64
+#define MMGUI_LIVE_STATS_IFNAME_LENGTH  16
+/*Reader gives up if writer keeps slot busy for this many attempts*/
+#define MMGUI_LIVE_STATS_READ_RETRIES   1000
+
+enum _mmgui_live_stats_flags {
+	MMGUI_LIVE_STATS_FLAG_ACTIVE     = 0x01,
+	MMGUI_LIVE_STATS_FLAG_ENABLED    = 0x02,
+	MMGUI_LIVE_STATS_FLAG_REGISTERED = 0x04,
+	MMGUI_LIVE_STATS_FLAG_CONNECTED  = 0x08
+};
+
+/*Per-device values, regstatus and mode follow enum _mmgui_reg_status and enum _mmgui_device_modes*/
+struct _mmgui_live_stats_device {
+	uint32_t flags;
+	uint32_t siglevel;
+	uint32_t regstatus;
+	uint32_t mode;
+	uint64_t updated; /*realtime, milliseconds*/
+	uint64_t rxbytes;
+	uint64_t txbytes;
+	uint64_t sessiontime;
+	float rxspeed; /*kbit/s*/
+	float txspeed; /*kbit/s*/
+	char persistentid[MMGUI_LIVE_STATS_ID_LENGTH];
+	char model[MMGUI_LIVE_STATS_NAME_LENGTH];
+	char operatorname[MMGUI_LIVE_STATS_NAME_LENGTH];
+	char interface[MMGUI_LIVE_STATS_IFNAME_LENGTH];
+};
+
+typedef struct _mmgui_live_stats_device *mmgui_live_stats_device_t;
+
+/*Device slot guarded by sequence counter, odd while values are written*/
+struct _mmgui_live_stats_slot {
+	volatile uint32_t sequence;
+	uint32_t reserved;
+	struct _mmgui_live_stats_device device;
+};
+
+/*Segment layout, version is raised on every incompatible change*/
+struct _mmgui_live_stats_segment {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t segmentsize;
+	uint32_t slotsize;
+	uint32_t maxdevices;
+	uint32_t writerpid;
+	struct _mmgui_live_stats_slot slots[MMGUI_LIVE_STATS_MAX_DEVICES];
+};
+
+typedef struct _mmgui_live_stats_segment *mmgui_live_stats_segment_t;
+
+/*Writer side (modem-manager-gui)*/
+struct _mmgui_live_stats_publisher {
+	int shmfd;
+	char shmname[32];
+	mmgui_live_stats_segment_t segment;
+};
+
+typedef struct _mmgui_live_stats_publisher *mmgui_live_stats_publisher_t;
+
+/*Reader side*/
+struct _mmgui_live_stats_reader {
+	int shmfd;
+	mmgui_live_stats_segment_t segment;
+};
+
+typedef struct _mmgui_live_stats_reader *mmgui_live_stats_reader_t;
+
+/*Publisher functions*/
+mmgui_live_stats_publisher_t mmgui_live_stats_publisher_open(void);
+void mmgui_live_stats_publisher_close(mmgui_live_stats_publisher_t publisher);
+int mmgui_live_stats_publish(mmgui_live_stats_publisher_t publisher, const struct _mmgui_live_stats_device *device);
+int mmgui_live_stats_deactivate(mmgui_live_stats_publisher_t publisher, const char *persistentid);
+/*Reader functions*/
+mmgui_live_stats_reader_t mmgui_live_stats_reader_open(uid_t uid);
+void mmgui_live_stats_reader_close(mmgui_live_stats_reader_t reader);
+unsigned int mmgui_live_stats_reader_get_slots(mmgui_live_stats_reader_t reader);
+int mmgui_live_stats_read(mmgui_live_stats_reader_t reader, unsigned int slot, struct _mmgui_live_stats_device *device);
+const char *mmgui_live_stats_mode_name(uint32_t mode);
+const char *mmgui_live_stats_reg_status_name(uint32_t regstatus);
+
+#endif /* __LIVESTATS_H__ */
@@ -47,6 +47,8 @@
 #include "mmguicore.h"
 #include "smsdb.h"
 #include "trafficdb.h"
+#include "speedhistory.h"
+#include "trafficexport.h"
 #include "netlink.h"
 #include "../resources.h"
 
@@ -378,6 +380,14 @@ static void mmgui_main_event_callback(enum _mmgui_event event, gpointer mmguicor
 			appdata->data = GINT_TO_POINTER(event);
 			g_idle_add(mmgui_main_traffic_limits_show_message_from_thread, appdata);
 			break;
+		case MMGUI_EVENT_TRAFFIC_LIMIT_WARNING:
+		case MMGUI_EVENT_TIME_LIMIT_WARNING:
+			appdata = g_new0(struct _mmgui_application_data, 1);
+			appdata->mmguiapp = mmguiapp;
+			/*Used percent of limit is kept in upper bits*/
+			appdata->data = GUINT_TO_POINTER((guint)event | (GPOINTER_TO_UINT(data) << 16));
+			g_idle_add(mmgui_main_traffic_limits_show_message_from_thread, appdata);
+			break;
 		case MMGUI_EVENT_UPDATE_CONNECTIONS_LIST:
 			g_idle_add(mmgui_main_traffic_connections_update_from_thread, mmguiapp);
 			break;
@@ -2165,6 +2175,7 @@ static gboolean mmgui_main_settings_ui_load(mmgui_application_t mmguiapp)
 static gboolean mmgui_main_settings_load(mmgui_application_t mmguiapp)
 {
 	gchar *strparam;
+	gint intparam;
 	
 	if (mmguiapp == NULL) return FALSE;
 	if ((mmguiapp->options == NULL) || (mmguiapp->settings == NULL)) return FALSE;
@@ -2197,12 +2208,37 @@ static gboolean mmgui_main_settings_load(mmgui_application_t mmguiapp)
 		g_free(strparam);
 	#endif
 	mmguiapp->options->graphrighttoleft = gmm_settings_get_boolean(mmguiapp->settings, "graph_right_to_left", FALSE);
+	/*Speed graph history length in samples*/
+	mmguiapp->coreoptions->speedhistorylength = CLAMP(gmm_settings_get_int(mmguiapp->settings, "graph_history_length", MMGUI_SPEED_HISTORY_MIN_LENGTH), MMGUI_SPEED_HISTORY_MIN_LENGTH, MMGUI_SPEED_HISTORY_MAX_LENGTH);
+	/*Sampling period while speed graph is visible (0 - disabled)*/
+	intparam = gmm_settings_get_int(mmguiapp->settings, "graph_live_sampling_period", MMGUI_THREAD_LIVE_PERIOD);
+	if (intparam > 0) {
+		mmguiapp->coreoptions->livesamplingperiod = CLAMP(intparam, 100, 1000);
+	} else {
+		mmguiapp->coreoptions->livesamplingperiod = 0;
+	}
+	/*Traffic export directory (empty - disabled), interval and format of day and live files*/
+	if (mmguiapp->coreoptions->exportdirectory != NULL) {
+		g_free(mmguiapp->coreoptions->exportdirectory);
+		mmguiapp->coreoptions->exportdirectory = NULL;
+	}
+	strparam = gmm_settings_get_string(mmguiapp->settings, "export_directory", "");
+	if ((strparam != NULL) && (strparam[0] != '\0')) {
+		mmguiapp->coreoptions->exportdirectory = strparam;
+	} else {
+		g_free(strparam);
+	}
+	mmguiapp->coreoptions->exportinterval = CLAMP(gmm_settings_get_int(mmguiapp->settings, "export_interval", MMGUI_TRAFFIC_EXPORT_DEFAULT_INTERVAL), MMGUI_TRAFFIC_EXPORT_MIN_INTERVAL, MMGUI_TRAFFIC_EXPORT_MAX_INTERVAL);
+	strparam = gmm_settings_get_string(mmguiapp->settings, "export_format", "csv");
+	mmguiapp->coreoptions->exportformat = mmgui_traffic_export_format_from_string(strparam);
+	g_free(strparam);
 	
 	/*SMS options*/
 	mmguiapp->options->concatsms = gmm_settings_get_boolean(mmguiapp->settings, "sms_concatenation", FALSE);
 	mmguiapp->options->smsexpandfolders = gmm_settings_get_boolean(mmguiapp->settings, "sms_expand_folders", TRUE);
 	mmguiapp->options->smsoldontop = gmm_settings_get_boolean(mmguiapp->settings, "sms_old_on_top", TRUE);
 	mmguiapp->options->smsvalidityperiod = gmm_settings_get_int(mmguiapp->settings, "sms_validity_period", -1);
+	mmguiapp->options->smsarchivemonths = gmm_settings_get_int(mmguiapp->settings, "sms_archive_months", 0);
 	mmguiapp->options->smsdeliveryreport = gmm_settings_get_boolean(mmguiapp->settings, "sms_send_delivery_report", FALSE);
 	strparam = gmm_settings_get_string(mmguiapp->settings, "sms_custom_command", "");
 	mmguiapp->options->smscustomcommand = g_strcompress(strparam);
@@ -2387,6 +2423,7 @@ static gboolean mmgui_main_application_build_user_interface(mmgui_application_t
 		{"newsmsbutton", &(mmguiapp->window->newsmsbutton)},
 		{"removesmsbutton", &(mmguiapp->window->removesmsbutton)},
 		{"answersmsbutton", &(mmguiapp->window->answersmsbutton)},
+		{"smssearchentry", &(mmguiapp->window->smssearchentry)},
 		/*Info page*/
 		{"devicevlabel", &(mmguiapp->window->devicevlabel)},
 		{"operatorvlabel", &(mmguiapp->window->operatorvlabel)},
@@ -2435,11 +2472,13 @@ static gboolean mmgui_main_application_build_user_interface(mmgui_application_t
 		{"trafficunits", &(mmguiapp->window->trafficunits)},
 		{"trafficmessage", &(mmguiapp->window->trafficmessage)},
 		{"trafficaction", &(mmguiapp->window->trafficaction)},
+		{"trafficperiod", &(mmguiapp->window->trafficperiod)},
 		{"timelimitcheckbutton", &(mmguiapp->window->timelimitcheckbutton)},
 		{"timeamount", &(mmguiapp->window->timeamount)},
 		{"timeunits", &(mmguiapp->window->timeunits)},
 		{"timemessage", &(mmguiapp->window->timemessage)},
 		{"timeaction", &(mmguiapp->window->timeaction)},
+		{"timeperiod", &(mmguiapp->window->timeperiod)},
 		/*Connections dialog*/
 		{"conndialog", &(mmguiapp->window->conndialog)},
 		{"connscrolledwindow", &(mmguiapp->window->connscrolledwindow)},
@@ -2450,6 +2489,7 @@ static gboolean mmgui_main_application_build_user_interface(mmgui_application_t
 		{"trafficstatstreeview", &(mmguiapp->window->trafficstatstreeview)},
 		{"trafficstatsmonthcb", &(mmguiapp->window->trafficstatsmonthcb)},
 		{"trafficstatsyearcb", &(mmguiapp->window->trafficstatsyearcb)},
+		{"trafficstatsalldevicescb", &(mmguiapp->window->trafficstatsalldevicescb)},
 		/*USSD edition dialog*/
 		{"ussdeditdialog", &(mmguiapp->window->ussdeditdialog)},
 		{"ussdedittreeview", &(mmguiapp->window->ussdedittreeview)},
@@ -2462,6 +2502,7 @@ static gboolean mmgui_main_application_build_user_interface(mmgui_application_t
 		{"prefssmsoldontop", &(mmguiapp->window->prefsmsoldontop)},
 		{"prefsmsvalidityscale", &(mmguiapp->window->prefsmsvalidityscale)},
 		{"prefsmsreportcb", &(mmguiapp->window->prefsmsreportcb)},
+		{"prefsmsarchivespin", &(mmguiapp->window->prefsmsarchivespin)},
 		{"prefsmscommandentry", &(mmguiapp->window->prefsmscommandentry)},
 		{"preftrafficrxcolor", &(mmguiapp->window->preftrafficrxcolor)},
 		{"preftraffictxcolor", &(mmguiapp->window->preftraffictxcolor)},
@@ -2802,6 +2843,8 @@ static void mmgui_main_continue_initialization(mmgui_application_t mmguiapp, mmg
 	}
 	/*Redraw traffic graph signal*/
 	g_signal_connect(G_OBJECT(mmguiapp->window->trafficdrawingarea), "draw", G_CALLBACK(mmgui_main_traffic_speed_plot_draw), mmguiapp);
+	g_signal_connect(G_OBJECT(mmguiapp->window->trafficdrawingarea), "map", G_CALLBACK(mmgui_main_traffic_speed_plot_map_signal), mmguiapp);
+	g_signal_connect(G_OBJECT(mmguiapp->window->trafficdrawingarea), "unmap", G_CALLBACK(mmgui_main_traffic_speed_plot_unmap_signal), mmguiapp);
 }
 
 static void mmgui_main_application_activate_signal(GtkApplication *application, gpointer data)
@@ -2869,6 +2912,16 @@ static void mmgui_main_application_shutdown_signal(GtkApplication *application,
 	mmgui_ayatana_close(mmguiapp->ayatana);
 	/*Close core interface*/
 	mmguicore_close(mmguiapp->core);
+	/*Free connections list rows map*/
+	if (mmguiapp->window->connrows != NULL) {
+		g_hash_table_destroy(mmguiapp->window->connrows);
+		mmguiapp->window->connrows = NULL;
+	}
+	/*Free messages list rows map*/
+	if (mmguiapp->window->smsrows != NULL) {
+		g_hash_table_destroy(mmguiapp->window->smsrows);
+		mmguiapp->window->smsrows = NULL;
+	}
 	/*Close settings interface*/
 	gmm_settings_close(mmguiapp->settings);
 }
@@ -3000,6 +3053,7 @@ int main(int argc, char *argv[])
 	mmguiapp->coreoptions->trafficaction = 0;
 	mmguiapp->coreoptions->trafficfull = 0;
 	mmguiapp->coreoptions->trafficexecuted = FALSE;
+	mmguiapp->coreoptions->trafficperiod = MMGUI_LIMIT_PERIOD_SESSION;
 	mmguiapp->coreoptions->timeenabled = FALSE;
 	mmguiapp->coreoptions->timeamount = 60;
 	mmguiapp->coreoptions->timeunits = 0;
@@ -3007,6 +3061,12 @@ int main(int argc, char *argv[])
 	mmguiapp->coreoptions->timeaction = 0;
 	mmguiapp->coreoptions->timefull = 0;
 	mmguiapp->coreoptions->timeexecuted = FALSE;
+	mmguiapp->coreoptions->timeperiod = MMGUI_LIMIT_PERIOD_SESSION;
+	mmguiapp->coreoptions->speedhistorylength = MMGUI_SPEED_HISTORY_MIN_LENGTH;
+	mmguiapp->coreoptions->livesamplingperiod = MMGUI_THREAD_LIVE_PERIOD;
+	mmguiapp->coreoptions->exportdirectory = NULL;
+	mmguiapp->coreoptions->exportinterval = MMGUI_TRAFFIC_EXPORT_DEFAULT_INTERVAL;
+	mmguiapp->coreoptions->exportformat = MMGUI_TRAFFIC_EXPORT_FORMAT_CSV;
 	listmodules = FALSE;
 	
 	/*Predefined CLI options*/
@@ -3116,6 +3176,9 @@ int main(int argc, char *argv[])
 		if (mmguiapp->coreoptions->timemessage != NULL) {
 			g_free(mmguiapp->coreoptions->timemessage);
 		}
+		if (mmguiapp->coreoptions->exportdirectory != NULL) {
+			g_free(mmguiapp->coreoptions->exportdirectory);
+		}
 		g_free(mmguiapp->coreoptions);
 	}
 	if (mmguiapp != NULL) {
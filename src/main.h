@@ -175,6 +175,9 @@ struct _mmgui_main_window {
 	GtkWidget *newsmsbutton;
 	GtkWidget *removesmsbutton;
 	GtkWidget *answersmsbutton;
+	GtkWidget *smssearchentry;
+	guint smssearchtimeout;
+	GHashTable *smsrows;
 	GdkPixbuf *smsreadicon;
 	GdkPixbuf *smsunreadicon;
 	GdkPixbuf *smsrecvfoldericon;
@@ -183,6 +186,7 @@ struct _mmgui_main_window {
 	GtkTreePath *incomingpath;
 	GtkTreePath *sentpath;
 	GtkTreePath *draftspath;
+	GtkTreePath *threadspath;
 	GtkTextTag *smsheadingtag;
 	GtkTextTag *smsdatetag;
 	/*Info page*/
@@ -219,6 +223,9 @@ struct _mmgui_main_window {
 	GtkWidget *trafficdrawingarea;
 	GtkWidget *trafficlimitbutton;
 	GtkWidget *trafficconnbutton;
+	gpointer trafficappsdb;
+	guint trafficappsgeneration;
+	time_t trafficappstime;
 	/*Contacts page*/
 	GtkWidget *newcontactbutton;
 	GtkWidget *removecontactbutton;
@@ -244,22 +251,27 @@ struct _mmgui_main_window {
 	GtkWidget *trafficunits;
 	GtkWidget *trafficmessage;
 	GtkWidget *trafficaction;
+	GtkWidget *trafficperiod;
 	GtkWidget *timelimitcheckbutton;
 	GtkWidget *timeamount;
 	GtkWidget *timeunits;
 	GtkWidget *timemessage;
 	GtkWidget *timeaction;
+	GtkWidget *timeperiod;
 	/*Connections dialog*/
 	GtkAccelGroup *connaccelgroup;
 	GtkWidget *conndialog;
 	GtkWidget *connscrolledwindow;
 	GtkWidget *conntreeview;
 	GtkWidget *conntermtoolbutton;
+	GHashTable *connrows;
 	/*Traffic statistics dialog*/
 	GtkWidget *trafficstatsdialog;
 	GtkWidget *trafficstatstreeview;
 	GtkWidget *trafficstatsmonthcb;
 	GtkWidget *trafficstatsyearcb;
+	GtkWidget *trafficstatsalldevicescb;
+	guint trafficstatsreport;
 	/*USSD editor dialog*/
 	GtkAccelGroup *ussdaccelgroup;
 	GtkWidget *ussdeditdialog;
@@ -273,6 +285,7 @@ struct _mmgui_main_window {
 	GtkWidget *prefsmsoldontop;
 	GtkWidget *prefsmsvalidityscale;
 	GtkWidget *prefsmsreportcb;
+	GtkWidget *prefsmsarchivespin;
 	GtkWidget *prefsmscommandentry;
 	GtkWidget *preftrafficrxcolor;
 	GtkWidget *preftraffictxcolor;
@@ -344,6 +357,7 @@ struct _mmgui_cli_options {
 	gboolean smsoldontop;
 	gboolean smsdeliveryreport;
 	gint smsvalidityperiod;
+	gint smsarchivemonths;
 	gchar *smscustomcommand;
 	/*Traffic graph*/
 	#if GTK_CHECK_VERSION(3,4,0)
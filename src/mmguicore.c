@@ -29,10 +29,14 @@
 #include <stdarg.h>
 #include <sys/stat.h>
 #include <poll.h>
+#include <time.h>
 
 #include "mmguicore.h"
 #include "smsdb.h"
 #include "trafficdb.h"
+#include "speedhistory.h"
+#include "trafficexport.h"
+#include "livestats.h"
 #include "netlink.h"
 #include "polkit.h"
 #include "svcmanager.h"
@@ -69,6 +73,7 @@
 /*Commands*/
 #define MMGUI_THREAD_STOP_CMD            0x00
 #define MMGUI_THREAD_REFRESH_CMD         0x01
+#define MMGUI_THREAD_SAMPLING_CMD        0x02
 
 
 static void mmguicore_event_callback(enum _mmgui_event event, gpointer mmguicore, gpointer data);
@@ -114,12 +119,26 @@ static gint mmguicore_contacts_get_compare(gconstpointer a, gconstpointer b);
 static gint mmguicore_contacts_delete_compare(gconstpointer a, gconstpointer b);
 static gboolean mmguicore_main(mmguicore_t mmguicore);
 static gpointer mmguicore_work_thread(gpointer data);
-static void mmguicore_traffic_count(mmguicore_t mmguicore, guint64 rxbytes, guint64 txbytes);
+static guint64 mmguicore_monotonic_time(void);
+static void mmguicore_traffic_count(mmguicore_t mmguicore, guint64 rxbytes, guint64 txbytes, gboolean counters64, guint64 timestamp);
 static void mmguicore_traffic_zero(mmguicore_t mmguicore);
-static void mmguicore_traffic_limits(mmguicore_t mmguicore);
+static void mmguicore_traffic_account_applications(mmguicore_t mmguicore);
+static void mmguicore_traffic_export(mmguicore_t mmguicore, time_t currenttime);
+static void mmguicore_live_stats_publish(mmguicore_t mmguicore);
+static time_t mmguicore_traffic_limits_window_end(guint period, time_t currenttime);
+static void mmguicore_traffic_limits_window_usage(mmguicore_t mmguicore, guint period, guint64 *bytes, guint64 *seconds);
+static guint64 mmguicore_traffic_limit_value(struct _mmgui_core_limit *limit, guint threshold);
+static void mmguicore_traffic_limit_arm(struct _mmgui_core_limit *limit, gboolean enabled, guint period, guint64 full, guint64 used, gboolean executed, time_t currenttime);
+static gint mmguicore_traffic_limit_advance(struct _mmgui_core_limit *limit, guint64 delta, time_t currenttime, gboolean *executed);
+static void mmguicore_traffic_limits_arm(mmguicore_t mmguicore, guint updates, time_t currenttime);
+static void mmguicore_traffic_limits_advance(mmguicore_t mmguicore, guint64 bytes, guint seconds, time_t currenttime);
+static void mmguicore_traffic_limits_fire(mmguicore_t mmguicore, guint threshold, gboolean *executed, guint action, enum _mmgui_event limitevent, enum _mmgui_event warningevent);
 static void mmguicore_update_connection_status(mmguicore_t mmguicore, gboolean sendresult, gboolean result);
 
 
+/*Share of limit at which events are sent, last one executes limit action*/
+static const guint mmguicore_limit_percents[MMGUI_LIMIT_THRESHOLDS] = {50, 80, 100};
+
 static void mmguicore_event_callback(enum _mmgui_event event, gpointer mmguicore, gpointer data)
 {
 	mmguicore_t mmguicorelc;
@@ -1871,6 +1890,14 @@ gboolean mmguicore_devices_open(mmguicore_t mmguicore, guint deviceid, gboolean
 				mmguicore->device->smsdb = mmgui_smsdb_open(mmguicore->device->persistentid, mmguicore->device->internalid);
 				/*Open traffic database*/
 				mmguicore->device->trafficdb = mmgui_trafficdb_open(mmguicore->device->persistentid, mmguicore->device->internalid);
+				/*Create speed history*/
+				mmguicore->device->speedhistory = mmgui_speed_history_new(mmguicore->options != NULL ? mmguicore->options->speedhistorylength : MMGUI_SPEED_HISTORY_MIN_LENGTH);
+				/*Export history of newly opened device*/
+				mmguicore->exportdaytime = 0;
+				/*Limits are counted from database of newly opened device*/
+				memset(&mmguicore->trafficlimit, 0, sizeof(mmguicore->trafficlimit));
+				memset(&mmguicore->timelimit, 0, sizeof(mmguicore->timelimit));
+				g_atomic_int_or(&mmguicore->limitsupdate, MMGUI_LIMITS_UPDATE_OPTIONS);
 				/*Open contacts*/
 				mmguicore_contacts_enum(mmguicore);
 				/*For Huawei modem USSD answers must be converted*/
@@ -1921,6 +1948,14 @@ gboolean mmguicore_devices_open(mmguicore_t mmguicore, guint deviceid, gboolean
 					mmguicore->device->smsdb = mmgui_smsdb_open(mmguicore->device->persistentid, mmguicore->device->internalid);
 					/*Open traffic database*/
 					mmguicore->device->trafficdb = mmgui_trafficdb_open(mmguicore->device->persistentid, mmguicore->device->internalid);
+					/*Create speed history*/
+					mmguicore->device->speedhistory = mmgui_speed_history_new(mmguicore->options != NULL ? mmguicore->options->speedhistorylength : MMGUI_SPEED_HISTORY_MIN_LENGTH);
+					/*Export history of newly opened device*/
+					mmguicore->exportdaytime = 0;
+					/*Limits are counted from database of newly opened device*/
+					memset(&mmguicore->trafficlimit, 0, sizeof(mmguicore->trafficlimit));
+					memset(&mmguicore->timelimit, 0, sizeof(mmguicore->timelimit));
+					g_atomic_int_or(&mmguicore->limitsupdate, MMGUI_LIMITS_UPDATE_OPTIONS);
 					/*Open contacts*/
 					mmguicore_contacts_enum(mmguicore);
 					/*For Huawei modem USSD answers must be converted*/
@@ -2008,20 +2043,28 @@ static gboolean mmguicore_devices_close(mmguicore_t mmguicore)
 			memset(mmguicore->device->locgpsdata, 0, sizeof(mmguicore->device->locgpsdata));
 			/*Scan*/
 			mmguicore->device->scancaps = MMGUI_SCAN_CAPS_NONE;
+			/*Device is kept in live statistics as inactive*/
+			mmgui_live_stats_deactivate((mmgui_live_stats_publisher_t)mmguicore->livestats, mmguicore->device->persistentid);
 			/*Close traffic database session*/
 			mmgui_trafficdb_session_close(mmguicore->device->trafficdb);
 			/*Close traffic database*/
 			mmgui_trafficdb_close(mmguicore->device->trafficdb);
 			mmguicore->device->trafficdb = NULL;
+			/*Free speed history*/
+			mmgui_speed_history_free(mmguicore->device->speedhistory);
+			mmguicore->device->speedhistory = NULL;
 			/*Traffic*/
 			mmguicore->device->rxbytes = 0;
 			mmguicore->device->txbytes = 0;
 			mmguicore->device->sessiontime = 0;
+			mmguicore->device->sessionrxbytes = 0;
+			mmguicore->device->sessiontxbytes = 0;
 			mmguicore->device->speedchecktime = 0;
 			mmguicore->device->smschecktime = 0;
-			mmguicore->device->speedindex = 0;
+			mmguicore->device->pendingrxbytes = 0;
+			mmguicore->device->pendingtxbytes = 0;
+			mmguicore->device->pendingduration = 0;
 			mmguicore->device->connected = FALSE;
-			memset(mmguicore->device->speedvalues, 0, sizeof(mmguicore->device->speedvalues));
 			memset(mmguicore->device->interface, 0, sizeof(mmguicore->device->interface));
 			/*Zero traffic values in UI*/
 			mmguicore_traffic_zero(mmguicore);
@@ -2774,6 +2817,82 @@ GSList *mmguicore_get_connections_changes(mmguicore_t mmguicore)
 	return changes;
 }
 
+void mmguicore_traffic_set_live_sampling(mmguicore_t mmguicore, gboolean enabled)
+{
+	gint workthreadcmd;
+	
+	if (mmguicore == NULL) return;
+	
+	if (g_atomic_int_get(&mmguicore->livesampling) == (gint)enabled) return;
+	
+	g_atomic_int_set(&mmguicore->livesampling, (gint)enabled);
+	
+	/*Wake up work thread to apply new sampling period at once*/
+	if (mmguicore->workthread != NULL) {
+		workthreadcmd = MMGUI_THREAD_SAMPLING_CMD;
+		if (write(mmguicore->workthreadctl[1], &workthreadcmd, sizeof(workthreadcmd)) != sizeof(workthreadcmd)) {
+			g_debug("Unable to send sampling command\n");
+		}
+	}
+}
+
+void mmguicore_traffic_limits_update(mmguicore_t mmguicore)
+{
+	if (mmguicore == NULL) return;
+	
+	/*Work thread rebuilds limits with next counters update*/
+	g_atomic_int_or(&mmguicore->limitsupdate, MMGUI_LIMITS_UPDATE_OPTIONS);
+}
+
+gboolean mmguicore_traffic_limits_get_usage(mmguicore_t mmguicore, guint64 *trafficused, guint64 *timeused)
+{
+	if (mmguicore == NULL) return FALSE;
+	if (mmguicore->device == NULL) return FALSE;
+	
+	/*Limit counters are advanced by work thread*/
+	#if GLIB_CHECK_VERSION(2,32,0)
+		g_mutex_lock(&mmguicore->workthreadmutex);
+	#else
+		g_mutex_lock(mmguicore->workthreadmutex);
+	#endif
+	
+	if (trafficused != NULL) *trafficused = mmguicore->trafficlimit.used;
+	if (timeused != NULL) *timeused = mmguicore->timelimit.used;
+	
+	#if GLIB_CHECK_VERSION(2,32,0)
+		g_mutex_unlock(&mmguicore->workthreadmutex);
+	#else
+		g_mutex_unlock(mmguicore->workthreadmutex);
+	#endif
+	
+	return TRUE;
+}
+
+gboolean mmguicore_traffic_get_day_traffic(mmguicore_t mmguicore, mmgui_day_traffic_t daytraffic)
+{
+	gboolean res;
+	
+	if ((mmguicore == NULL) || (daytraffic == NULL)) return FALSE;
+	if (mmguicore->device == NULL) return FALSE;
+	
+	/*Session counters are written by work thread*/
+	#if GLIB_CHECK_VERSION(2,32,0)
+		g_mutex_lock(&mmguicore->workthreadmutex);
+	#else
+		g_mutex_lock(mmguicore->workthreadmutex);
+	#endif
+	
+	res = mmgui_trafficdb_session_get_day_traffic((mmgui_trafficdb_t)mmguicore->device->trafficdb, daytraffic);
+	
+	#if GLIB_CHECK_VERSION(2,32,0)
+		g_mutex_unlock(&mmguicore->workthreadmutex);
+	#else
+		g_mutex_unlock(mmguicore->workthreadmutex);
+	#endif
+	
+	return res;
+}
+
 gchar *mmguicore_get_last_error(mmguicore_t mmguicore)
 {
 	if ((mmguicore == NULL) || (mmguicore->last_error_func == NULL)) return NULL;
@@ -2907,6 +3026,16 @@ static gboolean mmguicore_main(mmguicore_t mmguicore)
 	/*New day time*/
 	mmguicore->newdaytime = mmgui_trafficdb_get_new_day_timesatmp(time(NULL), NULL, NULL);
 	
+	/*Traffic export*/
+	mmguicore->exporttime = 0;
+	mmguicore->exportdaytime = 0;
+	
+	/*Live statistics for external readers*/
+	mmguicore->livestats = mmgui_live_stats_publisher_open();
+	if (mmguicore->livestats == NULL) {
+		g_debug("Unable to open live statistics segment\n");
+	}
+	
 	/*Work thread*/
 	if (pipe(mmguicore->workthreadctl) == 0) {
 		#if GLIB_CHECK_VERSION(2,32,0)
@@ -2962,6 +3091,11 @@ void mmguicore_close(mmguicore_t mmguicore)
 	if (mmguicore->netlink != NULL) {
 		mmgui_netlink_close(mmguicore->netlink);
 	}
+	/*Remove live statistics segment*/
+	if (mmguicore->livestats != NULL) {
+		mmgui_live_stats_publisher_close((mmgui_live_stats_publisher_t)mmguicore->livestats);
+		mmguicore->livestats = NULL;
+	}
 	/*Close service manager interface*/
 	mmgui_svcmanager_close(mmguicore->svcmanager);
 	/*Close polkit interface*/
@@ -2994,8 +3128,10 @@ static gpointer mmguicore_work_thread(gpointer data)
 	struct msghdr intmsg;
 	/*Connections monitoring*/
 	gint connfd, connfdnum;
-	struct iovec conniov;
-	struct msghdr connmsg;
+	gboolean recvconns;
+	/*Sampling*/
+	guint64 sampletime, nextsampletime, nextconnstime, sampleperiod;
+	gint polltimeout;
 	/*Events*/
 	struct _mmgui_netlink_interface_event event;
 	time_t ifstatetime, currenttime;
@@ -3012,8 +3148,6 @@ static gpointer mmguicore_work_thread(gpointer data)
 	databuf = g_malloc0(databufsize);
 	intiov.iov_len = databufsize;
 	intiov.iov_base = databuf;
-	conniov.iov_len = databufsize;
-	conniov.iov_base = databuf;
 	
 	/*Initialize active sockets*/
 	activesockets = 0;
@@ -3052,21 +3186,34 @@ static gpointer mmguicore_work_thread(gpointer data)
 		connfdnum = activesockets;
 		pollfds[connfdnum].fd = connfd;
 		pollfds[connfdnum].events = POLLIN;
-		connmsg.msg_name = (void *)mmgui_netlink_get_connections_monitoring_socket_address(mmguicore->netlink);
-		connmsg.msg_namelen = sizeof(struct sockaddr_nl);
-		connmsg.msg_iov = &conniov;
-		connmsg.msg_iovlen = 1;
-		connmsg.msg_control = NULL;
-		connmsg.msg_controllen = 0;
-		connmsg.msg_flags = 0;
 		activesockets++;
 	}
 	
 	/*First we have to get device state*/
 	ifstatetime = time(NULL);
 	
+	sampletime = mmguicore_monotonic_time();
+	nextsampletime = sampletime + MMGUI_THREAD_SLEEP_PERIOD * G_GUINT64_CONSTANT(1000000000);
+	nextconnstime = nextsampletime;
+	
 	while (TRUE) {
-		pollstatus = poll(pollfds, activesockets, 1000);
+		/*Sample faster while live statistics are shown*/
+		if ((g_atomic_int_get(&mmguicore->livesampling)) && (mmguicore->options != NULL) && (mmguicore->options->livesamplingperiod > 0)) {
+			sampleperiod = mmguicore->options->livesamplingperiod * G_GUINT64_CONSTANT(1000000);
+		} else {
+			sampleperiod = MMGUI_THREAD_SLEEP_PERIOD * G_GUINT64_CONSTANT(1000000000);
+		}
+		sampletime = mmguicore_monotonic_time();
+		if (nextsampletime > sampletime + sampleperiod) {
+			nextsampletime = sampletime + sampleperiod;
+		}
+		if (nextsampletime > sampletime) {
+			polltimeout = (gint)((nextsampletime - sampletime + 999999) / 1000000);
+		} else {
+			polltimeout = 0;
+		}
+		
+		pollstatus = poll(pollfds, activesockets, polltimeout);
 		if (pollstatus > 0) {
 			/*Work thread control*/
 			if (pollfds[ctlfdnum].revents & POLLIN) {
@@ -3079,8 +3226,6 @@ static gpointer mmguicore_work_thread(gpointer data)
 						databuf = radatabuf;
 						intiov.iov_len = databufsize;
 						intiov.iov_base = databuf;
-						conniov.iov_len = databufsize;
-						conniov.iov_base = databuf;
 					}
 				}
 				/*Receive data*/
@@ -3092,6 +3237,9 @@ static gpointer mmguicore_work_thread(gpointer data)
 					} else if (workthreadcmd == MMGUI_THREAD_REFRESH_CMD) {
 						/*Refresh connection state*/
 						ifstatetime = time(NULL);
+					} else if (workthreadcmd == MMGUI_THREAD_SAMPLING_CMD) {
+						/*Sampling period is recalculated on next iteration*/
+						g_debug("Work thread: live sampling %s\n", g_atomic_int_get(&mmguicore->livesampling) ? "enabled" : "disabled");
 					}
 				} else {
 					g_debug("Work thread: Control command not received\n");
@@ -3108,6 +3256,14 @@ static gpointer mmguicore_work_thread(gpointer data)
 		
 		currenttime = time(NULL);
 		
+		/*Clear requested from other threads is done by history writer*/
+		if ((mmguicore->device != NULL) && (g_atomic_int_compare_and_exchange(&mmguicore->speedhistoryclear, 1, 0))) {
+			mmgui_speed_history_clear(mmguicore->device->speedhistory);
+			if (mmguicore->extcb != NULL) {
+				(mmguicore->extcb)(MMGUI_EVENT_NET_STATUS, mmguicore, NULL, mmguicore->userdata);
+			}
+		}
+		
 		/*Connections monitoring*/
 		if ((mmguicore->device != NULL) && (!(mmguicore->cmcaps & MMGUI_CONNECTION_MANAGER_CAPS_MONITORING))) {
 			if (abs((gint)difftime(ifstatetime, currenttime)) <= 15) {
@@ -3135,9 +3291,13 @@ static gpointer mmguicore_work_thread(gpointer data)
 							/*Get session start timestamp*/
 							mmguicore->device->sessionstarttime = (time_t)mmguicore_devices_get_connection_timestamp(mmguicore);
 							mmguicore->device->sessiontime = llabs((gint64)difftime(currenttime, mmguicore->device->sessionstarttime));
+							mmguicore->device->sessionrxbytes = 0;
+							mmguicore->device->sessiontxbytes = 0;
 							g_debug("Session start time: %" G_GUINT64_FORMAT ", duration: %" G_GUINT64_FORMAT "\n", (guint64)mmguicore->device->sessionstarttime, mmguicore->device->sessiontime);
 							/*Open traffic database session*/
 							mmgui_trafficdb_session_new(mmguicore->device->trafficdb, mmguicore->device->sessionstarttime);
+							/*Session limits start over*/
+							g_atomic_int_or(&mmguicore->limitsupdate, MMGUI_LIMITS_UPDATE_SESSION);
 							/*Device connect signal*/
 							if (mmguicore->extcb != NULL) {
 								(mmguicore->extcb)(MMGUI_EVENT_DEVICE_CONNECTION_STATUS, mmguicore, GUINT_TO_POINTER(TRUE), mmguicore->userdata);
@@ -3149,19 +3309,48 @@ static gpointer mmguicore_work_thread(gpointer data)
 			}
 		}
 		
-		if (pollstatus == 0) {
-			/*Timeout - request data*/
+		sampletime = mmguicore_monotonic_time();
+		
+		if (sampletime >= nextsampletime) {
+			/*Sampling deadline - request data*/
 			if (mmguicore->device != NULL) {
 				if (mmguicore->device->connected) {
 					/*Interface statistics*/
 					mmgui_netlink_request_interface_statistics(mmguicore->netlink, mmguicore->device->interface);
-					/*TCP connections - IPv4*/
-					mmgui_netlink_request_connections_list(mmguicore->netlink, AF_INET);
-					/*TCP connections - IPv6*/
-					mmgui_netlink_request_connections_list(mmguicore->netlink, AF_INET6);
+					/*Connections are listed at slow rate only*/
+					if (sampletime >= nextconnstime) {
+						/*Requests may drop connections of unwatched family, so list is locked like on receive*/
+						#if GLIB_CHECK_VERSION(2,32,0)
+							g_mutex_lock(&mmguicore->connsyncmutex);
+						#else
+							g_mutex_lock(mmguicore->connsyncmutex);
+						#endif
+						/*Only sockets bound to modem interface are accounted*/
+						mmgui_netlink_set_accounting_interface(mmguicore->netlink, mmguicore->device->interface);
+						/*TCP and UDP connections - IPv4*/
+						mmgui_netlink_request_connections_list(mmguicore->netlink, AF_INET);
+						/*TCP and UDP connections - IPv6*/
+						mmgui_netlink_request_connections_list(mmguicore->netlink, AF_INET6);
+						if ((mmguicore->extcb != NULL) && (mmgui_netlink_notify_connections_changes(mmguicore->netlink))) {
+							(mmguicore->extcb)(MMGUI_EVENT_UPDATE_CONNECTIONS_LIST, mmguicore, mmguicore, mmguicore->userdata);
+						}
+						#if GLIB_CHECK_VERSION(2,32,0)
+							g_mutex_unlock(&mmguicore->connsyncmutex);
+						#else
+							g_mutex_unlock(mmguicore->connsyncmutex);
+						#endif
+						nextconnstime = sampletime + MMGUI_THREAD_SLEEP_PERIOD * G_GUINT64_CONSTANT(1000000000);
+					}
 				}
 			}
-		} else if (pollstatus > 0) {
+			/*Deadlines do not drift with processing time*/
+			nextsampletime += sampleperiod;
+			if (nextsampletime <= sampletime) {
+				nextsampletime = sampletime + sampleperiod;
+			}
+		}
+		
+		if (pollstatus > 0) {
 			/*New data available*/
 			/*Interface monitoring*/
 			if (pollfds[intfdnum].revents & POLLIN) {
@@ -3174,20 +3363,19 @@ static gpointer mmguicore_work_thread(gpointer data)
 						databuf = radatabuf;
 						intiov.iov_len = databufsize;
 						intiov.iov_base = databuf;
-						conniov.iov_len = databufsize;
-						conniov.iov_base = databuf;
 					}
 				}
 				/*Receive data*/
 				recvbytes = recvmsg(intfd, &intmsg, 0);
 				if (recvbytes) {
+					memset(&event, 0, sizeof(event));
 					if (mmgui_netlink_read_interface_event(mmguicore->netlink, databuf, recvbytes, &event)) {
 						/*Traffic statisctics available*/
 						if (event.type & MMGUI_NETLINK_INTERFACE_EVENT_TYPE_STATS) {
 							if (mmguicore->device != NULL) {
 								if ((mmguicore->device->connected) && (g_str_equal(mmguicore->device->interface, event.ifname))) {
 									/*Count traffic*/
-									mmguicore_traffic_count(mmguicore, event.rxbytes, event.txbytes);
+									mmguicore_traffic_count(mmguicore, event.rxbytes, event.txbytes, event.counters64, sampletime);
 								}
 							}
 						}
@@ -3225,38 +3413,27 @@ static gpointer mmguicore_work_thread(gpointer data)
 			}
 			/*Connections monitoring*/
 			if (pollfds[connfdnum].revents & POLLIN) {
-				/*Extend buffer if needed*/
-				recvbytes = recv(connfd, NULL, 0, MSG_PEEK | MSG_TRUNC);
-				if (recvbytes > databufsize) {
-					radatabuf = g_try_realloc(databuf, recvbytes);
-					if (radatabuf != NULL) {
-						databufsize = recvbytes;
-						databuf = radatabuf;
-						intiov.iov_len = databufsize;
-						intiov.iov_base = databuf;
-						conniov.iov_len = databufsize;
-						conniov.iov_base = databuf;
+				/*Dump messages are received in batches into preallocated buffers*/
+				#if GLIB_CHECK_VERSION(2,32,0)
+					g_mutex_lock(&mmguicore->connsyncmutex);
+				#else
+					g_mutex_lock(mmguicore->connsyncmutex);
+				#endif
+				recvconns = mmgui_netlink_receive_connections_list(mmguicore->netlink);
+				if (recvconns) {
+					/*Per-application traffic*/
+					mmguicore_traffic_account_applications(mmguicore);
+					/*Changes are merged until interface takes them, so one signal per change set is enough*/
+					if ((mmguicore->extcb != NULL) && (mmgui_netlink_notify_connections_changes(mmguicore->netlink))) {
+						(mmguicore->extcb)(MMGUI_EVENT_UPDATE_CONNECTIONS_LIST, mmguicore, mmguicore, mmguicore->userdata);
 					}
 				}
-				/*Receive data*/
-				recvbytes = recvmsg(connfd, &connmsg, 0);
-				if (recvbytes) {
-					#if GLIB_CHECK_VERSION(2,32,0)
-						g_mutex_lock(&mmguicore->connsyncmutex);
-					#else
-						g_mutex_lock(mmguicore->connsyncmutex);
-					#endif
-					if (mmgui_netlink_read_connections_list(mmguicore->netlink, databuf, recvbytes)) {
-						if (mmguicore->extcb != NULL) {
-							(mmguicore->extcb)(MMGUI_EVENT_UPDATE_CONNECTIONS_LIST, mmguicore, mmguicore, mmguicore->userdata);
-						}
-					}
-					#if GLIB_CHECK_VERSION(2,32,0)
-						g_mutex_unlock(&mmguicore->connsyncmutex);
-					#else
-						g_mutex_unlock(mmguicore->connsyncmutex);
-					#endif
-				} else {
+				#if GLIB_CHECK_VERSION(2,32,0)
+					g_mutex_unlock(&mmguicore->connsyncmutex);
+				#else
+					g_mutex_unlock(mmguicore->connsyncmutex);
+				#endif
+				if (!recvconns) {
 					g_debug("Work thread: connections data not received\n");
 				}
 			}
@@ -3265,9 +3442,12 @@ static gpointer mmguicore_work_thread(gpointer data)
 		/*Update internal module state*/
 		mmguicore_devices_update_state(mmguicore);
 		
+		/*Values for external readers*/
+		mmguicore_live_stats_publish(mmguicore);
+		
 		if (mmguicore->device != NULL) {
-			/*Handle traffic limits*/
-			mmguicore_traffic_limits(mmguicore);
+			/*Write exported statistics*/
+			mmguicore_traffic_export(mmguicore, currenttime);
 		}
 		
 		/*New day time*/
@@ -3293,11 +3473,24 @@ static gpointer mmguicore_work_thread(gpointer data)
 	return NULL;
 }
 
-static void mmguicore_traffic_count(mmguicore_t mmguicore, guint64 rxbytes, guint64 txbytes)
+static guint64 mmguicore_monotonic_time(void)
+{
+	struct timespec ts;
+	
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+		return (guint64)g_get_monotonic_time() * 1000;
+	}
+	
+	return (guint64)ts.tv_sec * G_GUINT64_CONSTANT(1000000000) + (guint64)ts.tv_nsec;
+}
+
+static void mmguicore_traffic_count(mmguicore_t mmguicore, guint64 rxbytes, guint64 txbytes, gboolean counters64, guint64 timestamp)
 {
 	mmguidevice_t device;
 	time_t currenttime;
-	guint timeframe;
+	guint64 timeframe, deltarxbytes, deltatxbytes, limitbytes;
+	gdouble seconds;
+	guint duration, limitseconds, limitsupdate;
 	struct _mmgui_traffic_update trafficupd;
 	
 	if (mmguicore == NULL) return;
@@ -3307,47 +3500,216 @@ static void mmguicore_traffic_count(mmguicore_t mmguicore, guint64 rxbytes, guin
 	
 	currenttime = time(NULL);
 	
-	if ((device->connected) && (device->rxbytes <= rxbytes) && (device->txbytes <= txbytes)) {
-		if (device->speedchecktime != 0) {
+	limitbytes = 0;
+	limitseconds = 0;
+	limitsupdate = 0;
+	
+	if (device->connected) {
+		if ((device->speedchecktime != 0) && (timestamp > device->speedchecktime)) {
 			/*Time period for speed calculation*/
-			timeframe = (guint)difftime(currenttime, device->speedchecktime);
-			device->sessiontime += timeframe;
-			if (device->speedindex < MMGUI_SPEED_VALUES_NUMBER) {
-				/*Add new speed value*/
-				device->speedvalues[0][device->speedindex] = (gfloat)((rxbytes - device->rxbytes)*8)/(gfloat)(timeframe*1024);
-				device->speedvalues[1][device->speedindex] = (gfloat)((txbytes - device->txbytes)*8)/(gfloat)(timeframe*1024);
-				device->speedindex++;
+			timeframe = timestamp - device->speedchecktime;
+			/*32-bit kernel counters wrap around, 64-bit ones only go back on reset*/
+			if (rxbytes >= device->rxbytes) {
+				deltarxbytes = rxbytes - device->rxbytes;
+			} else if ((!counters64) && (device->rxbytes <= G_MAXUINT32)) {
+				deltarxbytes = rxbytes + (G_GUINT64_CONSTANT(1) << 32) - device->rxbytes;
 			} else {
-				/*Move speed values and add new one*/
-				memmove(&device->speedvalues[0][0], &device->speedvalues[0][1], sizeof(device->speedvalues[0]) - sizeof(device->speedvalues[0][0]));
-				memmove(&device->speedvalues[1][0], &device->speedvalues[1][1], sizeof(device->speedvalues[1]) - sizeof(device->speedvalues[1][0]));
-				device->speedvalues[0][MMGUI_SPEED_VALUES_NUMBER-1] = (gfloat)((rxbytes - device->rxbytes)*8)/(gfloat)(timeframe*1024);
-				device->speedvalues[1][MMGUI_SPEED_VALUES_NUMBER-1] = (gfloat)((txbytes - device->txbytes)*8)/(gfloat)(timeframe*1024);
+				deltarxbytes = 0;
 			}
+			if (txbytes >= device->txbytes) {
+				deltatxbytes = txbytes - device->txbytes;
+			} else if ((!counters64) && (device->txbytes <= G_MAXUINT32)) {
+				deltatxbytes = txbytes + (G_GUINT64_CONSTANT(1) << 32) - device->txbytes;
+			} else {
+				deltatxbytes = 0;
+			}
+			/*Instant speed*/
+			seconds = timeframe / 1000000000.0;
+			mmgui_speed_history_set_current(device->speedhistory, (gfloat)((deltarxbytes*8)/(seconds*1024)), (gfloat)((deltatxbytes*8)/(seconds*1024)));
+			/*Short samples are accumulated into whole seconds*/
+			device->pendingrxbytes += deltarxbytes;
+			device->pendingtxbytes += deltatxbytes;
+			device->pendingduration += timeframe;
+			device->sessionrxbytes += deltarxbytes;
+			device->sessiontxbytes += deltatxbytes;
+			limitbytes = deltarxbytes + deltatxbytes;
 			
-			/*Update database*/
-			trafficupd.fullrxbytes = device->rxbytes;
-			trafficupd.fulltxbytes = device->txbytes;
-			trafficupd.fulltime = device->sessiontime;
-			trafficupd.deltarxbytes = rxbytes - device->rxbytes;
-			trafficupd.deltatxbytes = txbytes - device->txbytes;
-			trafficupd.deltaduration = timeframe;
-			
-			mmgui_trafficdb_traffic_update(mmguicore->device->trafficdb, &trafficupd);
+			if (device->pendingduration >= G_GUINT64_CONSTANT(1000000000)) {
+				duration = (guint)(device->pendingduration / G_GUINT64_CONSTANT(1000000000));
+				seconds = device->pendingduration / 1000000000.0;
+				device->sessiontime += duration;
+				
+				/*Add new speed value*/
+				mmgui_speed_history_append(device->speedhistory, (gfloat)((device->pendingrxbytes*8)/(seconds*1024)), (gfloat)((device->pendingtxbytes*8)/(seconds*1024)));
+				
+				/*Update database*/
+				trafficupd.fullrxbytes = device->rxbytes;
+				trafficupd.fulltxbytes = device->txbytes;
+				trafficupd.fulltime = device->sessiontime;
+				trafficupd.deltarxbytes = device->pendingrxbytes;
+				trafficupd.deltatxbytes = device->pendingtxbytes;
+				trafficupd.deltaduration = duration;
+				
+				mmgui_trafficdb_traffic_update(mmguicore->device->trafficdb, &trafficupd);
+				mmgui_trafficdb_series_add(mmguicore->device->trafficdb, currenttime, trafficupd.deltarxbytes, trafficupd.deltatxbytes);
+				
+				/*Fraction of second stays for next update*/
+				device->pendingrxbytes = 0;
+				device->pendingtxbytes = 0;
+				device->pendingduration -= (guint64)duration * G_GUINT64_CONSTANT(1000000000);
+				/*Changed limits are rebuilt while database counters are up to date*/
+				limitseconds = duration;
+				limitsupdate = g_atomic_int_and(&mmguicore->limitsupdate, 0);
+			}
 		}
 		/*Update traffic count*/
 		device->rxbytes = rxbytes;
 		device->txbytes = txbytes;
+		/*Limits are only evaluated when counters advance*/
+		if (limitsupdate != 0) {
+			mmguicore_traffic_limits_arm(mmguicore, limitsupdate, currenttime);
+		} else if ((limitbytes > 0) || (limitseconds > 0)) {
+			mmguicore_traffic_limits_advance(mmguicore, limitbytes, limitseconds, currenttime);
+		}
 	}
 	
 	/*Set last update time*/
-	device->speedchecktime = currenttime;
+	device->speedchecktime = timestamp;
 	/*Callback*/
 	if (mmguicore->extcb != NULL) {
 		(mmguicore->extcb)(MMGUI_EVENT_NET_STATUS, mmguicore, device, mmguicore->userdata);
 	}
 }
 
+static void mmguicore_traffic_account_applications(mmguicore_t mmguicore)
+{
+	GHashTable *usage;
+	GHashTableIter iter;
+	gpointer value;
+	mmgui_netlink_app_usage_t appusage;
+	
+	if (mmguicore == NULL) return;
+	if (mmguicore->device == NULL) return;
+	if (mmguicore->device->trafficdb == NULL) return;
+	
+	usage = mmgui_netlink_take_application_usage(mmguicore->netlink);
+	
+	if (usage == NULL) return;
+	
+	g_hash_table_iter_init(&iter, usage);
+	
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		appusage = (mmgui_netlink_app_usage_t)value;
+		mmgui_trafficdb_application_usage_add(mmguicore->device->trafficdb, appusage->appname, appusage->rxbytes, appusage->txbytes);
+	}
+	
+	g_hash_table_destroy(usage);
+}
+
+static void mmguicore_traffic_export(mmguicore_t mmguicore, time_t currenttime)
+{
+	mmguidevice_t device;
+	struct _mmgui_traffic_export_live live;
+	struct _mmgui_speed_snapshot snapshot;
+	const gchar *extension;
+	gchar *filename, *filepath;
+	
+	if (mmguicore == NULL) return;
+	if ((mmguicore->options == NULL) || (mmguicore->options->exportdirectory == NULL)) return;
+	
+	device = mmguicore->device;
+	if ((device == NULL) || (device->persistentid == NULL)) return;
+	
+	if (currenttime < mmguicore->exporttime) return;
+	
+	mmguicore->exporttime = currenttime + mmguicore->options->exportinterval;
+	
+	extension = mmgui_traffic_export_format_extension(mmguicore->options->exportformat);
+	
+	/*Day history is rewritten once a day and when device changes*/
+	if ((extension != NULL) && (device->trafficdb != NULL) && (mmguicore->exportdaytime != mmguicore->newdaytime)) {
+		filename = g_strdup_printf("traffic-%s.%s", device->persistentid, extension);
+		filepath = g_build_filename(mmguicore->options->exportdirectory, filename, NULL);
+		mmgui_traffic_export_days((mmgui_trafficdb_t)device->trafficdb, filepath, mmguicore->options->exportformat, 0);
+		mmguicore->exportdaytime = mmguicore->newdaytime;
+		g_free(filepath);
+		g_free(filename);
+	}
+	
+	memset(&snapshot, 0, sizeof(snapshot));
+	mmgui_speed_history_snapshot(device->speedhistory, &snapshot, NULL, NULL, 0);
+	
+	live.device = device->persistentid;
+	live.model = device->model;
+	live.timestamp = currenttime;
+	live.connected = device->connected;
+	live.rxbytes = device->connected ? device->rxbytes : 0;
+	live.txbytes = device->connected ? device->txbytes : 0;
+	live.sessionrxbytes = device->connected ? device->sessionrxbytes : 0;
+	live.sessiontxbytes = device->connected ? device->sessiontxbytes : 0;
+	live.sessiontime = device->connected ? device->sessiontime : 0;
+	live.rxspeed = device->connected ? snapshot.stats[MMGUI_SPEED_HISTORY_RX].last : 0.0;
+	live.txspeed = device->connected ? snapshot.stats[MMGUI_SPEED_HISTORY_TX].last : 0.0;
+	live.siglevel = device->siglevel;
+	
+	/*Live counters are appended line by line*/
+	if (extension != NULL) {
+		filename = g_strdup_printf("traffic-%s-live.%s", device->persistentid, extension);
+		filepath = g_build_filename(mmguicore->options->exportdirectory, filename, NULL);
+		mmgui_traffic_export_live_append(filepath, mmguicore->options->exportformat, &live);
+		g_free(filepath);
+		g_free(filename);
+	}
+	
+	/*Textfile for node_exporter collector*/
+	filepath = g_build_filename(mmguicore->options->exportdirectory, MMGUI_TRAFFIC_EXPORT_PROMETHEUS_FILE, NULL);
+	mmgui_traffic_export_prometheus(filepath, &live);
+	g_free(filepath);
+}
+
+static void mmguicore_live_stats_publish(mmguicore_t mmguicore)
+{
+	mmguidevice_t device;
+	struct _mmgui_live_stats_device live;
+	struct _mmgui_speed_snapshot snapshot;
+	
+	if ((mmguicore == NULL) || (mmguicore->livestats == NULL)) return;
+	
+	device = mmguicore->device;
+	if ((device == NULL) || (device->persistentid == NULL)) return;
+	
+	memset(&live, 0, sizeof(live));
+	
+	if (device->enabled) live.flags |= MMGUI_LIVE_STATS_FLAG_ENABLED;
+	if (device->registered) live.flags |= MMGUI_LIVE_STATS_FLAG_REGISTERED;
+	if (device->connected) live.flags |= MMGUI_LIVE_STATS_FLAG_CONNECTED;
+	
+	live.siglevel = device->siglevel;
+	live.regstatus = device->regstatus;
+	live.mode = device->mode;
+	
+	if (device->connected) {
+		memset(&snapshot, 0, sizeof(snapshot));
+		mmgui_speed_history_snapshot(device->speedhistory, &snapshot, NULL, NULL, 0);
+		live.rxbytes = device->rxbytes;
+		live.txbytes = device->txbytes;
+		live.sessiontime = device->sessiontime;
+		live.rxspeed = snapshot.stats[MMGUI_SPEED_HISTORY_RX].last;
+		live.txspeed = snapshot.stats[MMGUI_SPEED_HISTORY_TX].last;
+		g_strlcpy(live.interface, device->interface, sizeof(live.interface));
+	}
+	
+	g_strlcpy(live.persistentid, device->persistentid, sizeof(live.persistentid));
+	if (device->model != NULL) {
+		g_strlcpy(live.model, device->model, sizeof(live.model));
+	}
+	if (device->operatorname != NULL) {
+		g_strlcpy(live.operatorname, device->operatorname, sizeof(live.operatorname));
+	}
+	
+	mmgui_live_stats_publish((mmgui_live_stats_publisher_t)mmguicore->livestats, &live);
+}
+
 static void mmguicore_traffic_zero(mmguicore_t mmguicore)
 {
 	mmguidevice_t device;
@@ -3359,55 +3721,215 @@ static void mmguicore_traffic_zero(mmguicore_t mmguicore)
 	if (device == NULL) return;	
 	
 	/*Zero speed values if device is not connected anymore*/
-	mmguicore->device->speedindex = 0;
-	mmguicore->device->speedvalues[0][0] = 0.0;
-	mmguicore->device->speedvalues[1][0] = 0.0;
+	g_atomic_int_set(&mmguicore->speedhistoryclear, 1);
 	mmguicore->device->rxbytes = 0;
 	mmguicore->device->txbytes = 0;
+	mmguicore->device->pendingrxbytes = 0;
+	mmguicore->device->pendingtxbytes = 0;
+	mmguicore->device->pendingduration = 0;
 	/*Set last update time*/
-	mmguicore->device->speedchecktime = time(NULL);
+	mmguicore->device->speedchecktime = mmguicore_monotonic_time();
 	/*Callback*/
 	if (mmguicore->extcb != NULL) {
 		(mmguicore->extcb)(MMGUI_EVENT_NET_STATUS, mmguicore, NULL, mmguicore->userdata);
 	}
 }
 
-static void mmguicore_traffic_limits(mmguicore_t mmguicore)
+static time_t mmguicore_traffic_limits_window_end(guint period, time_t currenttime)
 {
-	if (mmguicore == NULL) return;
+	struct tm *timespec;
+	struct tm windowspec;
 	
-	if ((mmguicore->options != NULL) && (mmguicore->device != NULL)) {
-		/*Traffic limit*/
-		if (mmguicore->options->trafficenabled) {
-			if ((!mmguicore->options->trafficexecuted) && (mmguicore->options->trafficfull < (mmguicore->device->rxbytes + mmguicore->device->txbytes))) {
-				mmguicore->options->trafficexecuted = TRUE;
-				if (mmguicore->options->trafficaction == MMGUI_EVENT_ACTION_DISCONNECT) {
-					if (mmguicore->device_connection_disconnect_func != NULL) {
-						(mmguicore->device_connection_disconnect_func)(mmguicore);
-					}
-				}
-				/*Callback*/
-				if (mmguicore->extcb != NULL) {
-					(mmguicore->extcb)(MMGUI_EVENT_TRAFFIC_LIMIT, mmguicore, NULL, mmguicore->userdata);
-				}
+	switch (period) {
+		case MMGUI_LIMIT_PERIOD_DAY:
+			return mmgui_trafficdb_get_new_day_timesatmp(currenttime, NULL, NULL);
+		case MMGUI_LIMIT_PERIOD_MONTH:
+			timespec = localtime(&currenttime);
+			memset(&windowspec, 0, sizeof(windowspec));
+			windowspec.tm_year = timespec->tm_year;
+			windowspec.tm_mon = timespec->tm_mon + 1;
+			windowspec.tm_mday = 1;
+			windowspec.tm_isdst = -1;
+			return mktime(&windowspec);
+		default:
+			/*Session window ends with connection*/
+			return 0;
+	}
+}
+
+static void mmguicore_traffic_limits_window_usage(mmguicore_t mmguicore, guint period, guint64 *bytes, guint64 *seconds)
+{
+	mmguidevice_t device;
+	mmgui_trafficdb_t trafficdb;
+	struct _mmgui_day_traffic daytraffic;
+	guint64 usedbytes, usedseconds;
+	
+	device = mmguicore->device;
+	trafficdb = (mmgui_trafficdb_t)device->trafficdb;
+	
+	/*Session counters are used if database has no session yet*/
+	usedbytes = device->rxbytes + device->txbytes;
+	usedseconds = device->sessiontime;
+	
+	if (trafficdb != NULL) {
+		if (period == MMGUI_LIMIT_PERIOD_DAY) {
+			if (mmgui_trafficdb_session_get_day_traffic(trafficdb, &daytraffic)) {
+				usedbytes = daytraffic.dayrxbytes + daytraffic.daytxbytes + daytraffic.sessrxbytes + daytraffic.sesstxbytes;
+				usedseconds = (guint64)daytraffic.dayduration + daytraffic.sessduration;
 			}
+		} else if (period == MMGUI_LIMIT_PERIOD_MONTH) {
+			usedbytes = trafficdb->monthrxbytes + trafficdb->monthtxbytes;
+			usedseconds = trafficdb->monthduration;
 		}
-		
-		/*Time limit*/
-		if (mmguicore->options->timeenabled) {
-			if ((!mmguicore->options->timeexecuted) && (mmguicore->options->timefull < mmguicore->device->sessiontime)) {
-				mmguicore->options->timeexecuted = TRUE;
-				if (mmguicore->options->timeaction == MMGUI_EVENT_ACTION_DISCONNECT) {
-					if (mmguicore->device_connection_disconnect_func != NULL) {
-						(mmguicore->device_connection_disconnect_func)(mmguicore);
-					}
-				}
-				/*Callback*/
-				if (mmguicore->extcb != NULL) {
-					(mmguicore->extcb)(MMGUI_EVENT_TIME_LIMIT, mmguicore, NULL, mmguicore->userdata);
-				}
+	}
+	
+	if (bytes != NULL) *bytes = usedbytes;
+	if (seconds != NULL) *seconds = usedseconds;
+}
+
+static guint64 mmguicore_traffic_limit_value(struct _mmgui_core_limit *limit, guint threshold)
+{
+	return limit->full / 100 * mmguicore_limit_percents[threshold] + limit->full % 100 * mmguicore_limit_percents[threshold] / 100;
+}
+
+static void mmguicore_traffic_limit_arm(struct _mmgui_core_limit *limit, gboolean enabled, guint period, guint64 full, guint64 used, gboolean executed, time_t currenttime)
+{
+	guint64 value;
+	
+	limit->period = period;
+	limit->full = (enabled) ? full : 0;
+	limit->used = used;
+	limit->windowend = mmguicore_traffic_limits_window_end(period, currenttime);
+	limit->threshold = 0;
+	limit->remaining = 0;
+	
+	if (limit->full == 0) return;
+	
+	if (executed) {
+		limit->threshold = MMGUI_LIMIT_THRESHOLDS;
+		return;
+	}
+	
+	/*Warnings passed before limit was set are not sent, exceeded limit fires on next update*/
+	while ((limit->threshold < MMGUI_LIMIT_THRESHOLDS - 1) && (used >= mmguicore_traffic_limit_value(limit, limit->threshold))) {
+		limit->threshold++;
+	}
+	
+	value = mmguicore_traffic_limit_value(limit, limit->threshold);
+	
+	if (value > used) {
+		limit->remaining = value - used;
+	}
+}
+
+static gint mmguicore_traffic_limit_advance(struct _mmgui_core_limit *limit, guint64 delta, time_t currenttime, gboolean *executed)
+{
+	gint crossed;
+	
+	if (limit->full == 0) return -1;
+	
+	/*Day and month windows start empty*/
+	if ((limit->windowend != 0) && (currenttime >= limit->windowend)) {
+		*executed = FALSE;
+		mmguicore_traffic_limit_arm(limit, TRUE, limit->period, limit->full, 0, FALSE, currenttime);
+	}
+	
+	limit->used += delta;
+	
+	if (limit->threshold >= MMGUI_LIMIT_THRESHOLDS) return -1;
+	
+	if (delta < limit->remaining) {
+		limit->remaining -= delta;
+		return -1;
+	}
+	
+	/*Only highest crossed threshold is reported*/
+	crossed = -1;
+	
+	while ((limit->threshold < MMGUI_LIMIT_THRESHOLDS) && (limit->used >= mmguicore_traffic_limit_value(limit, limit->threshold))) {
+		crossed = (gint)limit->threshold;
+		limit->threshold++;
+	}
+	
+	if (limit->threshold < MMGUI_LIMIT_THRESHOLDS) {
+		limit->remaining = mmguicore_traffic_limit_value(limit, limit->threshold) - limit->used;
+	} else {
+		limit->remaining = 0;
+	}
+	
+	return crossed;
+}
+
+static void mmguicore_traffic_limits_arm(mmguicore_t mmguicore, guint updates, time_t currenttime)
+{
+	mmgui_core_options_t options;
+	guint64 trafficused, timeused;
+	
+	if ((mmguicore == NULL) || (mmguicore->device == NULL)) return;
+	
+	options = mmguicore->options;
+	
+	if (options == NULL) return;
+	
+	/*New connection starts new session window*/
+	if (updates & MMGUI_LIMITS_UPDATE_SESSION) {
+		if (options->trafficperiod == MMGUI_LIMIT_PERIOD_SESSION) {
+			options->trafficexecuted = FALSE;
+		}
+		if (options->timeperiod == MMGUI_LIMIT_PERIOD_SESSION) {
+			options->timeexecuted = FALSE;
+		}
+	}
+	
+	mmguicore_traffic_limits_window_usage(mmguicore, options->trafficperiod, &trafficused, NULL);
+	mmguicore_traffic_limit_arm(&mmguicore->trafficlimit, options->trafficenabled, options->trafficperiod, options->trafficfull, trafficused, options->trafficexecuted, currenttime);
+	
+	mmguicore_traffic_limits_window_usage(mmguicore, options->timeperiod, NULL, &timeused);
+	mmguicore_traffic_limit_arm(&mmguicore->timelimit, options->timeenabled, options->timeperiod, options->timefull, timeused, options->timeexecuted, currenttime);
+}
+
+static void mmguicore_traffic_limits_advance(mmguicore_t mmguicore, guint64 bytes, guint seconds, time_t currenttime)
+{
+	mmgui_core_options_t options;
+	gint crossed;
+	
+	if ((mmguicore == NULL) || (mmguicore->device == NULL)) return;
+	
+	options = mmguicore->options;
+	
+	if (options == NULL) return;
+	
+	/*Traffic limit*/
+	crossed = mmguicore_traffic_limit_advance(&mmguicore->trafficlimit, bytes, currenttime, &options->trafficexecuted);
+	if (crossed != -1) {
+		mmguicore_traffic_limits_fire(mmguicore, (guint)crossed, &options->trafficexecuted, options->trafficaction, MMGUI_EVENT_TRAFFIC_LIMIT, MMGUI_EVENT_TRAFFIC_LIMIT_WARNING);
+	}
+	
+	/*Time limit*/
+	crossed = mmguicore_traffic_limit_advance(&mmguicore->timelimit, seconds, currenttime, &options->timeexecuted);
+	if (crossed != -1) {
+		mmguicore_traffic_limits_fire(mmguicore, (guint)crossed, &options->timeexecuted, options->timeaction, MMGUI_EVENT_TIME_LIMIT, MMGUI_EVENT_TIME_LIMIT_WARNING);
+	}
+}
+
+static void mmguicore_traffic_limits_fire(mmguicore_t mmguicore, guint threshold, gboolean *executed, guint action, enum _mmgui_event limitevent, enum _mmgui_event warningevent)
+{
+	if (threshold == MMGUI_LIMIT_THRESHOLDS - 1) {
+		*executed = TRUE;
+		if (action == MMGUI_EVENT_ACTION_DISCONNECT) {
+			if (mmguicore->device_connection_disconnect_func != NULL) {
+				(mmguicore->device_connection_disconnect_func)(mmguicore);
 			}
 		}
+		/*Callback*/
+		if (mmguicore->extcb != NULL) {
+			(mmguicore->extcb)(limitevent, mmguicore, NULL, mmguicore->userdata);
+		}
+	} else {
+		/*Callback with percent of limit used*/
+		if (mmguicore->extcb != NULL) {
+			(mmguicore->extcb)(warningevent, mmguicore, GUINT_TO_POINTER(mmguicore_limit_percents[threshold]), mmguicore->userdata);
+		}
 	}
 }
 
@@ -3435,6 +3957,8 @@ static void mmguicore_update_connection_status(mmguicore_t mmguicore, gboolean s
 		mmguicore->device->sessiontime = llabs((gint64)difftime(time(NULL), mmguicore->device->sessionstarttime));
 		/*Open traffic database session*/
 		mmgui_trafficdb_session_new(mmguicore->device->trafficdb, mmguicore->device->sessionstarttime);
+		/*Session limits start over*/
+		g_atomic_int_or(&mmguicore->limitsupdate, MMGUI_LIMITS_UPDATE_SESSION);
 		if (sendresult) {
 			if (mmguicore->extcb != NULL) {
 				(mmguicore->extcb)(MMGUI_EVENT_MODEM_CONNECTION_RESULT, mmguicore, GUINT_TO_POINTER(result), mmguicore->userdata);
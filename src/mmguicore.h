@@ -28,10 +28,10 @@
 #include "polkit.h"
 #include "svcmanager.h"
 #include "smsdb.h"
-
-#define MMGUI_SPEED_VALUES_NUMBER    20
+#include "trafficdb.h"
 
 #define MMGUI_THREAD_SLEEP_PERIOD    1 /*seconds*/
+#define MMGUI_THREAD_LIVE_PERIOD     200 /*milliseconds*/
 
 enum _mmgui_event {
 	/*Device events*/
@@ -63,6 +63,8 @@ enum _mmgui_event {
 	MMGUI_EVENT_NET_STATUS,
 	MMGUI_EVENT_TRAFFIC_LIMIT,
 	MMGUI_EVENT_TIME_LIMIT,
+	MMGUI_EVENT_TRAFFIC_LIMIT_WARNING,
+	MMGUI_EVENT_TIME_LIMIT_WARNING,
 	MMGUI_EVENT_UPDATE_CONNECTIONS_LIST,
 	/*Special-purpose events*/
 	MMGUI_EVENT_EXTEND_CAPABILITIES,
@@ -300,6 +302,32 @@ enum _mmgui_event_action {
 	MMGUI_EVENT_ACTION_DISCONNECT
 };
 
+/*Window limits are counted in*/
+enum _mmgui_limit_period {
+	MMGUI_LIMIT_PERIOD_SESSION = 0,
+	MMGUI_LIMIT_PERIOD_DAY,
+	MMGUI_LIMIT_PERIOD_MONTH
+};
+
+/*Reasons to recompute limit state*/
+enum _mmgui_limits_update {
+	MMGUI_LIMITS_UPDATE_OPTIONS = 1 << 0,
+	MMGUI_LIMITS_UPDATE_SESSION = 1 << 1
+};
+
+/*Warnings at 50% and 80%, limit action at 100%*/
+#define MMGUI_LIMIT_THRESHOLDS 3
+
+/*Limit state precomputed by work thread, advanced only when counters grow*/
+struct _mmgui_core_limit {
+	guint period;
+	guint64 full;
+	guint64 used;
+	guint64 remaining; /*until next threshold*/
+	guint threshold; /*next threshold, MMGUI_LIMIT_THRESHOLDS when all passed*/
+	time_t windowend; /*0 for session window*/
+};
+
 struct _mmgui_scanned_network {
 	enum _mmgui_network_availability status;
 	enum _mmgui_access_tech access_tech;
@@ -363,6 +391,7 @@ struct _mmgui_core_options {
 	guint64 trafficfull;
 	gchar *trafficmessage;
 	guint trafficaction;
+	guint trafficperiod;
 	gboolean timeenabled;
 	gboolean timeexecuted;
 	guint timeamount;
@@ -370,6 +399,15 @@ struct _mmgui_core_options {
 	guint64 timefull;
 	gchar *timemessage;
 	guint timeaction;
+	guint timeperiod;
+	/*Speed history*/
+	guint speedhistorylength;
+	/*High-frequency sampling period in milliseconds, 0 to disable*/
+	guint livesamplingperiod;
+	/*Traffic export, NULL directory to disable*/
+	gchar *exportdirectory;
+	guint exportinterval;
+	guint exportformat;
 };
 
 typedef struct _mmgui_core_options *mmgui_core_options_t;
@@ -418,10 +456,14 @@ struct _mmguidevice {
 	guint64 rxbytes;
 	guint64 txbytes;
 	guint64 sessiontime;
-	time_t speedchecktime;
+	guint64 sessionrxbytes; /*counted since connection*/
+	guint64 sessiontxbytes;
+	guint64 speedchecktime; /*monotonic, nanoseconds*/
 	time_t smschecktime;
-	gfloat speedvalues[2][MMGUI_SPEED_VALUES_NUMBER];
-	guint speedindex;
+	guint64 pendingrxbytes;
+	guint64 pendingtxbytes;
+	guint64 pendingduration; /*nanoseconds*/
+	gpointer speedhistory;
 	gboolean connected;
 	gchar interface[IFNAMSIZ];
 	time_t sessionstarttime;
@@ -569,9 +611,21 @@ struct _mmguicore {
 	mmgui_svcmanager_t svcmanager;
 	/*New day time*/
 	time_t newdaytime;
+	/*Traffic export*/
+	time_t exporttime;
+	time_t exportdaytime;
+	/*Live statistics shared memory segment*/
+	gpointer livestats;
+	/*Speed history is cleared by its only writer, the work thread*/
+	gint speedhistoryclear;
+	/*Traffic limits*/
+	struct _mmgui_core_limit trafficlimit;
+	struct _mmgui_core_limit timelimit;
+	guint limitsupdate;
 	/*Work thread*/
 	GThread *workthread;
 	gint workthreadctl[2];
+	gint livesampling;
 	#if GLIB_CHECK_VERSION(2,32,0)
 		GMutex workthreadmutex;
 		GMutex connsyncmutex;
@@ -652,6 +706,11 @@ gboolean mmguicore_contacts_add(mmguicore_t mmguicore, mmgui_contact_t contact);
 GSList *mmguicore_open_connections_list(mmguicore_t mmguicore);
 void mmguicore_close_connections_list(mmguicore_t mmguicore);
 GSList *mmguicore_get_connections_changes(mmguicore_t mmguicore);
+/*Traffic*/
+void mmguicore_traffic_set_live_sampling(mmguicore_t mmguicore, gboolean enabled);
+void mmguicore_traffic_limits_update(mmguicore_t mmguicore);
+gboolean mmguicore_traffic_limits_get_usage(mmguicore_t mmguicore, guint64 *trafficused, guint64 *timeused);
+gboolean mmguicore_traffic_get_day_traffic(mmguicore_t mmguicore, mmgui_day_traffic_t daytraffic);
 /*MMGUI Core*/
 gchar *mmguicore_get_last_error(mmguicore_t mmguicore);
 gchar *mmguicore_get_last_connection_error(mmguicore_t mmguicore);
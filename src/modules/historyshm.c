@@ -42,7 +42,11 @@ enum _mmgui_history_shm_client_xml_elements {
 	MMGUI_HISTORY_SHM_XML_PARAM_NULL
 };
 
-static gint mmgui_history_shm_client_xml_parameter = MMGUI_HISTORY_SHM_XML_PARAM_NULL;
+/*Parser state is kept per parse call*/
+struct _mmgui_history_client_xml_state {
+	mmgui_sms_message_t message;
+	gint parameter;
+};
 
 static mmgui_sms_message_t mmgui_history_client_xml_parse(gchar *xml, gsize size);
 static void mmgui_history_client_xml_get_element(GMarkupParseContext *context, const gchar *element, const gchar **attr_names, const gchar **attr_values, gpointer data, GError **error);
@@ -148,10 +152,13 @@ gboolean mmgui_history_client_close_device(mmgui_history_shm_client_t client)
 GSList *mmgui_history_client_enum_messages(mmgui_history_shm_client_t client)
 {
 	GSList *messages;
+	GArray *records, *timestamps;
+	struct _mmgui_smsdb_raw_record record;
 	mmgui_sms_message_t message;
-	datum key, data;
+	datum key, nextkey, data;
 	gchar drvstr[128];
 	guint64 localts, maxts;
+	guint i;
 	
 	if (client == NULL) return NULL;
 	if ((!client->devopened) || (client->db == NULL) || (client->shmaddr == NULL) || (client->drivername == NULL)) return NULL;
@@ -159,28 +166,48 @@ GSList *mmgui_history_client_enum_messages(mmgui_history_shm_client_t client)
 	messages = NULL;
 	maxts = 0;
 	
+	/*Raw records are fetched first and decoded in parallel*/
+	records = g_array_new(FALSE, FALSE, sizeof(struct _mmgui_smsdb_raw_record));
+	timestamps = g_array_new(FALSE, FALSE, sizeof(guint64));
+	
 	key = gdbm_firstkey(client->db);
-		
-	if (key.dptr != NULL) {
-		do {
-			localts = mmgui_history_get_driver_from_key(key.dptr, key.dsize, (gchar *)&drvstr, sizeof(drvstr));
-			if (localts != 0) {
-				if ((g_str_equal(drvstr, client->drivername)) && ((client->shmaddr->synctime == 0) || ((client->shmaddr->synctime != 0) && (localts > client->shmaddr->synctime)))) {
-					data = gdbm_fetch(client->db, key);
-					if (data.dptr != NULL) {
-						message = mmgui_history_client_xml_parse(data.dptr, data.dsize);
-						if (message != NULL) {
-							messages = g_slist_prepend(messages, message);
-							if (localts > maxts) {
-								maxts = localts;
-							}
-						}
-					}
+	
+	while (key.dptr != NULL) {
+		localts = mmgui_history_get_driver_from_key(key.dptr, key.dsize, (gchar *)&drvstr, sizeof(drvstr));
+		if (localts != 0) {
+			if ((g_str_equal(drvstr, client->drivername)) && ((client->shmaddr->synctime == 0) || ((client->shmaddr->synctime != 0) && (localts > client->shmaddr->synctime)))) {
+				data = gdbm_fetch(client->db, key);
+				if (data.dptr != NULL) {
+					record.data = data.dptr;
+					record.size = data.dsize;
+					record.dbid = 0;
+					record.message = NULL;
+					g_array_append_val(records, record);
+					g_array_append_val(timestamps, localts);
 				}
 			}
-			key = gdbm_nextkey(client->db, key);
-		} while (key.dptr != NULL);
+		}
+		nextkey = gdbm_nextkey(client->db, key);
+		free(key.dptr);
+		key = nextkey;
+	}
+	
+	mmgui_smsdb_decode_records(records, mmgui_history_client_xml_parse);
+	
+	for (i=0; i<records->len; i++) {
+		message = g_array_index(records, struct _mmgui_smsdb_raw_record, i).message;
+		if (message != NULL) {
+			messages = g_slist_prepend(messages, message);
+			localts = g_array_index(timestamps, guint64, i);
+			if (localts > maxts) {
+				maxts = localts;
+			}
+		}
 	}
+	
+	g_array_free(records, TRUE);
+	g_array_free(timestamps, TRUE);
+	
 	/*Maximum timestamp for next synchronizations*/
 	if (messages != NULL) {
 		client->shmaddr->synctime = maxts;
@@ -194,6 +221,7 @@ GSList *mmgui_history_client_enum_messages(mmgui_history_shm_client_t client)
 static mmgui_sms_message_t mmgui_history_client_xml_parse(gchar *xml, gsize size)
 {
 	mmgui_sms_message_t message;
+	struct _mmgui_history_client_xml_state state;
 	GMarkupParser mp;
 	GMarkupParseContext *mpc;
 	GError *error = NULL;
@@ -206,7 +234,10 @@ static mmgui_sms_message_t mmgui_history_client_xml_parse(gchar *xml, gsize size
 	mp.passthrough = NULL;
 	mp.error = NULL;
 	
-	mpc = g_markup_parse_context_new(&mp, 0, (gpointer)message, NULL);
+	state.message = message;
+	state.parameter = MMGUI_HISTORY_SHM_XML_PARAM_NULL;
+	
+	mpc = g_markup_parse_context_new(&mp, 0, (gpointer)&state, NULL);
 	g_markup_parse_context_parse(mpc, xml, size, &error);
 	if (error != NULL) {
 		g_debug("Error parsing XML: %s", error->message);
@@ -222,32 +253,38 @@ static mmgui_sms_message_t mmgui_history_client_xml_parse(gchar *xml, gsize size
 
 static void mmgui_history_client_xml_get_element(GMarkupParseContext *context, const gchar *element, const gchar **attr_names, const gchar **attr_values, gpointer data, GError **error)
 {
+	struct _mmgui_history_client_xml_state *state;
+	
+	state = (struct _mmgui_history_client_xml_state *)data;
+	
 	if (g_str_equal(element, "localtime")) {
-		mmgui_history_shm_client_xml_parameter = MMGUI_HISTORY_SHM_XML_PARAM_LOCALTIME;
+		state->parameter = MMGUI_HISTORY_SHM_XML_PARAM_LOCALTIME;
 	} else if (g_str_equal(element, "remotetime")) {
-		mmgui_history_shm_client_xml_parameter = MMGUI_HISTORY_SHM_XML_PARAM_REMOTETIME;
+		state->parameter = MMGUI_HISTORY_SHM_XML_PARAM_REMOTETIME;
 	} else if (g_str_equal(element, "driver")) {
-		mmgui_history_shm_client_xml_parameter = MMGUI_HISTORY_SHM_XML_PARAM_DRIVER;
+		state->parameter = MMGUI_HISTORY_SHM_XML_PARAM_DRIVER;
 	} else if (g_str_equal(element, "sender")) {
-		mmgui_history_shm_client_xml_parameter = MMGUI_HISTORY_SHM_XML_PARAM_SENDER;
+		state->parameter = MMGUI_HISTORY_SHM_XML_PARAM_SENDER;
 	} else if (g_str_equal(element, "text")) {
-		mmgui_history_shm_client_xml_parameter = MMGUI_HISTORY_SHM_XML_PARAM_TEXT;
+		state->parameter = MMGUI_HISTORY_SHM_XML_PARAM_TEXT;
 	} else {
-		mmgui_history_shm_client_xml_parameter = MMGUI_HISTORY_SHM_XML_PARAM_NULL;
+		state->parameter = MMGUI_HISTORY_SHM_XML_PARAM_NULL;
 	}
 }
 
 static void mmgui_history_client_xml_get_value(GMarkupParseContext *context, const gchar *text, gsize size, gpointer data, GError **error)
 {
+	struct _mmgui_history_client_xml_state *state;
 	mmgui_sms_message_t message;
 	time_t timestamp;
 	gchar *escstr;
 	
-	message = (mmgui_sms_message_t)data;
+	state = (struct _mmgui_history_client_xml_state *)data;
+	message = state->message;
 	
-	if (mmgui_history_shm_client_xml_parameter == MMGUI_HISTORY_SHM_XML_PARAM_NULL) return;
+	if (state->parameter == MMGUI_HISTORY_SHM_XML_PARAM_NULL) return;
 	
-	switch (mmgui_history_shm_client_xml_parameter) {
+	switch (state->parameter) {
 		case MMGUI_HISTORY_SHM_XML_PARAM_LOCALTIME:
 			timestamp = (time_t)atol(text);
 			mmgui_smsdb_message_set_timestamp(message, timestamp);
@@ -283,8 +320,12 @@ static void mmgui_history_client_xml_get_value(GMarkupParseContext *context, con
 
 static void mmgui_history_client_xml_end_element(GMarkupParseContext *context, const gchar *element, gpointer data, GError **error)
 {
+	struct _mmgui_history_client_xml_state *state;
+	
+	state = (struct _mmgui_history_client_xml_state *)data;
+	
 	if (!g_str_equal(element, "message")) {
-		mmgui_history_shm_client_xml_parameter = MMGUI_HISTORY_SHM_XML_PARAM_NULL;
+		state->parameter = MMGUI_HISTORY_SHM_XML_PARAM_NULL;
 	}
 }
 
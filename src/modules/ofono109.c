@@ -1258,9 +1258,11 @@ static mmguidevice_t mmgui_module_device_new(mmguicore_t mmguicore, const gchar
 	device->sessiontime = 0;
 	device->speedchecktime = 0;
 	device->smschecktime = 0;
-	device->speedindex = 0;
+	device->pendingrxbytes = 0;
+	device->pendingtxbytes = 0;
+	device->pendingduration = 0;
 	device->connected = FALSE;
-	memset(device->speedvalues, 0, sizeof(device->speedvalues));
+	device->speedhistory = NULL;
 	memset(device->interface, 0, sizeof(device->interface));
 	//Contacts
 	device->contactscaps = MMGUI_CONTACTS_CAPS_NONE;
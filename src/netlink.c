@@ -17,6 +17,11 @@
  *      along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
  
+/*recvmmsg() is GNU extension*/
+#ifndef _GNU_SOURCE
+	#define _GNU_SOURCE
+#endif
+
 #include <glib.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -38,21 +43,68 @@
 #include <fcntl.h>
 #include <net/if.h>
 #include <limits.h>
+#include <ifaddrs.h>
 
 #include "netlink.h"
 
 #define MMGUI_NETLINK_INTERNAL_SEQUENCE_NUMBER 100000
 
+/*Offsets of byte counters in kernel tcp_info structure (Linux 4.1+)*/
+#define MMGUI_NETLINK_TCP_INFO_BYTES_ACKED_OFFSET    120
+#define MMGUI_NETLINK_TCP_INFO_BYTES_RECEIVED_OFFSET 128
+
+/*Synchronized TCP states, listening and half-open sockets carry no traffic*/
+#define MMGUI_NETLINK_TCP_CONNECTED_STATES ((1 << TCP_ESTABLISHED) | (1 << TCP_FIN_WAIT1) | (1 << TCP_FIN_WAIT2) | (1 << TCP_CLOSE_WAIT) | (1 << TCP_LAST_ACK) | (1 << TCP_CLOSING))
+/*UDP sockets are either connected to peer or only bound*/
+#define MMGUI_NETLINK_UDP_STATES ((1 << TCP_ESTABLISHED) | (1 << TCP_CLOSE))
+/*Dump without answer for this many seconds is abandoned*/
+#define MMGUI_NETLINK_DUMP_TIMEOUT 5
+
+/*Preallocated buffers for batched receive of connections dumps*/
+struct _mmgui_netlink_receive_batch {
+	struct mmsghdr messages[MMGUI_NETLINK_RECEIVE_BATCH];
+	struct iovec iovecs[MMGUI_NETLINK_RECEIVE_BATCH];
+	struct sockaddr_nl addresses[MMGUI_NETLINK_RECEIVE_BATCH];
+	gchar buffers[MMGUI_NETLINK_RECEIVE_BATCH][MMGUI_NETLINK_RECEIVE_BUFFER_SIZE];
+};
+
+/*Dumps in order they are sent to kernel*/
+enum _mmgui_netlink_dump {
+	MMGUI_NETLINK_DUMP_TCP_INET  = 1 << 0,
+	MMGUI_NETLINK_DUMP_TCP_INET6 = 1 << 1,
+	MMGUI_NETLINK_DUMP_UDP_INET  = 1 << 2,
+	MMGUI_NETLINK_DUMP_UDP_INET6 = 1 << 3
+};
+
+#define MMGUI_NETLINK_DUMP_INET (MMGUI_NETLINK_DUMP_TCP_INET | MMGUI_NETLINK_DUMP_UDP_INET)
+#define MMGUI_NETLINK_DUMP_UDP  (MMGUI_NETLINK_DUMP_UDP_INET | MMGUI_NETLINK_DUMP_UDP_INET6)
+
 
 static gboolean mmgui_netlink_numeric_name(gchar *dirname);
 static gboolean mmgui_netlink_process_access(gchar *dirname, uid_t uid);
-static gboolean mmgui_netlink_socket_access(gchar *dirname, gchar *sockname, guint inode);
 static gchar *mmgui_netlink_process_name(gchar *dirname, gchar *appname, gsize appsize);
-static gboolean mmgui_netlink_get_process(guint inode, gchar *appname, gsize namesize, pid_t *apppid);
+static guint64 mmgui_netlink_process_start_time(gchar *dirname);
+static gboolean mmgui_netlink_process_expired_foreach(gpointer key, gpointer value, gpointer user_data);
+static void mmgui_netlink_process_sockets_scan(mmgui_netlink_t netlink, mmgui_netlink_process_t process);
+static void mmgui_netlink_process_index_refresh(mmgui_netlink_t netlink, guint inode);
+static mmgui_netlink_process_t mmgui_netlink_get_process(mmgui_netlink_t netlink, guint inode);
 static gboolean mmgui_netlink_hash_clear_foreach(gpointer key, gpointer value, gpointer user_data);
+static guint mmgui_netlink_dump_type(guint family, guint protocol);
+static void mmgui_netlink_remove_stale_connections(mmgui_netlink_t netlink, guint dump);
+static gboolean mmgui_netlink_family_watched(mmgui_netlink_t netlink, guint family);
+static gsize mmgui_netlink_connections_filter(mmgui_netlink_t netlink, guint family, gchar *bytecode, gsize size);
+static gboolean mmgui_netlink_send_connections_dump(mmgui_netlink_t netlink, guint family, guint protocol);
+static gboolean mmgui_netlink_send_next_dump(mmgui_netlink_t netlink);
 struct sockaddr_nl *mmgui_netlink_get_connections_monitoring_socket_address(mmgui_netlink_t netlink);
 struct sockaddr_nl *mmgui_netlink_get_interfaces_monitoring_socket_address(mmgui_netlink_t netlink);
 static mmgui_netlink_connection_change_t mmgui_netlink_create_connection_change(mmgui_netlink_t netlink, guint event, guint inode);
+static void mmgui_netlink_queue_connection_change(mmgui_netlink_t netlink, guint event, guint inode);
+static gboolean mmgui_netlink_tcp_info_counters(struct nlmsghdr *msgheader, guint64 *rxbytes, guint64 *txbytes);
+static gboolean mmgui_netlink_memory_queue(struct nlmsghdr *msgheader, guint *dqueue);
+static gboolean mmgui_netlink_address_accounted(mmgui_netlink_t netlink, struct inet_diag_msg *entry);
+static void mmgui_netlink_account_traffic(mmgui_netlink_t netlink, mmgui_netlink_connection_t connection, guint64 rxbytes, guint64 txbytes);
+static void mmgui_netlink_app_usage_destroy(gpointer data);
+static struct _mmgui_netlink_receive_batch *mmgui_netlink_receive_batch_new(void);
 
 
 static gboolean mmgui_netlink_numeric_name(gchar *dirname)
@@ -92,28 +144,6 @@ static gboolean mmgui_netlink_process_access(gchar *dirname, uid_t uid)
 	return TRUE;
 }
 
-static gboolean mmgui_netlink_socket_access(gchar *dirname, gchar *sockname, guint inode)
-{
-	gchar fullpath[PATH_MAX];
-	struct stat fdstat;
-	
-	if (!mmgui_netlink_numeric_name(sockname)) return FALSE;
-		
-	memset(fullpath, 0, sizeof(fullpath));
-	
-	snprintf(fullpath, sizeof(fullpath), "/proc/%s/fd/%s", dirname, sockname);
-	
-	if (stat(fullpath, &fdstat) == -1) {
-		return FALSE;
-	}
-	
-	if (((fdstat.st_mode & S_IFMT) == S_IFSOCK) && (fdstat.st_ino == inode)) {
-		return TRUE;
-	}
-	
-	return FALSE;
-}
-
 static gchar *mmgui_netlink_process_name(gchar *dirname, gchar *appname, gsize appsize)
 {
 	gint fd, i;
@@ -128,7 +158,7 @@ static gchar *mmgui_netlink_process_name(gchar *dirname, gchar *appname, gsize a
 	
 	linkchars = readlink(fpath, appname, appsize-1);
 	
-	if (linkchars == 0) {
+	if (linkchars <= 0) {
 		memset(fpath, 0, sizeof(fpath));
 		snprintf(fpath, sizeof(fpath), "/proc/%s/comm", dirname);
 		
@@ -139,6 +169,13 @@ static gchar *mmgui_netlink_process_name(gchar *dirname, gchar *appname, gsize a
 		} else {
 			return NULL;
 		}
+		
+		if (linkchars <= 0) return NULL;
+		
+		/*Kernel terminates name with newline*/
+		if (appname[linkchars-1] == '\n') {
+			linkchars--;
+		}
 	}
 		
 	appname[linkchars] = '\0';
@@ -156,41 +193,169 @@ static gchar *mmgui_netlink_process_name(gchar *dirname, gchar *appname, gsize a
 	return appname;
 }
 
-static gboolean mmgui_netlink_get_process(guint inode, gchar *appname, gsize namesize, pid_t *apppid)
+static guint64 mmgui_netlink_process_start_time(gchar *dirname)
+{
+	gint fd;
+	gchar fpath[PATH_MAX];
+	gchar statline[1024];
+	gchar *field;
+	ssize_t statchars;
+	guint i;
+	
+	memset(fpath, 0, sizeof(fpath));
+	snprintf(fpath, sizeof(fpath), "/proc/%s/stat", dirname);
+	
+	fd = open(fpath, O_RDONLY);
+	
+	if (fd == -1) return 0;
+	
+	statchars = read(fd, statline, sizeof(statline)-1);
+	close(fd);
+	
+	if (statchars <= 0) return 0;
+	
+	statline[statchars] = '\0';
+	
+	/*Process name may contain spaces, so fields are counted after its closing bracket*/
+	field = strrchr(statline, ')');
+	
+	if (field == NULL) return 0;
+	
+	/*Start time is 22nd field, 3rd field follows bracket*/
+	for (i=0; i<20; i++) {
+		field = strchr(field + 1, ' ');
+		if (field == NULL) return 0;
+	}
+	
+	return g_ascii_strtoull(field + 1, NULL, 10);
+}
+
+static gboolean mmgui_netlink_process_expired_foreach(gpointer key, gpointer value, gpointer user_data)
+{
+	mmgui_netlink_process_t process;
+	mmgui_netlink_t netlink;
+	
+	process = (mmgui_netlink_process_t)value;
+	netlink = (mmgui_netlink_t)user_data;
+	
+	return (process->generation != netlink->procgeneration);
+}
+
+static void mmgui_netlink_process_sockets_scan(mmgui_netlink_t netlink, mmgui_netlink_process_t process)
 {
-	DIR *procdir, *fddir;
-	struct dirent *procde, *fdde;
+	DIR *fddir;
+	struct dirent *fdde;
+	struct stat fdstat;
 	gchar fdirpath[PATH_MAX];
 	
-	if ((appname == NULL) || (namesize == 0) || (apppid == NULL)) return FALSE;
+	//Enumerate file descriptors
+	memset(fdirpath, 0, sizeof(fdirpath));
+	snprintf(fdirpath, sizeof(fdirpath), "/proc/%u/fd", (guint)process->pid);
+	
+	fddir = opendir(fdirpath);
+	
+	if (fddir == NULL) return;
+	
+	while ((fdde = readdir(fddir))) {
+		if (!mmgui_netlink_numeric_name(fdde->d_name)) continue;
+		if (fstatat(dirfd(fddir), fdde->d_name, &fdstat, 0) == -1) continue;
+		if ((fdstat.st_mode & S_IFMT) != S_IFSOCK) continue;
+		//Shared sockets belong to first process found
+		if (!g_hash_table_contains(netlink->sockowners, GUINT_TO_POINTER((guint)fdstat.st_ino))) {
+			g_hash_table_insert(netlink->sockowners, GUINT_TO_POINTER((guint)fdstat.st_ino), process);
+		}
+	}
+	
+	closedir(fddir);
+}
+
+static void mmgui_netlink_process_index_refresh(mmgui_netlink_t netlink, guint inode)
+{
+	DIR *procdir;
+	struct dirent *procde;
+	gchar appname[1024];
+	mmgui_netlink_process_t process;
+	GSList *known, *fresh, *replaced, *iterator;
+	guint64 starttime;
+	pid_t pid;
+	uid_t uid;
 	
 	procdir = opendir("/proc");
-	if (procdir != NULL) {
-		while ((procde = readdir(procdir))) {
-			if (mmgui_netlink_process_access(procde->d_name, getuid())) {
-				memset(fdirpath, 0, sizeof(fdirpath));
-				snprintf(fdirpath, sizeof(fdirpath), "/proc/%s/fd", procde->d_name);
-				//enumerate file descriptors
-				fddir = opendir(fdirpath);
-				if (fddir != NULL) {
-					while ((fdde = readdir(fddir))) {
-						if (mmgui_netlink_socket_access(procde->d_name, fdde->d_name, inode)) {
-							//printf("%s:%s (%s)\n", procde->d_name, fdde->d_name, nlconnections_process_name(procde->d_name, appname, sizeof(appname)));
-							*apppid = atoi(procde->d_name);
-							mmgui_netlink_process_name(procde->d_name, appname, namesize);
-							closedir(fddir);
-							closedir(procdir);
-							return TRUE;
-						}
-					}
-					closedir(fddir);
-				}
-			}
+	
+	if (procdir == NULL) return;
+	
+	netlink->procgeneration = netlink->dumpgeneration;
+	
+	known = NULL;
+	fresh = NULL;
+	replaced = NULL;
+	uid = getuid();
+	
+	/*Only new or restarted processes get their descriptors scanned*/
+	while ((procde = readdir(procdir))) {
+		if (!mmgui_netlink_process_access(procde->d_name, uid)) continue;
+		pid = atoi(procde->d_name);
+		starttime = mmgui_netlink_process_start_time(procde->d_name);
+		process = g_hash_table_lookup(netlink->processes, GINT_TO_POINTER(pid));
+		if ((process != NULL) && (process->starttime == starttime)) {
+			process->generation = netlink->procgeneration;
+			known = g_slist_prepend(known, process);
+			continue;
+		}
+		if (mmgui_netlink_process_name(procde->d_name, appname, sizeof(appname)) == NULL) continue;
+		//Reused PID belongs to another process, its sockets are dropped below
+		if (process != NULL) {
+			process->generation = 0;
+			g_hash_table_steal(netlink->processes, GINT_TO_POINTER(pid));
+			replaced = g_slist_prepend(replaced, process);
 		}
-		closedir(procdir);
+		process = g_new(struct _mmgui_netlink_process, 1);
+		process->pid = pid;
+		process->starttime = starttime;
+		process->appname = g_intern_string(appname);
+		process->generation = netlink->procgeneration;
+		g_hash_table_insert(netlink->processes, GINT_TO_POINTER(pid), process);
+		fresh = g_slist_prepend(fresh, process);
 	}
 	
-	return FALSE;
+	closedir(procdir);
+	
+	//Forget sockets and processes that exited
+	g_hash_table_foreach_remove(netlink->sockowners, mmgui_netlink_process_expired_foreach, netlink);
+	g_hash_table_foreach_remove(netlink->processes, mmgui_netlink_process_expired_foreach, netlink);
+	g_slist_free_full(replaced, g_free);
+	
+	for (iterator = fresh; iterator != NULL; iterator = iterator->next) {
+		mmgui_netlink_process_sockets_scan(netlink, (mmgui_netlink_process_t)iterator->data);
+	}
+	
+	//Socket opened by already known process
+	if (!g_hash_table_contains(netlink->sockowners, GUINT_TO_POINTER(inode))) {
+		for (iterator = known; iterator != NULL; iterator = iterator->next) {
+			mmgui_netlink_process_sockets_scan(netlink, (mmgui_netlink_process_t)iterator->data);
+		}
+	}
+	
+	g_slist_free(known);
+	g_slist_free(fresh);
+}
+
+static mmgui_netlink_process_t mmgui_netlink_get_process(mmgui_netlink_t netlink, guint inode)
+{
+	mmgui_netlink_process_t process;
+	
+	//Orphaned sockets have no owner
+	if (inode == 0) return NULL;
+	
+	process = g_hash_table_lookup(netlink->sockowners, GUINT_TO_POINTER(inode));
+	
+	//Unknown sockets cause at most one /proc pass per dump cycle
+	if ((process == NULL) && (netlink->procgeneration != netlink->dumpgeneration)) {
+		mmgui_netlink_process_index_refresh(netlink, inode);
+		process = g_hash_table_lookup(netlink->sockowners, GUINT_TO_POINTER(inode));
+	}
+	
+	return process;
 }
 
 gboolean mmgui_netlink_terminate_application(pid_t pid)
@@ -234,6 +399,18 @@ gchar *mmgui_netlink_socket_state(guchar state)
 	}
 }
 
+gchar *mmgui_netlink_socket_protocol(guchar protocol)
+{
+	switch (protocol) {
+		case IPPROTO_TCP:
+			return "TCP";
+		case IPPROTO_UDP:
+			return "UDP";
+		default:
+			return "Unknown";
+	}
+}
+
 void mmgui_netlink_hash_destroy(gpointer data)
 {
 	mmgui_netlink_connection_t connection;
@@ -242,64 +419,205 @@ void mmgui_netlink_hash_destroy(gpointer data)
 	
 	if (connection == NULL) return;
 	
-	if (connection->appname != NULL) g_free(connection->appname);
-	if (connection->dsthostname != NULL) g_free(connection->dsthostname);
-	
-	g_free(connection);
+	//Application name is interned and shared with process index
+	g_slice_free(struct _mmgui_netlink_connection, connection);
 }
 
 static gboolean mmgui_netlink_hash_clear_foreach(gpointer key, gpointer value, gpointer user_data)
 {
 	mmgui_netlink_connection_t connection;
 	mmgui_netlink_t netlink;
-	mmgui_netlink_connection_change_t change;
 	
 	connection = (mmgui_netlink_connection_t)value;
 	netlink = (mmgui_netlink_t)user_data;
 	
-	if (connection->updatetime == netlink->currenttime) {
+	if ((mmgui_netlink_dump_type(connection->family, connection->protocol) != netlink->dumpstale) || (connection->generation == netlink->dumpgeneration)) {
 		return FALSE;
 	} else {
-		if (netlink->changequeue != NULL) {
-			change = mmgui_netlink_create_connection_change(netlink, MMGUI_NETLINK_CONNECTION_EVENT_REMOVE, connection->inode);
-			if (change != NULL) {
-				g_async_queue_push(netlink->changequeue, change);
-			}								
-		}
+		mmgui_netlink_queue_connection_change(netlink, MMGUI_NETLINK_CONNECTION_EVENT_REMOVE, connection->inode);
 		
 		g_debug("Connection removed: inode %u\n", connection->inode);
 		return TRUE;
 	}
 }
 
-gboolean mmgui_netlink_request_connections_list(mmgui_netlink_t netlink, guint family)
+static guint mmgui_netlink_dump_type(guint family, guint protocol)
+{
+	if (protocol == IPPROTO_UDP) {
+		return (family == AF_INET) ? MMGUI_NETLINK_DUMP_UDP_INET : MMGUI_NETLINK_DUMP_UDP_INET6;
+	} else {
+		return (family == AF_INET) ? MMGUI_NETLINK_DUMP_TCP_INET : MMGUI_NETLINK_DUMP_TCP_INET6;
+	}
+}
+
+static void mmgui_netlink_remove_stale_connections(mmgui_netlink_t netlink, guint dump)
+{
+	netlink->dumpstale = dump;
+	
+	g_hash_table_foreach_remove(netlink->connections, mmgui_netlink_hash_clear_foreach, netlink);
+}
+
+static gboolean mmgui_netlink_family_watched(mmgui_netlink_t netlink, guint family)
+{
+	guint i;
+	
+	//Without known addresses modem sockets can not be told from LAN and loopback ones
+	if ((netlink->accountaddrs == NULL) || (netlink->accountaddrs->len == 0)) return FALSE;
+	
+	for (i=0; i<netlink->accountaddrs->len; i++) {
+		if (g_array_index(netlink->accountaddrs, struct _mmgui_netlink_address, i).family == family) {
+			return TRUE;
+		}
+	}
+	
+	return FALSE;
+}
+
+static gsize mmgui_netlink_connections_filter(mmgui_netlink_t netlink, guint family, gchar *bytecode, gsize size)
+{
+	struct _mmgui_netlink_address *address;
+	struct inet_diag_bc_op *op;
+	struct inet_diag_hostcond *cond;
+	gsize addrlen, condlen, length, offset;
+	guint i;
+	
+	if ((netlink->accountaddrs == NULL) || (netlink->accountaddrs->len == 0)) return 0;
+	
+	addrlen = (family == AF_INET) ? 4 : 16;
+	condlen = sizeof(struct inet_diag_bc_op) + sizeof(struct inet_diag_hostcond) + addrlen;
+	
+	length = 0;
+	for (i=0; i<netlink->accountaddrs->len; i++) {
+		if (g_array_index(netlink->accountaddrs, struct _mmgui_netlink_address, i).family == family) {
+			length += (length == 0) ? condlen : condlen + sizeof(struct inet_diag_bc_op);
+		}
+	}
+	
+	//Too many addresses are checked in userspace only
+	if ((length == 0) || (length > size)) return 0;
+	
+	/*Source address conditions joined with OR like ss does it: matching condition is followed by jump to filter end which accepts socket,
+	  mismatch skips that jump to next condition, last mismatch lands past filter end and rejects socket.
+	  Kernel verifies that every target is reachable through match branches.*/
+	offset = 0;
+	for (i=0; i<netlink->accountaddrs->len; i++) {
+		address = &g_array_index(netlink->accountaddrs, struct _mmgui_netlink_address, i);
+		if (address->family != family) continue;
+		op = (struct inet_diag_bc_op *)(bytecode + offset);
+		op->code = INET_DIAG_BC_S_COND;
+		op->yes = condlen;
+		op->no = condlen + sizeof(struct inet_diag_bc_op);
+		cond = (struct inet_diag_hostcond *)(bytecode + offset + sizeof(struct inet_diag_bc_op));
+		cond->family = family;
+		cond->prefix_len = addrlen * 8;
+		cond->port = -1;
+		memcpy(cond->addr, address->addr, addrlen);
+		offset += condlen;
+		if (offset < length) {
+			op = (struct inet_diag_bc_op *)(bytecode + offset);
+			op->code = INET_DIAG_BC_JMP;
+			op->yes = sizeof(struct inet_diag_bc_op);
+			op->no = length - offset;
+			offset += sizeof(struct inet_diag_bc_op);
+		}
+	}
+	
+	return length;
+}
+
+static gboolean mmgui_netlink_send_connections_dump(mmgui_netlink_t netlink, guint family, guint protocol)
 {
 	struct _mmgui_netlink_connection_info_request request;
+	gsize bytecodelen;
 	gint status;
-		
-	if ((netlink == NULL) || ((family != AF_INET) && (family != AF_INET6))) return FALSE;
 	
-	memset(&request.msgheader, 0, sizeof(struct nlmsghdr));
+	memset(&request, 0, sizeof(request));
 	
-	request.msgheader.nlmsg_len = sizeof(struct _mmgui_netlink_connection_info_request);
-	request.msgheader.nlmsg_type = TCPDIAG_GETSOCK;
-	request.msgheader.nlmsg_flags = NLM_F_REQUEST | NLM_F_ROOT;
+	request.msgheader.nlmsg_len = NLMSG_LENGTH(sizeof(struct inet_diag_req_v2));
+	request.msgheader.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+	request.msgheader.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
 	request.msgheader.nlmsg_pid = ((1 & 0xffc00000) << 22) | (getpid() & 0x3fffff);
-	request.msgheader.nlmsg_seq = 0;
+	request.msgheader.nlmsg_seq = ++netlink->dumpsequence;
+	
+	request.nlreq.sdiag_family = family;
+	request.nlreq.sdiag_protocol = protocol;
+	if (protocol == IPPROTO_UDP) {
+		request.nlreq.idiag_states = MMGUI_NETLINK_UDP_STATES;
+		/*UDP has no byte counters, but memory info shows queued datagrams*/
+		request.nlreq.idiag_ext = (1 << (INET_DIAG_MEMINFO - 1));
+	} else {
+		request.nlreq.idiag_states = MMGUI_NETLINK_TCP_CONNECTED_STATES;
+		/*TCP info carries per-socket byte counters*/
+		request.nlreq.idiag_ext = (1 << (INET_DIAG_INFO - 1));
+	}
 	
-	memset(&request.nlreq, 0, sizeof(struct inet_diag_req));
-	request.nlreq.idiag_family = family;
-	request.nlreq.idiag_states = ((1 << (TCP_CLOSING + 1)) - 1);
+	/*Kernel skips sockets not bound to modem interface addresses*/
+	bytecodelen = mmgui_netlink_connections_filter(netlink, family, request.bytecode, sizeof(request.bytecode));
+	if (bytecodelen > 0) {
+		request.bcattr.rta_type = INET_DIAG_REQ_BYTECODE;
+		request.bcattr.rta_len = RTA_LENGTH(bytecodelen);
+		request.msgheader.nlmsg_len += RTA_ALIGN(request.bcattr.rta_len);
+	}
 	
 	request.msgheader.nlmsg_len = NLMSG_ALIGN(request.msgheader.nlmsg_len);
 	
 	status = send(netlink->connsocketfd, &request, request.msgheader.nlmsg_len, 0);
 	
-	if (status != -1) {
-		return TRUE;
-	} else {
-		return FALSE;
+	return (status != -1);
+}
+
+static gboolean mmgui_netlink_send_next_dump(mmgui_netlink_t netlink)
+{
+	guint dump, family, protocol;
+	
+	netlink->dumpcurrent = 0;
+	netlink->dumptruncated = FALSE;
+	
+	while (netlink->dumpqueue != 0) {
+		dump = 1 << g_bit_nth_lsf(netlink->dumpqueue, -1);
+		netlink->dumpqueue &= ~dump;
+		family = (dump & MMGUI_NETLINK_DUMP_INET) ? AF_INET : AF_INET6;
+		protocol = (dump & MMGUI_NETLINK_DUMP_UDP) ? IPPROTO_UDP : IPPROTO_TCP;
+		//Interface has no addresses of this family, so none of its sockets are relevant
+		if (!mmgui_netlink_family_watched(netlink, family)) {
+			mmgui_netlink_remove_stale_connections(netlink, dump);
+			continue;
+		}
+		if (mmgui_netlink_send_connections_dump(netlink, family, protocol)) {
+			netlink->dumpcurrent = dump;
+			return TRUE;
+		}
+	}
+	
+	return FALSE;
+}
+
+gboolean mmgui_netlink_request_connections_list(mmgui_netlink_t netlink, guint family)
+{
+	if ((netlink == NULL) || ((family != AF_INET) && (family != AF_INET6))) return FALSE;
+	if (netlink->connsocketfd == -1) return FALSE;
+	
+	//Lost dump must not block the following ones
+	if ((netlink->dumpcurrent != 0) && (time(NULL) - netlink->currenttime > MMGUI_NETLINK_DUMP_TIMEOUT)) {
+		netlink->dumpcurrent = 0;
+		netlink->dumpqueue = 0;
+	}
+	
+	//New cycle starts when previous dumps are complete
+	if ((netlink->dumpcurrent == 0) && (netlink->dumpqueue == 0)) {
+		netlink->currenttime = time(NULL);
+		netlink->dumpgeneration++;
+	}
+	
+	//Both TCP and UDP sockets of family are listed
+	netlink->dumpqueue |= mmgui_netlink_dump_type(family, IPPROTO_TCP) | mmgui_netlink_dump_type(family, IPPROTO_UDP);
+	
+	//Kernel runs one dump per socket at a time
+	if (netlink->dumpcurrent == 0) {
+		mmgui_netlink_send_next_dump(netlink);
 	}
+	
+	return TRUE;
 }
 
 gboolean mmgui_netlink_read_connections_list(mmgui_netlink_t netlink, gchar *data, gsize datasize)
@@ -307,59 +625,82 @@ gboolean mmgui_netlink_read_connections_list(mmgui_netlink_t netlink, gchar *dat
 	struct nlmsghdr *msgheader;
 	struct inet_diag_msg *entry;
 	mmgui_netlink_connection_t connection;
-	mmgui_netlink_connection_change_t change;
-	/*struct hostent *dsthost;*/
-	gchar srcbuf[INET6_ADDRSTRLEN];
-	gchar dstbuf[INET6_ADDRSTRLEN];
-	gchar appname[1024];
-	pid_t apppid;
-	gboolean needupdate;
+	mmgui_netlink_process_t process;
+	gboolean needupdate, counters;
+	guint64 rxbytes, txbytes;
+	guint dqueue;
+	guchar protocol;
 			
 	if ((netlink == NULL) || (data == NULL) || (datasize == 0)) return FALSE;
 	
-	//Get current time
-	netlink->currenttime = time(NULL);
-	
-	//Work with data
+	//Work with data, dump may span many messages
 	for (msgheader = (struct nlmsghdr *)data; NLMSG_OK(msgheader, (unsigned int)datasize); msgheader = NLMSG_NEXT(msgheader, datasize)) {
+		//Late reply to timed out dump must not be taken for current one
+		if ((netlink->dumpcurrent == 0) || (msgheader->nlmsg_seq != netlink->dumpsequence)) continue;
 		if ((msgheader->nlmsg_type == NLMSG_ERROR) || (msgheader->nlmsg_type == NLMSG_DONE)) {
+			if ((msgheader->nlmsg_type == NLMSG_DONE) && (netlink->dumptruncated)) {
+				//Part of dump was lost, so it is requested again
+				netlink->dumpqueue |= netlink->dumpcurrent;
+			} else if (msgheader->nlmsg_type == NLMSG_DONE) {
+				//Sockets seen after full dumps of both families were opened while we watched
+				netlink->conndumps++;
+				//Connections missing from complete dump are closed
+				mmgui_netlink_remove_stale_connections(netlink, netlink->dumpcurrent);
+			}
+			mmgui_netlink_send_next_dump(netlink);
 			break;
 		}
 		//New connections list
-		if (msgheader->nlmsg_type == TCPDIAG_GETSOCK) {
+		if (msgheader->nlmsg_type == SOCK_DIAG_BY_FAMILY) {
 			entry = (struct inet_diag_msg *)NLMSG_DATA(msgheader);
 			if (entry != NULL) {
+				//Messages carry no protocol, but only one dump runs at a time
+				if (netlink->dumpcurrent & MMGUI_NETLINK_DUMP_UDP) {
+					protocol = IPPROTO_UDP;
+					counters = FALSE;
+					if (!mmgui_netlink_memory_queue(msgheader, &dqueue)) {
+						dqueue = entry->idiag_rqueue + entry->idiag_wqueue;
+					}
+				} else {
+					protocol = IPPROTO_TCP;
+					counters = mmgui_netlink_tcp_info_counters(msgheader, &rxbytes, &txbytes);
+					dqueue = entry->idiag_rqueue + entry->idiag_wqueue;
+				}
 				if ((entry->idiag_uid == netlink->userid) || (netlink->userid == 0)) {
 					if (!g_hash_table_contains(netlink->connections, (gconstpointer)&entry->idiag_inode)) {
 						//Add new connection
-						if (mmgui_netlink_get_process(entry->idiag_inode, appname, sizeof(appname), &apppid)) {
-							connection = g_new(struct _mmgui_netlink_connection, 1);
+						process = mmgui_netlink_get_process(netlink, entry->idiag_inode);
+						if (process != NULL) {
+							connection = g_slice_new(struct _mmgui_netlink_connection);
 							connection->inode = entry->idiag_inode;
 							connection->family = entry->idiag_family;
+							connection->protocol = protocol;
 							connection->userid = entry->idiag_uid;
 							connection->updatetime = netlink->currenttime;
-							connection->dqueue = entry->idiag_rqueue + entry->idiag_wqueue;
+							connection->generation = netlink->dumpgeneration;
+							connection->dqueue = dqueue;
 							connection->state = entry->idiag_state;
+							//Addresses are formatted only when shown
+							memcpy(connection->srcaddr, entry->id.idiag_src, sizeof(connection->srcaddr));
+							memcpy(connection->dstaddr, entry->id.idiag_dst, sizeof(connection->dstaddr));
 							connection->srcport = ntohs(entry->id.idiag_sport);
-							g_snprintf(connection->srcaddr, sizeof(connection->srcaddr), "%s:%u", inet_ntop(entry->idiag_family, entry->id.idiag_src, srcbuf, INET6_ADDRSTRLEN), ntohs(entry->id.idiag_sport));
-							g_snprintf(connection->dstaddr, sizeof(connection->dstaddr), "%s:%u", inet_ntop(entry->idiag_family, entry->id.idiag_dst, dstbuf, INET6_ADDRSTRLEN), ntohs(entry->id.idiag_dport));
-							connection->appname = g_strdup(appname);
-							connection->apppid = apppid;
-							connection->dsthostname = NULL;
-							/*dsthost = gethostbyaddr(entry->id.idiag_dst, sizeof(entry->id.idiag_dst), entry->idiag_family);
-							if (dsthost != NULL) {
-								connection->dsthostname = g_strdup(dsthost->h_name);
-							} else {*/
-								connection->dsthostname = g_strdup(connection->dstaddr);
-							/*}*/
+							connection->dstport = ntohs(entry->id.idiag_dport);
+							connection->appname = process->appname;
+							connection->apppid = process->pid;
+							//Traffic before first dumps was not watched by us
+							connection->rxbytes = 0;
+							connection->txbytes = 0;
+							if (counters) {
+								if (netlink->conndumps < 2) {
+									connection->rxbytes = rxbytes;
+									connection->txbytes = txbytes;
+								} else if (mmgui_netlink_address_accounted(netlink, entry)) {
+									mmgui_netlink_account_traffic(netlink, connection, rxbytes, txbytes);
+								}
+							}
 							g_hash_table_insert(netlink->connections, (gpointer)&connection->inode, connection);
 							/*Add change*/
-							if (netlink->changequeue != NULL) {
-								change = mmgui_netlink_create_connection_change(netlink, MMGUI_NETLINK_CONNECTION_EVENT_ADD, connection->inode);
-								if (change != NULL) {
-									g_async_queue_push(netlink->changequeue, change);
-								}								
-							}
+							mmgui_netlink_queue_connection_change(netlink, MMGUI_NETLINK_CONNECTION_EVENT_ADD, connection->inode);
 							g_debug("Connection added: inode %u\n", entry->idiag_inode);
 						}
 					} else {
@@ -367,9 +708,13 @@ gboolean mmgui_netlink_read_connections_list(mmgui_netlink_t netlink, gchar *dat
 						connection = g_hash_table_lookup(netlink->connections, (gconstpointer)&entry->idiag_inode);
 						if (connection != NULL) {
 							connection->updatetime = netlink->currenttime;
+							connection->generation = netlink->dumpgeneration;
+							if ((counters) && (mmgui_netlink_address_accounted(netlink, entry))) {
+								mmgui_netlink_account_traffic(netlink, connection, rxbytes, txbytes);
+							}
 							needupdate = FALSE;
-							if (connection->dqueue != (entry->idiag_rqueue + entry->idiag_wqueue)) {
-								connection->dqueue = entry->idiag_rqueue + entry->idiag_wqueue;
+							if (connection->dqueue != dqueue) {
+								connection->dqueue = dqueue;
 								needupdate = TRUE;
 							}
 							if (connection->state != entry->idiag_state) {
@@ -377,12 +722,7 @@ gboolean mmgui_netlink_read_connections_list(mmgui_netlink_t netlink, gchar *dat
 								needupdate = TRUE;
 							}
 							if (needupdate) {
-								if (netlink->changequeue != NULL) {
-									change = mmgui_netlink_create_connection_change(netlink, MMGUI_NETLINK_CONNECTION_EVENT_MODIFY, connection->inode);
-									if (change != NULL) {
-										g_async_queue_push(netlink->changequeue, change);
-									}								
-								}
+								mmgui_netlink_queue_connection_change(netlink, MMGUI_NETLINK_CONNECTION_EVENT_MODIFY, connection->inode);
 								g_debug("Connection updated: inode %u\n", entry->idiag_inode);
 							}
 						}	
@@ -392,9 +732,6 @@ gboolean mmgui_netlink_read_connections_list(mmgui_netlink_t netlink, gchar *dat
 		}
 	}
 	
-	//Remove connections that disappear
-	g_hash_table_foreach_remove(netlink->connections, mmgui_netlink_hash_clear_foreach, netlink);
-		
 	return TRUE;
 }
 
@@ -442,7 +779,7 @@ gboolean mmgui_netlink_read_interface_event(mmgui_netlink_t netlink, gchar *data
 	struct ifinfomsg *ifi;
 	struct rtattr *rta;
 	struct rtnl_link_stats *ifstats;
-	struct rtnl_link_stats64 *ifstats64;
+	struct rtnl_link_stats64 ifstats64;
 	gchar ifname[IFNAMSIZ];
 	gboolean have64bitstats;
 	
@@ -497,15 +834,16 @@ gboolean mmgui_netlink_read_interface_event(mmgui_netlink_t netlink, gchar *data
 						}
 					}
 					g_debug("Tag: Interface Statistics (32bit): RX: %u, TX: %u\n", ifstats->rx_bytes, ifstats->tx_bytes);
-				} else if (rta->rta_type == IFLA_STATS64) {
-					ifstats64 = (struct rtnl_link_stats64 *)RTA_DATA(rta);
-					event->rxbytes = ifstats64->rx_bytes;
-					event->txbytes = ifstats64->tx_bytes;
+				} else if ((rta->rta_type == IFLA_STATS64) && (RTA_PAYLOAD(rta) >= sizeof(ifstats64))) {
+					/*Attribute payload is only 4-byte aligned*/
+					memcpy(&ifstats64, RTA_DATA(rta), sizeof(ifstats64));
+					event->rxbytes = ifstats64.rx_bytes;
+					event->txbytes = ifstats64.tx_bytes;
 					have64bitstats = TRUE;
 					if (!(event->type & MMGUI_NETLINK_INTERFACE_EVENT_TYPE_STATS)) {
 						event->type |= MMGUI_NETLINK_INTERFACE_EVENT_TYPE_STATS;
 					}
-					g_debug("Tag: Interface Statistics (64bit): RX: %llu, TX: %llu\n", ifstats64->rx_bytes, ifstats64->tx_bytes);
+					g_debug("Tag: Interface Statistics (64bit): RX: %llu, TX: %llu\n", ifstats64.rx_bytes, ifstats64.tx_bytes);
 				} else if (rta->rta_type == IFLA_LINK) {
 					g_debug("Tag: Link type\n");
 				} else if (rta->rta_type == IFLA_ADDRESS) {
@@ -517,6 +855,7 @@ gboolean mmgui_netlink_read_interface_event(mmgui_netlink_t netlink, gchar *data
 				}
 				rta = RTA_NEXT(rta, msgheader->nlmsg_len);
 			}
+			event->counters64 = have64bitstats;
 		}
 	}
 	
@@ -564,25 +903,15 @@ static mmgui_netlink_connection_change_t mmgui_netlink_create_connection_change(
 		case MMGUI_NETLINK_CONNECTION_EVENT_ADD:
 			connection = g_hash_table_lookup(netlink->connections, &inode);
 			if (connection != NULL) {
-				change = g_new0(struct _mmgui_netlink_connection_change, 1);
+				change = g_slice_new(struct _mmgui_netlink_connection_change);
 				change->inode = inode;
 				change->event = event;
-				change->data.connection = g_new0(struct _mmgui_netlink_connection, 1);
-				change->data.connection->state = connection->state;
-				change->data.connection->family = connection->family;
-				change->data.connection->srcport = connection->srcport;
-				change->data.connection->dqueue = connection->dqueue;
-				change->data.connection->inode = connection->inode;
-				change->data.connection->userid = connection->userid;
-				change->data.connection->apppid = connection->apppid;
-				change->data.connection->appname = g_strdup(connection->appname);
-				change->data.connection->dsthostname = g_strdup(connection->dsthostname);
-				strncpy(change->data.connection->srcaddr, connection->srcaddr, sizeof(change->data.connection->srcaddr));
-				strncpy(change->data.connection->dstaddr, connection->dstaddr, sizeof(change->data.connection->dstaddr));
+				//Connection holds no owned strings, so plain copy is enough
+				change->data.connection = g_slice_dup(struct _mmgui_netlink_connection, connection);
 			}
 			break;
 		case MMGUI_NETLINK_CONNECTION_EVENT_REMOVE:
-			change = g_new0(struct _mmgui_netlink_connection_change, 1);
+			change = g_slice_new(struct _mmgui_netlink_connection_change);
 			change->inode = inode;
 			change->event = event;
 			change->data.connection = NULL;
@@ -590,10 +919,10 @@ static mmgui_netlink_connection_change_t mmgui_netlink_create_connection_change(
 		case MMGUI_NETLINK_CONNECTION_EVENT_MODIFY:
 			connection = g_hash_table_lookup(netlink->connections, &inode);
 			if (connection != NULL) {
-				change = g_new0(struct _mmgui_netlink_connection_change, 1);
+				change = g_slice_new(struct _mmgui_netlink_connection_change);
 				change->inode = inode;
 				change->event = event;
-				change->data.params = g_new0(struct _mmgui_netlink_connection_changed_params, 1);
+				change->data.params = g_slice_new(struct _mmgui_netlink_connection_changed_params);
 				change->data.params->state = connection->state;
 				change->data.params->dqueue = connection->dqueue;
 			}
@@ -605,6 +934,60 @@ static mmgui_netlink_connection_change_t mmgui_netlink_create_connection_change(
 	return change;
 }
 
+static void mmgui_netlink_queue_connection_change(mmgui_netlink_t netlink, guint event, guint inode)
+{
+	mmgui_netlink_connection_change_t change;
+	mmgui_netlink_connection_t connection;
+	gboolean replaces;
+	
+	//Nobody watches connections list
+	if (netlink->changes == NULL) return;
+	
+	change = g_hash_table_lookup(netlink->changes, &inode);
+	replaces = FALSE;
+	
+	if (change != NULL) {
+		/*Changes of one socket between two deliveries are merged*/
+		switch (event) {
+			case MMGUI_NETLINK_CONNECTION_EVENT_ADD:
+				//Inode of removed socket was reused, row is replaced
+				replaces = ((change->event != MMGUI_NETLINK_CONNECTION_EVENT_ADD) || (change->replaces));
+				g_hash_table_remove(netlink->changes, &inode);
+				break;
+			case MMGUI_NETLINK_CONNECTION_EVENT_REMOVE:
+				if ((change->event == MMGUI_NETLINK_CONNECTION_EVENT_ADD) && (!change->replaces)) {
+					//Socket opened and closed in the same window is never shown
+					g_hash_table_remove(netlink->changes, &inode);
+					return;
+				}
+				//Row of socket shown before still has to be removed
+				g_hash_table_remove(netlink->changes, &inode);
+				break;
+			case MMGUI_NETLINK_CONNECTION_EVENT_MODIFY:
+				connection = g_hash_table_lookup(netlink->connections, &inode);
+				if (connection == NULL) return;
+				//Only latest state is delivered
+				if (change->event == MMGUI_NETLINK_CONNECTION_EVENT_ADD) {
+					change->data.connection->state = connection->state;
+					change->data.connection->dqueue = connection->dqueue;
+				} else if (change->event == MMGUI_NETLINK_CONNECTION_EVENT_MODIFY) {
+					change->data.params->state = connection->state;
+					change->data.params->dqueue = connection->dqueue;
+				}
+				return;
+			default:
+				return;
+		}
+	}
+	
+	change = mmgui_netlink_create_connection_change(netlink, event, inode);
+	
+	if (change != NULL) {
+		change->replaces = replaces;
+		g_hash_table_insert(netlink->changes, &change->inode, change);
+	}
+}
+
 void mmgui_netlink_free_connection_change(mmgui_netlink_connection_change_t change)
 {
 	if (change == NULL) return;
@@ -612,24 +995,18 @@ void mmgui_netlink_free_connection_change(mmgui_netlink_connection_change_t chan
 	switch (change->event) {
 		case MMGUI_NETLINK_CONNECTION_EVENT_ADD:
 			if (change->data.connection != NULL) {
-				if (change->data.connection->appname != NULL) {
-					g_free(change->data.connection->appname);
-				}
-				if (change->data.connection->dsthostname != NULL) {
-					g_free(change->data.connection->dsthostname);
-				}
-				g_free(change->data.connection);
+				g_slice_free(struct _mmgui_netlink_connection, change->data.connection);
 			}
-			g_free(change);
+			g_slice_free(struct _mmgui_netlink_connection_change, change);
 			break;
 		case MMGUI_NETLINK_CONNECTION_EVENT_REMOVE:
-			g_free(change);
+			g_slice_free(struct _mmgui_netlink_connection_change, change);
 			break;
 		case MMGUI_NETLINK_CONNECTION_EVENT_MODIFY:
 			if (change->data.params != NULL) {
-				g_free(change->data.params);				
+				g_slice_free(struct _mmgui_netlink_connection_changed_params, change->data.params);
 			}
-			g_free(change);
+			g_slice_free(struct _mmgui_netlink_connection_change, change);
 			break;
 		 default:
 			break;
@@ -640,15 +1017,20 @@ void mmgui_netlink_free_connection(mmgui_netlink_connection_t connection)
 {
 	if (connection == NULL) return;
 	
-	if (connection->appname != NULL) {
-		g_free(connection->appname);
-	}
+	g_slice_free(struct _mmgui_netlink_connection, connection);
+}
+
+gchar *mmgui_netlink_connection_address(mmgui_netlink_connection_t connection, gboolean destination, gchar *buffer, gsize bufsize)
+{
+	gchar addrbuf[INET6_ADDRSTRLEN];
 	
-	if (connection->dsthostname != NULL) {
-		g_free(connection->dsthostname);
-	}
+	if ((connection == NULL) || (buffer == NULL) || (bufsize == 0)) return NULL;
+	
+	if (inet_ntop(connection->family, destination ? connection->dstaddr : connection->srcaddr, addrbuf, sizeof(addrbuf)) == NULL) return NULL;
 	
-	g_free(connection);
+	g_snprintf(buffer, bufsize, "%s:%u", addrbuf, destination ? connection->dstport : connection->srcport);
+	
+	return buffer;
 }
 
 GSList *mmgui_netlink_open_interactive_connections_list(mmgui_netlink_t netlink)
@@ -666,19 +1048,7 @@ GSList *mmgui_netlink_open_interactive_connections_list(mmgui_netlink_t netlink)
 	while (g_hash_table_iter_next(&iter, &key, &value)) {
 		srcconn = (mmgui_netlink_connection_t)value;
 		if (srcconn != NULL) {
-			dstconn = g_new(struct _mmgui_netlink_connection, 1);
-			dstconn->inode = srcconn->inode;
-			dstconn->family = srcconn->family;
-			dstconn->userid = srcconn->userid;
-			dstconn->updatetime = srcconn->updatetime;
-			dstconn->dqueue = srcconn->dqueue;
-			dstconn->state = srcconn->state;
-			dstconn->srcport = srcconn->srcport;
-			strncpy(dstconn->srcaddr, srcconn->srcaddr, sizeof(dstconn->srcaddr));
-			strncpy(dstconn->dstaddr, srcconn->dstaddr, sizeof(dstconn->dstaddr));
-			dstconn->appname = g_strdup(srcconn->appname);
-			dstconn->apppid = srcconn->apppid;
-			dstconn->dsthostname = g_strdup(srcconn->dsthostname);
+			dstconn = g_slice_dup(struct _mmgui_netlink_connection, srcconn);
 			connections = g_slist_prepend(connections, dstconn);
 		}
 	}
@@ -686,8 +1056,9 @@ GSList *mmgui_netlink_open_interactive_connections_list(mmgui_netlink_t netlink)
 		connections = g_slist_reverse(connections);
 	}
 	
-	if (netlink->changequeue == NULL) {
-		netlink->changequeue = g_async_queue_new_full((GDestroyNotify)mmgui_netlink_free_connection_change);
+	if (netlink->changes == NULL) {
+		netlink->changes = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, (GDestroyNotify)mmgui_netlink_free_connection_change);
+		netlink->changesnotified = FALSE;
 	}
 	
 	return connections;
@@ -695,32 +1066,260 @@ GSList *mmgui_netlink_open_interactive_connections_list(mmgui_netlink_t netlink)
 
 void mmgui_netlink_close_interactive_connections_list(mmgui_netlink_t netlink)
 {
-	if (netlink->changequeue != NULL) {
-		g_async_queue_unref(netlink->changequeue);
-		netlink->changequeue = NULL;
+	if (netlink->changes != NULL) {
+		g_hash_table_destroy(netlink->changes);
+		netlink->changes = NULL;
+	}
+}
+
+gboolean mmgui_netlink_receive_connections_list(mmgui_netlink_t netlink)
+{
+	struct _mmgui_netlink_receive_batch *batch;
+	struct nlmsghdr *msgheader;
+	gint received, i;
+	gboolean updated;
+	
+	if ((netlink == NULL) || (netlink->recvbatch == NULL)) return FALSE;
+	
+	batch = netlink->recvbatch;
+	
+	//Kernel rewrites only address length and flags of prepared headers
+	for (i=0; i<MMGUI_NETLINK_RECEIVE_BATCH; i++) {
+		batch->messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_nl);
+		batch->messages[i].msg_hdr.msg_flags = 0;
+	}
+	
+	received = recvmmsg(netlink->connsocketfd, batch->messages, MMGUI_NETLINK_RECEIVE_BATCH, MSG_DONTWAIT, NULL);
+	
+	if (received <= 0) return FALSE;
+	
+	updated = FALSE;
+	
+	for (i=0; i<received; i++) {
+		//Sockets cut off from message would be taken for closed ones
+		if (batch->messages[i].msg_hdr.msg_flags & MSG_TRUNC) {
+			g_debug("Connections message truncated to %u bytes, dump dropped\n", batch->messages[i].msg_len);
+			msgheader = (struct nlmsghdr *)batch->buffers[i];
+			if ((batch->messages[i].msg_len >= sizeof(struct nlmsghdr)) && (msgheader->nlmsg_seq == netlink->dumpsequence)) {
+				netlink->dumptruncated = TRUE;
+			}
+			continue;
+		}
+		if (mmgui_netlink_read_connections_list(netlink, batch->buffers[i], batch->messages[i].msg_len)) {
+			updated = TRUE;
+		}
 	}
+	
+	return updated;
 }
 
 GSList *mmgui_netlink_get_connections_changes(mmgui_netlink_t netlink)
 {
 	GSList *changes;
-	mmgui_netlink_connection_change_t change;
+	GHashTableIter iter;
+	gpointer key, value;
 	
-	if (netlink->changequeue == NULL) return NULL;
+	if (netlink->changes == NULL) return NULL;
 	
 	changes = NULL;
 	
-	while ((change = g_async_queue_try_pop(netlink->changequeue)) != NULL) {
-		changes = g_slist_prepend(changes, change);
+	//Whole change set is taken at once, at most one change per socket
+	g_hash_table_iter_init(&iter, netlink->changes);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		changes = g_slist_prepend(changes, value);
+		g_hash_table_iter_steal(&iter);
 	}
 	
-	if (changes != NULL) {
-		changes = g_slist_reverse(changes);
-	}
+	netlink->changesnotified = FALSE;
 	
 	return changes;
 }
 
+gboolean mmgui_netlink_notify_connections_changes(mmgui_netlink_t netlink)
+{
+	if ((netlink == NULL) || (netlink->changes == NULL)) return FALSE;
+	
+	//Pending change set is announced once, until it is taken
+	if ((netlink->changesnotified) || (g_hash_table_size(netlink->changes) == 0)) return FALSE;
+	
+	netlink->changesnotified = TRUE;
+	
+	return TRUE;
+}
+
+gboolean mmgui_netlink_set_accounting_interface(mmgui_netlink_t netlink, const gchar *interface)
+{
+	struct ifaddrs *ifaddresses, *ifaddress;
+	struct _mmgui_netlink_address address;
+	
+	if ((netlink == NULL) || (interface == NULL)) return FALSE;
+	if (netlink->accountaddrs == NULL) return FALSE;
+	
+	//Addresses of previous interface must not stay if new ones are unknown
+	g_array_set_size(netlink->accountaddrs, 0);
+	
+	if (getifaddrs(&ifaddresses) == -1) return FALSE;
+	
+	for (ifaddress = ifaddresses; ifaddress != NULL; ifaddress = ifaddress->ifa_next) {
+		if ((ifaddress->ifa_addr == NULL) || (ifaddress->ifa_name == NULL)) continue;
+		if (!g_str_equal(ifaddress->ifa_name, interface)) continue;
+		memset(&address, 0, sizeof(address));
+		if (ifaddress->ifa_addr->sa_family == AF_INET) {
+			address.family = AF_INET;
+			memcpy(address.addr, &((struct sockaddr_in *)ifaddress->ifa_addr)->sin_addr, 4);
+			g_array_append_val(netlink->accountaddrs, address);
+		} else if (ifaddress->ifa_addr->sa_family == AF_INET6) {
+			address.family = AF_INET6;
+			memcpy(address.addr, &((struct sockaddr_in6 *)ifaddress->ifa_addr)->sin6_addr, 16);
+			g_array_append_val(netlink->accountaddrs, address);
+		}
+	}
+	
+	freeifaddrs(ifaddresses);
+	
+	return TRUE;
+}
+
+GHashTable *mmgui_netlink_take_application_usage(mmgui_netlink_t netlink)
+{
+	GHashTable *usage;
+	
+	if ((netlink == NULL) || (netlink->appusage == NULL)) return NULL;
+	
+	if (g_hash_table_size(netlink->appusage) == 0) return NULL;
+	
+	usage = netlink->appusage;
+	netlink->appusage = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)mmgui_netlink_app_usage_destroy);
+	
+	return usage;
+}
+
+static gboolean mmgui_netlink_tcp_info_counters(struct nlmsghdr *msgheader, guint64 *rxbytes, guint64 *txbytes)
+{
+	struct rtattr *attr;
+	gint attrlen;
+	
+	if ((msgheader == NULL) || (rxbytes == NULL) || (txbytes == NULL)) return FALSE;
+	
+	attr = (struct rtattr *)((gchar *)NLMSG_DATA(msgheader) + NLMSG_ALIGN(sizeof(struct inet_diag_msg)));
+	attrlen = msgheader->nlmsg_len - NLMSG_LENGTH(NLMSG_ALIGN(sizeof(struct inet_diag_msg)));
+	
+	while (RTA_OK(attr, attrlen)) {
+		if (attr->rta_type == INET_DIAG_INFO) {
+			//Older kernels send shorter structure without byte counters
+			if (RTA_PAYLOAD(attr) < MMGUI_NETLINK_TCP_INFO_BYTES_RECEIVED_OFFSET + sizeof(guint64)) return FALSE;
+			memcpy(txbytes, (gchar *)RTA_DATA(attr) + MMGUI_NETLINK_TCP_INFO_BYTES_ACKED_OFFSET, sizeof(guint64));
+			memcpy(rxbytes, (gchar *)RTA_DATA(attr) + MMGUI_NETLINK_TCP_INFO_BYTES_RECEIVED_OFFSET, sizeof(guint64));
+			return TRUE;
+		}
+		attr = RTA_NEXT(attr, attrlen);
+	}
+	
+	return FALSE;
+}
+
+static gboolean mmgui_netlink_memory_queue(struct nlmsghdr *msgheader, guint *dqueue)
+{
+	struct rtattr *attr;
+	struct inet_diag_meminfo meminfo;
+	gint attrlen;
+	
+	if ((msgheader == NULL) || (dqueue == NULL)) return FALSE;
+	
+	attr = (struct rtattr *)((gchar *)NLMSG_DATA(msgheader) + NLMSG_ALIGN(sizeof(struct inet_diag_msg)));
+	attrlen = msgheader->nlmsg_len - NLMSG_LENGTH(NLMSG_ALIGN(sizeof(struct inet_diag_msg)));
+	
+	while (RTA_OK(attr, attrlen)) {
+		if (attr->rta_type == INET_DIAG_MEMINFO) {
+			if (RTA_PAYLOAD(attr) < sizeof(meminfo)) return FALSE;
+			memcpy(&meminfo, RTA_DATA(attr), sizeof(meminfo));
+			//Received datagrams not read yet and datagrams not sent yet
+			*dqueue = meminfo.idiag_rmem + meminfo.idiag_tmem;
+			return TRUE;
+		}
+		attr = RTA_NEXT(attr, attrlen);
+	}
+	
+	return FALSE;
+}
+
+static gboolean mmgui_netlink_address_accounted(mmgui_netlink_t netlink, struct inet_diag_msg *entry)
+{
+	struct _mmgui_netlink_address *address;
+	guint i;
+	
+	//Without known addresses nothing is charged to modem
+	if ((netlink->accountaddrs == NULL) || (netlink->accountaddrs->len == 0)) return FALSE;
+	
+	for (i=0; i<netlink->accountaddrs->len; i++) {
+		address = &g_array_index(netlink->accountaddrs, struct _mmgui_netlink_address, i);
+		if (address->family != entry->idiag_family) continue;
+		if (memcmp(address->addr, entry->id.idiag_src, (address->family == AF_INET) ? 4 : 16) == 0) {
+			return TRUE;
+		}
+	}
+	
+	return FALSE;
+}
+
+static void mmgui_netlink_account_traffic(mmgui_netlink_t netlink, mmgui_netlink_connection_t connection, guint64 rxbytes, guint64 txbytes)
+{
+	mmgui_netlink_app_usage_t usage;
+	guint64 deltarxbytes, deltatxbytes;
+	
+	//Counters only grow while socket lives
+	deltarxbytes = (rxbytes > connection->rxbytes) ? rxbytes - connection->rxbytes : 0;
+	deltatxbytes = (txbytes > connection->txbytes) ? txbytes - connection->txbytes : 0;
+	connection->rxbytes = rxbytes;
+	connection->txbytes = txbytes;
+	
+	if (((deltarxbytes == 0) && (deltatxbytes == 0)) || (connection->appname == NULL)) return;
+	
+	usage = g_hash_table_lookup(netlink->appusage, connection->appname);
+	if (usage == NULL) {
+		usage = g_new0(struct _mmgui_netlink_app_usage, 1);
+		usage->appname = g_strdup(connection->appname);
+		g_hash_table_insert(netlink->appusage, usage->appname, usage);
+	}
+	
+	usage->apppid = connection->apppid;
+	usage->rxbytes += deltarxbytes;
+	usage->txbytes += deltatxbytes;
+}
+
+static void mmgui_netlink_app_usage_destroy(gpointer data)
+{
+	mmgui_netlink_app_usage_t usage;
+	
+	usage = (mmgui_netlink_app_usage_t)data;
+	
+	if (usage == NULL) return;
+	
+	g_free(usage->appname);
+	g_free(usage);
+}
+
+static struct _mmgui_netlink_receive_batch *mmgui_netlink_receive_batch_new(void)
+{
+	struct _mmgui_netlink_receive_batch *batch;
+	gint i;
+	
+	batch = g_new0(struct _mmgui_netlink_receive_batch, 1);
+	
+	for (i=0; i<MMGUI_NETLINK_RECEIVE_BATCH; i++) {
+		batch->iovecs[i].iov_base = batch->buffers[i];
+		batch->iovecs[i].iov_len = MMGUI_NETLINK_RECEIVE_BUFFER_SIZE;
+		batch->messages[i].msg_hdr.msg_name = &batch->addresses[i];
+		batch->messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_nl);
+		batch->messages[i].msg_hdr.msg_iov = &batch->iovecs[i];
+		batch->messages[i].msg_hdr.msg_iovlen = 1;
+		batch->messages[i].msg_hdr.msg_control = NULL;
+		batch->messages[i].msg_hdr.msg_controllen = 0;
+	}
+	
+	return batch;
+}
+
 void mmgui_netlink_close(mmgui_netlink_t netlink)
 {
 	if (netlink == NULL) return;
@@ -728,9 +1327,14 @@ void mmgui_netlink_close(mmgui_netlink_t netlink)
 	if (netlink->connsocketfd != -1) {
 		close(netlink->connsocketfd);
 		g_hash_table_destroy(netlink->connections);
-		if (netlink->changequeue != NULL) {
-			g_async_queue_unref(netlink->changequeue);
+		if (netlink->changes != NULL) {
+			g_hash_table_destroy(netlink->changes);
 		}
+		g_hash_table_destroy(netlink->appusage);
+		g_array_free(netlink->accountaddrs, TRUE);
+		g_hash_table_destroy(netlink->sockowners);
+		g_hash_table_destroy(netlink->processes);
+		g_free(netlink->recvbatch);
 	}
 	
 	if (netlink->intsocketfd != -1) {
@@ -759,10 +1363,39 @@ mmgui_netlink_t mmgui_netlink_open(void)
 		netlink->connaddr.nl_groups = 0;
 		
 		netlink->userid = getuid();
-		netlink->changequeue = NULL;
+		netlink->changes = NULL;
+		netlink->changesnotified = FALSE;
 		netlink->connections = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, (GDestroyNotify)mmgui_netlink_hash_destroy);
+		netlink->appusage = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)mmgui_netlink_app_usage_destroy);
+		netlink->accountaddrs = g_array_new(FALSE, TRUE, sizeof(struct _mmgui_netlink_address));
+		netlink->conndumps = 0;
+		netlink->processes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+		netlink->sockowners = g_hash_table_new(g_direct_hash, g_direct_equal);
+		netlink->procgeneration = 0;
+		netlink->dumpgeneration = 0;
+		netlink->dumpqueue = 0;
+		netlink->dumpcurrent = 0;
+		netlink->dumpstale = 0;
+		netlink->dumpsequence = 0;
+		netlink->dumptruncated = FALSE;
+		netlink->currenttime = 0;
+		netlink->recvbatch = mmgui_netlink_receive_batch_new();
 	} else {
 		netlink->connections = NULL;
+		netlink->appusage = NULL;
+		netlink->accountaddrs = NULL;
+		netlink->conndumps = 0;
+		netlink->processes = NULL;
+		netlink->sockowners = NULL;
+		netlink->procgeneration = 0;
+		netlink->dumpgeneration = 0;
+		netlink->dumpqueue = 0;
+		netlink->dumpcurrent = 0;
+		netlink->dumpstale = 0;
+		netlink->dumpsequence = 0;
+		netlink->dumptruncated = FALSE;
+		netlink->currenttime = 0;
+		netlink->recvbatch = NULL;
 		g_debug("Failed to open connections monitoring netlink socket\n");
 	}
 	
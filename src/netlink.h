@@ -25,6 +25,7 @@
 #include <netinet/in.h>
 #include <linux/netlink.h>
 #include <linux/inet_diag.h>
+#include <linux/sock_diag.h>
 #include <linux/rtnetlink.h>
 
 enum _mmgui_netlink_interface_event_type {
@@ -45,17 +46,48 @@ struct _mmgui_netlink_connection {
 	guint dqueue;
 	uid_t userid;
 	time_t updatetime;
+	guint generation;
 	pid_t apppid;
-	gchar *appname;
-	gchar *dsthostname;
-	gchar srcaddr[INET6_ADDRSTRLEN + 8];
-	gchar dstaddr[INET6_ADDRSTRLEN + 8];
+	const gchar *appname;
+	/*Binary addresses in network byte order*/
+	guchar srcaddr[16];
+	guchar dstaddr[16];
 	gushort srcport;
+	gushort dstport;
 	guchar state;
 	guchar family;
+	guchar protocol;
+	/*Cumulative TCP counters from kernel*/
+	guint64 rxbytes;
+	guint64 txbytes;
 };
 
 typedef struct _mmgui_netlink_connection *mmgui_netlink_connection_t;
+
+/*Process owning sockets, name is interned*/
+struct _mmgui_netlink_process {
+	pid_t pid;
+	guint64 starttime;
+	const gchar *appname;
+	guint generation;
+};
+
+typedef struct _mmgui_netlink_process *mmgui_netlink_process_t;
+
+/*Traffic of one application since last collection*/
+struct _mmgui_netlink_app_usage {
+	gchar *appname;
+	pid_t apppid;
+	guint64 rxbytes;
+	guint64 txbytes;
+};
+
+typedef struct _mmgui_netlink_app_usage *mmgui_netlink_app_usage_t;
+/*Local address of accounted interface*/
+struct _mmgui_netlink_address {
+	guchar family;
+	guchar addr[16];
+};
 /*Changed parameters of connection */
 struct _mmgui_netlink_connection_changed_params {
 	guchar state;
@@ -67,6 +99,7 @@ typedef struct _mmgui_netlink_connection_changed_params *mmgui_netlink_connectio
 struct _mmgui_netlink_connection_change {
 	guint inode;
 	guint event;
+	gboolean replaces; //pending ADD follows REMOVE of socket with same inode
 	union {
 		mmgui_netlink_connection_changed_params_t params;
 		mmgui_netlink_connection_t connection;
@@ -76,9 +109,19 @@ struct _mmgui_netlink_connection_change {
 typedef struct _mmgui_netlink_connection_change *mmgui_netlink_connection_change_t;
 
 
+/*Bytecode filter matches up to 8 IPv6 addresses, each followed by jump except last one*/
+#define MMGUI_NETLINK_FILTER_MAX_ADDRESSES 8
+#define MMGUI_NETLINK_FILTER_BYTECODE_SIZE (MMGUI_NETLINK_FILTER_MAX_ADDRESSES * (2 * sizeof(struct inet_diag_bc_op) + sizeof(struct inet_diag_hostcond) + 16) - sizeof(struct inet_diag_bc_op))
+
+/*Kernel fills dump messages up to 32 KiB when reader buffer allows it*/
+#define MMGUI_NETLINK_RECEIVE_BATCH       4
+#define MMGUI_NETLINK_RECEIVE_BUFFER_SIZE 32768
+
 struct _mmgui_netlink_connection_info_request {
 	struct nlmsghdr msgheader;
-	struct inet_diag_req nlreq;
+	struct inet_diag_req_v2 nlreq;
+	struct rtattr bcattr;
+	gchar bytecode[MMGUI_NETLINK_FILTER_BYTECODE_SIZE];
 };
 
 struct _mmgui_netlink_interface_info_request {
@@ -93,6 +136,7 @@ struct _mmgui_netlink_interface_event {
 	gboolean up;
 	guint64 rxbytes;
 	guint64 txbytes;
+	gboolean counters64;
 };
 
 typedef struct _mmgui_netlink_interface_event *mmgui_netlink_interface_event_t;
@@ -103,8 +147,26 @@ struct _mmgui_netlink {
 	pid_t userid;
 	time_t currenttime;
 	GHashTable *connections;
-	GAsyncQueue *changequeue; //single queue for now
+	GHashTable *changes; //pending changes merged by inode
+	gboolean changesnotified;
 	struct sockaddr_nl connaddr;
+	//Per-application accounting
+	GHashTable *appusage;
+	GArray *accountaddrs;
+	guint conndumps;
+	//Socket inode to process index, updated incrementally from /proc
+	GHashTable *processes;
+	GHashTable *sockowners;
+	guint procgeneration;
+	//Dump cycle, kernel runs one dump per socket so others wait in queue
+	guint dumpgeneration;
+	guint dumpqueue;
+	guint dumpcurrent;
+	guint dumpstale;
+	//Sequence number of dump in flight, replies to timed out dumps carry older one
+	guint dumpsequence;
+	gboolean dumptruncated;
+	struct _mmgui_netlink_receive_batch *recvbatch;
 	//Network interfaces monitoring
 	gint intsocketfd;
 	struct sockaddr_nl intaddr;
@@ -114,9 +176,11 @@ typedef struct _mmgui_netlink *mmgui_netlink_t;
 
 gboolean mmgui_netlink_terminate_application(pid_t pid);
 gchar *mmgui_netlink_socket_state(guchar state);
+gchar *mmgui_netlink_socket_protocol(guchar protocol);
 gboolean mmgui_netlink_update(mmgui_netlink_t netlink);
 gboolean mmgui_netlink_request_connections_list(mmgui_netlink_t netlink, guint family);
 gboolean mmgui_netlink_read_connections_list(mmgui_netlink_t netlink, gchar *data, gsize datasize);
+gboolean mmgui_netlink_receive_connections_list(mmgui_netlink_t netlink);
 gboolean mmgui_netlink_request_interface_statistics(mmgui_netlink_t netlink, gchar *interface);
 gboolean mmgui_netlink_read_interface_event(mmgui_netlink_t netlink, gchar *data, gsize datasize, mmgui_netlink_interface_event_t event);
 gint mmgui_netlink_get_connections_monitoring_socket_fd(mmgui_netlink_t netlink);
@@ -125,9 +189,13 @@ struct sockaddr_nl *mmgui_netlink_get_connections_monitoring_socket_address(mmgu
 struct sockaddr_nl *mmgui_netlink_get_interfaces_monitoring_socket_address(mmgui_netlink_t netlink);
 void mmgui_netlink_free_connection_change(mmgui_netlink_connection_change_t change);
 void mmgui_netlink_free_connection(mmgui_netlink_connection_t connection);
+gchar *mmgui_netlink_connection_address(mmgui_netlink_connection_t connection, gboolean destination, gchar *buffer, gsize bufsize);
 GSList *mmgui_netlink_open_interactive_connections_list(mmgui_netlink_t netlink);
 void mmgui_netlink_close_interactive_connections_list(mmgui_netlink_t netlink);
 GSList *mmgui_netlink_get_connections_changes(mmgui_netlink_t netlink);
+gboolean mmgui_netlink_notify_connections_changes(mmgui_netlink_t netlink);
+gboolean mmgui_netlink_set_accounting_interface(mmgui_netlink_t netlink, const gchar *interface);
+GHashTable *mmgui_netlink_take_application_usage(mmgui_netlink_t netlink);
 void mmgui_netlink_close(mmgui_netlink_t netlink);
 mmgui_netlink_t mmgui_netlink_open(void);
 
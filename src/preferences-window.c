@@ -303,6 +303,7 @@ void mmgui_preferences_window_activate_signal(GSimpleAction *action, GVariant *p
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(mmguiapp->window->prefsmsoldontop), mmguiapp->options->smsoldontop);
 	gtk_range_set_value(GTK_RANGE(mmguiapp->window->prefsmsvalidityscale), (gdouble)mmguiapp->options->smsvalidityperiod);
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(mmguiapp->window->prefsmsreportcb), mmguiapp->options->smsdeliveryreport);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(mmguiapp->window->prefsmsarchivespin), (gdouble)mmguiapp->options->smsarchivemonths);
 	if (mmguiapp->options->smscustomcommand != NULL) {
 		gtk_entry_set_text(GTK_ENTRY(mmguiapp->window->prefsmscommandentry), mmguiapp->options->smscustomcommand);
 	}
@@ -399,6 +400,8 @@ void mmgui_preferences_window_activate_signal(GSimpleAction *action, GVariant *p
 		gmm_settings_set_int(mmguiapp->settings, "sms_validity_period", (gint)gtk_range_get_value(GTK_RANGE(mmguiapp->window->prefsmsvalidityscale)));
 		mmguiapp->options->smsdeliveryreport = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(mmguiapp->window->prefsmsreportcb));
 		gmm_settings_set_boolean(mmguiapp->settings, "sms_send_delivery_report", gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(mmguiapp->window->prefsmsreportcb)));
+		mmguiapp->options->smsarchivemonths = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(mmguiapp->window->prefsmsarchivespin));
+		gmm_settings_set_int(mmguiapp->settings, "sms_archive_months", gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(mmguiapp->window->prefsmsarchivespin)));
 		/*Custom command validation*/
 		if (mmguiapp->options->smscustomcommand != NULL) {
 			g_free(mmguiapp->options->smscustomcommand);
@@ -51,9 +51,13 @@ enum _mmgui_main_smslist_columns {
 	MMGUI_MAIN_SMSLIST_ID,
 	MMGUI_MAIN_SMSLIST_FOLDER,
 	MMGUI_MAIN_SMSLIST_ISFOLDER,
+	MMGUI_MAIN_SMSLIST_THREAD,
 	MMGUI_MAIN_SMSLIST_COLUMNS
 };
 
+/*Conversations node follows message folders*/
+#define MMGUI_MAIN_SMSLIST_FOLDER_THREADS MMGUI_SMSDB_SMS_FOLDERS_NUMBER
+
 enum _mmgui_main_new_sms_validation {
 	MMGUI_MAIN_NEW_SMS_VALIDATION_VALID = 0x00,
 	MMGUI_MAIN_NEW_SMS_VALIDATION_WRONG_NUMBER = 0x01,
@@ -89,21 +93,40 @@ enum _mmgui_main_sms_list {
 	MMGUI_MAIN_SMS_LIST_COLUMNS
 };
 
+/*Search results shown at once*/
+#define MMGUI_MAIN_SMS_SEARCH_LIMIT 500
+/*Search starts when user stops typing for this many milliseconds*/
+#define MMGUI_MAIN_SMS_SEARCH_DELAY 300
+
 struct _sms_selection_data {
 	mmgui_application_t mmguiapp;
-	gulong messageid;
+	guint64 messageid;
 };
 
 typedef struct _sms_selection_data *sms_selection_data_t;
 
 static void mmgui_main_sms_notification_show_window_callback(gpointer notification, gchar *action, gpointer userdata);
-static void mmgui_main_sms_select_entry_from_list(mmgui_application_t mmguiapp, gulong entryid, gboolean isfolder);
+static void mmgui_main_sms_select_entry_from_list(mmgui_application_t mmguiapp, guint64 entryid, gboolean isfolder);
 static void mmgui_main_sms_get_message_list_hash_destroy_notify(gpointer data);
 static void mmgui_main_sms_new_dialog_number_changed_signal(GtkEditable *editable, gpointer data);
 static enum _mmgui_main_new_sms_dialog_result mmgui_main_sms_new_dialog(mmgui_application_t mmguiapp, const gchar *number, const gchar *text);
 static void mmgui_main_sms_list_selection_changed_signal(GtkTreeSelection *selection, gpointer data);
 static void mmgui_main_sms_list_row_activated_signal(GtkTreeView *treeview, GtkTreePath *path, GtkTreeViewColumn *col, gpointer data);
+static void mmgui_main_sms_message_set(mmgui_application_t mmguiapp, GtkTreeModel *model, GtkTreeIter *iter, mmgui_sms_message_t sms);
 static void mmgui_main_sms_add_to_list(mmgui_application_t mmguiapp, mmgui_sms_message_t sms, GtkTreeModel *model, gboolean expand);
+static GSList *mmgui_main_sms_search_list_read(mmgui_application_t mmguiapp, const gchar *query);
+static GSList *mmgui_main_sms_search_list_scan(mmgui_application_t mmguiapp, const gchar *query);
+static gboolean mmgui_main_sms_search_timeout_handler(gpointer data);
+static void mmgui_main_sms_thread_set(mmgui_application_t mmguiapp, GtkTreeModel *model, GtkTreeIter *iter, mmgui_sms_thread_t thread);
+static void mmgui_main_sms_thread_list_fill(mmgui_application_t mmguiapp, GtkTreeModel *model);
+static gboolean mmgui_main_sms_thread_update(mmgui_application_t mmguiapp, GtkTreeModel *model, const gchar *number, gboolean raise, GtkTreeIter *threaditer);
+static void mmgui_main_sms_thread_messages_fill(mmgui_application_t mmguiapp, GtkTreeModel *model, GtkTreeIter *threaditer);
+static gboolean mmgui_main_sms_list_test_expand_row_signal(GtkTreeView *treeview, GtkTreeIter *iter, GtkTreePath *path, gpointer data);
+static void mmgui_main_sms_list_mark_read(mmgui_application_t mmguiapp, GtkTreeModel *model, guint64 id, const gchar *number);
+static void mmgui_main_sms_list_remove_ids(mmgui_application_t mmguiapp, GtkTreeModel *model, GHashTable *ids);
+static void mmgui_main_sms_rows_destroy(gpointer data);
+static GSList *mmgui_main_sms_rows_get(mmgui_application_t mmguiapp, guint64 id);
+static void mmgui_main_sms_list_model_fill(mmgui_application_t mmguiapp);
 static gboolean mmgui_main_sms_autocompletion_select_entry_signal(GtkEntryCompletion *widget, GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data);
 static void mmgui_main_sms_autocompletion_model_fill(mmgui_application_t mmguiapp, guint source);
 static void mmgui_main_sms_menu_model_fill(mmgui_application_t mmguiapp, guint source);
@@ -136,7 +159,7 @@ static void mmgui_main_sms_notification_show_window_callback(gpointer notificati
 	g_free(seldata);
 }
 
-static void mmgui_main_sms_select_entry_from_list(mmgui_application_t mmguiapp, gulong entryid, gboolean isfolder)
+static void mmgui_main_sms_select_entry_from_list(mmgui_application_t mmguiapp, guint64 entryid, gboolean isfolder)
 {
 	GtkTreeModel *model;
 	GtkTreeSelection *selection;
@@ -144,7 +167,7 @@ static void mmgui_main_sms_select_entry_from_list(mmgui_application_t mmguiapp,
 	GtkTreeIter *firstfolderiter, *entryiter;
 	GtkTreePath *path;
     gboolean foldervalid, msgvalid;
-    gulong curid;
+    guint64 curid;
     guint curfolder;
     gboolean curisfolder;
     
@@ -339,6 +362,9 @@ gboolean mmgui_main_sms_get_message_list_from_thread(gpointer data)
 	/*Free list*/
 	g_slist_free(messages);
 	
+	/*Commit all added messages with single sync*/
+	mmgui_smsdb_flush(mmguicore_devices_get_sms_db(mmguiappdata->mmguiapp->core));
+	
 	/*Form notification caption based on messages count*/
 	if (nummessages > 1) {
 		notifycaption = g_strdup_printf(_("Received %u new SMS messages"), nummessages);
@@ -460,7 +486,7 @@ gboolean mmgui_main_sms_handle_new_day_from_thread(gpointer data)
 	GtkTreeModel *model;
 	GtkTreeIter folderiter, msgiter;
 	gboolean foldervalid, msgvalid;
-	gulong curid;
+	guint64 curid;
 	guint curfolder;
 	gboolean curisfolder;
 	mmgui_sms_message_t message;
@@ -760,8 +786,9 @@ void mmgui_main_sms_remove(mmgui_application_t mmguiapp)
 	guint rmcount;
 	gchar *questionstr;
 	gchar *errorstr;
-	gulong id;
+	guint64 id;
 	gboolean isfolder;
+	GHashTable *removed;
 	
 	if (mmguiapp == NULL) return;
 		
@@ -795,13 +822,19 @@ void mmgui_main_sms_remove(mmgui_application_t mmguiapp)
 				questionstr = g_strdup_printf(_("Really want to remove messages (%u) ?"), rowcount);
 				if (mmgui_main_ui_question_dialog_open(mmguiapp, _("<b>Remove messages</b>"), questionstr)) {
 					rmcount = 0;
+					removed = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
 					for (listiter = rowreflist; listiter; listiter = listiter->next) {
 						treepath = gtk_tree_row_reference_get_path((GtkTreeRowReference *)listiter->data);
 						if (treepath != NULL) {
 							if (gtk_tree_model_get_iter(GTK_TREE_MODEL(model), &iter, treepath)) {
 								gtk_tree_model_get(model, &iter, MMGUI_MAIN_SMSLIST_ID, &id, MMGUI_MAIN_SMSLIST_ISFOLDER, &isfolder, -1);
 								if (!isfolder) {
-									if (mmgui_smsdb_remove_sms_message(mmguicore_devices_get_sms_db(mmguiapp->core), id)) {
+									/*Same message may be selected in folder and in conversation*/
+									if (g_hash_table_contains(removed, &id)) {
+										gtk_tree_store_remove(GTK_TREE_STORE(model), &iter);
+										rmcount++;
+									} else if (mmgui_smsdb_remove_sms_message(mmguicore_devices_get_sms_db(mmguiapp->core), id)) {
+										g_hash_table_add(removed, g_memdup(&id, sizeof(id)));
 										/*Remove entry from list*/
 										gtk_tree_store_remove(GTK_TREE_STORE(model), &iter);
 										/*Ayatana menu*/
@@ -813,6 +846,12 @@ void mmgui_main_sms_remove(mmgui_application_t mmguiapp)
 							}
 						}
 					}
+					/*Remove other copies of messages and refresh conversations*/
+					if (g_hash_table_size(removed) > 0) {
+						mmgui_main_sms_list_remove_ids(mmguiapp, model, removed);
+						mmgui_main_sms_thread_list_fill(mmguiapp, model);
+					}
+					g_hash_table_destroy(removed);
 					/*Show error message if some messages weren't removed*/
 					if (rmcount < rowcount) {
 						errorstr = g_strdup_printf(_("Some messages weren\'t removed (%u)"), rowcount - rmcount);
@@ -878,7 +917,7 @@ void mmgui_main_sms_answer(mmgui_application_t mmguiapp)
 	gchar *pathstr;
 	GtkTreeIter iter;
 	guint smscaps;
-	gulong id;
+	guint64 id;
 	guint folder;
 	gboolean isfolder;
 	mmgui_sms_message_t message;
@@ -955,7 +994,7 @@ static void mmgui_main_sms_list_selection_changed_signal(GtkTreeSelection *selec
 	GtkTreePath *treepath;
 	GList *msgreflist, *folderreflist;
 	guint msgcount, foldercount, folder;
-	gulong id, lastid;
+	guint64 id, lastid;
 	gboolean isfolder, numchecked, canremove, cananswer;
 	gchar *msgnumber;
 	
@@ -1062,7 +1101,7 @@ static void mmgui_main_sms_list_selection_changed_signal(GtkTreeSelection *selec
 									/*Set read flag if not set before*/
 									if (!mmgui_smsdb_message_get_read(sms)) {
 										if (mmgui_smsdb_set_message_read_status(mmguicore_devices_get_sms_db(mmguiapp->core), id, TRUE)) {
-											gtk_tree_store_set(GTK_TREE_STORE(model), &iter, MMGUI_MAIN_SMSLIST_ICON, mmguiapp->window->smsreadicon, -1);
+											mmgui_main_sms_list_mark_read(mmguiapp, model, id, mmgui_smsdb_message_get_number(sms));
 										}
 										/*Ayatana menu*/
 										mmgui_ayatana_set_unread_messages_number(mmguiapp->ayatana, mmgui_smsdb_get_unread_messages(mmguicore_devices_get_sms_db(mmguiapp->core)));
@@ -1134,6 +1173,16 @@ static void mmgui_main_sms_list_selection_changed_signal(GtkTreeSelection *selec
 											gtk_text_buffer_get_end_iter(textbuffer, &endtextiter);
 											gtk_text_buffer_insert(textbuffer, &endtextiter, _("This is folder for your SMS message drafts.\nSelect message and click 'Answer' button to start editing."), -1);
 											break;
+										case MMGUI_MAIN_SMSLIST_FOLDER_THREADS:
+											/*Folder heading*/
+											gtk_text_buffer_get_end_iter(textbuffer, &endtextiter);
+											gtk_text_buffer_insert_with_tags(textbuffer, &endtextiter, _("Conversations"), -1, mmguiapp->window->smsheadingtag, NULL);
+											gtk_text_buffer_get_end_iter(textbuffer, &endtextiter);
+											gtk_text_buffer_insert(textbuffer, &endtextiter, "\n", -1);
+											/*Folder description*/
+											gtk_text_buffer_get_end_iter(textbuffer, &endtextiter);
+											gtk_text_buffer_insert(textbuffer, &endtextiter, _("Messages grouped by contact, most recent conversation first.\nExpand conversation to read its messages."), -1);
+											break;
 										default:
 											break;
 									}
@@ -1165,22 +1214,16 @@ static void mmgui_main_sms_list_row_activated_signal(GtkTreeView *treeview, GtkT
 	mmgui_main_sms_answer(mmguiapp);
 }
 
-static void mmgui_main_sms_add_to_list(mmgui_application_t mmguiapp, mmgui_sms_message_t sms, GtkTreeModel *model, gboolean expand)
+static void mmgui_main_sms_message_set(mmgui_application_t mmguiapp, GtkTreeModel *model, GtkTreeIter *iter, mmgui_sms_message_t sms)
 {
-	GtkTreeIter iter, child;
-	GtkTreePath *expandpath;
 	time_t timestamp;
 	gchar *markup;
 	gchar timestr[200];
 	GdkPixbuf *icon;
 	guint folder;
-		
-	if ((mmguiapp == NULL) || (sms == NULL)) return;
-	
-	/*Get model if needed*/
-	if (model == NULL) {
-		model = gtk_tree_view_get_model(GTK_TREE_VIEW(mmguiapp->window->smslist));
-	}
+	guint64 id;
+	GtkTreePath *path;
+	GSList *rows;
 	
 	/*Get message timestamp*/
 	timestamp = mmgui_smsdb_message_get_timestamp(sms);
@@ -1195,33 +1238,100 @@ static void mmgui_main_sms_add_to_list(mmgui_application_t mmguiapp, mmgui_sms_m
 		icon = mmguiapp->window->smsunreadicon;
 	}
 	
+	/*Unknown folders are shown as incoming*/
+	folder = mmgui_smsdb_message_get_folder(sms);
+	if (folder >= MMGUI_SMSDB_SMS_FOLDERS_NUMBER) {
+		folder = MMGUI_SMSDB_SMS_FOLDER_INCOMING;
+	}
+	
+	id = mmgui_smsdb_message_get_db_identifier(sms);
+	
+	gtk_tree_store_set(GTK_TREE_STORE(model), iter,
+						MMGUI_MAIN_SMSLIST_ICON, icon,
+						MMGUI_MAIN_SMSLIST_SMS, markup,
+						MMGUI_MAIN_SMSLIST_ID, id,
+						MMGUI_MAIN_SMSLIST_FOLDER, folder,
+						MMGUI_MAIN_SMSLIST_ISFOLDER, FALSE,
+						-1);
+	
+	/*Rows are found by identifier without walking the list*/
+	path = gtk_tree_model_get_path(model, iter);
+	rows = mmgui_main_sms_rows_get(mmguiapp, id);
+	rows = g_slist_prepend(rows, gtk_tree_row_reference_new(model, path));
+	g_hash_table_insert(mmguiapp->window->smsrows, g_memdup(&id, sizeof(id)), rows);
+	gtk_tree_path_free(path);
+	
+	/*Free markup string*/
+	g_free(markup);
+}
+
+static void mmgui_main_sms_rows_destroy(gpointer data)
+{
+	g_slist_free_full((GSList *)data, (GDestroyNotify)gtk_tree_row_reference_free);
+}
+
+static GSList *mmgui_main_sms_rows_get(mmgui_application_t mmguiapp, guint64 id)
+{
+	GSList *rows, *iterator, *valid;
+	gpointer key;
+	
+	if (!g_hash_table_lookup_extended(mmguiapp->window->smsrows, &id, &key, (gpointer *)&rows)) return NULL;
+	
+	g_hash_table_steal(mmguiapp->window->smsrows, &id);
+	g_free(key);
+	
+	/*References of removed rows are dropped, so each list holds shown copies only*/
+	valid = NULL;
+	for (iterator=rows; iterator; iterator=iterator->next) {
+		if (gtk_tree_row_reference_valid((GtkTreeRowReference *)iterator->data)) {
+			valid = g_slist_prepend(valid, iterator->data);
+		} else {
+			gtk_tree_row_reference_free((GtkTreeRowReference *)iterator->data);
+		}
+	}
+	
+	g_slist_free(rows);
+	
+	return valid;
+}
+
+static void mmgui_main_sms_add_to_list(mmgui_application_t mmguiapp, mmgui_sms_message_t sms, GtkTreeModel *model, gboolean expand)
+{
+	GtkTreeIter iter, child, threaditer;
+	GtkTreePath *expandpath;
+	gboolean newmessage, isplaceholder;
+		
+	if ((mmguiapp == NULL) || (sms == NULL)) return;
+	
+	/*Get model if needed*/
+	newmessage = (model == NULL);
+	if (model == NULL) {
+		model = gtk_tree_view_get_model(GTK_TREE_VIEW(mmguiapp->window->smslist));
+	}
+	
 	/*Create iterators*/
 	expandpath = NULL;
 	
 	switch (mmgui_smsdb_message_get_folder(sms)) {
 		case MMGUI_SMSDB_SMS_FOLDER_INCOMING:
-			folder = MMGUI_SMSDB_SMS_FOLDER_INCOMING;
 			gtk_tree_model_get_iter(model, &iter, mmguiapp->window->incomingpath);
 			if ((expand) && (!gtk_tree_model_iter_has_child(model, &iter))) {
 				expandpath = mmguiapp->window->incomingpath;
 			}
 			break;
 		case MMGUI_SMSDB_SMS_FOLDER_SENT:
-			folder = MMGUI_SMSDB_SMS_FOLDER_SENT;
 			gtk_tree_model_get_iter(model, &iter, mmguiapp->window->sentpath);
 			if ((expand) && (!gtk_tree_model_iter_has_child(model, &iter))) {
 				expandpath = mmguiapp->window->sentpath;
 			}
 			break;
 		case MMGUI_SMSDB_SMS_FOLDER_DRAFTS:
-			folder = MMGUI_SMSDB_SMS_FOLDER_DRAFTS;
 			gtk_tree_model_get_iter(model, &iter, mmguiapp->window->draftspath);
 			if ((expand) && (!gtk_tree_model_iter_has_child(model, &iter))) {
 				expandpath = mmguiapp->window->draftspath;
 			}
 			break;
 		default:
-			folder = MMGUI_SMSDB_SMS_FOLDER_INCOMING;
 			gtk_tree_model_get_iter(model, &iter, mmguiapp->window->incomingpath);
 			if ((expand) && (!gtk_tree_model_iter_has_child(model, &iter))) {
 				expandpath = mmguiapp->window->incomingpath;
@@ -1237,31 +1347,324 @@ static void mmgui_main_sms_add_to_list(mmgui_application_t mmguiapp, mmgui_sms_m
 	}
 	
 	/*Finally add message*/
-	gtk_tree_store_set(GTK_TREE_STORE(model), &child,
+	mmgui_main_sms_message_set(mmguiapp, model, &child, sms);
+	
+	/*Conversation of new message goes on top*/
+	if (newmessage) {
+		if (mmgui_main_sms_thread_update(mmguiapp, model, mmgui_smsdb_message_get_number(sms), TRUE, &threaditer)) {
+			/*Message is added only to already loaded conversation, placeholder loads it later*/
+			if (gtk_tree_model_iter_children(model, &child, &threaditer)) {
+				gtk_tree_model_get(model, &child, MMGUI_MAIN_SMSLIST_ISFOLDER, &isplaceholder, -1);
+				if (!isplaceholder) {
+					gtk_tree_store_append(GTK_TREE_STORE(model), &child, &threaditer);
+					mmgui_main_sms_message_set(mmguiapp, model, &child, sms);
+				}
+			}
+		}
+	}
+	
+	/*Expand list with first message if needed*/
+	if (expandpath != NULL) {
+		gtk_tree_view_expand_to_path(GTK_TREE_VIEW(mmguiapp->window->smslist), expandpath);
+	}
+}
+
+static GSList *mmgui_main_sms_search_list_read(mmgui_application_t mmguiapp, const gchar *query)
+{
+	smsdb_t smsdb;
+	GArray *ids;
+	GSList *smslist;
+	mmgui_sms_message_t message;
+	guint i;
+	
+	smsdb = (smsdb_t)mmguicore_devices_get_sms_db(mmguiapp->core);
+	
+	ids = mmgui_smsdb_search_sms(smsdb, query, MMGUI_MAIN_SMS_SEARCH_LIMIT);
+	
+	/*Query shorter than one trigram can not be looked up in index*/
+	if (ids == NULL) {
+		return mmgui_main_sms_search_list_scan(mmguiapp, query);
+	}
+	
+	smslist = NULL;
+	
+	/*Identifiers come newest first, list is built in arrival order*/
+	for (i=0; i<ids->len; i++) {
+		message = mmgui_smsdb_read_sms_message(smsdb, g_array_index(ids, guint64, i));
+		if (message != NULL) {
+			smslist = g_slist_prepend(smslist, message);
+		}
+	}
+	
+	g_array_free(ids, TRUE);
+	
+	return smslist;
+}
+
+static GSList *mmgui_main_sms_search_list_scan(mmgui_application_t mmguiapp, const gchar *query)
+{
+	GSList *smslist, *iterator, *next;
+	mmgui_sms_message_t message;
+	gchar *foldquery, *foldvalue;
+	gboolean found;
+	
+	smslist = mmgui_smsdb_read_sms_list(mmguicore_devices_get_sms_db(mmguiapp->core));
+	
+	if (smslist == NULL) return NULL;
+	
+	foldquery = g_utf8_casefold(query, -1);
+	
+	/*Case-insensitive substring match over number and text*/
+	for (iterator=smslist; iterator!=NULL; iterator=next) {
+		next = iterator->next;
+		message = (mmgui_sms_message_t)iterator->data;
+		found = FALSE;
+		if (message->number != NULL) {
+			foldvalue = g_utf8_casefold(message->number, -1);
+			found = (strstr(foldvalue, foldquery) != NULL);
+			g_free(foldvalue);
+		}
+		if ((!found) && (!message->binary) && (message->text != NULL)) {
+			foldvalue = g_utf8_casefold(message->text->str, message->text->len);
+			found = (strstr(foldvalue, foldquery) != NULL);
+			g_free(foldvalue);
+		}
+		if (!found) {
+			mmgui_smsdb_message_free(message);
+			smslist = g_slist_delete_link(smslist, iterator);
+		}
+	}
+	
+	g_free(foldquery);
+	
+	return smslist;
+}
+
+static void mmgui_main_sms_thread_set(mmgui_application_t mmguiapp, GtkTreeModel *model, GtkTreeIter *iter, mmgui_sms_thread_t thread)
+{
+	GtkTreeIter placeholder;
+	gchar *markup;
+	gchar timestr[200];
+	GdkPixbuf *icon;
+	
+	/*Format caption from summary*/
+	if (thread->unread > 0) {
+		markup = g_strdup_printf(_("<b>%s</b> (%u/%u)\n<small>%s</small>"), thread->number, thread->unread, thread->total, mmgui_str_format_sms_time(thread->timestamp, timestr, sizeof(timestr)));
+		icon = mmguiapp->window->smsunreadicon;
+	} else {
+		markup = g_strdup_printf(_("<b>%s</b> (%u)\n<small>%s</small>"), thread->number, thread->total, mmgui_str_format_sms_time(thread->timestamp, timestr, sizeof(timestr)));
+		icon = mmguiapp->window->smsreadicon;
+	}
+	
+	gtk_tree_store_set(GTK_TREE_STORE(model), iter,
 						MMGUI_MAIN_SMSLIST_ICON, icon,
 						MMGUI_MAIN_SMSLIST_SMS, markup,
-						MMGUI_MAIN_SMSLIST_ID, mmgui_smsdb_message_get_db_identifier(sms),
-						MMGUI_MAIN_SMSLIST_FOLDER, folder,
-						MMGUI_MAIN_SMSLIST_ISFOLDER, FALSE,
+						MMGUI_MAIN_SMSLIST_ID, thread->lastid,
+						MMGUI_MAIN_SMSLIST_FOLDER, MMGUI_MAIN_SMSLIST_FOLDER_THREADS,
+						MMGUI_MAIN_SMSLIST_ISFOLDER, TRUE,
+						MMGUI_MAIN_SMSLIST_THREAD, thread->key,
 						-1);
 	
-	/*Free markup string*/
 	g_free(markup);
 	
-	/*Expand list with first message if needed*/
-	if (expandpath != NULL) {
-		gtk_tree_view_expand_to_path(GTK_TREE_VIEW(mmguiapp->window->smslist), expandpath);
+	/*Empty child makes conversation expandable until messages are loaded*/
+	if (!gtk_tree_model_iter_has_child(model, iter)) {
+		gtk_tree_store_append(GTK_TREE_STORE(model), &placeholder, iter);
+		gtk_tree_store_set(GTK_TREE_STORE(model), &placeholder,
+							MMGUI_MAIN_SMSLIST_ID, (guint64)0,
+							MMGUI_MAIN_SMSLIST_FOLDER, MMGUI_MAIN_SMSLIST_FOLDER_THREADS,
+							MMGUI_MAIN_SMSLIST_ISFOLDER, TRUE,
+							-1);
 	}
 }
 
-gboolean mmgui_main_sms_list_fill(mmgui_application_t mmguiapp)
+static void mmgui_main_sms_thread_list_fill(mmgui_application_t mmguiapp, GtkTreeModel *model)
+{
+	GtkTreeIter iter, child;
+	GSList *threadlist, *iterator;
+	
+	if ((mmguiapp->window->threadspath == NULL) || (model == NULL)) return;
+	
+	if (!gtk_tree_model_get_iter(model, &iter, mmguiapp->window->threadspath)) return;
+	
+	/*Remove previous conversations*/
+	while (gtk_tree_model_iter_children(model, &child, &iter)) {
+		gtk_tree_store_remove(GTK_TREE_STORE(model), &child);
+	}
+	
+	/*Only summaries are read, most recent conversation first*/
+	threadlist = mmgui_smsdb_read_thread_list(mmguicore_devices_get_sms_db(mmguiapp->core));
+	
+	for (iterator=threadlist; iterator; iterator=iterator->next) {
+		gtk_tree_store_append(GTK_TREE_STORE(model), &child, &iter);
+		mmgui_main_sms_thread_set(mmguiapp, model, &child, (mmgui_sms_thread_t)iterator->data);
+	}
+	
+	mmgui_smsdb_thread_free_list(threadlist);
+}
+
+static gboolean mmgui_main_sms_thread_update(mmgui_application_t mmguiapp, GtkTreeModel *model, const gchar *number, gboolean raise, GtkTreeIter *threaditer)
+{
+	mmgui_sms_thread_t thread;
+	GtkTreeIter iter, child;
+	gchar *threadkey;
+	gboolean valid, found;
+	
+	if ((mmguiapp->window->threadspath == NULL) || (model == NULL) || (number == NULL)) return FALSE;
+	
+	if (!gtk_tree_model_get_iter(model, &iter, mmguiapp->window->threadspath)) return FALSE;
+	
+	thread = mmgui_smsdb_read_thread(mmguicore_devices_get_sms_db(mmguiapp->core), number);
+	
+	if (thread == NULL) return FALSE;
+	
+	found = FALSE;
+	
+	valid = gtk_tree_model_iter_children(model, &child, &iter);
+	while ((valid) && (!found)) {
+		gtk_tree_model_get(model, &child, MMGUI_MAIN_SMSLIST_THREAD, &threadkey, -1);
+		if (g_strcmp0(threadkey, thread->key) == 0) {
+			found = TRUE;
+		} else {
+			valid = gtk_tree_model_iter_next(model, &child);
+		}
+		g_free(threadkey);
+	}
+	
+	if (!found) {
+		/*First message from new contact*/
+		gtk_tree_store_prepend(GTK_TREE_STORE(model), &child, &iter);
+	} else if (raise) {
+		gtk_tree_store_move_after(GTK_TREE_STORE(model), &child, NULL);
+	}
+	
+	mmgui_main_sms_thread_set(mmguiapp, model, &child, thread);
+	
+	mmgui_smsdb_thread_free(thread);
+	
+	if (threaditer != NULL) {
+		*threaditer = child;
+	}
+	
+	return TRUE;
+}
+
+static void mmgui_main_sms_thread_messages_fill(mmgui_application_t mmguiapp, GtkTreeModel *model, GtkTreeIter *threaditer)
+{
+	GtkTreeIter child;
+	GSList *smslist, *iterator;
+	gchar *threadkey;
+	gboolean isplaceholder;
+	
+	/*Messages are loaded once, placeholder marks conversation not loaded yet*/
+	if (!gtk_tree_model_iter_children(model, &child, threaditer)) return;
+	
+	gtk_tree_model_get(model, &child, MMGUI_MAIN_SMSLIST_ISFOLDER, &isplaceholder, -1);
+	
+	if (!isplaceholder) return;
+	
+	gtk_tree_model_get(model, threaditer, MMGUI_MAIN_SMSLIST_THREAD, &threadkey, -1);
+	
+	if (threadkey == NULL) return;
+	
+	gtk_tree_store_remove(GTK_TREE_STORE(model), &child);
+	
+	smslist = mmgui_smsdb_read_thread_messages(mmguicore_devices_get_sms_db(mmguiapp->core), threadkey);
+	
+	for (iterator=smslist; iterator; iterator=iterator->next) {
+		gtk_tree_store_append(GTK_TREE_STORE(model), &child, threaditer);
+		mmgui_main_sms_message_set(mmguiapp, model, &child, (mmgui_sms_message_t)iterator->data);
+	}
+	
+	mmgui_smsdb_message_free_list(smslist);
+	
+	g_free(threadkey);
+}
+
+static gboolean mmgui_main_sms_list_test_expand_row_signal(GtkTreeView *treeview, GtkTreeIter *iter, GtkTreePath *path, gpointer data)
+{
+	mmgui_application_t mmguiapp;
+	GtkTreeModel *model;
+	guint folder;
+	gboolean isfolder;
+	
+	mmguiapp = (mmgui_application_t)data;
+	
+	if (mmguiapp == NULL) return FALSE;
+	
+	model = gtk_tree_view_get_model(treeview);
+	
+	if (model == NULL) return FALSE;
+	
+	gtk_tree_model_get(model, iter, MMGUI_MAIN_SMSLIST_FOLDER, &folder, MMGUI_MAIN_SMSLIST_ISFOLDER, &isfolder, -1);
+	
+	/*Conversation messages are loaded when conversation is opened*/
+	if ((isfolder) && (folder == MMGUI_MAIN_SMSLIST_FOLDER_THREADS) && (gtk_tree_path_get_depth(path) > 1)) {
+		mmgui_main_sms_thread_messages_fill(mmguiapp, model, iter);
+	}
+	
+	return FALSE;
+}
+
+static void mmgui_main_sms_list_mark_read(mmgui_application_t mmguiapp, GtkTreeModel *model, guint64 id, const gchar *number)
+{
+	GSList *rows, *iterator;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	
+	/*Message may be shown both in folder and in conversation*/
+	rows = mmgui_main_sms_rows_get(mmguiapp, id);
+	
+	for (iterator=rows; iterator; iterator=iterator->next) {
+		path = gtk_tree_row_reference_get_path((GtkTreeRowReference *)iterator->data);
+		if (path != NULL) {
+			if (gtk_tree_model_get_iter(model, &iter, path)) {
+				gtk_tree_store_set(GTK_TREE_STORE(model), &iter, MMGUI_MAIN_SMSLIST_ICON, mmguiapp->window->smsreadicon, -1);
+			}
+			gtk_tree_path_free(path);
+		}
+	}
+	
+	if (rows != NULL) {
+		g_hash_table_insert(mmguiapp->window->smsrows, g_memdup(&id, sizeof(id)), rows);
+	}
+	
+	mmgui_main_sms_thread_update(mmguiapp, model, number, FALSE, NULL);
+}
+
+static void mmgui_main_sms_list_remove_ids(mmgui_application_t mmguiapp, GtkTreeModel *model, GHashTable *ids)
+{
+	GHashTableIter iditer;
+	gpointer key;
+	GSList *rows, *iterator;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	
+	/*Other copies of removed messages are found by identifier*/
+	g_hash_table_iter_init(&iditer, ids);
+	while (g_hash_table_iter_next(&iditer, &key, NULL)) {
+		rows = mmgui_main_sms_rows_get(mmguiapp, *(guint64 *)key);
+		for (iterator=rows; iterator; iterator=iterator->next) {
+			path = gtk_tree_row_reference_get_path((GtkTreeRowReference *)iterator->data);
+			if (path != NULL) {
+				if (gtk_tree_model_get_iter(model, &iter, path)) {
+					gtk_tree_store_remove(GTK_TREE_STORE(model), &iter);
+				}
+				gtk_tree_path_free(path);
+			}
+		}
+		mmgui_main_sms_rows_destroy(rows);
+	}
+}
+
+static void mmgui_main_sms_list_model_fill(mmgui_application_t mmguiapp)
 {
 	GSList *smslist;
 	GtkTreeModel *model;
 	GtkTreeIter iter;
 	gint i;
 	GSList *iterator;
-	mmgui_application_data_t appdata;
+	const gchar *query;
 		
 	gchar *foldercomments[3]       = {_("<b>Incoming</b>\n<small>Incoming messages</small>"), 
 										_("<b>Sent</b>\n<small>Sent messages</small>"),
@@ -1276,42 +1679,73 @@ gboolean mmgui_main_sms_list_fill(mmgui_application_t mmguiapp)
 										&mmguiapp->window->smssentfoldericon, 
 										&mmguiapp->window->smsdraftsfoldericon};
 	
-	if (mmguiapp == NULL) return FALSE;
+	/*Show only matching messages while search query is entered*/
+	query = gtk_entry_get_text(GTK_ENTRY(mmguiapp->window->smssearchentry));
 	
-	if (mmguicore_devices_get_current(mmguiapp->core) != NULL) {
+	if ((query != NULL) && (query[0] != '\0')) {
+		smslist = mmgui_main_sms_search_list_read(mmguiapp, query);
+	} else {
 		smslist = mmgui_smsdb_read_sms_list(mmguicore_devices_get_sms_db(mmguiapp->core));
-		
-		model = gtk_tree_view_get_model(GTK_TREE_VIEW(mmguiapp->window->smslist));
-		if (model != NULL) {
-			/*Detach and clear model*/
-			g_object_ref(model);
-			gtk_tree_view_set_model(GTK_TREE_VIEW(mmguiapp->window->smslist), NULL);
-			gtk_tree_store_clear(GTK_TREE_STORE(model));
-			/*Add folders*/
-			for (i = 0; i < 3; i++) {
-				gtk_tree_store_append(GTK_TREE_STORE(model), &iter, NULL);
-				gtk_tree_store_set(GTK_TREE_STORE(model), &iter, MMGUI_MAIN_SMSLIST_ICON, *foldericon[i], MMGUI_MAIN_SMSLIST_SMS, foldercomments[i], MMGUI_MAIN_SMSLIST_ID, 0, MMGUI_MAIN_SMSLIST_FOLDER, folderids[i], MMGUI_MAIN_SMSLIST_ISFOLDER, TRUE, -1);
-				*(folderpath[i]) = gtk_tree_model_get_path(model, &iter);
-			}
-			/*Add messages*/
-			if (smslist != NULL) {
-				for (iterator=smslist; iterator; iterator=iterator->next) {
-					mmgui_main_sms_add_to_list(mmguiapp, (mmgui_sms_message_t)iterator->data, model, FALSE);
-				}
+	}
+	
+	model = gtk_tree_view_get_model(GTK_TREE_VIEW(mmguiapp->window->smslist));
+	if (model != NULL) {
+		/*Detach and clear model*/
+		g_object_ref(model);
+		gtk_tree_view_set_model(GTK_TREE_VIEW(mmguiapp->window->smslist), NULL);
+		gtk_tree_store_clear(GTK_TREE_STORE(model));
+		g_hash_table_remove_all(mmguiapp->window->smsrows);
+		/*Add folders*/
+		for (i = 0; i < 3; i++) {
+			gtk_tree_store_append(GTK_TREE_STORE(model), &iter, NULL);
+			gtk_tree_store_set(GTK_TREE_STORE(model), &iter, MMGUI_MAIN_SMSLIST_ICON, *foldericon[i], MMGUI_MAIN_SMSLIST_SMS, foldercomments[i], MMGUI_MAIN_SMSLIST_ID, (guint64)0, MMGUI_MAIN_SMSLIST_FOLDER, folderids[i], MMGUI_MAIN_SMSLIST_ISFOLDER, TRUE, -1);
+			*(folderpath[i]) = gtk_tree_model_get_path(model, &iter);
+		}
+		/*Add conversations, search results are shown in folders only*/
+		if (mmguiapp->window->threadspath != NULL) {
+			gtk_tree_path_free(mmguiapp->window->threadspath);
+			mmguiapp->window->threadspath = NULL;
+		}
+		if ((query == NULL) || (query[0] == '\0')) {
+			gtk_tree_store_append(GTK_TREE_STORE(model), &iter, NULL);
+			gtk_tree_store_set(GTK_TREE_STORE(model), &iter, MMGUI_MAIN_SMSLIST_ICON, mmguiapp->window->smsrecvfoldericon, MMGUI_MAIN_SMSLIST_SMS, _("<b>Conversations</b>\n<small>Messages grouped by contact</small>"), MMGUI_MAIN_SMSLIST_ID, (guint64)0, MMGUI_MAIN_SMSLIST_FOLDER, MMGUI_MAIN_SMSLIST_FOLDER_THREADS, MMGUI_MAIN_SMSLIST_ISFOLDER, TRUE, -1);
+			mmguiapp->window->threadspath = gtk_tree_model_get_path(model, &iter);
+			mmgui_main_sms_thread_list_fill(mmguiapp, model);
+		}
+		/*Add messages*/
+		if (smslist != NULL) {
+			for (iterator=smslist; iterator; iterator=iterator->next) {
+				mmgui_main_sms_add_to_list(mmguiapp, (mmgui_sms_message_t)iterator->data, model, FALSE);
 			}
-			/*Attach model*/
-			gtk_tree_view_set_model(GTK_TREE_VIEW(mmguiapp->window->smslist), model);
-			g_object_unref(model);
-			/*Expand folders if needed*/
-			if (mmguiapp->options->smsexpandfolders) {
-				gtk_tree_view_expand_all(GTK_TREE_VIEW(mmguiapp->window->smslist));
+		}
+		/*Attach model*/
+		gtk_tree_view_set_model(GTK_TREE_VIEW(mmguiapp->window->smslist), model);
+		g_object_unref(model);
+		/*Expand folders if needed, conversations stay collapsed until opened*/
+		if ((mmguiapp->options->smsexpandfolders) || ((query != NULL) && (query[0] != '\0'))) {
+			for (i = 0; i < 3; i++) {
+				gtk_tree_view_expand_row(GTK_TREE_VIEW(mmguiapp->window->smslist), *(folderpath[i]), FALSE);
 			}
 		}
+	}
+	
+	/*Free resources*/
+	if (smslist != NULL) {
+		mmgui_smsdb_message_free_list(smslist);
+	}
+}
+
+gboolean mmgui_main_sms_list_fill(mmgui_application_t mmguiapp)
+{
+	mmgui_application_data_t appdata;
+	
+	if (mmguiapp == NULL) return FALSE;
+	
+	if (mmguicore_devices_get_current(mmguiapp->core) != NULL) {
+		/*Unread counter is stored in database, so badge does not depend on list*/
+		mmgui_ayatana_set_unread_messages_number(mmguiapp->ayatana, mmgui_smsdb_get_unread_messages(mmguicore_devices_get_sms_db(mmguiapp->core)));
 		
-		/*Free resources*/
-		if (smslist != NULL) {
-			mmgui_smsdb_message_free_list(smslist);
-		}
+		mmgui_main_sms_list_model_fill(mmguiapp);
 		
 		/*Get new messages from modem*/
 		appdata = g_new0(struct _mmgui_application_data, 1);
@@ -1319,14 +1753,59 @@ gboolean mmgui_main_sms_list_fill(mmgui_application_t mmguiapp)
 		appdata->data = GUINT_TO_POINTER(mmguiapp->options->concatsms);
 		
 		g_idle_add(mmgui_main_sms_get_message_list_from_thread, appdata);
+		
+		/*Old messages are moved out of working database in background*/
+		if (mmguiapp->options->smsarchivemonths > 0) {
+			mmgui_smsdb_archive(mmguicore_devices_get_sms_db(mmguiapp->core), (guint)mmguiapp->options->smsarchivemonths);
+		}
+	}
+	
+	return FALSE;
+}
+
+static gboolean mmgui_main_sms_search_timeout_handler(gpointer data)
+{
+	mmgui_application_t mmguiapp;
+	
+	mmguiapp = (mmgui_application_t)data;
+	
+	if (mmguiapp == NULL) return FALSE;
+	
+	mmguiapp->window->smssearchtimeout = 0;
+	
+	if (mmguicore_devices_get_current(mmguiapp->core) != NULL) {
+		mmgui_main_sms_list_model_fill(mmguiapp);
 	}
 	
 	return FALSE;
 }
 
+void mmgui_main_sms_search_entry_changed_signal(GtkEditable *editable, gpointer data)
+{
+	mmgui_application_t mmguiapp;
+	
+	mmguiapp = (mmgui_application_t)data;
+	
+	if (mmguiapp == NULL) return;
+	
+	/*List is filled once when typing pauses, not on every keystroke*/
+	if (mmguiapp->window->smssearchtimeout != 0) {
+		g_source_remove(mmguiapp->window->smssearchtimeout);
+	}
+	
+	mmguiapp->window->smssearchtimeout = g_timeout_add(MMGUI_MAIN_SMS_SEARCH_DELAY, mmgui_main_sms_search_timeout_handler, mmguiapp);
+}
+
+void mmgui_main_sms_search_entry_icon_release_signal(GtkEntry *entry, GtkEntryIconPosition iconpos, GdkEvent *event, gpointer data)
+{
+	if (iconpos == GTK_ENTRY_ICON_SECONDARY) {
+		gtk_entry_set_text(entry, "");
+	}
+}
+
 void mmgui_main_sms_restore_settings_for_modem(mmgui_application_t mmguiapp)
 {
-	gulong entryid;
+	guint64 entryid;
 	gboolean entryisfolder;
 	
 	
@@ -1334,7 +1813,7 @@ void mmgui_main_sms_restore_settings_for_modem(mmgui_application_t mmguiapp)
 	if (mmguiapp->modemsettings == NULL) return;
 	
 	/*Get settings*/
-	entryid = (gulong)mmgui_modem_settings_get_int64(mmguiapp->modemsettings, "sms_entry_id", 0);
+	entryid = (guint64)mmgui_modem_settings_get_int64(mmguiapp->modemsettings, "sms_entry_id", 0);
 	entryisfolder = mmgui_modem_settings_get_boolean(mmguiapp->modemsettings, "sms_is_folder", TRUE);
 
 	/*Select last entry*/
@@ -1953,7 +2432,9 @@ void mmgui_main_sms_list_init(mmgui_application_t mmguiapp)
 	gtk_tree_view_column_set_attributes(column, renderer, "markup", MMGUI_MAIN_SMSLIST_SMS, NULL);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(mmguiapp->window->smslist), column);
 	
-	store = gtk_tree_store_new(MMGUI_MAIN_SMSLIST_COLUMNS, GDK_TYPE_PIXBUF, G_TYPE_STRING, G_TYPE_ULONG, G_TYPE_UINT, G_TYPE_BOOLEAN);
+	store = gtk_tree_store_new(MMGUI_MAIN_SMSLIST_COLUMNS, GDK_TYPE_PIXBUF, G_TYPE_STRING, G_TYPE_UINT64, G_TYPE_UINT, G_TYPE_BOOLEAN, G_TYPE_STRING);
+	mmguiapp->window->threadspath = NULL;
+	mmguiapp->window->smsrows = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, mmgui_main_sms_rows_destroy);
 	gtk_tree_view_set_model(GTK_TREE_VIEW(mmguiapp->window->smslist), GTK_TREE_MODEL(store));
 	g_object_unref(store);
 	
@@ -1970,6 +2451,9 @@ void mmgui_main_sms_list_init(mmgui_application_t mmguiapp)
 	/*Answer message signal*/
 	g_signal_connect(G_OBJECT(mmguiapp->window->smslist), "row-activated", G_CALLBACK(mmgui_main_sms_list_row_activated_signal), mmguiapp);
 	
+	/*Load conversation messages signal*/
+	g_signal_connect(G_OBJECT(mmguiapp->window->smslist), "test-expand-row", G_CALLBACK(mmgui_main_sms_list_test_expand_row_signal), mmguiapp);
+	
 	/*New SMS entry autocompletion*/
 	mmguiapp->window->smscompletion = gtk_entry_completion_new();
 	/*Search for names*/
@@ -2029,6 +2513,11 @@ void mmgui_main_sms_list_clear(mmgui_application_t mmguiapp)
 	model = gtk_tree_view_get_model(GTK_TREE_VIEW(mmguiapp->window->smslist));
 	if (model != NULL) {
 		gtk_tree_store_clear(GTK_TREE_STORE(model));
+		g_hash_table_remove_all(mmguiapp->window->smsrows);
+	}
+	if (mmguiapp->window->threadspath != NULL) {
+		gtk_tree_path_free(mmguiapp->window->threadspath);
+		mmguiapp->window->threadspath = NULL;
 	}
 	
 	/*Clear SMS text field*/
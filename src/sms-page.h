@@ -38,6 +38,8 @@ void mmgui_main_sms_new_button_clicked_signal(GObject *object, gpointer data);
 void mmgui_main_sms_answer(mmgui_application_t mmguiapp);
 void mmgui_main_sms_answer_button_clicked_signal(GObject *object, gpointer data);
 gboolean mmgui_main_sms_list_fill(mmgui_application_t mmguiapp);
+void mmgui_main_sms_search_entry_changed_signal(GtkEditable *editable, gpointer data);
+void mmgui_main_sms_search_entry_icon_release_signal(GtkEntry *entry, GtkEntryIconPosition iconpos, GdkEvent *event, gpointer data);
 void mmgui_main_sms_load_contacts_from_system_addressbooks(mmgui_application_t mmguiapp);
 void mmgui_main_sms_restore_settings_for_modem(mmgui_application_t mmguiapp);
 void mmgui_main_sms_restore_contacts_for_modem(mmgui_application_t mmguiapp);
@@ -26,17 +26,108 @@
 #include <ctype.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "encoding.h"
 #include "smsdb.h"
 
-#define MMGUI_SMSDB_SMS_MESSAGE_XML "<sms>\n\t<number>%s</number>\n\t<time>%lu</time>\n\t<binary>%u</binary>\n\t<servicenumber>%s</servicenumber>\n\t<text>%s</text>\n\t<read>%u</read>\n\t<folder>%u</folder>\n</sms>\n\n"
+#define MMGUI_SMSDB_ACCESS_MASK     0755
 
-#define MMGUI_SMSDB_READ_TAG        "\n\t<read>"
-#define MMGUI_SMSDB_TRAILER_TAG     "\n</sms>\n\n"
-#define MMGUI_SMSDB_TRAILER_PARAMS  "\n\t<read>%u</read>\n\t<folder>%u</folder>\n</sms>\n\n"
+/*Metadata record*/
+#define MMGUI_SMSDB_META_KEY                      "meta"
+#define MMGUI_SMSDB_META_VERSION_OFFSET           0
+#define MMGUI_SMSDB_META_FLAGS_OFFSET             4
+#define MMGUI_SMSDB_META_ID_CEILING_OFFSET        8
+#define MMGUI_SMSDB_META_STATS_OFFSET             16
+#define MMGUI_SMSDB_META_STATS_ENTRY_SIZE         8
+#define MMGUI_SMSDB_META_V1_SIZE                  4
+#define MMGUI_SMSDB_META_V2_SIZE                  16
+#define MMGUI_SMSDB_META_V3_SIZE                  (MMGUI_SMSDB_META_STATS_OFFSET + MMGUI_SMSDB_SMS_FOLDERS_NUMBER * MMGUI_SMSDB_META_STATS_ENTRY_SIZE)
+#define MMGUI_SMSDB_META_SIZE                     MMGUI_SMSDB_META_V3_SIZE
 
-#define MMGUI_SMSDB_ACCESS_MASK     0755
+/*Counters are not trusted if database was not closed properly*/
+#define MMGUI_SMSDB_META_FLAG_DIRTY               0x01
+/*Archiver freed space to be reclaimed on next open*/
+#define MMGUI_SMSDB_META_FLAG_COMPACT             0x02
+
+/*Format 2 introduced binary records with sequential keys, format 3 added folder counters*/
+#define MMGUI_SMSDB_FORMAT_RECORDS_VERSION        2
+#define MMGUI_SMSDB_FORMAT_VERSION                3
+
+/*Message keys are big-endian 64-bit sequential identifiers*/
+#define MMGUI_SMSDB_KEY_SIZE                      8
+#define MMGUI_SMSDB_ID_BLOCK_SIZE                 256
+
+/*Binary message record: fixed-width little-endian header followed by number, service number and text*/
+#define MMGUI_SMSDB_RECORD_MAGIC                  0xa5
+#define MMGUI_SMSDB_RECORD_VERSION                1
+
+#define MMGUI_SMSDB_RECORD_MAGIC_OFFSET           0
+#define MMGUI_SMSDB_RECORD_VERSION_OFFSET         1
+#define MMGUI_SMSDB_RECORD_FLAGS_OFFSET           2
+#define MMGUI_SMSDB_RECORD_FOLDER_OFFSET          3
+#define MMGUI_SMSDB_RECORD_TIME_OFFSET            4
+#define MMGUI_SMSDB_RECORD_NUMBER_LEN_OFFSET      12
+#define MMGUI_SMSDB_RECORD_SVCNUMBER_LEN_OFFSET   14
+#define MMGUI_SMSDB_RECORD_TEXT_LEN_OFFSET        16
+#define MMGUI_SMSDB_RECORD_HEADER_SIZE            20
+
+#define MMGUI_SMSDB_RECORD_FLAG_READ              0x01
+#define MMGUI_SMSDB_RECORD_FLAG_BINARY            0x02
+#define MMGUI_SMSDB_RECORD_FLAG_RAW               0x04
+
+/*Secondary indexes stored in separate database*/
+#define MMGUI_SMSDB_INDEX_VERSION                 3
+#define MMGUI_SMSDB_INDEX_META_VERSION_OFFSET     0
+#define MMGUI_SMSDB_INDEX_META_DIRTY_OFFSET       4
+#define MMGUI_SMSDB_INDEX_META_SIZE               8
+
+/*Folder index is split into time buckets of about 24 days*/
+#define MMGUI_SMSDB_INDEX_BUCKET_SHIFT            21
+
+#define MMGUI_SMSDB_INDEX_FOLDER_KEY              "f%u:%" G_GUINT64_FORMAT
+#define MMGUI_SMSDB_INDEX_DIRECTORY_KEY           "d%u"
+#define MMGUI_SMSDB_INDEX_UNREAD_KEY              "u"
+
+/*Identifier lists are split into blocks, so every update rewrites one bounded block*/
+#define MMGUI_SMSDB_INDEX_LIST_BLOCK_KEY          "%s:%" G_GUINT64_FORMAT
+#define MMGUI_SMSDB_INDEX_LIST_BLOCK_SHIFT        12
+
+/*Text index: trigram posting lists split into identifier blocks*/
+#define MMGUI_SMSDB_INDEX_TEXT_KEY                "t%s:%" G_GUINT64_FORMAT
+#define MMGUI_SMSDB_INDEX_TEXT_BLOCK_SHIFT        12
+#define MMGUI_SMSDB_INDEX_TEXT_GRAM               3
+
+/*Conversation threads keyed by normalized sender number*/
+#define MMGUI_SMSDB_INDEX_THREAD_KEY              "c%s"
+#define MMGUI_SMSDB_INDEX_THREAD_SUMMARY_KEY      "s%s"
+#define MMGUI_SMSDB_INDEX_THREAD_DIRECTORY_KEY    "C"
+
+/*Thread summary words*/
+#define MMGUI_SMSDB_THREAD_SUMMARY_LAST_ID        0
+#define MMGUI_SMSDB_THREAD_SUMMARY_TIMESTAMP      1
+#define MMGUI_SMSDB_THREAD_SUMMARY_UNREAD         2
+#define MMGUI_SMSDB_THREAD_SUMMARY_TOTAL          3
+#define MMGUI_SMSDB_THREAD_SUMMARY_SIZE           4
+
+/*Bulk decoding is split into chunks processed by thread pool*/
+#define MMGUI_SMSDB_DECODE_CHUNK_SIZE             256
+#define MMGUI_SMSDB_DECODE_MAX_THREADS            8
+
+/*Messages older than retention period are moved into monthly segments*/
+#define MMGUI_SMSDB_ARCHIVE_DIRECTORY             "archive"
+#define MMGUI_SMSDB_ARCHIVE_SEGMENT_PREFIX        "sms-"
+#define MMGUI_SMSDB_ARCHIVE_SEGMENT_SUFFIX        ".gdbm"
+#define MMGUI_SMSDB_ARCHIVE_SEGMENT_NAME          MMGUI_SMSDB_ARCHIVE_SEGMENT_PREFIX "%06u" MMGUI_SMSDB_ARCHIVE_SEGMENT_SUFFIX
+#define MMGUI_SMSDB_ARCHIVE_META_FIRST_ID_OFFSET  0
+#define MMGUI_SMSDB_ARCHIVE_META_LAST_ID_OFFSET   8
+#define MMGUI_SMSDB_ARCHIVE_META_SIZE             16
+/*Database lock is released between chunks, so new messages are not delayed*/
+#define MMGUI_SMSDB_ARCHIVE_CHUNK_SIZE            256
+
+/*Write-behind batch is committed with single sync when any limit reached*/
+#define MMGUI_SMSDB_BATCH_SIZE      64
+#define MMGUI_SMSDB_BATCH_TIMEOUT   2
 
 enum _mmgui_smsdb_xml_elements {
 	MMGUI_SMSDB_XML_PARAM_NUMBER = 0,
@@ -49,9 +140,133 @@ enum _mmgui_smsdb_xml_elements {
 	MMGUI_SMSDB_XML_PARAM_NULL
 };
 
-static gint mmgui_smsdb_xml_parameter = MMGUI_SMSDB_XML_PARAM_NULL;
+/*Parser state lives on stack of caller, so records can be decoded in parallel*/
+struct _mmgui_smsdb_xml_state {
+	mmgui_sms_message_t message;
+	gint parameter;
+};
+
+/*Part of bulk decoding job*/
+struct _mmgui_smsdb_decode_chunk {
+	struct _mmgui_smsdb_raw_record *records;
+	guint count;
+	mmgui_smsdb_decode_func decodefunc;
+};
+
+/*Legacy record waiting for new identifier*/
+struct _mmgui_smsdb_migrate_entry {
+	guint64 timestamp;
+	datum key;
+};
+
+/*Index element: (timestamp, identifier) or (bucket, count)*/
+struct _mmgui_smsdb_index_pair {
+	guint64 first;
+	guint64 second;
+};
+
+/*Archive segment with messages received in one month*/
+struct _mmgui_smsdb_segment {
+	guint month;
+	guint64 firstid;
+	guint64 lastid;
+	gchar *filepath;
+	gpointer handle;
+	gboolean writable;
+};
+
+/*Message waiting to be archived*/
+struct _mmgui_smsdb_archive_entry {
+	guint64 id;
+	guint month;
+};
+
+/*Record visitor, receives ownership of record data*/
+typedef void (*mmgui_smsdb_record_func)(smsdb_t smsdb, guint64 id, datum data, gpointer userdata);
+
+/*Decoded record fields point into record buffer*/
+struct _mmgui_smsdb_record {
+	guint8 version;
+	guint8 flags;
+	guint8 folder;
+	guint64 timestamp;
+	const gchar *number;
+	gsize numberlen;
+	const gchar *svcnumber;
+	gsize svcnumberlen;
+	const gchar *text;
+	gsize textlen;
+};
 
+static gboolean mmgui_smsdb_batch_timeout_handler(gpointer data);
+static void mmgui_smsdb_batch_commit(smsdb_t smsdb, gboolean force);
+static void mmgui_smsdb_batch_append(smsdb_t smsdb);
+static gboolean mmgui_smsdb_key_is_meta(datum key);
+static gchar *mmgui_smsdb_segments_directory(smsdb_t smsdb);
+static void mmgui_smsdb_segments_load(smsdb_t smsdb);
+static void mmgui_smsdb_segments_free(smsdb_t smsdb);
+static gint mmgui_smsdb_segment_compare(gconstpointer a, gconstpointer b);
+static struct _mmgui_smsdb_segment *mmgui_smsdb_segment_get(smsdb_t smsdb, guint month, gboolean create);
+static gpointer mmgui_smsdb_segment_open(struct _mmgui_smsdb_segment *segment, gboolean writable);
+static void mmgui_smsdb_segment_close(struct _mmgui_smsdb_segment *segment);
+static datum mmgui_smsdb_record_fetch(smsdb_t smsdb, guint64 id, struct _mmgui_smsdb_segment **segment);
+static gboolean mmgui_smsdb_record_store(smsdb_t smsdb, guint64 id, datum data, struct _mmgui_smsdb_segment *segment);
+static gboolean mmgui_smsdb_record_delete(smsdb_t smsdb, guint64 id, struct _mmgui_smsdb_segment *segment);
+static void mmgui_smsdb_record_purge_segments(smsdb_t smsdb, guint64 id);
+static void mmgui_smsdb_records_foreach(smsdb_t smsdb, mmgui_smsdb_record_func func, gpointer userdata);
+static guint mmgui_smsdb_archive_month(guint64 timestamp);
+static gint mmgui_smsdb_archive_entry_compare(gconstpointer a, gconstpointer b);
+static gpointer mmgui_smsdb_archive_worker(gpointer data);
+static void mmgui_smsdb_meta_load(smsdb_t smsdb);
+static gboolean mmgui_smsdb_meta_store(smsdb_t smsdb);
+static guint64 mmgui_smsdb_id_allocate(smsdb_t smsdb);
+static datum mmgui_smsdb_key_from_id(guint64 id, gchar *buffer);
+static gboolean mmgui_smsdb_key_to_id(datum key, guint64 *id);
+static gint mmgui_smsdb_migrate_entry_compare(gconstpointer a, gconstpointer b);
+static gboolean mmgui_smsdb_format_migrate(smsdb_t smsdb);
+static guint mmgui_smsdb_stats_folder(guint folder);
+static void mmgui_smsdb_stats_update(smsdb_t smsdb, guint folder, gint totaldelta, gint unreaddelta);
+static void mmgui_smsdb_stats_rebuild_record(smsdb_t smsdb, guint64 id, datum data, gpointer userdata);
+static void mmgui_smsdb_stats_rebuild(smsdb_t smsdb);
+static void mmgui_smsdb_put_uint16(gchar *dest, guint16 value);
+static void mmgui_smsdb_put_uint32(gchar *dest, guint32 value);
+static void mmgui_smsdb_put_uint64(gchar *dest, guint64 value);
+static guint16 mmgui_smsdb_get_uint16(const gchar *src);
+static guint32 mmgui_smsdb_get_uint32(const gchar *src);
+static guint64 mmgui_smsdb_get_uint64(const gchar *src);
+static void mmgui_smsdb_hex_append(GString *string, const guchar *data, gsize len);
+static gboolean mmgui_smsdb_hex_validate(const gchar *hex, gsize len);
+static gchar *mmgui_smsdb_record_encode(mmgui_sms_message_t message, gsize *size);
+static gboolean mmgui_smsdb_record_decode(const gchar *data, gsize size, struct _mmgui_smsdb_record *record);
+static mmgui_sms_message_t mmgui_smsdb_record_to_message(const struct _mmgui_smsdb_record *record);
+static mmgui_sms_message_t mmgui_smsdb_record_parse(gchar *data, gsize size);
+static gboolean mmgui_smsdb_index_open(smsdb_t smsdb, gboolean rebuild);
+static void mmgui_smsdb_index_close(smsdb_t smsdb);
+static GArray *mmgui_smsdb_index_load(smsdb_t smsdb, const gchar *name, guint elemsize);
+static void mmgui_smsdb_index_save(smsdb_t smsdb, const gchar *name, GArray *array);
+static guint mmgui_smsdb_index_id_search(GArray *array, guint64 id, gboolean *found);
+static guint mmgui_smsdb_index_pair_search(GArray *array, guint64 first, guint64 second, gboolean *found);
+static void mmgui_smsdb_index_update_id(smsdb_t smsdb, const gchar *name, guint64 id, gboolean insert);
+static void mmgui_smsdb_index_update_list(smsdb_t smsdb, const gchar *list, guint64 id, gboolean insert);
+static guint64 mmgui_smsdb_index_list_last(smsdb_t smsdb, const gchar *list, guint64 block);
+static void mmgui_smsdb_index_update_folder(smsdb_t smsdb, guint folder, guint64 timestamp, guint64 id, gboolean insert);
+static void mmgui_smsdb_index_update_text(smsdb_t smsdb, guint64 id, const struct _mmgui_smsdb_record *record, gboolean insert);
+static void mmgui_smsdb_index_update_thread(smsdb_t smsdb, guint64 id, const struct _mmgui_smsdb_record *record, gboolean insert);
+static void mmgui_smsdb_index_update_thread_unread(smsdb_t smsdb, const struct _mmgui_smsdb_record *record, gint unreaddelta);
+static void mmgui_smsdb_index_update_message(smsdb_t smsdb, guint64 id, const struct _mmgui_smsdb_record *record, gboolean insert);
+static gchar *mmgui_smsdb_thread_key(const gchar *number, gsize len);
+static mmgui_sms_thread_t mmgui_smsdb_thread_from_summary(smsdb_t smsdb, guint64 lastid);
+static void mmgui_smsdb_index_intersect(GArray *array, GArray *other);
+static gchar *mmgui_smsdb_text_normalize(const gchar *text, gsize len);
+static void mmgui_smsdb_text_trigrams(const gchar *normalized, GHashTable *trigrams);
+static gboolean mmgui_smsdb_search_match(smsdb_t smsdb, guint64 id, gchar **tokens);
+static void mmgui_smsdb_index_rebuild_record(smsdb_t smsdb, guint64 id, datum data, gpointer userdata);
+static void mmgui_smsdb_index_rebuild(smsdb_t smsdb);
+static void mmgui_smsdb_index_cache_destroy(gpointer data);
+static GSList *mmgui_smsdb_read_sms_index(smsdb_t smsdb, const gchar *name);
 static gint mmgui_smsdb_sms_message_sort_compare(gconstpointer a, gconstpointer b);
+static void mmgui_smsdb_read_sms_list_record(smsdb_t smsdb, guint64 id, datum data, gpointer userdata);
+static void mmgui_smsdb_decode_worker(gpointer data, gpointer user_data);
 static void mmgui_smsdb_free_sms_list_foreach(gpointer data, gpointer user_data);
 static mmgui_sms_message_t mmgui_smsdb_xml_parse(gchar *xml, gsize size);
 static void mmgui_smsdb_xml_get_element(GMarkupParseContext *context, const gchar *element, const gchar **attr_names, const gchar **attr_values, gpointer data, GError **error);
@@ -61,10 +276,12 @@ static void mmgui_smsdb_xml_end_element(GMarkupParseContext *context, const gcha
 smsdb_t mmgui_smsdb_open(const gchar *persistentid, const gchar *internalid)
 {
 	smsdb_t smsdb;
+	GDBM_FILE db;
 	const gchar *newfilepath;
 	const gchar *newfilename;
 	gchar filename[64];
 	const gchar *oldfilename;
+	gboolean migrated;
 	
 	if (persistentid == NULL) return NULL;
 	
@@ -107,10 +324,65 @@ smsdb_t mmgui_smsdb_open(const gchar *persistentid, const gchar *internalid)
 		g_free((gchar *)oldfilename);
 	}
 	
+	//Database stays opened until device is closed
+	db = gdbm_open((gchar *)newfilename, 0, GDBM_WRCREAT, MMGUI_SMSDB_ACCESS_MASK, 0);
+	
+	if (db == NULL) {
+		g_warning("Unable to open SMS database: %s", newfilename);
+		g_free((gchar *)newfilename);
+		return NULL;
+	}
+	
 	smsdb = g_new(struct _smsdb, 1);
 	
 	smsdb->filepath = newfilename;
 	smsdb->unreadmessages = 0;
+	smsdb->dbhandle = (gpointer)db;
+	smsdb->nextid = 1;
+	smsdb->idceiling = 0;
+	smsdb->pendingwrites = 0;
+	smsdb->pendingsince = 0;
+	smsdb->flushtimeout = 0;
+	smsdb->indexhandle = NULL;
+	smsdb->indexcache = NULL;
+	smsdb->metaflags = 0;
+	memset(smsdb->folderstats, 0, sizeof(smsdb->folderstats));
+	smsdb->archivethread = NULL;
+	smsdb->archiverunning = 0;
+	smsdb->archivecancel = 0;
+	smsdb->archivemonths = 0;
+	smsdb->archivestarted = FALSE;
+	g_rec_mutex_init(&smsdb->dblock);
+	
+	//Archived messages are counted and indexed like hot ones
+	mmgui_smsdb_segments_load(smsdb);
+	
+	//Convert records stored in older formats once
+	mmgui_smsdb_meta_load(smsdb);
+	migrated = FALSE;
+	if (smsdb->formatversion < MMGUI_SMSDB_FORMAT_VERSION) {
+		migrated = mmgui_smsdb_format_migrate(smsdb);
+	} else if (smsdb->metaflags & MMGUI_SMSDB_META_FLAG_DIRTY) {
+		//Counters may be inconsistent after crash
+		mmgui_smsdb_stats_rebuild(smsdb);
+	}
+	
+	//Space freed by archiver is returned while database is not shared yet
+	if (smsdb->metaflags & MMGUI_SMSDB_META_FLAG_COMPACT) {
+		if (gdbm_reorganize(db) != 0) {
+			g_debug("Unable to compact SMS database\n");
+		}
+		smsdb->metaflags &= ~MMGUI_SMSDB_META_FLAG_COMPACT;
+	}
+	
+	//Counters are trusted again only after proper close
+	smsdb->metaflags |= MMGUI_SMSDB_META_FLAG_DIRTY;
+	if (mmgui_smsdb_meta_store(smsdb)) {
+		gdbm_sync(db);
+	}
+	
+	//Secondary indexes are optional, plain scans still work without them
+	mmgui_smsdb_index_open(smsdb, migrated);
 	
 	return smsdb;
 }
@@ -119,16 +391,156 @@ gboolean mmgui_smsdb_close(smsdb_t smsdb)
 {
 	if (smsdb == NULL) return FALSE;
 	
+	//Archiver stops after current chunk
+	if (smsdb->archivethread != NULL) {
+		g_atomic_int_set(&smsdb->archivecancel, 1);
+		g_thread_join(smsdb->archivethread);
+		smsdb->archivethread = NULL;
+	}
+	
+	if (smsdb->dbhandle != NULL) {
+		//Release unused reserved identifiers and mark counters consistent
+		smsdb->idceiling = smsdb->nextid;
+		smsdb->metaflags &= ~MMGUI_SMSDB_META_FLAG_DIRTY;
+		if (mmgui_smsdb_meta_store(smsdb)) {
+			mmgui_smsdb_batch_append(smsdb);
+		}
+		//Commit pending changes before closing
+		mmgui_smsdb_batch_commit(smsdb, TRUE);
+		mmgui_smsdb_index_close(smsdb);
+		gdbm_close((GDBM_FILE)smsdb->dbhandle);
+		smsdb->dbhandle = NULL;
+	}
+	
+	mmgui_smsdb_segments_free(smsdb);
+	g_rec_mutex_clear(&smsdb->dblock);
+	
 	if (smsdb->filepath != NULL) {
 		g_free((gchar *)smsdb->filepath);
 	}
 	smsdb->unreadmessages = 0;
+	memset(smsdb->folderstats, 0, sizeof(smsdb->folderstats));
 	
 	g_free(smsdb);
 	
 	return TRUE;
 }
 
+gboolean mmgui_smsdb_flush(smsdb_t smsdb)
+{
+	if (smsdb == NULL) return FALSE;
+	if (smsdb->dbhandle == NULL) return FALSE;
+	
+	g_rec_mutex_lock(&smsdb->dblock);
+	
+	mmgui_smsdb_batch_commit(smsdb, TRUE);
+	
+	g_rec_mutex_unlock(&smsdb->dblock);
+	
+	return TRUE;
+}
+
+gboolean mmgui_smsdb_archive(smsdb_t smsdb, guint months)
+{
+	GError *error;
+	
+	if (smsdb == NULL) return FALSE;
+	if (smsdb->dbhandle == NULL) return FALSE;
+	
+	if (months == 0) return FALSE;
+	
+	//Archiver runs once while database is open
+	if (smsdb->archivestarted) return FALSE;
+	
+	smsdb->archivestarted = TRUE;
+	smsdb->archivemonths = months;
+	
+	g_atomic_int_set(&smsdb->archivecancel, 0);
+	g_atomic_int_set(&smsdb->archiverunning, 1);
+	
+	error = NULL;
+	
+	smsdb->archivethread = g_thread_try_new("smsdb-archive", mmgui_smsdb_archive_worker, smsdb, &error);
+	
+	if (smsdb->archivethread == NULL) {
+		g_atomic_int_set(&smsdb->archiverunning, 0);
+		if (error != NULL) {
+			g_debug("Unable to start SMS archiver: %s\n", error->message);
+			g_error_free(error);
+		}
+		return FALSE;
+	}
+	
+	return TRUE;
+}
+
+static gboolean mmgui_smsdb_batch_timeout_handler(gpointer data)
+{
+	smsdb_t smsdb;
+	
+	smsdb = (smsdb_t)data;
+	
+	if (smsdb == NULL) return FALSE;
+	
+	g_rec_mutex_lock(&smsdb->dblock);
+	
+	//Source is destroyed after return
+	smsdb->flushtimeout = 0;
+	
+	mmgui_smsdb_batch_commit(smsdb, TRUE);
+	
+	g_rec_mutex_unlock(&smsdb->dblock);
+	
+	return FALSE;
+}
+
+static void mmgui_smsdb_batch_commit(smsdb_t smsdb, gboolean force)
+{
+	gint64 elapsed;
+	
+	if ((smsdb == NULL) || (smsdb->dbhandle == NULL)) return;
+	
+	if (smsdb->pendingwrites == 0) return;
+	
+	if (!force) {
+		elapsed = g_get_monotonic_time() - smsdb->pendingsince;
+		if ((smsdb->pendingwrites < MMGUI_SMSDB_BATCH_SIZE) && (elapsed < (gint64)MMGUI_SMSDB_BATCH_TIMEOUT * G_USEC_PER_SEC)) {
+			//Commit later if no more writes will come
+			if (smsdb->flushtimeout == 0) {
+				smsdb->flushtimeout = g_timeout_add_seconds(MMGUI_SMSDB_BATCH_TIMEOUT, mmgui_smsdb_batch_timeout_handler, smsdb);
+			}
+			return;
+		}
+	}
+	
+	gdbm_sync((GDBM_FILE)smsdb->dbhandle);
+	
+	if (smsdb->indexhandle != NULL) {
+		gdbm_sync((GDBM_FILE)smsdb->indexhandle);
+	}
+	
+	smsdb->pendingwrites = 0;
+	smsdb->pendingsince = 0;
+	
+	if (smsdb->flushtimeout != 0) {
+		g_source_remove(smsdb->flushtimeout);
+		smsdb->flushtimeout = 0;
+	}
+}
+
+static void mmgui_smsdb_batch_append(smsdb_t smsdb)
+{
+	if (smsdb == NULL) return;
+	
+	if (smsdb->pendingwrites == 0) {
+		smsdb->pendingsince = g_get_monotonic_time();
+	}
+	
+	smsdb->pendingwrites++;
+	
+	mmgui_smsdb_batch_commit(smsdb, FALSE);
+}
+
 mmgui_sms_message_t mmgui_smsdb_message_create(void)
 {
 	mmgui_sms_message_t message;
@@ -267,51 +679,22 @@ const gchar *mmgui_smsdb_message_get_text(mmgui_sms_message_t message)
 
 gboolean mmgui_smsdb_message_set_data(mmgui_sms_message_t message, const gchar *data, gsize len, gboolean append)
 {
-	guint srclen, index;
-	
 	if ((message == NULL) || (data == NULL) || (len == 0)) return FALSE;
 	
 	if (!message->binary) return FALSE;
 	
-	if (!append) {
+	if ((!append) || (message->text == NULL)) {
 		if (message->text != NULL) {
 			g_string_free(message->text, TRUE);
 		}
-		message->text = g_string_new_len(NULL, len*2+1);
-		for (index=0; index<len; index++) {
-			if ((guchar)data[index] < 0x10) {
-				g_sprintf(message->text->str+(index*2), "0%1x", (guchar)data[index]);
-			} else {
-				g_sprintf(message->text->str+(index*2), "%2x", (guchar)data[index]);
-			}
-		}
-		message->text->str[len*2] = '\0';
+		message->text = g_string_sized_new(len*2+1);
 	} else {
-		if (message->text != NULL) {
-			message->text = g_string_append(message->text, "00");
-			srclen = message->text->len-1;
-			message->text = g_string_set_size(message->text, srclen+len*2+1);
-			for (index=0; index<len; index++) {
-				if ((guchar)data[index] < 0x10) {
-					g_sprintf(message->text->str+(srclen+index*2), "0%1x", (guchar)data[index]);
-				} else {
-					g_sprintf(message->text->str+(srclen+index*2), "%2x", (guchar)data[index]);
-				}
-			}
-			message->text->str[srclen+len*2] = '\0';
-		} else {
-			message->text = g_string_new_len(NULL, len*2+1);
-			for (index=0; index<len; index++) {
-				if ((guchar)data[index] < 0x10) {
-					g_sprintf(message->text->str+(index*2), "0%1x", (guchar)data[index]);
-				} else {
-					g_sprintf(message->text->str+(index*2), "%2x", (guchar)data[index]);
-				}
-			}
-			message->text->str[len*2] = '\0';
-		}
+		/*Parts of concatenated binary message are separated*/
+		message->text = g_string_append_c(message->text, '0');
 	}
 	
+	mmgui_smsdb_hex_append(message->text, (const guchar *)data, len);
+	
 	return TRUE;
 }
 
@@ -429,7 +812,7 @@ gboolean mmgui_smsdb_message_get_binary(mmgui_sms_message_t message)
 	return message->binary;
 }
 
-gulong mmgui_smsdb_message_get_db_identifier(mmgui_sms_message_t message)
+guint64 mmgui_smsdb_message_get_db_identifier(mmgui_sms_message_t message)
 {
 	if (message == NULL) return 0;
 	
@@ -443,81 +826,86 @@ guint mmgui_smsdb_get_unread_messages(smsdb_t smsdb)
 	return smsdb->unreadmessages;
 }
 
+gboolean mmgui_smsdb_get_folder_stats(smsdb_t smsdb, enum _mmgui_smsdb_sms_folder folder, guint *total, guint *unread)
+{
+	guint index;
+	
+	if (smsdb == NULL) return FALSE;
+	if (smsdb->dbhandle == NULL) return FALSE;
+	
+	index = mmgui_smsdb_stats_folder((guint)folder);
+	
+	if (total != NULL) {
+		*total = smsdb->folderstats[index].total;
+	}
+	
+	if (unread != NULL) {
+		*unread = smsdb->folderstats[index].unread;
+	}
+	
+	return TRUE;
+}
+
 gboolean mmgui_smsdb_add_sms(smsdb_t smsdb, mmgui_sms_message_t message)
 {
 	GDBM_FILE db;
-	gchar smsid[64];
-	gulong idvalue;
-	gint idlen;
+	gchar smsid[MMGUI_SMSDB_KEY_SIZE];
+	guint64 idvalue;
 	datum key, data;
-	gchar *smsnumber;
-	gchar *smstext;
-	gchar *smsxml;
+	gchar *record;
+	gsize recordlen;
+	struct _mmgui_smsdb_record recordview;
 	
 	if ((smsdb == NULL) || (message == NULL)) return FALSE;
-	if (smsdb->filepath == NULL) return FALSE;
-	if ((message->number == NULL) || ((message->text->str == NULL))) return FALSE;
-		
-	db = gdbm_open((gchar *)smsdb->filepath, 0, GDBM_WRCREAT, MMGUI_SMSDB_ACCESS_MASK, 0);
-	
-	if (db == NULL) return FALSE;
+	if (smsdb->dbhandle == NULL) return FALSE;
+	if ((message->number == NULL) || (message->text == NULL)) return FALSE;
 	
-	do {
-		idvalue = (gulong)random();
-		memset(smsid, 0, sizeof(smsid));
-		idlen = snprintf(smsid, sizeof(smsid), "%lu", idvalue);
-		key.dptr = (gchar *)smsid;
-		key.dsize = idlen;
-	} while (gdbm_exists(db, key));
+	g_rec_mutex_lock(&smsdb->dblock);
 	
-	message->dbid = idvalue;
+	db = (GDBM_FILE)smsdb->dbhandle;
 	
-	smsnumber = g_markup_escape_text(message->number, -1);
+	idvalue = mmgui_smsdb_id_allocate(smsdb);
 	
-	if (smsnumber == NULL) {
-		g_warning("Unable to convert SMS number string");
-		gdbm_close(db);
+	if (idvalue == 0) {
+		g_warning("Unable to allocate SMS identifier");
+		g_rec_mutex_unlock(&smsdb->dblock);
 		return FALSE;
 	}
 	
-	smstext = g_markup_escape_text(message->text->str, -1);
+	key = mmgui_smsdb_key_from_id(idvalue, smsid);
+	
+	message->dbid = idvalue;
+	
+	record = mmgui_smsdb_record_encode(message, &recordlen);
 	
-	if (smstext == NULL) {
-		g_warning("Unable to convert SMS text string");
-		g_free(smsnumber);
-		gdbm_close(db);
+	if (record == NULL) {
+		g_warning("Unable to encode SMS message");
+		g_rec_mutex_unlock(&smsdb->dblock);
 		return FALSE;
 	}
 	
-	smsxml = g_strdup_printf(MMGUI_SMSDB_SMS_MESSAGE_XML,
-								smsnumber,
-								message->timestamp,
-								message->binary,
-								message->svcnumber,
-								smstext,
-								message->read,
-								message->folder);
-	
-	data.dptr = smsxml;
-	data.dsize = strlen(smsxml);
+	data.dptr = record;
+	data.dsize = recordlen;
 	
 	if (gdbm_store(db, key, data, GDBM_REPLACE) == -1) {
 		g_warning("Unable to write to database");
-		gdbm_close(db);
-		g_free(smsxml);
+		g_free(record);
+		g_rec_mutex_unlock(&smsdb->dblock);
 		return FALSE;
 	}
 	
-	gdbm_sync(db);
-	gdbm_close(db);
-	
-	if (!message->read) {
-		smsdb->unreadmessages++;
+	if (mmgui_smsdb_record_decode(record, recordlen, &recordview)) {
+		mmgui_smsdb_index_update_message(smsdb, idvalue, &recordview, TRUE);
 	}
 	
-	g_free(smsxml);
-	g_free(smsnumber);
-	g_free(smstext);
+	mmgui_smsdb_stats_update(smsdb, message->folder, 1, (message->read) ? 0 : 1);
+	
+	/*Sync is deferred until batch is committed*/
+	mmgui_smsdb_batch_append(smsdb);
+	
+	g_rec_mutex_unlock(&smsdb->dblock);
+	
+	g_free(record);
 	
 	return TRUE;
 }
@@ -538,47 +926,51 @@ static gint mmgui_smsdb_sms_message_sort_compare(gconstpointer a, gconstpointer
 	}
 }
 
+static void mmgui_smsdb_read_sms_list_record(smsdb_t smsdb, guint64 id, datum data, gpointer userdata)
+{
+	struct _mmgui_smsdb_raw_record record;
+	
+	record.data = data.dptr;
+	record.size = data.dsize;
+	record.dbid = id;
+	record.message = NULL;
+	
+	g_array_append_val((GArray *)userdata, record);
+}
+
 GSList *mmgui_smsdb_read_sms_list(smsdb_t smsdb)
 {
-	GDBM_FILE db;
 	GSList *list;
+	GArray *records;
 	mmgui_sms_message_t message;
-	datum key, data;
-	gchar smsid[64];
+	guint i;
 	
 	if (smsdb == NULL) return NULL;
-	if (smsdb->filepath == NULL) return NULL;
+	if (smsdb->dbhandle == NULL) return NULL;
 	
-	db = gdbm_open((gchar *)smsdb->filepath, 0, GDBM_READER, MMGUI_SMSDB_ACCESS_MASK, 0);
+	list = NULL;
 	
-	if (db == NULL) return NULL;
+	/*Raw records are fetched sequentially because database handle is not thread-safe*/
+	records = g_array_new(FALSE, FALSE, sizeof(struct _mmgui_smsdb_raw_record));
 	
-	smsdb->unreadmessages = 0;
+	g_rec_mutex_lock(&smsdb->dblock);
 	
-	list = NULL;
+	mmgui_smsdb_records_foreach(smsdb, mmgui_smsdb_read_sms_list_record, records);
 	
-	key = gdbm_firstkey(db);
+	g_rec_mutex_unlock(&smsdb->dblock);
 	
-	if (key.dptr != NULL) {
-		do {
-			data = gdbm_fetch(db, key);
-			if (data.dptr != NULL) {
-				message = mmgui_smsdb_xml_parse(data.dptr, data.dsize);
-				if (message != NULL) {
-					if (!message->read) {
-						smsdb->unreadmessages++;
-					}
-					memset(smsid, 0, sizeof(smsid));
-					strncpy(smsid, key.dptr, key.dsize);
-					message->dbid = strtoul(smsid, NULL, 0);
-					list = g_slist_prepend(list, message);
-				}
-			}
-			key = gdbm_nextkey(db, key);
-		} while (key.dptr != NULL);
+	/*Decoding is done in parallel*/
+	mmgui_smsdb_decode_records(records, mmgui_smsdb_record_parse);
+	
+	for (i=0; i<records->len; i++) {
+		message = g_array_index(records, struct _mmgui_smsdb_raw_record, i).message;
+		if (message != NULL) {
+			message->dbid = g_array_index(records, struct _mmgui_smsdb_raw_record, i).dbid;
+			list = g_slist_prepend(list, message);
+		}
 	}
 	
-	gdbm_close(db);
+	g_array_free(records, TRUE);
 	
 	if (list != NULL) {
 		list = g_slist_sort(list, mmgui_smsdb_sms_message_sort_compare);
@@ -587,215 +979,2441 @@ GSList *mmgui_smsdb_read_sms_list(smsdb_t smsdb)
 	return list;
 }
 
-static void mmgui_smsdb_free_sms_list_foreach(gpointer data, gpointer user_data)
+static void mmgui_smsdb_decode_worker(gpointer data, gpointer user_data)
 {
-	mmgui_sms_message_t message;
+	struct _mmgui_smsdb_decode_chunk *chunk;
+	guint i;
 	
-	if (data != NULL) return;
+	chunk = (struct _mmgui_smsdb_decode_chunk *)data;
 	
-	message = (mmgui_sms_message_t)data;
+	if (chunk == NULL) return;
 	
-	if (message->number != NULL) {
-		g_free(message->number);
+	for (i=0; i<chunk->count; i++) {
+		chunk->records[i].message = (chunk->decodefunc)(chunk->records[i].data, chunk->records[i].size);
+		/*Raw data is allocated by gdbm*/
+		free(chunk->records[i].data);
+		chunk->records[i].data = NULL;
 	}
+}
+
+void mmgui_smsdb_decode_records(GArray *records, mmgui_smsdb_decode_func decodefunc)
+{
+	struct _mmgui_smsdb_decode_chunk *chunks;
+	struct _mmgui_smsdb_decode_chunk single;
+	GThreadPool *pool;
+	GError *error;
+	glong processors;
+	guint numchunks, numthreads, i;
 	
-	if (message->svcnumber != NULL) {
-		g_free(message->svcnumber);
+	if ((records == NULL) || (decodefunc == NULL)) return;
+	if (records->len == 0) return;
+	
+	numchunks = (records->len + MMGUI_SMSDB_DECODE_CHUNK_SIZE - 1) / MMGUI_SMSDB_DECODE_CHUNK_SIZE;
+	
+	processors = sysconf(_SC_NPROCESSORS_ONLN);
+	
+	if (processors < 1) {
+		processors = 1;
 	}
 	
-	if (message->idents != NULL) {
-		g_array_free(message->idents, TRUE);
+	numthreads = MIN(MIN((guint)processors, numchunks), MMGUI_SMSDB_DECODE_MAX_THREADS);
+	
+	pool = NULL;
+	
+	/*Small lists are not worth starting threads*/
+	if (numthreads > 1) {
+		error = NULL;
+		pool = g_thread_pool_new(mmgui_smsdb_decode_worker, NULL, (gint)numthreads, TRUE, &error);
+		if (pool == NULL) {
+			if (error != NULL) {
+				g_debug("Unable to start SMS decoding threads: %s\n", error->message);
+				g_error_free(error);
+			}
+		}
 	}
 	
-	if (message->text != NULL) {
-		g_string_free(message->text, TRUE);
+	if (pool == NULL) {
+		single.records = (struct _mmgui_smsdb_raw_record *)records->data;
+		single.count = records->len;
+		single.decodefunc = decodefunc;
+		mmgui_smsdb_decode_worker(&single, NULL);
+		return;
 	}
-}
-
-void mmgui_smsdb_message_free_list(GSList *smslist)
-{
-	if (smslist == NULL) return;
 	
-	g_slist_foreach(smslist, mmgui_smsdb_free_sms_list_foreach, NULL);
-	g_slist_free(smslist);
+	chunks = g_new(struct _mmgui_smsdb_decode_chunk, numchunks);
+	
+	for (i=0; i<numchunks; i++) {
+		chunks[i].records = &g_array_index(records, struct _mmgui_smsdb_raw_record, i * MMGUI_SMSDB_DECODE_CHUNK_SIZE);
+		chunks[i].count = MIN(MMGUI_SMSDB_DECODE_CHUNK_SIZE, records->len - i * MMGUI_SMSDB_DECODE_CHUNK_SIZE);
+		chunks[i].decodefunc = decodefunc;
+		g_thread_pool_push(pool, &chunks[i], NULL);
+	}
+	
+	/*Wait for all chunks to be decoded*/
+	g_thread_pool_free(pool, FALSE, TRUE);
+	
+	g_free(chunks);
 }
 
-mmgui_sms_message_t mmgui_smsdb_read_sms_message(smsdb_t smsdb, gulong idvalue)
+GSList *mmgui_smsdb_read_sms_range(smsdb_t smsdb, guint64 firstid, guint64 lastid)
 {
-	GDBM_FILE db;
-	gchar smsid[64];
-	gint idlen;
-	datum key, data;
+	GSList *list;
 	mmgui_sms_message_t message;
-		
+	datum data;
+	guint64 idvalue;
+	
 	if (smsdb == NULL) return NULL;
-	if (smsdb->filepath == NULL) return NULL;
+	if (smsdb->dbhandle == NULL) return NULL;
 	
-	db = gdbm_open((gchar *)smsdb->filepath, 0, GDBM_READER, MMGUI_SMSDB_ACCESS_MASK, 0);
+	list = NULL;
 	
-	if (db == NULL) return NULL;
+	g_rec_mutex_lock(&smsdb->dblock);
 	
-	message = NULL;
+	/*Identifiers never exceed last allocated one*/
+	if (lastid >= smsdb->nextid) {
+		lastid = smsdb->nextid - 1;
+	}
 	
-	memset(smsid, 0, sizeof(smsid));
-	idlen = snprintf(smsid, sizeof(smsid), "%lu", idvalue);
-	key.dptr = (gchar *)smsid;
-	key.dsize = idlen;
+	if (firstid == 0) {
+		firstid = 1;
+	}
 	
-	if (gdbm_exists(db, key)) {
-		data = gdbm_fetch(db, key);
+	/*Walk backwards to build list in arrival order without reversing*/
+	for (idvalue=lastid; idvalue>=firstid; idvalue--) {
+		data = mmgui_smsdb_record_fetch(smsdb, idvalue, NULL);
 		if (data.dptr != NULL) {
-			message = mmgui_smsdb_xml_parse(data.dptr, data.dsize);
-			message->dbid = idvalue;
+			message = mmgui_smsdb_record_parse(data.dptr, data.dsize);
+			if (message != NULL) {
+				message->dbid = idvalue;
+				list = g_slist_prepend(list, message);
+			}
+			free(data.dptr);
 		}
 	}
 	
-	gdbm_close(db);
+	g_rec_mutex_unlock(&smsdb->dblock);
 	
-	return message;
+	return list;
 }
 
-gboolean mmgui_smsdb_remove_sms_message(smsdb_t smsdb, gulong idvalue)
+GSList *mmgui_smsdb_read_sms_page(smsdb_t smsdb, enum _mmgui_smsdb_sms_folder folder, guint offset, guint limit)
 {
-	GDBM_FILE db;
-	gchar smsid[64];
-	gint idlen, unreaddelta;
-	datum key, data;
-	gchar *node;
+	GArray *directory, *bucket;
+	GSList *list;
+	struct _mmgui_smsdb_index_pair *bucketpair, *pair;
+	mmgui_sms_message_t message;
+	gchar name[64];
+	gint i, j;
 	
-	if (smsdb == NULL) return FALSE;
-	if (smsdb->filepath == NULL) return FALSE;
+	if ((smsdb == NULL) || (limit == 0)) return NULL;
+	if ((smsdb->dbhandle == NULL) || (smsdb->indexhandle == NULL)) return NULL;
 	
-	db = gdbm_open((gchar *)smsdb->filepath, 0, GDBM_WRCREAT, MMGUI_SMSDB_ACCESS_MASK, 0);
+	list = NULL;
 	
-	if (db == NULL) return FALSE;
+	g_rec_mutex_lock(&smsdb->dblock);
 	
-	memset(smsid, 0, sizeof(smsid));
-	idlen = g_snprintf(smsid, sizeof(smsid), "%lu", idvalue);
-	key.dptr = (gchar *)smsid;
-	key.dsize = idlen;
+	g_snprintf(name, sizeof(name), MMGUI_SMSDB_INDEX_DIRECTORY_KEY, (guint)folder);
 	
-	unreaddelta = 0;
+	directory = mmgui_smsdb_index_load(smsdb, name, sizeof(struct _mmgui_smsdb_index_pair));
 	
-	if (gdbm_exists(db, key)) {
-		data = gdbm_fetch(db, key);
-		if (data.dptr != NULL) {
-			node = strstr(data.dptr, MMGUI_SMSDB_READ_TAG);
-			if (node != NULL) {
-				if ((node-data.dptr > 8) && (isdigit(node[8]))) {
-					if (node[8] == '0') {
-						unreaddelta = -1;
-					} else {
-						unreaddelta = 0;
-					}
-				}
-			} else {
-				unreaddelta = -1;
-			}
-			free(data.dptr);
+	/*Newest buckets first, whole buckets before offset are skipped by count*/
+	for (i=(gint)directory->len-1; (i>=0) && (limit>0); i--) {
+		bucketpair = &g_array_index(directory, struct _mmgui_smsdb_index_pair, i);
+		if (offset >= bucketpair->second) {
+			offset -= bucketpair->second;
+			continue;
 		}
-		
-		if (gdbm_delete(db, key) == 0) {
-			smsdb->unreadmessages += unreaddelta;
-			gdbm_sync(db);
-			gdbm_close(db);
-			return TRUE;
+		g_snprintf(name, sizeof(name), MMGUI_SMSDB_INDEX_FOLDER_KEY, (guint)folder, bucketpair->first);
+		bucket = mmgui_smsdb_index_load(smsdb, name, sizeof(struct _mmgui_smsdb_index_pair));
+		for (j=(gint)bucket->len-1-(gint)offset; (j>=0) && (limit>0); j--) {
+			pair = &g_array_index(bucket, struct _mmgui_smsdb_index_pair, j);
+			message = mmgui_smsdb_read_sms_message(smsdb, pair->second);
+			if (message != NULL) {
+				list = g_slist_prepend(list, message);
+				limit--;
+			}
 		}
+		offset = 0;
+		g_array_free(bucket, TRUE);
 	}
 	
-	gdbm_close(db);
+	g_array_free(directory, TRUE);
 	
-	return FALSE;
+	g_rec_mutex_unlock(&smsdb->dblock);
+	
+	return g_slist_reverse(list);
 }
 
-gboolean mmgui_smsdb_set_message_read_status(smsdb_t smsdb, gulong idvalue, gboolean readflag)
+static GSList *mmgui_smsdb_read_sms_index(smsdb_t smsdb, const gchar *name)
 {
-	GDBM_FILE db;
-	gint unreaddelta;
-	gchar smsid[64];
-	gint idlen;
-	datum key, data;
-	gchar *node, /* *trailer,*/ *newmsg;
-	gchar newtrailer[64];
-	gint newtrailerlen;
-	gboolean res;
-			
-	if (smsdb == NULL) return FALSE;
-	if (smsdb->filepath == NULL) return FALSE;
-	
-	db = gdbm_open((gchar *)smsdb->filepath, 0, GDBM_WRITER, MMGUI_SMSDB_ACCESS_MASK, 0);
-	
-	if (db == NULL) return FALSE;
+	GArray *ids;
+	GSList *list;
+	mmgui_sms_message_t message;
+	gchar *blockname;
+	guint64 block, lastblock;
+	guint i;
 	
-	memset(smsid, 0, sizeof(smsid));
-	idlen = snprintf(smsid, sizeof(smsid), "%lu", idvalue);
-	key.dptr = (gchar *)smsid;
-	key.dsize = idlen;
+	g_rec_mutex_lock(&smsdb->dblock);
 	
-	res = FALSE;
+	list = NULL;
 	
-	unreaddelta = 0;
+	/*Blocks in identifier order, missing blocks have no messages*/
+	lastblock = smsdb->nextid >> MMGUI_SMSDB_INDEX_LIST_BLOCK_SHIFT;
 	
-	if (gdbm_exists(db, key)) {
-		data = gdbm_fetch(db, key);
-		if (data.dptr != NULL) {
-			node = strstr(data.dptr, MMGUI_SMSDB_READ_TAG);
-			if (node != NULL) {
-				if ((node-data.dptr > 8) && (isdigit(node[8]))) {
-					if ((readflag) && (node[8] == '0')) {
-						unreaddelta = -1;
-						node[8] = '1';
-					} else if ((!readflag) && (node[8] == '1')) {
-						unreaddelta = 1;
-						node[8] = '0';
-					}
-					
-					if (gdbm_store(db, key, data, GDBM_REPLACE) == 0) {
-						smsdb->unreadmessages += unreaddelta;
-						res = TRUE;
-					}
-					
-					free(data.dptr);
-				}
-			} else {
-				if (strstr(data.dptr, MMGUI_SMSDB_TRAILER_TAG) != NULL) {
-					memset(newtrailer, 0, sizeof(newtrailer));
-					newtrailerlen = g_snprintf(newtrailer, sizeof(newtrailer), MMGUI_SMSDB_TRAILER_PARAMS, readflag, MMGUI_SMSDB_SMS_FOLDER_INCOMING);
-					
-					newmsg = g_malloc0(data.dsize-9+newtrailerlen+1);
-					memcpy(newmsg, data.dptr, data.dsize-9);
-					memcpy(newmsg+data.dsize-9, newtrailer, newtrailerlen);
-					
-					free(data.dptr);
-					
-					data.dptr = newmsg;
-					data.dsize = data.dsize-9+newtrailerlen;
-					
-					if (readflag) {
-						unreaddelta = -1;
-					} else {
-						unreaddelta = 0;
-					}
-					
-					if (gdbm_store(db, key, data, GDBM_REPLACE) == 0) {
-						smsdb->unreadmessages += unreaddelta;
-						res = TRUE;
-					}
-					
-					g_free(newmsg);
-				}
+	for (block=0; block<=lastblock; block++) {
+		blockname = g_strdup_printf(MMGUI_SMSDB_INDEX_LIST_BLOCK_KEY, name, block);
+		ids = mmgui_smsdb_index_load(smsdb, blockname, sizeof(guint64));
+		for (i=0; i<ids->len; i++) {
+			message = mmgui_smsdb_read_sms_message(smsdb, g_array_index(ids, guint64, i));
+			if (message != NULL) {
+				list = g_slist_prepend(list, message);
 			}
 		}
+		g_array_free(ids, TRUE);
+		g_free(blockname);
 	}
 	
-	gdbm_close(db);
+	g_rec_mutex_unlock(&smsdb->dblock);
 	
-	return res;
+	return g_slist_reverse(list);
 }
 
-static mmgui_sms_message_t mmgui_smsdb_xml_parse(gchar *xml, gsize size)
+GSList *mmgui_smsdb_read_sms_by_number(smsdb_t smsdb, const gchar *number)
 {
+	GSList *list, *iterator, *next;
 	mmgui_sms_message_t message;
+	gchar *threadkey, *name;
+	
+	if ((smsdb == NULL) || (number == NULL)) return NULL;
+	if ((smsdb->dbhandle == NULL) || (smsdb->indexhandle == NULL)) return NULL;
+	
+	/*Sender messages are taken from thread index, it only ignores number formatting*/
+	threadkey = mmgui_smsdb_thread_key(number, strlen(number));
+	name = g_strdup_printf(MMGUI_SMSDB_INDEX_THREAD_KEY, threadkey);
+	
+	list = mmgui_smsdb_read_sms_index(smsdb, name);
+	
+	g_free(name);
+	g_free(threadkey);
+	
+	for (iterator=list; iterator!=NULL; iterator=next) {
+		next = iterator->next;
+		message = (mmgui_sms_message_t)iterator->data;
+		if ((message->number == NULL) || (!g_str_equal(message->number, number))) {
+			mmgui_smsdb_message_free(message);
+			list = g_slist_delete_link(list, iterator);
+		}
+	}
+	
+	return list;
+}
+
+GSList *mmgui_smsdb_read_unread_sms_list(smsdb_t smsdb)
+{
+	if (smsdb == NULL) return NULL;
+	if ((smsdb->dbhandle == NULL) || (smsdb->indexhandle == NULL)) return NULL;
+	
+	return mmgui_smsdb_read_sms_index(smsdb, MMGUI_SMSDB_INDEX_UNREAD_KEY);
+}
+
+static mmgui_sms_thread_t mmgui_smsdb_thread_from_summary(smsdb_t smsdb, guint64 lastid)
+{
+	mmgui_sms_message_t message;
+	mmgui_sms_thread_t thread;
+	GArray *summary;
+	gchar *threadkey, *name;
+	guint64 *words;
+	
+	/*Last message gives sender number and preview*/
+	message = mmgui_smsdb_read_sms_message(smsdb, lastid);
+	
+	if (message == NULL) return NULL;
+	
+	threadkey = mmgui_smsdb_thread_key(message->number, strlen(message->number));
+	name = g_strdup_printf(MMGUI_SMSDB_INDEX_THREAD_SUMMARY_KEY, threadkey);
+	
+	g_rec_mutex_lock(&smsdb->dblock);
+	
+	summary = mmgui_smsdb_index_load(smsdb, name, sizeof(guint64));
+	
+	g_rec_mutex_unlock(&smsdb->dblock);
+	
+	thread = NULL;
+	
+	if (summary->len >= MMGUI_SMSDB_THREAD_SUMMARY_SIZE) {
+		words = (guint64 *)summary->data;
+		thread = g_new0(struct _mmgui_sms_thread, 1);
+		thread->number = message->number;
+		thread->key = threadkey;
+		thread->lastid = words[MMGUI_SMSDB_THREAD_SUMMARY_LAST_ID];
+		thread->timestamp = (time_t)words[MMGUI_SMSDB_THREAD_SUMMARY_TIMESTAMP];
+		thread->unread = (guint)words[MMGUI_SMSDB_THREAD_SUMMARY_UNREAD];
+		thread->total = (guint)words[MMGUI_SMSDB_THREAD_SUMMARY_TOTAL];
+		if (message->binary) {
+			thread->preview = NULL;
+		} else {
+			thread->preview = g_string_free(message->text, FALSE);
+			message->text = NULL;
+		}
+		message->number = NULL;
+		threadkey = NULL;
+	}
+	
+	g_array_free(summary, TRUE);
+	g_free(name);
+	g_free(threadkey);
+	
+	mmgui_smsdb_message_free(message);
+	
+	return thread;
+}
+
+GSList *mmgui_smsdb_read_thread_list(smsdb_t smsdb)
+{
+	GArray *directory;
+	GSList *list;
+	mmgui_sms_thread_t thread;
+	guint i;
+	
+	if (smsdb == NULL) return NULL;
+	if ((smsdb->dbhandle == NULL) || (smsdb->indexhandle == NULL)) return NULL;
+	
+	g_rec_mutex_lock(&smsdb->dblock);
+	
+	directory = mmgui_smsdb_index_load(smsdb, MMGUI_SMSDB_INDEX_THREAD_DIRECTORY_KEY, sizeof(guint64));
+	
+	list = NULL;
+	
+	/*Directory is sorted by last message identifier, so list starts with most recent thread*/
+	for (i=0; i<directory->len; i++) {
+		thread = mmgui_smsdb_thread_from_summary(smsdb, g_array_index(directory, guint64, i));
+		if (thread != NULL) {
+			list = g_slist_prepend(list, thread);
+		}
+	}
+	
+	g_array_free(directory, TRUE);
+	
+	g_rec_mutex_unlock(&smsdb->dblock);
+	
+	return list;
+}
+
+mmgui_sms_thread_t mmgui_smsdb_read_thread(smsdb_t smsdb, const gchar *number)
+{
+	GArray *summary;
+	gchar *threadkey, *name;
+	guint64 lastid;
+	
+	if ((smsdb == NULL) || (number == NULL)) return NULL;
+	if ((smsdb->dbhandle == NULL) || (smsdb->indexhandle == NULL)) return NULL;
+	
+	threadkey = mmgui_smsdb_thread_key(number, strlen(number));
+	name = g_strdup_printf(MMGUI_SMSDB_INDEX_THREAD_SUMMARY_KEY, threadkey);
+	
+	g_rec_mutex_lock(&smsdb->dblock);
+	
+	summary = mmgui_smsdb_index_load(smsdb, name, sizeof(guint64));
+	
+	g_rec_mutex_unlock(&smsdb->dblock);
+	
+	if (summary->len >= MMGUI_SMSDB_THREAD_SUMMARY_SIZE) {
+		lastid = g_array_index(summary, guint64, MMGUI_SMSDB_THREAD_SUMMARY_LAST_ID);
+	} else {
+		lastid = 0;
+	}
+	
+	g_array_free(summary, TRUE);
+	g_free(name);
+	g_free(threadkey);
+	
+	if (lastid == 0) return NULL;
+	
+	return mmgui_smsdb_thread_from_summary(smsdb, lastid);
+}
+
+GSList *mmgui_smsdb_read_thread_messages(smsdb_t smsdb, const gchar *number)
+{
+	GSList *list;
+	gchar *threadkey, *name;
+	
+	if ((smsdb == NULL) || (number == NULL)) return NULL;
+	if ((smsdb->dbhandle == NULL) || (smsdb->indexhandle == NULL)) return NULL;
+	
+	threadkey = mmgui_smsdb_thread_key(number, strlen(number));
+	name = g_strdup_printf(MMGUI_SMSDB_INDEX_THREAD_KEY, threadkey);
+	
+	list = mmgui_smsdb_read_sms_index(smsdb, name);
+	
+	g_free(name);
+	g_free(threadkey);
+	
+	return list;
+}
+
+void mmgui_smsdb_thread_free(mmgui_sms_thread_t thread)
+{
+	if (thread == NULL) return;
+	
+	g_free(thread->number);
+	g_free(thread->key);
+	g_free(thread->preview);
+	
+	g_free(thread);
+}
+
+void mmgui_smsdb_thread_free_list(GSList *threadlist)
+{
+	if (threadlist == NULL) return;
+	
+	g_slist_free_full(threadlist, (GDestroyNotify)mmgui_smsdb_thread_free);
+}
+
+GArray *mmgui_smsdb_search_sms(smsdb_t smsdb, const gchar *query, guint limit)
+{
+	GHashTable *trigrams;
+	GList *trigramlist, *iterator;
+	GArray *result, *candidates, *postings;
+	gchar *normquery;
+	gchar **tokens;
+	gchar name[64];
+	guint64 block, id;
+	guint i;
+	
+	if ((smsdb == NULL) || (query == NULL)) return NULL;
+	if ((smsdb->dbhandle == NULL) || (smsdb->indexhandle == NULL)) return NULL;
+	
+	normquery = mmgui_smsdb_text_normalize(query, strlen(query));
+	
+	if (normquery == NULL) return NULL;
+	
+	trigrams = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	
+	mmgui_smsdb_text_trigrams(normquery, trigrams);
+	
+	/*Query without single trigram can not be looked up*/
+	if (g_hash_table_size(trigrams) == 0) {
+		g_hash_table_destroy(trigrams);
+		g_free(normquery);
+		return NULL;
+	}
+	
+	trigramlist = g_hash_table_get_keys(trigrams);
+	tokens = g_strsplit(normquery, " ", -1);
+	
+	g_rec_mutex_lock(&smsdb->dblock);
+	
+	result = g_array_new(FALSE, FALSE, sizeof(guint64));
+	
+	/*Newest identifier blocks first, so search stops as soon as limit reached*/
+	block = smsdb->nextid >> MMGUI_SMSDB_INDEX_TEXT_BLOCK_SHIFT;
+	
+	while ((limit == 0) || (result->len < limit)) {
+		candidates = NULL;
+		for (iterator=trigramlist; iterator != NULL; iterator=iterator->next) {
+			g_snprintf(name, sizeof(name), MMGUI_SMSDB_INDEX_TEXT_KEY, (const gchar *)iterator->data, block);
+			postings = mmgui_smsdb_index_load(smsdb, name, sizeof(guint64));
+			if (candidates == NULL) {
+				candidates = postings;
+			} else {
+				mmgui_smsdb_index_intersect(candidates, postings);
+				g_array_free(postings, TRUE);
+			}
+			if (candidates->len == 0) break;
+		}
+		/*Trigram match is verified against record*/
+		for (i=candidates->len; (i>0) && ((limit == 0) || (result->len < limit)); i--) {
+			id = g_array_index(candidates, guint64, i-1);
+			if (mmgui_smsdb_search_match(smsdb, id, tokens)) {
+				g_array_append_val(result, id);
+			}
+		}
+		g_array_free(candidates, TRUE);
+		if (block == 0) break;
+		block--;
+	}
+	
+	g_rec_mutex_unlock(&smsdb->dblock);
+	
+	g_strfreev(tokens);
+	g_list_free(trigramlist);
+	g_hash_table_destroy(trigrams);
+	g_free(normquery);
+	
+	return result;
+}
+
+static void mmgui_smsdb_free_sms_list_foreach(gpointer data, gpointer user_data)
+{
+	if (data == NULL) return;
+	
+	mmgui_smsdb_message_free((mmgui_sms_message_t)data);
+}
+
+void mmgui_smsdb_message_free_list(GSList *smslist)
+{
+	if (smslist == NULL) return;
+	
+	g_slist_foreach(smslist, mmgui_smsdb_free_sms_list_foreach, NULL);
+	g_slist_free(smslist);
+}
+
+mmgui_sms_message_t mmgui_smsdb_read_sms_message(smsdb_t smsdb, guint64 idvalue)
+{
+	datum data;
+	mmgui_sms_message_t message;
+		
+	if (smsdb == NULL) return NULL;
+	if (smsdb->dbhandle == NULL) return NULL;
+	
+	message = NULL;
+	
+	g_rec_mutex_lock(&smsdb->dblock);
+	
+	data = mmgui_smsdb_record_fetch(smsdb, idvalue, NULL);
+	
+	g_rec_mutex_unlock(&smsdb->dblock);
+	
+	if (data.dptr != NULL) {
+		message = mmgui_smsdb_record_parse(data.dptr, data.dsize);
+		if (message != NULL) {
+			message->dbid = idvalue;
+		}
+		free(data.dptr);
+	}
+	
+	return message;
+}
+
+gboolean mmgui_smsdb_remove_sms_message(smsdb_t smsdb, guint64 idvalue)
+{
+	gint unreaddelta;
+	guint folder;
+	datum data;
+	struct _mmgui_smsdb_record record;
+	struct _mmgui_smsdb_segment *segment;
+	mmgui_sms_message_t message;
+	gboolean res;
+	
+	if (smsdb == NULL) return FALSE;
+	if (smsdb->dbhandle == NULL) return FALSE;
+	
+	unreaddelta = 0;
+	folder = MMGUI_SMSDB_SMS_FOLDER_INCOMING;
+	
+	g_rec_mutex_lock(&smsdb->dblock);
+	
+	data = mmgui_smsdb_record_fetch(smsdb, idvalue, &segment);
+	if (data.dptr == NULL) {
+		g_rec_mutex_unlock(&smsdb->dblock);
+		return FALSE;
+	}
+	
+	if (mmgui_smsdb_record_decode(data.dptr, data.dsize, &record)) {
+		/*Binary record*/
+		if (!(record.flags & MMGUI_SMSDB_RECORD_FLAG_READ)) {
+			unreaddelta = -1;
+		}
+		folder = record.folder;
+		mmgui_smsdb_index_update_message(smsdb, idvalue, &record, FALSE);
+	} else {
+		/*Legacy XML record*/
+		message = mmgui_smsdb_xml_parse(data.dptr, data.dsize);
+		if (message != NULL) {
+			if (!message->read) {
+				unreaddelta = -1;
+			}
+			folder = message->folder;
+			mmgui_smsdb_message_free(message);
+		}
+	}
+	free(data.dptr);
+	
+	res = mmgui_smsdb_record_delete(smsdb, idvalue, segment);
+	
+	if (res) {
+		/*Archived copy left by interrupted archiver must not reappear*/
+		if (segment == NULL) {
+			mmgui_smsdb_record_purge_segments(smsdb, idvalue);
+		}
+		mmgui_smsdb_stats_update(smsdb, folder, -1, unreaddelta);
+		/*Sync is deferred until batch is committed*/
+		mmgui_smsdb_batch_append(smsdb);
+	}
+	
+	g_rec_mutex_unlock(&smsdb->dblock);
+	
+	return res;
+}
+
+gboolean mmgui_smsdb_set_message_read_status(smsdb_t smsdb, guint64 idvalue, gboolean readflag)
+{
+	gint unreaddelta;
+	datum data;
+	struct _mmgui_smsdb_record record;
+	struct _mmgui_smsdb_segment *segment;
+	mmgui_sms_message_t message;
+	gchar *newrecord;
+	gsize newrecordlen;
+	gboolean res;
+			
+	if (smsdb == NULL) return FALSE;
+	if (smsdb->dbhandle == NULL) return FALSE;
+	
+	res = FALSE;
+	
+	unreaddelta = 0;
+	
+	g_rec_mutex_lock(&smsdb->dblock);
+	
+	data = mmgui_smsdb_record_fetch(smsdb, idvalue, &segment);
+	if (data.dptr == NULL) {
+		g_rec_mutex_unlock(&smsdb->dblock);
+		return FALSE;
+	}
+	
+	if (mmgui_smsdb_record_decode(data.dptr, data.dsize, &record)) {
+		/*Binary record: flags byte is changed in place*/
+		if ((readflag) && (!(record.flags & MMGUI_SMSDB_RECORD_FLAG_READ))) {
+			unreaddelta = -1;
+			data.dptr[MMGUI_SMSDB_RECORD_FLAGS_OFFSET] |= MMGUI_SMSDB_RECORD_FLAG_READ;
+		} else if ((!readflag) && (record.flags & MMGUI_SMSDB_RECORD_FLAG_READ)) {
+			unreaddelta = 1;
+			data.dptr[MMGUI_SMSDB_RECORD_FLAGS_OFFSET] &= ~MMGUI_SMSDB_RECORD_FLAG_READ;
+		}
+		
+		if (unreaddelta == 0) {
+			/*Nothing changed*/
+			res = TRUE;
+		} else if (mmgui_smsdb_record_store(smsdb, idvalue, data, segment)) {
+			mmgui_smsdb_stats_update(smsdb, record.folder, 0, unreaddelta);
+			if (smsdb->indexhandle != NULL) {
+				mmgui_smsdb_index_update_list(smsdb, MMGUI_SMSDB_INDEX_UNREAD_KEY, idvalue, !readflag);
+				mmgui_smsdb_index_update_thread_unread(smsdb, &record, unreaddelta);
+			}
+			res = TRUE;
+		}
+		free(data.dptr);
+	} else {
+		/*Legacy XML record is converted on update*/
+		message = mmgui_smsdb_xml_parse(data.dptr, data.dsize);
+		free(data.dptr);
+		if (message != NULL) {
+			if ((readflag) && (!message->read)) {
+				unreaddelta = -1;
+			} else if ((!readflag) && (message->read)) {
+				unreaddelta = 1;
+			}
+			message->read = readflag;
+			newrecord = mmgui_smsdb_record_encode(message, &newrecordlen);
+			if (newrecord != NULL) {
+				data.dptr = newrecord;
+				data.dsize = newrecordlen;
+				if (mmgui_smsdb_record_store(smsdb, idvalue, data, segment)) {
+					mmgui_smsdb_stats_update(smsdb, message->folder, 0, unreaddelta);
+					res = TRUE;
+				}
+				g_free(newrecord);
+			}
+			mmgui_smsdb_message_free(message);
+		}
+	}
+	
+	if ((res) && (unreaddelta != 0)) {
+		/*Sync is deferred until batch is committed*/
+		mmgui_smsdb_batch_append(smsdb);
+	}
+	
+	g_rec_mutex_unlock(&smsdb->dblock);
+	
+	return res;
+}
+
+static gboolean mmgui_smsdb_key_is_meta(datum key)
+{
+	if (key.dptr == NULL) return FALSE;
+	
+	return ((key.dsize == strlen(MMGUI_SMSDB_META_KEY)) && (memcmp(key.dptr, MMGUI_SMSDB_META_KEY, key.dsize) == 0));
+}
+
+static void mmgui_smsdb_meta_load(smsdb_t smsdb)
+{
+	datum key, data;
+	guint i;
+	
+	smsdb->formatversion = 0;
+	smsdb->idceiling = 0;
+	smsdb->metaflags = 0;
+	smsdb->unreadmessages = 0;
+	
+	key.dptr = MMGUI_SMSDB_META_KEY;
+	key.dsize = strlen(MMGUI_SMSDB_META_KEY);
+	
+	data = gdbm_fetch((GDBM_FILE)smsdb->dbhandle, key);
+	
+	if (data.dptr != NULL) {
+		if (data.dsize >= MMGUI_SMSDB_META_V1_SIZE) {
+			smsdb->formatversion = mmgui_smsdb_get_uint32(data.dptr + MMGUI_SMSDB_META_VERSION_OFFSET);
+		}
+		if (data.dsize >= MMGUI_SMSDB_META_V2_SIZE) {
+			smsdb->idceiling = mmgui_smsdb_get_uint64(data.dptr + MMGUI_SMSDB_META_ID_CEILING_OFFSET);
+		}
+		if (data.dsize >= MMGUI_SMSDB_META_V3_SIZE) {
+			smsdb->metaflags = mmgui_smsdb_get_uint32(data.dptr + MMGUI_SMSDB_META_FLAGS_OFFSET);
+			for (i=0; i<MMGUI_SMSDB_SMS_FOLDERS_NUMBER; i++) {
+				smsdb->folderstats[i].total = mmgui_smsdb_get_uint32(data.dptr + MMGUI_SMSDB_META_STATS_OFFSET + i * MMGUI_SMSDB_META_STATS_ENTRY_SIZE);
+				smsdb->folderstats[i].unread = mmgui_smsdb_get_uint32(data.dptr + MMGUI_SMSDB_META_STATS_OFFSET + i * MMGUI_SMSDB_META_STATS_ENTRY_SIZE + 4);
+				smsdb->unreadmessages += smsdb->folderstats[i].unread;
+			}
+		}
+		free(data.dptr);
+	}
+	
+	/*Identifiers reserved but not used before last close are skipped*/
+	smsdb->nextid = MAX(smsdb->idceiling, 1);
+}
+
+static gboolean mmgui_smsdb_meta_store(smsdb_t smsdb)
+{
+	datum key, data;
+	gchar meta[MMGUI_SMSDB_META_SIZE];
+	guint i;
+	
+	memset(meta, 0, sizeof(meta));
+	mmgui_smsdb_put_uint32(meta + MMGUI_SMSDB_META_VERSION_OFFSET, smsdb->formatversion);
+	mmgui_smsdb_put_uint32(meta + MMGUI_SMSDB_META_FLAGS_OFFSET, smsdb->metaflags);
+	mmgui_smsdb_put_uint64(meta + MMGUI_SMSDB_META_ID_CEILING_OFFSET, smsdb->idceiling);
+	for (i=0; i<MMGUI_SMSDB_SMS_FOLDERS_NUMBER; i++) {
+		mmgui_smsdb_put_uint32(meta + MMGUI_SMSDB_META_STATS_OFFSET + i * MMGUI_SMSDB_META_STATS_ENTRY_SIZE, smsdb->folderstats[i].total);
+		mmgui_smsdb_put_uint32(meta + MMGUI_SMSDB_META_STATS_OFFSET + i * MMGUI_SMSDB_META_STATS_ENTRY_SIZE + 4, smsdb->folderstats[i].unread);
+	}
+	
+	key.dptr = MMGUI_SMSDB_META_KEY;
+	key.dsize = strlen(MMGUI_SMSDB_META_KEY);
+	data.dptr = meta;
+	data.dsize = sizeof(meta);
+	
+	return (gdbm_store((GDBM_FILE)smsdb->dbhandle, key, data, GDBM_REPLACE) == 0);
+}
+
+static guint64 mmgui_smsdb_id_allocate(smsdb_t smsdb)
+{
+	if (smsdb->nextid >= smsdb->idceiling) {
+		/*Reserve next block of identifiers before handing them out*/
+		smsdb->idceiling = smsdb->nextid + MMGUI_SMSDB_ID_BLOCK_SIZE;
+		if (!mmgui_smsdb_meta_store(smsdb)) {
+			return 0;
+		}
+	}
+	
+	return smsdb->nextid++;
+}
+
+static datum mmgui_smsdb_key_from_id(guint64 id, gchar *buffer)
+{
+	datum key;
+	
+	/*Big-endian keys sort bytewise in identifier order*/
+	id = GUINT64_TO_BE(id);
+	memcpy(buffer, &id, MMGUI_SMSDB_KEY_SIZE);
+	
+	key.dptr = buffer;
+	key.dsize = MMGUI_SMSDB_KEY_SIZE;
+	
+	return key;
+}
+
+static gboolean mmgui_smsdb_key_to_id(datum key, guint64 *id)
+{
+	guint64 value;
+	
+	if ((key.dptr == NULL) || (key.dsize != MMGUI_SMSDB_KEY_SIZE) || (id == NULL)) return FALSE;
+	
+	memcpy(&value, key.dptr, MMGUI_SMSDB_KEY_SIZE);
+	
+	*id = GUINT64_FROM_BE(value);
+	
+	return TRUE;
+}
+
+static gchar *mmgui_smsdb_segments_directory(smsdb_t smsdb)
+{
+	gchar *devicepath, *archivepath;
+	
+	devicepath = g_path_get_dirname(smsdb->filepath);
+	archivepath = g_build_filename(devicepath, MMGUI_SMSDB_ARCHIVE_DIRECTORY, NULL);
+	g_free(devicepath);
+	
+	return archivepath;
+}
+
+static void mmgui_smsdb_segments_load(smsdb_t smsdb)
+{
+	gchar *archivepath;
+	GDir *dir;
+	const gchar *filename;
+	guint month;
+	struct _mmgui_smsdb_segment *segment;
+	datum key, data;
+	
+	smsdb->segments = g_ptr_array_new();
+	
+	archivepath = mmgui_smsdb_segments_directory(smsdb);
+	
+	dir = g_dir_open(archivepath, 0, NULL);
+	
+	if (dir != NULL) {
+		while ((filename = g_dir_read_name(dir)) != NULL) {
+			if ((!g_str_has_prefix(filename, MMGUI_SMSDB_ARCHIVE_SEGMENT_PREFIX)) || (!g_str_has_suffix(filename, MMGUI_SMSDB_ARCHIVE_SEGMENT_SUFFIX))) continue;
+			if (sscanf(filename, MMGUI_SMSDB_ARCHIVE_SEGMENT_NAME, &month) != 1) continue;
+			
+			segment = g_new0(struct _mmgui_smsdb_segment, 1);
+			segment->month = month;
+			segment->filepath = g_build_filename(archivepath, filename, NULL);
+			
+			/*Identifier range lets lookups skip segments without opening them*/
+			if (mmgui_smsdb_segment_open(segment, FALSE) != NULL) {
+				key.dptr = MMGUI_SMSDB_META_KEY;
+				key.dsize = strlen(MMGUI_SMSDB_META_KEY);
+				data = gdbm_fetch((GDBM_FILE)segment->handle, key);
+				if (data.dptr != NULL) {
+					if (data.dsize >= MMGUI_SMSDB_ARCHIVE_META_SIZE) {
+						segment->firstid = mmgui_smsdb_get_uint64(data.dptr + MMGUI_SMSDB_ARCHIVE_META_FIRST_ID_OFFSET);
+						segment->lastid = mmgui_smsdb_get_uint64(data.dptr + MMGUI_SMSDB_ARCHIVE_META_LAST_ID_OFFSET);
+					}
+					free(data.dptr);
+				}
+				mmgui_smsdb_segment_close(segment);
+				g_ptr_array_add(smsdb->segments, segment);
+			} else {
+				g_warning("Unable to open SMS archive segment: %s", segment->filepath);
+				g_free(segment->filepath);
+				g_free(segment);
+			}
+		}
+		g_dir_close(dir);
+	}
+	
+	g_free(archivepath);
+	
+	g_ptr_array_sort(smsdb->segments, mmgui_smsdb_segment_compare);
+}
+
+static void mmgui_smsdb_segments_free(smsdb_t smsdb)
+{
+	struct _mmgui_smsdb_segment *segment;
+	guint i;
+	
+	if (smsdb->segments == NULL) return;
+	
+	for (i=0; i<smsdb->segments->len; i++) {
+		segment = g_ptr_array_index(smsdb->segments, i);
+		mmgui_smsdb_segment_close(segment);
+		g_free(segment->filepath);
+		g_free(segment);
+	}
+	
+	g_ptr_array_free(smsdb->segments, TRUE);
+	smsdb->segments = NULL;
+}
+
+static gint mmgui_smsdb_segment_compare(gconstpointer a, gconstpointer b)
+{
+	const struct _mmgui_smsdb_segment *segment1, *segment2;
+	
+	segment1 = *(const struct _mmgui_smsdb_segment **)a;
+	segment2 = *(const struct _mmgui_smsdb_segment **)b;
+	
+	if (segment1->month < segment2->month) {
+		return -1;
+	} else if (segment1->month > segment2->month) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+static struct _mmgui_smsdb_segment *mmgui_smsdb_segment_get(smsdb_t smsdb, guint month, gboolean create)
+{
+	struct _mmgui_smsdb_segment *segment;
+	gchar *archivepath;
+	gchar filename[32];
+	guint i;
+	
+	for (i=0; i<smsdb->segments->len; i++) {
+		segment = g_ptr_array_index(smsdb->segments, i);
+		if (segment->month == month) {
+			return segment;
+		}
+	}
+	
+	if (!create) return NULL;
+	
+	archivepath = mmgui_smsdb_segments_directory(smsdb);
+	
+	if (!g_file_test(archivepath, G_FILE_TEST_IS_DIR)) {
+		if (g_mkdir_with_parents(archivepath, S_IRUSR|S_IWUSR|S_IXUSR|S_IXGRP|S_IXOTH) == -1) {
+			g_warning("Failed to make SMS archive directory: %s", archivepath);
+			g_free(archivepath);
+			return NULL;
+		}
+	}
+	
+	g_snprintf(filename, sizeof(filename), MMGUI_SMSDB_ARCHIVE_SEGMENT_NAME, month);
+	
+	segment = g_new0(struct _mmgui_smsdb_segment, 1);
+	segment->month = month;
+	segment->filepath = g_build_filename(archivepath, filename, NULL);
+	
+	g_free(archivepath);
+	
+	g_ptr_array_add(smsdb->segments, segment);
+	g_ptr_array_sort(smsdb->segments, mmgui_smsdb_segment_compare);
+	
+	return segment;
+}
+
+static gpointer mmgui_smsdb_segment_open(struct _mmgui_smsdb_segment *segment, gboolean writable)
+{
+	if (segment == NULL) return NULL;
+	
+	if (segment->handle != NULL) {
+		if (segment->writable == writable) {
+			return segment->handle;
+		}
+		/*Segments are read-only, writer is kept only while archived message is changed*/
+		mmgui_smsdb_segment_close(segment);
+	}
+	
+	if (writable) {
+		segment->handle = (gpointer)gdbm_open(segment->filepath, 0, GDBM_WRCREAT, MMGUI_SMSDB_ACCESS_MASK, 0);
+	} else {
+		segment->handle = (gpointer)gdbm_open(segment->filepath, 0, GDBM_READER, MMGUI_SMSDB_ACCESS_MASK, 0);
+	}
+	
+	segment->writable = (segment->handle != NULL) && (writable);
+	
+	return segment->handle;
+}
+
+static void mmgui_smsdb_segment_close(struct _mmgui_smsdb_segment *segment)
+{
+	datum key, data;
+	gchar meta[MMGUI_SMSDB_ARCHIVE_META_SIZE];
+	
+	if ((segment == NULL) || (segment->handle == NULL)) return;
+	
+	if (segment->writable) {
+		mmgui_smsdb_put_uint64(meta + MMGUI_SMSDB_ARCHIVE_META_FIRST_ID_OFFSET, segment->firstid);
+		mmgui_smsdb_put_uint64(meta + MMGUI_SMSDB_ARCHIVE_META_LAST_ID_OFFSET, segment->lastid);
+		
+		key.dptr = MMGUI_SMSDB_META_KEY;
+		key.dsize = strlen(MMGUI_SMSDB_META_KEY);
+		data.dptr = meta;
+		data.dsize = sizeof(meta);
+		
+		if (gdbm_store((GDBM_FILE)segment->handle, key, data, GDBM_REPLACE) == -1) {
+			g_warning("Unable to write SMS archive segment metadata: %s", segment->filepath);
+		}
+		
+		gdbm_sync((GDBM_FILE)segment->handle);
+	}
+	
+	gdbm_close((GDBM_FILE)segment->handle);
+	
+	segment->handle = NULL;
+	segment->writable = FALSE;
+}
+
+static datum mmgui_smsdb_record_fetch(smsdb_t smsdb, guint64 id, struct _mmgui_smsdb_segment **segment)
+{
+	gchar smsid[MMGUI_SMSDB_KEY_SIZE];
+	datum key, data;
+	struct _mmgui_smsdb_segment *cursegment;
+	guint i;
+	
+	key = mmgui_smsdb_key_from_id(id, smsid);
+	
+	if (segment != NULL) {
+		*segment = NULL;
+	}
+	
+	/*Recent messages are looked up first*/
+	data = gdbm_fetch((GDBM_FILE)smsdb->dbhandle, key);
+	
+	if ((data.dptr != NULL) || (smsdb->segments == NULL)) return data;
+	
+	for (i=smsdb->segments->len; i>0; i--) {
+		cursegment = g_ptr_array_index(smsdb->segments, i-1);
+		if ((id < cursegment->firstid) || (id > cursegment->lastid)) continue;
+		if (mmgui_smsdb_segment_open(cursegment, FALSE) == NULL) continue;
+		data = gdbm_fetch((GDBM_FILE)cursegment->handle, key);
+		if (data.dptr != NULL) {
+			if (segment != NULL) {
+				*segment = cursegment;
+			}
+			break;
+		}
+	}
+	
+	return data;
+}
+
+static gboolean mmgui_smsdb_record_store(smsdb_t smsdb, guint64 id, datum data, struct _mmgui_smsdb_segment *segment)
+{
+	gchar smsid[MMGUI_SMSDB_KEY_SIZE];
+	datum key;
+	gboolean res;
+	
+	key = mmgui_smsdb_key_from_id(id, smsid);
+	
+	if (segment == NULL) {
+		return (gdbm_store((GDBM_FILE)smsdb->dbhandle, key, data, GDBM_REPLACE) == 0);
+	}
+	
+	/*Archived messages are rarely changed, so writer is not kept*/
+	if (mmgui_smsdb_segment_open(segment, TRUE) == NULL) return FALSE;
+	
+	res = (gdbm_store((GDBM_FILE)segment->handle, key, data, GDBM_REPLACE) == 0);
+	
+	if (res) {
+		if ((segment->firstid == 0) || (id < segment->firstid)) {
+			segment->firstid = id;
+		}
+		if (id > segment->lastid) {
+			segment->lastid = id;
+		}
+	}
+	
+	mmgui_smsdb_segment_close(segment);
+	
+	return res;
+}
+
+static gboolean mmgui_smsdb_record_delete(smsdb_t smsdb, guint64 id, struct _mmgui_smsdb_segment *segment)
+{
+	gchar smsid[MMGUI_SMSDB_KEY_SIZE];
+	datum key;
+	gboolean res;
+	
+	key = mmgui_smsdb_key_from_id(id, smsid);
+	
+	if (segment == NULL) {
+		return (gdbm_delete((GDBM_FILE)smsdb->dbhandle, key) == 0);
+	}
+	
+	if (mmgui_smsdb_segment_open(segment, TRUE) == NULL) return FALSE;
+	
+	res = (gdbm_delete((GDBM_FILE)segment->handle, key) == 0);
+	
+	mmgui_smsdb_segment_close(segment);
+	
+	return res;
+}
+
+static void mmgui_smsdb_record_purge_segments(smsdb_t smsdb, guint64 id)
+{
+	struct _mmgui_smsdb_segment *segment;
+	guint i;
+	
+	if (smsdb->segments == NULL) return;
+	
+	for (i=0; i<smsdb->segments->len; i++) {
+		segment = g_ptr_array_index(smsdb->segments, i);
+		if ((id < segment->firstid) || (id > segment->lastid)) continue;
+		mmgui_smsdb_record_delete(smsdb, id, segment);
+	}
+}
+
+static void mmgui_smsdb_records_foreach(smsdb_t smsdb, mmgui_smsdb_record_func func, gpointer userdata)
+{
+	GDBM_FILE db;
+	datum key, nextkey, data;
+	struct _mmgui_smsdb_segment *segment;
+	guint64 idvalue;
+	guint i;
+	
+	db = (GDBM_FILE)smsdb->dbhandle;
+	
+	key = gdbm_firstkey(db);
+	while (key.dptr != NULL) {
+		if (mmgui_smsdb_key_to_id(key, &idvalue)) {
+			data = gdbm_fetch(db, key);
+			if (data.dptr != NULL) {
+				(func)(smsdb, idvalue, data, userdata);
+			}
+		}
+		nextkey = gdbm_nextkey(db, key);
+		free(key.dptr);
+		key = nextkey;
+	}
+	
+	if (smsdb->segments == NULL) return;
+	
+	for (i=0; i<smsdb->segments->len; i++) {
+		segment = g_ptr_array_index(smsdb->segments, i);
+		if (mmgui_smsdb_segment_open(segment, FALSE) == NULL) continue;
+		key = gdbm_firstkey((GDBM_FILE)segment->handle);
+		while (key.dptr != NULL) {
+			/*Copy left in hot database by interrupted archiver wins*/
+			if ((mmgui_smsdb_key_to_id(key, &idvalue)) && (!gdbm_exists(db, key))) {
+				data = gdbm_fetch((GDBM_FILE)segment->handle, key);
+				if (data.dptr != NULL) {
+					(func)(smsdb, idvalue, data, userdata);
+				}
+			}
+			nextkey = gdbm_nextkey((GDBM_FILE)segment->handle, key);
+			free(key.dptr);
+			key = nextkey;
+		}
+	}
+}
+
+static guint mmgui_smsdb_archive_month(guint64 timestamp)
+{
+	GDateTime *datetime;
+	guint month;
+	
+	datetime = g_date_time_new_from_unix_local((gint64)timestamp);
+	
+	if (datetime == NULL) return 0;
+	
+	month = g_date_time_get_year(datetime) * 100 + g_date_time_get_month(datetime);
+	
+	g_date_time_unref(datetime);
+	
+	return month;
+}
+
+static gint mmgui_smsdb_archive_entry_compare(gconstpointer a, gconstpointer b)
+{
+	const struct _mmgui_smsdb_archive_entry *entry1, *entry2;
+	
+	entry1 = (const struct _mmgui_smsdb_archive_entry *)a;
+	entry2 = (const struct _mmgui_smsdb_archive_entry *)b;
+	
+	if (entry1->month != entry2->month) {
+		return (entry1->month < entry2->month) ? -1 : 1;
+	} else if (entry1->id < entry2->id) {
+		return -1;
+	} else if (entry1->id > entry2->id) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+static gpointer mmgui_smsdb_archive_worker(gpointer data)
+{
+	smsdb_t smsdb;
+	GDBM_FILE db;
+	GDateTime *now, *limit;
+	GArray *entries, *moved;
+	struct _mmgui_smsdb_archive_entry entry, *curentry;
+	struct _mmgui_smsdb_record record;
+	struct _mmgui_smsdb_segment *segment;
+	gchar smsid[MMGUI_SMSDB_KEY_SIZE];
+	datum key, value;
+	guint64 idvalue, lastid, threshold;
+	guint i, j, k, count;
+	
+	smsdb = (smsdb_t)data;
+	
+	if (smsdb == NULL) return NULL;
+	
+	db = (GDBM_FILE)smsdb->dbhandle;
+	
+	entries = g_array_new(FALSE, FALSE, sizeof(struct _mmgui_smsdb_archive_entry));
+	moved = g_array_new(FALSE, FALSE, sizeof(guint64));
+	count = 0;
+	
+	if (smsdb->archivemonths > 0) {
+		now = g_date_time_new_now_local();
+		limit = g_date_time_add_months(now, -(gint)smsdb->archivemonths);
+		threshold = (guint64)g_date_time_to_unix(limit);
+		g_date_time_unref(limit);
+		g_date_time_unref(now);
+		
+		/*Identifiers are sequential, so candidates are collected by id range without key traversal, lock is held for one chunk at a time*/
+		g_rec_mutex_lock(&smsdb->dblock);
+		lastid = smsdb->nextid;
+		g_rec_mutex_unlock(&smsdb->dblock);
+		
+		for (idvalue=1; (idvalue<lastid) && (!g_atomic_int_get(&smsdb->archivecancel)); ) {
+			g_rec_mutex_lock(&smsdb->dblock);
+			for (j=0; (j<MMGUI_SMSDB_ARCHIVE_CHUNK_SIZE) && (idvalue<lastid); j++, idvalue++) {
+				key = mmgui_smsdb_key_from_id(idvalue, smsid);
+				value = gdbm_fetch(db, key);
+				if (value.dptr == NULL) continue;
+				/*Legacy records are converted on open, so only binary ones are archived*/
+				if ((mmgui_smsdb_record_decode(value.dptr, value.dsize, &record)) && (record.timestamp < threshold)) {
+					entry.id = idvalue;
+					entry.month = mmgui_smsdb_archive_month(record.timestamp);
+					g_array_append_val(entries, entry);
+				}
+				free(value.dptr);
+			}
+			g_rec_mutex_unlock(&smsdb->dblock);
+		}
+		
+		g_array_sort(entries, mmgui_smsdb_archive_entry_compare);
+		
+		for (i=0; (i<entries->len) && (!g_atomic_int_get(&smsdb->archivecancel)); i+=MMGUI_SMSDB_ARCHIVE_CHUNK_SIZE) {
+			g_rec_mutex_lock(&smsdb->dblock);
+			segment = NULL;
+			for (j=i; (j<entries->len) && (j<i+MMGUI_SMSDB_ARCHIVE_CHUNK_SIZE); j++) {
+				curentry = &g_array_index(entries, struct _mmgui_smsdb_archive_entry, j);
+				if ((segment == NULL) || (segment->month != curentry->month)) {
+					if (segment != NULL) {
+						/*Hot copies are removed only after segment is synced*/
+						mmgui_smsdb_segment_close(segment);
+						for (k=0; k<moved->len; k++) {
+							mmgui_smsdb_record_delete(smsdb, g_array_index(moved, guint64, k), NULL);
+							mmgui_smsdb_batch_append(smsdb);
+						}
+						count += moved->len;
+						g_array_set_size(moved, 0);
+					}
+					segment = mmgui_smsdb_segment_get(smsdb, curentry->month, TRUE);
+					if (mmgui_smsdb_segment_open(segment, TRUE) == NULL) {
+						g_warning("Unable to open SMS archive segment for writing");
+						segment = NULL;
+						continue;
+					}
+				}
+				/*Message may be removed while lock was released*/
+				key = mmgui_smsdb_key_from_id(curentry->id, smsid);
+				value = gdbm_fetch(db, key);
+				if (value.dptr == NULL) continue;
+				/*Archive copy is keyed by id and replaced, so move interrupted before hot copy removal is repeated without duplicate*/
+				if (gdbm_store((GDBM_FILE)segment->handle, key, value, GDBM_REPLACE) == 0) {
+					if ((segment->firstid == 0) || (curentry->id < segment->firstid)) {
+						segment->firstid = curentry->id;
+					}
+					if (curentry->id > segment->lastid) {
+						segment->lastid = curentry->id;
+					}
+					g_array_append_val(moved, curentry->id);
+				}
+				free(value.dptr);
+			}
+			if (segment != NULL) {
+				mmgui_smsdb_segment_close(segment);
+				for (k=0; k<moved->len; k++) {
+					mmgui_smsdb_record_delete(smsdb, g_array_index(moved, guint64, k), NULL);
+					mmgui_smsdb_batch_append(smsdb);
+				}
+				count += moved->len;
+				g_array_set_size(moved, 0);
+			}
+			mmgui_smsdb_batch_commit(smsdb, TRUE);
+			g_rec_mutex_unlock(&smsdb->dblock);
+		}
+	}
+	
+	g_array_free(moved, TRUE);
+	g_array_free(entries, TRUE);
+	
+	/*Reorganization rewrites whole file, so it is left for next open instead of blocking readers*/
+	if (count > 0) {
+		g_rec_mutex_lock(&smsdb->dblock);
+		smsdb->metaflags |= MMGUI_SMSDB_META_FLAG_COMPACT;
+		if (mmgui_smsdb_meta_store(smsdb)) {
+			mmgui_smsdb_batch_append(smsdb);
+			mmgui_smsdb_batch_commit(smsdb, TRUE);
+		}
+		g_rec_mutex_unlock(&smsdb->dblock);
+	}
+	
+	g_debug("SMS archiver finished, %u messages archived\n", count);
+	
+	g_atomic_int_set(&smsdb->archiverunning, 0);
+	
+	return NULL;
+}
+
+static gint mmgui_smsdb_migrate_entry_compare(gconstpointer a, gconstpointer b)
+{
+	const struct _mmgui_smsdb_migrate_entry *entry1, *entry2;
+	
+	entry1 = (const struct _mmgui_smsdb_migrate_entry *)a;
+	entry2 = (const struct _mmgui_smsdb_migrate_entry *)b;
+	
+	if (entry1->timestamp < entry2->timestamp) {
+		return -1;
+	} else if (entry1->timestamp > entry2->timestamp) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+static gboolean mmgui_smsdb_format_migrate(smsdb_t smsdb)
+{
+	GDBM_FILE db;
+	GArray *entries;
+	struct _mmgui_smsdb_migrate_entry entry;
+	datum key, nextkey, data, newkey, lastdata;
+	mmgui_sms_message_t message;
+	gchar smsid[MMGUI_SMSDB_KEY_SIZE];
+	gchar *record;
+	gsize recordlen;
+	guint64 idvalue, lastid;
+	guint i, converted;
+	
+	db = (GDBM_FILE)smsdb->dbhandle;
+	
+	/*Records are already stored in binary form, only counters are missing*/
+	if (smsdb->formatversion >= MMGUI_SMSDB_FORMAT_RECORDS_VERSION) {
+		mmgui_smsdb_stats_rebuild(smsdb);
+		smsdb->formatversion = MMGUI_SMSDB_FORMAT_VERSION;
+		if (!mmgui_smsdb_meta_store(smsdb)) {
+			g_warning("Unable to write SMS database metadata");
+		}
+		gdbm_sync(db);
+		return FALSE;
+	}
+	
+	/*Keys are collected first because database must not be changed while traversed*/
+	entries = g_array_new(FALSE, TRUE, sizeof(struct _mmgui_smsdb_migrate_entry));
+	lastid = 0;
+	
+	key = gdbm_firstkey(db);
+	while (key.dptr != NULL) {
+		nextkey = gdbm_nextkey(db, key);
+		if (!mmgui_smsdb_key_is_meta(key)) {
+			message = NULL;
+			data = gdbm_fetch(db, key);
+			if (data.dptr != NULL) {
+				if ((mmgui_smsdb_key_to_id(key, &idvalue)) && ((guchar)data.dptr[0] == MMGUI_SMSDB_RECORD_MAGIC)) {
+					/*Converted by interrupted migration, identifiers continue after it*/
+					lastid = MAX(lastid, idvalue);
+				} else {
+					message = mmgui_smsdb_record_parse(data.dptr, data.dsize);
+				}
+				free(data.dptr);
+			}
+			if (message != NULL) {
+				entry.timestamp = (guint64)message->timestamp;
+				entry.key = key;
+				g_array_append_val(entries, entry);
+				mmgui_smsdb_message_free(message);
+			} else {
+				free(key.dptr);
+			}
+		} else {
+			free(key.dptr);
+		}
+		key = nextkey;
+	}
+	
+	/*Random legacy identifiers are replaced with sequential ones in arrival order*/
+	g_array_sort(entries, mmgui_smsdb_migrate_entry_compare);
+	
+	smsdb->nextid = lastid + 1;
+	smsdb->idceiling = smsdb->nextid;
+	
+	/*Interrupted run may have stored last record without deleting its legacy copy*/
+	lastdata.dptr = NULL;
+	lastdata.dsize = 0;
+	if (lastid > 0) {
+		lastdata = gdbm_fetch(db, mmgui_smsdb_key_from_id(lastid, smsid));
+	}
+	
+	converted = 0;
+	
+	for (i=0; i<entries->len; i++) {
+		entry = g_array_index(entries, struct _mmgui_smsdb_migrate_entry, i);
+		data = gdbm_fetch(db, entry.key);
+		if (data.dptr != NULL) {
+			message = mmgui_smsdb_record_parse(data.dptr, data.dsize);
+			free(data.dptr);
+			if (message != NULL) {
+				record = mmgui_smsdb_record_encode(message, &recordlen);
+				if (record != NULL) {
+					if ((lastdata.dptr != NULL) && (lastdata.dsize == recordlen) && (memcmp(lastdata.dptr, record, recordlen) == 0)) {
+						gdbm_delete(db, entry.key);
+						free(lastdata.dptr);
+						lastdata.dptr = NULL;
+						g_free(record);
+						mmgui_smsdb_message_free(message);
+						free(entry.key.dptr);
+						continue;
+					}
+					/*Occupied keys are skipped, so record is never stored over itself or other legacy record*/
+					newkey = mmgui_smsdb_key_from_id(smsdb->nextid, smsid);
+					while (gdbm_exists(db, newkey)) {
+						smsdb->nextid++;
+						newkey = mmgui_smsdb_key_from_id(smsdb->nextid, smsid);
+					}
+					data.dptr = record;
+					data.dsize = recordlen;
+					if (gdbm_store(db, newkey, data, GDBM_INSERT) == 0) {
+						gdbm_delete(db, entry.key);
+						smsdb->nextid++;
+						converted++;
+					}
+					g_free(record);
+				}
+				mmgui_smsdb_message_free(message);
+			}
+		}
+		free(entry.key.dptr);
+	}
+	
+	g_array_free(entries, TRUE);
+	
+	if (lastdata.dptr != NULL) {
+		free(lastdata.dptr);
+	}
+	
+	/*Format version is stored only after all records are converted*/
+	smsdb->formatversion = MMGUI_SMSDB_FORMAT_VERSION;
+	smsdb->idceiling = smsdb->nextid;
+	
+	mmgui_smsdb_stats_rebuild(smsdb);
+	
+	if (!mmgui_smsdb_meta_store(smsdb)) {
+		g_warning("Unable to write SMS database metadata");
+	}
+	
+	gdbm_sync(db);
+	
+	g_debug("SMS database converted to format %u, %u records updated\n", MMGUI_SMSDB_FORMAT_VERSION, converted);
+	
+	return TRUE;
+}
+
+static guint mmgui_smsdb_stats_folder(guint folder)
+{
+	/*Unknown folders are counted as incoming like in message API*/
+	if (folder >= MMGUI_SMSDB_SMS_FOLDERS_NUMBER) {
+		return MMGUI_SMSDB_SMS_FOLDER_INCOMING;
+	}
+	
+	return folder;
+}
+
+static void mmgui_smsdb_stats_update(smsdb_t smsdb, guint folder, gint totaldelta, gint unreaddelta)
+{
+	struct _mmgui_smsdb_folder_stats *stats;
+	
+	if ((totaldelta == 0) && (unreaddelta == 0)) return;
+	
+	stats = &smsdb->folderstats[mmgui_smsdb_stats_folder(folder)];
+	
+	if ((totaldelta >= 0) || (stats->total >= (guint)(-totaldelta))) {
+		stats->total += totaldelta;
+	} else {
+		stats->total = 0;
+	}
+	
+	if ((unreaddelta >= 0) || (stats->unread >= (guint)(-unreaddelta))) {
+		stats->unread += unreaddelta;
+		smsdb->unreadmessages += unreaddelta;
+	} else {
+		smsdb->unreadmessages -= stats->unread;
+		stats->unread = 0;
+	}
+	
+	/*Counters are written with the same batch as message record*/
+	if (!mmgui_smsdb_meta_store(smsdb)) {
+		g_warning("Unable to write SMS database metadata");
+	}
+}
+
+static void mmgui_smsdb_stats_rebuild_record(smsdb_t smsdb, guint64 id, datum data, gpointer userdata)
+{
+	struct _mmgui_smsdb_record record;
+	mmgui_sms_message_t message;
+	guint folder;
+	gboolean read;
+	
+	if (mmgui_smsdb_record_decode(data.dptr, data.dsize, &record)) {
+		folder = mmgui_smsdb_stats_folder(record.folder);
+		read = (record.flags & MMGUI_SMSDB_RECORD_FLAG_READ) != 0;
+		smsdb->folderstats[folder].total++;
+		if (!read) {
+			smsdb->folderstats[folder].unread++;
+			smsdb->unreadmessages++;
+		}
+	} else {
+		/*Legacy record with sequential key*/
+		message = mmgui_smsdb_xml_parse(data.dptr, data.dsize);
+		if (message != NULL) {
+			folder = mmgui_smsdb_stats_folder(message->folder);
+			smsdb->folderstats[folder].total++;
+			if (!message->read) {
+				smsdb->folderstats[folder].unread++;
+				smsdb->unreadmessages++;
+			}
+			mmgui_smsdb_message_free(message);
+		}
+	}
+	
+	free(data.dptr);
+}
+
+static void mmgui_smsdb_stats_rebuild(smsdb_t smsdb)
+{
+	memset(smsdb->folderstats, 0, sizeof(smsdb->folderstats));
+	smsdb->unreadmessages = 0;
+	
+	/*Archived messages are counted too*/
+	mmgui_smsdb_records_foreach(smsdb, mmgui_smsdb_stats_rebuild_record, NULL);
+	
+	g_debug("SMS database counters rebuilt, %u unread messages\n", smsdb->unreadmessages);
+}
+
+static void mmgui_smsdb_put_uint16(gchar *dest, guint16 value)
+{
+	value = GUINT16_TO_LE(value);
+	memcpy(dest, &value, sizeof(value));
+}
+
+static void mmgui_smsdb_put_uint32(gchar *dest, guint32 value)
+{
+	value = GUINT32_TO_LE(value);
+	memcpy(dest, &value, sizeof(value));
+}
+
+static void mmgui_smsdb_put_uint64(gchar *dest, guint64 value)
+{
+	value = GUINT64_TO_LE(value);
+	memcpy(dest, &value, sizeof(value));
+}
+
+static guint16 mmgui_smsdb_get_uint16(const gchar *src)
+{
+	guint16 value;
+	
+	memcpy(&value, src, sizeof(value));
+	
+	return GUINT16_FROM_LE(value);
+}
+
+static guint32 mmgui_smsdb_get_uint32(const gchar *src)
+{
+	guint32 value;
+	
+	memcpy(&value, src, sizeof(value));
+	
+	return GUINT32_FROM_LE(value);
+}
+
+static guint64 mmgui_smsdb_get_uint64(const gchar *src)
+{
+	guint64 value;
+	
+	memcpy(&value, src, sizeof(value));
+	
+	return GUINT64_FROM_LE(value);
+}
+
+static void mmgui_smsdb_hex_append(GString *string, const guchar *data, gsize len)
+{
+	static const gchar hexdigits[] = "0123456789abcdef";
+	gsize srclen, index;
+	
+	srclen = string->len;
+	
+	string = g_string_set_size(string, srclen + len*2);
+	
+	for (index=0; index<len; index++) {
+		string->str[srclen + index*2] = hexdigits[data[index] >> 4];
+		string->str[srclen + index*2 + 1] = hexdigits[data[index] & 0x0f];
+	}
+}
+
+static gboolean mmgui_smsdb_hex_validate(const gchar *hex, gsize len)
+{
+	gsize index;
+	
+	if ((len == 0) || (len % 2 != 0)) return FALSE;
+	
+	for (index=0; index<len; index++) {
+		if (!g_ascii_isxdigit(hex[index])) return FALSE;
+	}
+	
+	return TRUE;
+}
+
+static gchar *mmgui_smsdb_record_encode(mmgui_sms_message_t message, gsize *size)
+{
+	gchar *record, *text;
+	gsize numberlen, svcnumberlen, textlen, index;
+	guint8 flags;
+	
+	if ((message == NULL) || (message->number == NULL) || (message->text == NULL) || (size == NULL)) return NULL;
+	
+	numberlen = MIN(strlen(message->number), G_MAXUINT16);
+	
+	if (message->svcnumber != NULL) {
+		svcnumberlen = MIN(strlen(message->svcnumber), G_MAXUINT16);
+	} else {
+		svcnumberlen = 0;
+	}
+	
+	flags = 0;
+	
+	if (message->read) {
+		flags |= MMGUI_SMSDB_RECORD_FLAG_READ;
+	}
+	
+	if (message->binary) {
+		flags |= MMGUI_SMSDB_RECORD_FLAG_BINARY;
+		/*Binary payload is stored as raw bytes instead of hex string*/
+		if (mmgui_smsdb_hex_validate(message->text->str, message->text->len)) {
+			flags |= MMGUI_SMSDB_RECORD_FLAG_RAW;
+		}
+	}
+	
+	if (flags & MMGUI_SMSDB_RECORD_FLAG_RAW) {
+		textlen = message->text->len / 2;
+	} else {
+		textlen = message->text->len;
+	}
+	
+	*size = MMGUI_SMSDB_RECORD_HEADER_SIZE + numberlen + svcnumberlen + textlen;
+	
+	record = g_malloc(*size);
+	
+	record[MMGUI_SMSDB_RECORD_MAGIC_OFFSET] = (gchar)MMGUI_SMSDB_RECORD_MAGIC;
+	record[MMGUI_SMSDB_RECORD_VERSION_OFFSET] = MMGUI_SMSDB_RECORD_VERSION;
+	record[MMGUI_SMSDB_RECORD_FLAGS_OFFSET] = flags;
+	record[MMGUI_SMSDB_RECORD_FOLDER_OFFSET] = (guint8)message->folder;
+	mmgui_smsdb_put_uint64(record + MMGUI_SMSDB_RECORD_TIME_OFFSET, (guint64)message->timestamp);
+	mmgui_smsdb_put_uint16(record + MMGUI_SMSDB_RECORD_NUMBER_LEN_OFFSET, (guint16)numberlen);
+	mmgui_smsdb_put_uint16(record + MMGUI_SMSDB_RECORD_SVCNUMBER_LEN_OFFSET, (guint16)svcnumberlen);
+	mmgui_smsdb_put_uint32(record + MMGUI_SMSDB_RECORD_TEXT_LEN_OFFSET, (guint32)textlen);
+	
+	memcpy(record + MMGUI_SMSDB_RECORD_HEADER_SIZE, message->number, numberlen);
+	if (svcnumberlen > 0) {
+		memcpy(record + MMGUI_SMSDB_RECORD_HEADER_SIZE + numberlen, message->svcnumber, svcnumberlen);
+	}
+	
+	text = record + MMGUI_SMSDB_RECORD_HEADER_SIZE + numberlen + svcnumberlen;
+	
+	if (flags & MMGUI_SMSDB_RECORD_FLAG_RAW) {
+		for (index=0; index<textlen; index++) {
+			text[index] = (gchar)((g_ascii_xdigit_value(message->text->str[index*2]) << 4) | g_ascii_xdigit_value(message->text->str[index*2 + 1]));
+		}
+	} else {
+		memcpy(text, message->text->str, textlen);
+	}
+	
+	return record;
+}
+
+static gboolean mmgui_smsdb_record_decode(const gchar *data, gsize size, struct _mmgui_smsdb_record *record)
+{
+	gsize numberlen, svcnumberlen, textlen;
+	
+	if ((data == NULL) || (record == NULL)) return FALSE;
+	if (size < MMGUI_SMSDB_RECORD_HEADER_SIZE) return FALSE;
+	if ((guchar)data[MMGUI_SMSDB_RECORD_MAGIC_OFFSET] != MMGUI_SMSDB_RECORD_MAGIC) return FALSE;
+	if ((guchar)data[MMGUI_SMSDB_RECORD_VERSION_OFFSET] > MMGUI_SMSDB_RECORD_VERSION) return FALSE;
+	
+	numberlen = mmgui_smsdb_get_uint16(data + MMGUI_SMSDB_RECORD_NUMBER_LEN_OFFSET);
+	svcnumberlen = mmgui_smsdb_get_uint16(data + MMGUI_SMSDB_RECORD_SVCNUMBER_LEN_OFFSET);
+	textlen = mmgui_smsdb_get_uint32(data + MMGUI_SMSDB_RECORD_TEXT_LEN_OFFSET);
+	
+	if (MMGUI_SMSDB_RECORD_HEADER_SIZE + numberlen + svcnumberlen + textlen > size) return FALSE;
+	
+	record->version = (guchar)data[MMGUI_SMSDB_RECORD_VERSION_OFFSET];
+	record->flags = (guchar)data[MMGUI_SMSDB_RECORD_FLAGS_OFFSET];
+	record->folder = (guchar)data[MMGUI_SMSDB_RECORD_FOLDER_OFFSET];
+	record->timestamp = mmgui_smsdb_get_uint64(data + MMGUI_SMSDB_RECORD_TIME_OFFSET);
+	record->number = data + MMGUI_SMSDB_RECORD_HEADER_SIZE;
+	record->numberlen = numberlen;
+	record->svcnumber = record->number + numberlen;
+	record->svcnumberlen = svcnumberlen;
+	record->text = record->svcnumber + svcnumberlen;
+	record->textlen = textlen;
+	
+	return TRUE;
+}
+
+static mmgui_sms_message_t mmgui_smsdb_record_to_message(const struct _mmgui_smsdb_record *record)
+{
+	mmgui_sms_message_t message;
+	
+	if (record == NULL) return NULL;
+	
+	message = g_new(struct _mmgui_sms_message, 1);
+	
+	message->timestamp = (time_t)record->timestamp;
+	message->read = (record->flags & MMGUI_SMSDB_RECORD_FLAG_READ) != 0;
+	message->binary = (record->flags & MMGUI_SMSDB_RECORD_FLAG_BINARY) != 0;
+	message->folder = record->folder;
+	message->number = g_strndup(record->number, record->numberlen);
+	if (record->svcnumberlen > 0) {
+		message->svcnumber = g_strndup(record->svcnumber, record->svcnumberlen);
+	} else {
+		message->svcnumber = NULL;
+	}
+	message->idents = NULL;
+	message->dbid = 0;
+	
+	if (record->flags & MMGUI_SMSDB_RECORD_FLAG_RAW) {
+		message->text = g_string_sized_new(record->textlen*2+1);
+		mmgui_smsdb_hex_append(message->text, (const guchar *)record->text, record->textlen);
+	} else {
+		message->text = g_string_new_len(record->text, record->textlen);
+	}
+	
+	return message;
+}
+
+static mmgui_sms_message_t mmgui_smsdb_record_parse(gchar *data, gsize size)
+{
+	struct _mmgui_smsdb_record record;
+	
+	if ((data == NULL) || (size == 0)) return NULL;
+	
+	if ((guchar)data[0] == MMGUI_SMSDB_RECORD_MAGIC) {
+		if (!mmgui_smsdb_record_decode(data, size, &record)) return NULL;
+		return mmgui_smsdb_record_to_message(&record);
+	} else {
+		/*Legacy XML record*/
+		return mmgui_smsdb_xml_parse(data, size);
+	}
+}
+
+static gboolean mmgui_smsdb_index_open(smsdb_t smsdb, gboolean rebuild)
+{
+	GDBM_FILE idxdb;
+	gchar *dirpath, *indexpath;
+	datum key, data;
+	guint32 version, dirty;
+	gchar meta[MMGUI_SMSDB_INDEX_META_SIZE];
+	
+	dirpath = g_path_get_dirname(smsdb->filepath);
+	indexpath = g_build_filename(dirpath, "smsindex.gdbm", NULL);
+	g_free(dirpath);
+	
+	idxdb = gdbm_open(indexpath, 0, GDBM_WRCREAT, MMGUI_SMSDB_ACCESS_MASK, 0);
+	
+	if (idxdb == NULL) {
+		g_warning("Unable to open SMS index database: %s", indexpath);
+		g_free(indexpath);
+		return FALSE;
+	}
+	
+	version = 0;
+	dirty = 1;
+	
+	key.dptr = MMGUI_SMSDB_META_KEY;
+	key.dsize = strlen(MMGUI_SMSDB_META_KEY);
+	
+	data = gdbm_fetch(idxdb, key);
+	
+	if (data.dptr != NULL) {
+		if (data.dsize >= MMGUI_SMSDB_INDEX_META_SIZE) {
+			version = mmgui_smsdb_get_uint32(data.dptr + MMGUI_SMSDB_INDEX_META_VERSION_OFFSET);
+			dirty = mmgui_smsdb_get_uint32(data.dptr + MMGUI_SMSDB_INDEX_META_DIRTY_OFFSET);
+		}
+		free(data.dptr);
+	}
+	
+	/*Indexes are not trusted after crash or format change*/
+	if ((rebuild) || (version != MMGUI_SMSDB_INDEX_VERSION) || (dirty != 0)) {
+		gdbm_close(idxdb);
+		idxdb = gdbm_open(indexpath, 0, GDBM_NEWDB, MMGUI_SMSDB_ACCESS_MASK, 0);
+		if (idxdb == NULL) {
+			g_warning("Unable to recreate SMS index database: %s", indexpath);
+			g_free(indexpath);
+			return FALSE;
+		}
+		smsdb->indexhandle = (gpointer)idxdb;
+		mmgui_smsdb_index_rebuild(smsdb);
+	} else {
+		smsdb->indexhandle = (gpointer)idxdb;
+	}
+	
+	g_free(indexpath);
+	
+	/*Mark indexes as being changed until database is closed properly*/
+	memset(meta, 0, sizeof(meta));
+	mmgui_smsdb_put_uint32(meta + MMGUI_SMSDB_INDEX_META_VERSION_OFFSET, MMGUI_SMSDB_INDEX_VERSION);
+	mmgui_smsdb_put_uint32(meta + MMGUI_SMSDB_INDEX_META_DIRTY_OFFSET, 1);
+	
+	data.dptr = meta;
+	data.dsize = sizeof(meta);
+	
+	if (gdbm_store(idxdb, key, data, GDBM_REPLACE) == 0) {
+		gdbm_sync(idxdb);
+	}
+	
+	return TRUE;
+}
+
+static void mmgui_smsdb_index_close(smsdb_t smsdb)
+{
+	GDBM_FILE idxdb;
+	datum key, data;
+	gchar meta[MMGUI_SMSDB_INDEX_META_SIZE];
+	
+	if (smsdb->indexhandle == NULL) return;
+	
+	idxdb = (GDBM_FILE)smsdb->indexhandle;
+	
+	memset(meta, 0, sizeof(meta));
+	mmgui_smsdb_put_uint32(meta + MMGUI_SMSDB_INDEX_META_VERSION_OFFSET, MMGUI_SMSDB_INDEX_VERSION);
+	mmgui_smsdb_put_uint32(meta + MMGUI_SMSDB_INDEX_META_DIRTY_OFFSET, 0);
+	
+	key.dptr = MMGUI_SMSDB_META_KEY;
+	key.dsize = strlen(MMGUI_SMSDB_META_KEY);
+	data.dptr = meta;
+	data.dsize = sizeof(meta);
+	
+	if (gdbm_store(idxdb, key, data, GDBM_REPLACE) == 0) {
+		gdbm_sync(idxdb);
+	}
+	
+	gdbm_close(idxdb);
+	
+	smsdb->indexhandle = NULL;
+}
+
+static GArray *mmgui_smsdb_index_load(smsdb_t smsdb, const gchar *name, guint elemsize)
+{
+	GArray *array;
+	gpointer cachedname;
+	datum key, data;
+	guint64 *words;
+	guint i, count;
+	
+	/*Rebuild keeps all indexes in memory*/
+	if (smsdb->indexcache != NULL) {
+		if (g_hash_table_lookup_extended(smsdb->indexcache, name, &cachedname, (gpointer *)&array)) {
+			g_hash_table_steal(smsdb->indexcache, name);
+			g_free(cachedname);
+		} else {
+			array = g_array_new(FALSE, FALSE, elemsize);
+		}
+		return array;
+	}
+	
+	key.dptr = (gchar *)name;
+	key.dsize = strlen(name);
+	
+	data = gdbm_fetch((GDBM_FILE)smsdb->indexhandle, key);
+	
+	if (data.dptr == NULL) {
+		return g_array_new(FALSE, FALSE, elemsize);
+	}
+	
+	count = data.dsize / elemsize;
+	
+	array = g_array_sized_new(FALSE, FALSE, elemsize, count);
+	array = g_array_set_size(array, count);
+	memcpy(array->data, data.dptr, count * elemsize);
+	
+	free(data.dptr);
+	
+	/*Index values are stored as little-endian 64-bit words*/
+	words = (guint64 *)array->data;
+	for (i=0; i<count * (elemsize / sizeof(guint64)); i++) {
+		words[i] = GUINT64_FROM_LE(words[i]);
+	}
+	
+	return array;
+}
+
+static void mmgui_smsdb_index_save(smsdb_t smsdb, const gchar *name, GArray *array)
+{
+	datum key, data;
+	guint64 *words;
+	guint i, size;
+	
+	if (smsdb->indexcache != NULL) {
+		g_hash_table_replace(smsdb->indexcache, g_strdup(name), array);
+		return;
+	}
+	
+	key.dptr = (gchar *)name;
+	key.dsize = strlen(name);
+	
+	if (array->len == 0) {
+		gdbm_delete((GDBM_FILE)smsdb->indexhandle, key);
+		g_array_free(array, TRUE);
+		return;
+	}
+	
+	size = array->len * g_array_get_element_size(array);
+	
+	words = (guint64 *)array->data;
+	for (i=0; i<size / sizeof(guint64); i++) {
+		words[i] = GUINT64_TO_LE(words[i]);
+	}
+	
+	data.dptr = array->data;
+	data.dsize = size;
+	
+	if (gdbm_store((GDBM_FILE)smsdb->indexhandle, key, data, GDBM_REPLACE) == -1) {
+		g_warning("Unable to write SMS index");
+	}
+	
+	g_array_free(array, TRUE);
+}
+
+static guint mmgui_smsdb_index_id_search(GArray *array, guint64 id, gboolean *found)
+{
+	guint low, high, middle;
+	guint64 value;
+	
+	low = 0;
+	high = array->len;
+	
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		value = g_array_index(array, guint64, middle);
+		if (value < id) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	
+	*found = ((low < array->len) && (g_array_index(array, guint64, low) == id));
+	
+	return low;
+}
+
+static guint mmgui_smsdb_index_pair_search(GArray *array, guint64 first, guint64 second, gboolean *found)
+{
+	guint low, high, middle;
+	struct _mmgui_smsdb_index_pair *pair;
+	
+	low = 0;
+	high = array->len;
+	
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		pair = &g_array_index(array, struct _mmgui_smsdb_index_pair, middle);
+		if ((pair->first < first) || ((pair->first == first) && (pair->second < second))) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	
+	if (low < array->len) {
+		pair = &g_array_index(array, struct _mmgui_smsdb_index_pair, low);
+		*found = ((pair->first == first) && (pair->second == second));
+	} else {
+		*found = FALSE;
+	}
+	
+	return low;
+}
+
+static void mmgui_smsdb_index_update_id(smsdb_t smsdb, const gchar *name, guint64 id, gboolean insert)
+{
+	GArray *array;
+	guint position;
+	gboolean found;
+	
+	array = mmgui_smsdb_index_load(smsdb, name, sizeof(guint64));
+	
+	position = mmgui_smsdb_index_id_search(array, id, &found);
+	
+	if ((insert) && (!found)) {
+		array = g_array_insert_val(array, position, id);
+	} else if ((!insert) && (found)) {
+		array = g_array_remove_index(array, position);
+	}
+	
+	mmgui_smsdb_index_save(smsdb, name, array);
+}
+
+static void mmgui_smsdb_index_update_list(smsdb_t smsdb, const gchar *list, guint64 id, gboolean insert)
+{
+	gchar *name;
+	
+	name = g_strdup_printf(MMGUI_SMSDB_INDEX_LIST_BLOCK_KEY, list, id >> MMGUI_SMSDB_INDEX_LIST_BLOCK_SHIFT);
+	
+	mmgui_smsdb_index_update_id(smsdb, name, id, insert);
+	
+	g_free(name);
+}
+
+static guint64 mmgui_smsdb_index_list_last(smsdb_t smsdb, const gchar *list, guint64 block)
+{
+	GArray *ids;
+	gchar *name;
+	guint64 lastid;
+	
+	lastid = 0;
+	
+	/*Blocks are visited downwards until non-empty one found*/
+	while (lastid == 0) {
+		name = g_strdup_printf(MMGUI_SMSDB_INDEX_LIST_BLOCK_KEY, list, block);
+		ids = mmgui_smsdb_index_load(smsdb, name, sizeof(guint64));
+		if (ids->len > 0) {
+			lastid = g_array_index(ids, guint64, ids->len-1);
+		}
+		if (smsdb->indexcache != NULL) {
+			/*Rebuild cache owns loaded arrays*/
+			mmgui_smsdb_index_save(smsdb, name, ids);
+		} else {
+			g_array_free(ids, TRUE);
+		}
+		g_free(name);
+		if (block == 0) break;
+		block--;
+	}
+	
+	return lastid;
+}
+
+static void mmgui_smsdb_index_update_folder(smsdb_t smsdb, guint folder, guint64 timestamp, guint64 id, gboolean insert)
+{
+	GArray *array;
+	struct _mmgui_smsdb_index_pair pair, *bucketpair;
+	gchar name[64];
+	guint64 bucket;
+	guint position;
+	gboolean found, changed;
+	
+	bucket = timestamp >> MMGUI_SMSDB_INDEX_BUCKET_SHIFT;
+	
+	/*Time bucket with (timestamp, identifier) pairs*/
+	g_snprintf(name, sizeof(name), MMGUI_SMSDB_INDEX_FOLDER_KEY, folder, bucket);
+	
+	array = mmgui_smsdb_index_load(smsdb, name, sizeof(struct _mmgui_smsdb_index_pair));
+	
+	position = mmgui_smsdb_index_pair_search(array, timestamp, id, &found);
+	
+	changed = FALSE;
+	
+	if ((insert) && (!found)) {
+		pair.first = timestamp;
+		pair.second = id;
+		array = g_array_insert_val(array, position, pair);
+		changed = TRUE;
+	} else if ((!insert) && (found)) {
+		array = g_array_remove_index(array, position);
+		changed = TRUE;
+	}
+	
+	mmgui_smsdb_index_save(smsdb, name, array);
+	
+	if (!changed) return;
+	
+	/*Folder directory with (bucket, messages count) pairs*/
+	g_snprintf(name, sizeof(name), MMGUI_SMSDB_INDEX_DIRECTORY_KEY, folder);
+	
+	array = mmgui_smsdb_index_load(smsdb, name, sizeof(struct _mmgui_smsdb_index_pair));
+	
+	position = mmgui_smsdb_index_pair_search(array, bucket, 0, &found);
+	
+	if ((position < array->len) && (g_array_index(array, struct _mmgui_smsdb_index_pair, position).first == bucket)) {
+		bucketpair = &g_array_index(array, struct _mmgui_smsdb_index_pair, position);
+		if (insert) {
+			bucketpair->second++;
+		} else if (bucketpair->second > 1) {
+			bucketpair->second--;
+		} else {
+			array = g_array_remove_index(array, position);
+		}
+	} else if (insert) {
+		pair.first = bucket;
+		pair.second = 1;
+		array = g_array_insert_val(array, position, pair);
+	}
+	
+	mmgui_smsdb_index_save(smsdb, name, array);
+}
+
+static void mmgui_smsdb_index_update_text(smsdb_t smsdb, guint64 id, const struct _mmgui_smsdb_record *record, gboolean insert)
+{
+	GHashTable *trigrams;
+	GHashTableIter iter;
+	gpointer trigram;
+	gchar *normalized;
+	gchar name[64];
+	
+	trigrams = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	
+	/*Sender number is searchable too*/
+	normalized = mmgui_smsdb_text_normalize(record->number, record->numberlen);
+	if (normalized != NULL) {
+		mmgui_smsdb_text_trigrams(normalized, trigrams);
+		g_free(normalized);
+	}
+	
+	/*Binary payload is not searchable*/
+	if (!(record->flags & MMGUI_SMSDB_RECORD_FLAG_BINARY)) {
+		normalized = mmgui_smsdb_text_normalize(record->text, record->textlen);
+		if (normalized != NULL) {
+			mmgui_smsdb_text_trigrams(normalized, trigrams);
+			g_free(normalized);
+		}
+	}
+	
+	g_hash_table_iter_init(&iter, trigrams);
+	while (g_hash_table_iter_next(&iter, &trigram, NULL)) {
+		g_snprintf(name, sizeof(name), MMGUI_SMSDB_INDEX_TEXT_KEY, (const gchar *)trigram, id >> MMGUI_SMSDB_INDEX_TEXT_BLOCK_SHIFT);
+		mmgui_smsdb_index_update_id(smsdb, name, id, insert);
+	}
+	
+	g_hash_table_destroy(trigrams);
+}
+
+static void mmgui_smsdb_index_update_thread(smsdb_t smsdb, guint64 id, const struct _mmgui_smsdb_record *record, gboolean insert)
+{
+	GArray *ids, *summary;
+	gchar *threadkey, *list, *name;
+	datum data;
+	struct _mmgui_smsdb_record lastrecord;
+	guint64 *words, lastid, timestamp;
+	guint position;
+	gboolean found;
+	
+	threadkey = mmgui_smsdb_thread_key(record->number, record->numberlen);
+	list = g_strdup_printf(MMGUI_SMSDB_INDEX_THREAD_KEY, threadkey);
+	
+	/*Thread messages in arrival order*/
+	name = g_strdup_printf(MMGUI_SMSDB_INDEX_LIST_BLOCK_KEY, list, id >> MMGUI_SMSDB_INDEX_LIST_BLOCK_SHIFT);
+	ids = mmgui_smsdb_index_load(smsdb, name, sizeof(guint64));
+	position = mmgui_smsdb_index_id_search(ids, id, &found);
+	
+	/*Summary is changed only if message list changed, so rebuild may visit record twice*/
+	if (insert == found) {
+		mmgui_smsdb_index_save(smsdb, name, ids);
+		g_free(name);
+		g_free(list);
+		g_free(threadkey);
+		return;
+	}
+	
+	if (insert) {
+		ids = g_array_insert_val(ids, position, id);
+	} else {
+		ids = g_array_remove_index(ids, position);
+	}
+	
+	mmgui_smsdb_index_save(smsdb, name, ids);
+	g_free(name);
+	
+	name = g_strdup_printf(MMGUI_SMSDB_INDEX_THREAD_SUMMARY_KEY, threadkey);
+	summary = mmgui_smsdb_index_load(smsdb, name, sizeof(guint64));
+	if (summary->len < MMGUI_SMSDB_THREAD_SUMMARY_SIZE) {
+		summary = g_array_set_size(summary, MMGUI_SMSDB_THREAD_SUMMARY_SIZE);
+		memset(summary->data, 0, MMGUI_SMSDB_THREAD_SUMMARY_SIZE * sizeof(guint64));
+	}
+	words = (guint64 *)summary->data;
+	
+	/*Earlier blocks are read only when last message of thread is removed*/
+	if (insert) {
+		lastid = MAX(words[MMGUI_SMSDB_THREAD_SUMMARY_LAST_ID], id);
+	} else if (id == words[MMGUI_SMSDB_THREAD_SUMMARY_LAST_ID]) {
+		lastid = mmgui_smsdb_index_list_last(smsdb, list, id >> MMGUI_SMSDB_INDEX_LIST_BLOCK_SHIFT);
+	} else {
+		lastid = words[MMGUI_SMSDB_THREAD_SUMMARY_LAST_ID];
+	}
+	
+	if (insert) {
+		words[MMGUI_SMSDB_THREAD_SUMMARY_TOTAL]++;
+		if (!(record->flags & MMGUI_SMSDB_RECORD_FLAG_READ)) {
+			words[MMGUI_SMSDB_THREAD_SUMMARY_UNREAD]++;
+		}
+	} else {
+		if (words[MMGUI_SMSDB_THREAD_SUMMARY_TOTAL] > 0) {
+			words[MMGUI_SMSDB_THREAD_SUMMARY_TOTAL]--;
+		}
+		if ((!(record->flags & MMGUI_SMSDB_RECORD_FLAG_READ)) && (words[MMGUI_SMSDB_THREAD_SUMMARY_UNREAD] > 0)) {
+			words[MMGUI_SMSDB_THREAD_SUMMARY_UNREAD]--;
+		}
+	}
+	
+	/*Directory holds last message identifier of every thread*/
+	if (lastid != words[MMGUI_SMSDB_THREAD_SUMMARY_LAST_ID]) {
+		if (words[MMGUI_SMSDB_THREAD_SUMMARY_LAST_ID] != 0) {
+			mmgui_smsdb_index_update_id(smsdb, MMGUI_SMSDB_INDEX_THREAD_DIRECTORY_KEY, words[MMGUI_SMSDB_THREAD_SUMMARY_LAST_ID], FALSE);
+		}
+		if (lastid != 0) {
+			mmgui_smsdb_index_update_id(smsdb, MMGUI_SMSDB_INDEX_THREAD_DIRECTORY_KEY, lastid, TRUE);
+		}
+		if (lastid == id) {
+			timestamp = record->timestamp;
+		} else {
+			/*Previous message becomes last one*/
+			timestamp = 0;
+			if (lastid != 0) {
+				data = mmgui_smsdb_record_fetch(smsdb, lastid, NULL);
+				if (data.dptr != NULL) {
+					if (mmgui_smsdb_record_decode(data.dptr, data.dsize, &lastrecord)) {
+						timestamp = lastrecord.timestamp;
+					}
+					free(data.dptr);
+				}
+			}
+		}
+		words[MMGUI_SMSDB_THREAD_SUMMARY_LAST_ID] = lastid;
+		words[MMGUI_SMSDB_THREAD_SUMMARY_TIMESTAMP] = timestamp;
+	}
+	
+	/*Empty summary is removed*/
+	if (lastid == 0) {
+		summary = g_array_set_size(summary, 0);
+	}
+	
+	mmgui_smsdb_index_save(smsdb, name, summary);
+	
+	g_free(name);
+	g_free(list);
+	g_free(threadkey);
+}
+
+static void mmgui_smsdb_index_update_thread_unread(smsdb_t smsdb, const struct _mmgui_smsdb_record *record, gint unreaddelta)
+{
+	GArray *summary;
+	gchar *threadkey, *name;
+	guint64 *words;
+	
+	if ((smsdb->indexhandle == NULL) || (record == NULL) || (unreaddelta == 0)) return;
+	
+	threadkey = mmgui_smsdb_thread_key(record->number, record->numberlen);
+	name = g_strdup_printf(MMGUI_SMSDB_INDEX_THREAD_SUMMARY_KEY, threadkey);
+	
+	summary = mmgui_smsdb_index_load(smsdb, name, sizeof(guint64));
+	
+	if (summary->len >= MMGUI_SMSDB_THREAD_SUMMARY_SIZE) {
+		words = (guint64 *)summary->data;
+		if ((unreaddelta > 0) || (words[MMGUI_SMSDB_THREAD_SUMMARY_UNREAD] >= (guint64)(-unreaddelta))) {
+			words[MMGUI_SMSDB_THREAD_SUMMARY_UNREAD] += unreaddelta;
+		} else {
+			words[MMGUI_SMSDB_THREAD_SUMMARY_UNREAD] = 0;
+		}
+	}
+	
+	mmgui_smsdb_index_save(smsdb, name, summary);
+	
+	g_free(name);
+	g_free(threadkey);
+}
+
+static void mmgui_smsdb_index_update_message(smsdb_t smsdb, guint64 id, const struct _mmgui_smsdb_record *record, gboolean insert)
+{
+	if ((smsdb->indexhandle == NULL) || (record == NULL)) return;
+	
+	mmgui_smsdb_index_update_folder(smsdb, record->folder, record->timestamp, id, insert);
+	
+	if (!(record->flags & MMGUI_SMSDB_RECORD_FLAG_READ)) {
+		mmgui_smsdb_index_update_list(smsdb, MMGUI_SMSDB_INDEX_UNREAD_KEY, id, insert);
+	}
+	
+	mmgui_smsdb_index_update_text(smsdb, id, record, insert);
+	
+	mmgui_smsdb_index_update_thread(smsdb, id, record, insert);
+}
+
+static void mmgui_smsdb_index_rebuild_record(smsdb_t smsdb, guint64 id, datum data, gpointer userdata)
+{
+	struct _mmgui_smsdb_record record;
+	
+	if (mmgui_smsdb_record_decode(data.dptr, data.dsize, &record)) {
+		mmgui_smsdb_index_update_message(smsdb, id, &record, TRUE);
+		(*(guint *)userdata)++;
+	}
+	
+	free(data.dptr);
+}
+
+static void mmgui_smsdb_index_rebuild(smsdb_t smsdb)
+{
+	GHashTable *indexcache;
+	GHashTableIter iter;
+	gpointer name, array;
+	guint count;
+	
+	/*Indexes are accumulated in memory and written once*/
+	smsdb->indexcache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, mmgui_smsdb_index_cache_destroy);
+	
+	count = 0;
+	
+	/*Archived messages stay searchable*/
+	mmgui_smsdb_records_foreach(smsdb, mmgui_smsdb_index_rebuild_record, &count);
+	
+	indexcache = smsdb->indexcache;
+	smsdb->indexcache = NULL;
+	
+	g_hash_table_iter_init(&iter, indexcache);
+	while (g_hash_table_iter_next(&iter, &name, &array)) {
+		/*Array is freed after being written*/
+		mmgui_smsdb_index_save(smsdb, (const gchar *)name, (GArray *)array);
+		g_hash_table_iter_steal(&iter);
+		g_free(name);
+	}
+	
+	g_hash_table_destroy(indexcache);
+	
+	gdbm_sync((GDBM_FILE)smsdb->indexhandle);
+	
+	g_debug("SMS indexes rebuilt for %u messages\n", count);
+}
+
+static void mmgui_smsdb_index_cache_destroy(gpointer data)
+{
+	if (data != NULL) {
+		g_array_free((GArray *)data, TRUE);
+	}
+}
+
+static void mmgui_smsdb_index_intersect(GArray *array, GArray *other)
+{
+	guint i, j, count;
+	guint64 value, othervalue;
+	
+	i = 0;
+	j = 0;
+	count = 0;
+	
+	/*Both arrays are sorted, result is written in place*/
+	while ((i < array->len) && (j < other->len)) {
+		value = g_array_index(array, guint64, i);
+		othervalue = g_array_index(other, guint64, j);
+		if (value < othervalue) {
+			i++;
+		} else if (value > othervalue) {
+			j++;
+		} else {
+			g_array_index(array, guint64, count) = value;
+			count++;
+			i++;
+			j++;
+		}
+	}
+	
+	g_array_set_size(array, count);
+}
+
+static gchar *mmgui_smsdb_text_normalize(const gchar *text, gsize len)
+{
+	gchar *normalized, *folded, *pointer;
+	GString *result;
+	gunichar character;
+	
+	if ((text == NULL) || (len == 0)) return NULL;
+	
+	/*NFKC keeps accented letters whole, so no combining mark splits a word*/
+	normalized = g_utf8_normalize(text, len, G_NORMALIZE_ALL_COMPOSE);
+	
+	if (normalized == NULL) return NULL;
+	
+	folded = g_utf8_casefold(normalized, -1);
+	
+	g_free(normalized);
+	
+	/*Everything except letters and digits separates tokens*/
+	result = g_string_sized_new(strlen(folded));
+	
+	for (pointer=folded; *pointer != '\0'; pointer=g_utf8_next_char(pointer)) {
+		character = g_utf8_get_char(pointer);
+		if (g_unichar_isalnum(character)) {
+			g_string_append_unichar(result, character);
+		} else if ((result->len > 0) && (result->str[result->len-1] != ' ')) {
+			g_string_append_c(result, ' ');
+		}
+	}
+	
+	g_free(folded);
+	
+	return g_string_free(result, FALSE);
+}
+
+static void mmgui_smsdb_text_trigrams(const gchar *normalized, GHashTable *trigrams)
+{
+	const gchar *start, *end;
+	gint i;
+	
+	/*Trigrams never cross token boundaries*/
+	for (start=normalized; *start != '\0'; start=g_utf8_next_char(start)) {
+		end = start;
+		for (i=0; i<MMGUI_SMSDB_INDEX_TEXT_GRAM; i++) {
+			if ((*end == '\0') || (*end == ' ')) break;
+			end = g_utf8_next_char(end);
+		}
+		if (i == MMGUI_SMSDB_INDEX_TEXT_GRAM) {
+			g_hash_table_add(trigrams, g_strndup(start, end - start));
+		}
+	}
+}
+
+static gchar *mmgui_smsdb_thread_key(const gchar *number, gsize len)
+{
+	GString *key;
+	gsize i;
+	
+	if ((number == NULL) || (len == 0)) return g_strdup("");
+	
+	/*Phone number formatting is ignored: '+7 (916) 123-45-67' equals '79161234567'*/
+	key = g_string_sized_new(len);
+	
+	for (i=0; i<len; i++) {
+		if (g_ascii_isdigit(number[i])) {
+			g_string_append_c(key, number[i]);
+		} else if (strchr("+-(). ", number[i]) == NULL) {
+			break;
+		}
+	}
+	
+	if ((i == len) && (key->len > 0)) {
+		return g_string_free(key, FALSE);
+	}
+	
+	g_string_free(key, TRUE);
+	
+	/*Alphanumeric senders are compared case-insensitively*/
+	return g_utf8_casefold(number, len);
+}
+
+static gboolean mmgui_smsdb_search_match(smsdb_t smsdb, guint64 id, gchar **tokens)
+{
+	datum data;
+	struct _mmgui_smsdb_record record;
+	gchar *number, *text;
+	gboolean matched;
+	gint i;
+	
+	data = mmgui_smsdb_record_fetch(smsdb, id, NULL);
+	
+	if (data.dptr == NULL) return FALSE;
+	
+	matched = FALSE;
+	
+	if (mmgui_smsdb_record_decode(data.dptr, data.dsize, &record)) {
+		number = mmgui_smsdb_text_normalize(record.number, record.numberlen);
+		if (!(record.flags & MMGUI_SMSDB_RECORD_FLAG_BINARY)) {
+			text = mmgui_smsdb_text_normalize(record.text, record.textlen);
+		} else {
+			text = NULL;
+		}
+		/*Every query token must be found in number or text*/
+		matched = TRUE;
+		for (i=0; tokens[i] != NULL; i++) {
+			if (tokens[i][0] == '\0') continue;
+			if ((number != NULL) && (strstr(number, tokens[i]) != NULL)) continue;
+			if ((text != NULL) && (strstr(text, tokens[i]) != NULL)) continue;
+			matched = FALSE;
+			break;
+		}
+		g_free(number);
+		g_free(text);
+	}
+	
+	free(data.dptr);
+	
+	return matched;
+}
+
+static mmgui_sms_message_t mmgui_smsdb_xml_parse(gchar *xml, gsize size)
+{
+	mmgui_sms_message_t message;
+	struct _mmgui_smsdb_xml_state state;
 	GMarkupParser mp;
 	GMarkupParseContext *mpc;
 	GError *error = NULL;
@@ -810,6 +3428,7 @@ static mmgui_sms_message_t mmgui_smsdb_xml_parse(gchar *xml, gsize size)
 	message->svcnumber = NULL;
 	message->idents = NULL;
 	message->text = NULL;
+	message->dbid = 0;
 		
 	mp.start_element = mmgui_smsdb_xml_get_element;
 	mp.end_element = mmgui_smsdb_xml_end_element;
@@ -817,7 +3436,10 @@ static mmgui_sms_message_t mmgui_smsdb_xml_parse(gchar *xml, gsize size)
 	mp.passthrough = NULL;
 	mp.error = NULL;
 	
-	mpc = g_markup_parse_context_new(&mp, 0, (gpointer)message, NULL);
+	state.message = message;
+	state.parameter = MMGUI_SMSDB_XML_PARAM_NULL;
+	
+	mpc = g_markup_parse_context_new(&mp, 0, (gpointer)&state, NULL);
 	g_markup_parse_context_parse(mpc, xml, size, &error);
 	if (error != NULL) {
 		//g_warning(error->message);
@@ -832,35 +3454,41 @@ static mmgui_sms_message_t mmgui_smsdb_xml_parse(gchar *xml, gsize size)
 
 static void mmgui_smsdb_xml_get_element(GMarkupParseContext *context, const gchar *element, const gchar **attr_names, const gchar **attr_values, gpointer data, GError **error)
 {
+	struct _mmgui_smsdb_xml_state *state;
+	
+	state = (struct _mmgui_smsdb_xml_state *)data;
+	
 	if (g_str_equal(element, "number")) {
-		mmgui_smsdb_xml_parameter = MMGUI_SMSDB_XML_PARAM_NUMBER;
+		state->parameter = MMGUI_SMSDB_XML_PARAM_NUMBER;
 	} else if (g_str_equal(element, "time")) {
-		mmgui_smsdb_xml_parameter = MMGUI_SMSDB_XML_PARAM_TIME;
+		state->parameter = MMGUI_SMSDB_XML_PARAM_TIME;
 	} else if (g_str_equal(element, "binary")) {
-		mmgui_smsdb_xml_parameter = MMGUI_SMSDB_XML_PARAM_BINARY;
+		state->parameter = MMGUI_SMSDB_XML_PARAM_BINARY;
 	} else if (g_str_equal(element, "servicenumber")) {
-		mmgui_smsdb_xml_parameter = MMGUI_SMSDB_XML_PARAM_SERVICENUMBER;
+		state->parameter = MMGUI_SMSDB_XML_PARAM_SERVICENUMBER;
 	} else if (g_str_equal(element, "text")) {
-		mmgui_smsdb_xml_parameter = MMGUI_SMSDB_XML_PARAM_TEXT;
+		state->parameter = MMGUI_SMSDB_XML_PARAM_TEXT;
 	} else if (g_str_equal(element, "read")) {
-		mmgui_smsdb_xml_parameter = MMGUI_SMSDB_XML_PARAM_READ;
+		state->parameter = MMGUI_SMSDB_XML_PARAM_READ;
 	} else if (g_str_equal(element, "folder")) {
-		mmgui_smsdb_xml_parameter = MMGUI_SMSDB_XML_PARAM_FOLDER;
+		state->parameter = MMGUI_SMSDB_XML_PARAM_FOLDER;
 	} else {
-		mmgui_smsdb_xml_parameter = MMGUI_SMSDB_XML_PARAM_NULL;
+		state->parameter = MMGUI_SMSDB_XML_PARAM_NULL;
 	}
 }
 
 static void mmgui_smsdb_xml_get_value(GMarkupParseContext *context, const gchar *text, gsize size, gpointer data, GError **error)
 {
+	struct _mmgui_smsdb_xml_state *state;
 	mmgui_sms_message_t message;
 	gchar *numescstr, *textescstr;
-		
-	message = (mmgui_sms_message_t)data;
 	
-	if (mmgui_smsdb_xml_parameter == MMGUI_SMSDB_XML_PARAM_NULL) return;
+	state = (struct _mmgui_smsdb_xml_state *)data;
+	message = state->message;
+	
+	if (state->parameter == MMGUI_SMSDB_XML_PARAM_NULL) return;
 	
-	switch (mmgui_smsdb_xml_parameter) {
+	switch (state->parameter) {
 		case MMGUI_SMSDB_XML_PARAM_NUMBER:
 			numescstr = encoding_unescape_xml_markup(text, size);
 			if (numescstr != NULL) {
@@ -908,7 +3536,11 @@ static void mmgui_smsdb_xml_get_value(GMarkupParseContext *context, const gchar
 
 static void mmgui_smsdb_xml_end_element(GMarkupParseContext *context, const gchar *element, gpointer data, GError **error)
 {
+	struct _mmgui_smsdb_xml_state *state;
+	
+	state = (struct _mmgui_smsdb_xml_state *)data;
+	
 	if (!g_str_equal(element, "sms")) {
-		mmgui_smsdb_xml_parameter = MMGUI_SMSDB_XML_PARAM_NULL;
+		state->parameter = MMGUI_SMSDB_XML_PARAM_NULL;
 	}
 }
@@ -26,9 +26,41 @@ enum _mmgui_smsdb_sms_folder {
 	MMGUI_SMSDB_SMS_FOLDER_DRAFTS
 };
 
+#define MMGUI_SMSDB_SMS_FOLDERS_NUMBER 3
+
+/*Persistent per-folder counters*/
+struct _mmgui_smsdb_folder_stats {
+	guint total;
+	guint unread;
+};
+
 struct _smsdb {
 	const gchar *filepath;
 	guint unreadmessages;
+	/*Long-lived database handle*/
+	gpointer dbhandle;
+	guint formatversion;
+	/*Sequential message identifiers*/
+	guint64 nextid;
+	guint64 idceiling;
+	guint metaflags;
+	struct _mmgui_smsdb_folder_stats folderstats[MMGUI_SMSDB_SMS_FOLDERS_NUMBER];
+	/*Secondary indexes*/
+	gpointer indexhandle;
+	GHashTable *indexcache;
+	/*Write-behind batch*/
+	guint pendingwrites;
+	gint64 pendingsince;
+	guint flushtimeout;
+	/*Read-only monthly archive segments*/
+	GPtrArray *segments;
+	/*Background archiver shares database handles*/
+	GRecMutex dblock;
+	GThread *archivethread;
+	gint archiverunning;
+	gint archivecancel;
+	guint archivemonths;
+	gboolean archivestarted;
 };
 
 typedef struct _smsdb *smsdb_t;
@@ -38,7 +70,7 @@ struct _mmgui_sms_message {
 	gchar *svcnumber;
 	GArray *idents;
 	GString *text;
-	gulong dbid;
+	guint64 dbid;
 	gboolean read;
 	gboolean binary;
 	guint folder;
@@ -47,8 +79,33 @@ struct _mmgui_sms_message {
 
 typedef struct _mmgui_sms_message *mmgui_sms_message_t;
 
+/*Conversation with one sender*/
+struct _mmgui_sms_thread {
+	gchar *number;
+	gchar *key;
+	gchar *preview;
+	guint64 lastid;
+	time_t timestamp;
+	guint unread;
+	guint total;
+};
+
+typedef struct _mmgui_sms_thread *mmgui_sms_thread_t;
+
+/*Raw database record waiting to be decoded*/
+struct _mmgui_smsdb_raw_record {
+	gchar *data;
+	gsize size;
+	guint64 dbid;
+	mmgui_sms_message_t message;
+};
+
+typedef mmgui_sms_message_t (*mmgui_smsdb_decode_func)(gchar *data, gsize size);
+
 smsdb_t mmgui_smsdb_open(const gchar *persistentid, const gchar *internalid);
 gboolean mmgui_smsdb_close(smsdb_t smsdb);
+gboolean mmgui_smsdb_flush(smsdb_t smsdb);
+gboolean mmgui_smsdb_archive(smsdb_t smsdb, guint months);
 /*Message functions*/
 mmgui_sms_message_t mmgui_smsdb_message_create(void);
 void mmgui_smsdb_message_free(mmgui_sms_message_t message);
@@ -69,14 +126,27 @@ gboolean mmgui_smsdb_message_set_folder(mmgui_sms_message_t message, enum _mmgui
 enum _mmgui_smsdb_sms_folder mmgui_smsdb_message_get_folder(mmgui_sms_message_t message);
 gboolean mmgui_smsdb_message_set_binary(mmgui_sms_message_t message, gboolean binary);
 gboolean mmgui_smsdb_message_get_binary(mmgui_sms_message_t message);
-gulong mmgui_smsdb_message_get_db_identifier(mmgui_sms_message_t message);
+guint64 mmgui_smsdb_message_get_db_identifier(mmgui_sms_message_t message);
 /*General functions*/
 guint mmgui_smsdb_get_unread_messages(smsdb_t smsdb);
+gboolean mmgui_smsdb_get_folder_stats(smsdb_t smsdb, enum _mmgui_smsdb_sms_folder folder, guint *total, guint *unread);
 gboolean mmgui_smsdb_add_sms(smsdb_t smsdb, mmgui_sms_message_t message);
 GSList *mmgui_smsdb_read_sms_list(smsdb_t smsdb);
+GSList *mmgui_smsdb_read_sms_range(smsdb_t smsdb, guint64 firstid, guint64 lastid);
+GSList *mmgui_smsdb_read_sms_page(smsdb_t smsdb, enum _mmgui_smsdb_sms_folder folder, guint offset, guint limit);
+GSList *mmgui_smsdb_read_sms_by_number(smsdb_t smsdb, const gchar *number);
+GSList *mmgui_smsdb_read_unread_sms_list(smsdb_t smsdb);
+GArray *mmgui_smsdb_search_sms(smsdb_t smsdb, const gchar *query, guint limit);
+/*Conversation functions*/
+GSList *mmgui_smsdb_read_thread_list(smsdb_t smsdb);
+mmgui_sms_thread_t mmgui_smsdb_read_thread(smsdb_t smsdb, const gchar *number);
+GSList *mmgui_smsdb_read_thread_messages(smsdb_t smsdb, const gchar *number);
+void mmgui_smsdb_thread_free(mmgui_sms_thread_t thread);
+void mmgui_smsdb_thread_free_list(GSList *threadlist);
 void mmgui_smsdb_message_free_list(GSList *smslist);
-mmgui_sms_message_t mmgui_smsdb_read_sms_message(smsdb_t smsdb, gulong idvalue);
-gboolean mmgui_smsdb_remove_sms_message(smsdb_t smsdb, gulong idvalue);
-gboolean mmgui_smsdb_set_message_read_status(smsdb_t smsdb, gulong idvalue, gboolean readflag);
+void mmgui_smsdb_decode_records(GArray *records, mmgui_smsdb_decode_func decodefunc);
+mmgui_sms_message_t mmgui_smsdb_read_sms_message(smsdb_t smsdb, guint64 idvalue);
+gboolean mmgui_smsdb_remove_sms_message(smsdb_t smsdb, guint64 idvalue);
+gboolean mmgui_smsdb_set_message_read_status(smsdb_t smsdb, guint64 idvalue, gboolean readflag);
 
 #endif /* __SMSDB_H__ */
@@ -0,0 +1,268 @@
+/*
+ *      speedhistory.c
+ *      
+ *      Copyright 2026 Alex <alex@linuxonly.ru>
+ *      
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <glib.h>
+
+#include "speedhistory.h"
+
+static guint mmgui_speed_history_bucket(gfloat value);
+static gfloat mmgui_speed_history_bucket_limit(guint bucket);
+static void mmgui_speed_history_queue_push(mmgui_speed_history_t history, struct _mmgui_speed_history_queue *queue, guint direction, gboolean minimum);
+static void mmgui_speed_history_publish(mmgui_speed_history_t history);
+
+
+mmgui_speed_history_t mmgui_speed_history_new(guint length)
+{
+	mmgui_speed_history_t history;
+	guint i;
+	
+	history = g_new0(struct _mmgui_speed_history, 1);
+	
+	history->length = CLAMP(length, MMGUI_SPEED_HISTORY_MIN_LENGTH, MMGUI_SPEED_HISTORY_MAX_LENGTH);
+	
+	for (i=0; i<MMGUI_SPEED_HISTORY_DIRECTIONS; i++) {
+		history->values[i] = g_new0(gfloat, history->length);
+		history->minqueue[i].sequence = g_new0(guint64, history->length);
+		history->maxqueue[i].sequence = g_new0(guint64, history->length);
+	}
+	
+	return history;
+}
+
+void mmgui_speed_history_free(mmgui_speed_history_t history)
+{
+	guint i;
+	
+	if (history == NULL) return;
+	
+	for (i=0; i<MMGUI_SPEED_HISTORY_DIRECTIONS; i++) {
+		g_free(history->values[i]);
+		g_free(history->minqueue[i].sequence);
+		g_free(history->maxqueue[i].sequence);
+	}
+	
+	g_free(history);
+}
+
+guint mmgui_speed_history_get_length(mmgui_speed_history_t history)
+{
+	if (history == NULL) return 0;
+	
+	return history->length;
+}
+
+void mmgui_speed_history_append(mmgui_speed_history_t history, gfloat rxspeed, gfloat txspeed)
+{
+	struct _mmgui_speed_history_queue *queue;
+	gfloat values[MMGUI_SPEED_HISTORY_DIRECTIONS];
+	gfloat oldvalue;
+	guint position, direction;
+	
+	if (history == NULL) return;
+	
+	values[MMGUI_SPEED_HISTORY_RX] = MAX(rxspeed, 0.0);
+	values[MMGUI_SPEED_HISTORY_TX] = MAX(txspeed, 0.0);
+	
+	position = (guint)(history->written % history->length);
+	
+	/*Readers retry while sequence is odd*/
+	g_atomic_int_inc(&history->sequence);
+	
+	for (direction=0; direction<MMGUI_SPEED_HISTORY_DIRECTIONS; direction++) {
+		/*Oldest sample leaves window*/
+		if ((history->written - history->cleared) >= history->length) {
+			oldvalue = history->values[direction][position];
+			history->sum[direction] -= oldvalue;
+			history->buckets[direction][mmgui_speed_history_bucket(oldvalue)]--;
+			queue = &history->minqueue[direction];
+			if ((queue->count > 0) && (queue->sequence[queue->first] + history->length <= history->written)) {
+				queue->first = (queue->first + 1) % history->length;
+				queue->count--;
+			}
+			queue = &history->maxqueue[direction];
+			if ((queue->count > 0) && (queue->sequence[queue->first] + history->length <= history->written)) {
+				queue->first = (queue->first + 1) % history->length;
+				queue->count--;
+			}
+		}
+		
+		history->values[direction][position] = values[direction];
+		history->sum[direction] += values[direction];
+		history->buckets[direction][mmgui_speed_history_bucket(values[direction])]++;
+		
+		mmgui_speed_history_queue_push(history, &history->minqueue[direction], direction, TRUE);
+		mmgui_speed_history_queue_push(history, &history->maxqueue[direction], direction, FALSE);
+	}
+	
+	history->written++;
+	
+	mmgui_speed_history_publish(history);
+	
+	g_atomic_int_inc(&history->sequence);
+}
+
+void mmgui_speed_history_clear(mmgui_speed_history_t history)
+{
+	guint direction;
+	
+	if (history == NULL) return;
+	
+	g_atomic_int_inc(&history->sequence);
+	
+	history->cleared = history->written;
+	
+	for (direction=0; direction<MMGUI_SPEED_HISTORY_DIRECTIONS; direction++) {
+		history->sum[direction] = 0.0;
+		memset(history->buckets[direction], 0, sizeof(history->buckets[direction]));
+		history->minqueue[direction].first = 0;
+		history->minqueue[direction].count = 0;
+		history->maxqueue[direction].first = 0;
+		history->maxqueue[direction].count = 0;
+	}
+	
+	mmgui_speed_history_publish(history);
+	
+	g_atomic_int_inc(&history->sequence);
+}
+
+void mmgui_speed_history_set_current(mmgui_speed_history_t history, gfloat rxspeed, gfloat txspeed)
+{
+	if (history == NULL) return;
+	
+	/*Instant speed between history samples*/
+	g_atomic_int_inc(&history->sequence);
+	
+	history->stats[MMGUI_SPEED_HISTORY_RX].last = MAX(rxspeed, 0.0);
+	history->stats[MMGUI_SPEED_HISTORY_TX].last = MAX(txspeed, 0.0);
+	
+	g_atomic_int_inc(&history->sequence);
+}
+
+guint mmgui_speed_history_snapshot(mmgui_speed_history_t history, mmgui_speed_snapshot_t snapshot, gfloat *rxvalues, gfloat *txvalues, guint maxvalues)
+{
+	gint before, after;
+	guint count, i, position;
+	guint64 head;
+	
+	if ((history == NULL) || (snapshot == NULL)) return 0;
+	
+	do {
+		before = g_atomic_int_get(&history->sequence);
+		if (before & 1) {
+			/*Writer is in the middle of update*/
+			g_thread_yield();
+			continue;
+		}
+		
+		snapshot->count = history->count;
+		memcpy(snapshot->stats, history->stats, sizeof(snapshot->stats));
+		head = history->head;
+		
+		/*Samples are copied oldest first*/
+		count = MIN(snapshot->count, maxvalues);
+		for (i=0; i<count; i++) {
+			position = (guint)((head - count + i) % history->length);
+			if (rxvalues != NULL) {
+				rxvalues[i] = history->values[MMGUI_SPEED_HISTORY_RX][position];
+			}
+			if (txvalues != NULL) {
+				txvalues[i] = history->values[MMGUI_SPEED_HISTORY_TX][position];
+			}
+		}
+		
+		after = g_atomic_int_get(&history->sequence);
+	} while ((before & 1) || (before != after));
+	
+	return count;
+}
+
+static guint mmgui_speed_history_bucket(gfloat value)
+{
+	guint bucket;
+	
+	if (value <= 0.0) return 0;
+	
+	bucket = (guint)(log2f(value + 1.0) * MMGUI_SPEED_HISTORY_BUCKET_STEPS);
+	
+	return MIN(bucket, MMGUI_SPEED_HISTORY_BUCKETS - 1);
+}
+
+static gfloat mmgui_speed_history_bucket_limit(guint bucket)
+{
+	return exp2f((gfloat)(bucket + 1) / MMGUI_SPEED_HISTORY_BUCKET_STEPS) - 1.0;
+}
+
+static void mmgui_speed_history_queue_push(mmgui_speed_history_t history, struct _mmgui_speed_history_queue *queue, guint direction, gboolean minimum)
+{
+	gfloat value, lastvalue;
+	guint last;
+	
+	value = history->values[direction][history->written % history->length];
+	
+	/*Samples that can never become extreme again are dropped*/
+	while (queue->count > 0) {
+		last = (queue->first + queue->count - 1) % history->length;
+		lastvalue = history->values[direction][queue->sequence[last] % history->length];
+		if (((minimum) && (lastvalue >= value)) || ((!minimum) && (lastvalue <= value))) {
+			queue->count--;
+		} else {
+			break;
+		}
+	}
+	
+	queue->sequence[(queue->first + queue->count) % history->length] = history->written;
+	queue->count++;
+}
+
+static void mmgui_speed_history_publish(mmgui_speed_history_t history)
+{
+	struct _mmgui_speed_stats *stats;
+	struct _mmgui_speed_history_queue *queue;
+	guint direction, bucket, rank, seen;
+	
+	history->count = (guint)MIN(history->written - history->cleared, (guint64)history->length);
+	history->head = history->written;
+	
+	for (direction=0; direction<MMGUI_SPEED_HISTORY_DIRECTIONS; direction++) {
+		stats = &history->stats[direction];
+		
+		if (history->count == 0) {
+			memset(stats, 0, sizeof(struct _mmgui_speed_stats));
+			continue;
+		}
+		
+		stats->last = history->values[direction][(history->written - 1) % history->length];
+		queue = &history->minqueue[direction];
+		stats->min = history->values[direction][queue->sequence[queue->first] % history->length];
+		queue = &history->maxqueue[direction];
+		stats->max = history->values[direction][queue->sequence[queue->first] % history->length];
+		stats->mean = (gfloat)(history->sum[direction] / history->count);
+		
+		/*Upper limit of bucket holding 95th percentile, never above real maximum*/
+		rank = history->count - (history->count * 95) / 100;
+		seen = 0;
+		for (bucket=MMGUI_SPEED_HISTORY_BUCKETS; bucket>0; bucket--) {
+			seen += history->buckets[direction][bucket-1];
+			if (seen >= rank) break;
+		}
+		stats->p95 = MIN(mmgui_speed_history_bucket_limit(bucket > 0 ? bucket-1 : 0), stats->max);
+	}
+}
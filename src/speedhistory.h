@@ -0,0 +1,89 @@
+/*
+ *      speedhistory.h
+ *      
+ *      Copyright 2026 Alex <alex@linuxonly.ru>
+ *      
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SPEEDHISTORY_H__
+#define __SPEEDHISTORY_H__
+
+#include <glib.h>
+
+#define MMGUI_SPEED_HISTORY_MIN_LENGTH     20
+#define MMGUI_SPEED_HISTORY_MAX_LENGTH     (4 * 60 * 60)
+/*Quarter-octave buckets used for percentile estimation*/
+#define MMGUI_SPEED_HISTORY_BUCKETS        96
+#define MMGUI_SPEED_HISTORY_BUCKET_STEPS   4
+
+enum _mmgui_speed_history_direction {
+	MMGUI_SPEED_HISTORY_RX = 0,
+	MMGUI_SPEED_HISTORY_TX,
+	MMGUI_SPEED_HISTORY_DIRECTIONS
+};
+
+/*Statistics over samples kept in history*/
+struct _mmgui_speed_stats {
+	gfloat last;
+	gfloat min;
+	gfloat max;
+	gfloat mean;
+	gfloat p95;
+};
+
+/*Window of monotonic queue used for running minimum or maximum*/
+struct _mmgui_speed_history_queue {
+	guint64 *sequence;
+	guint first;
+	guint count;
+};
+
+/*Written by one thread at a time, read by any thread without locking*/
+struct _mmgui_speed_history {
+	guint length;
+	gfloat *values[MMGUI_SPEED_HISTORY_DIRECTIONS];
+	/*Producer state*/
+	guint64 written;
+	guint64 cleared;
+	gdouble sum[MMGUI_SPEED_HISTORY_DIRECTIONS];
+	guint buckets[MMGUI_SPEED_HISTORY_DIRECTIONS][MMGUI_SPEED_HISTORY_BUCKETS];
+	struct _mmgui_speed_history_queue minqueue[MMGUI_SPEED_HISTORY_DIRECTIONS];
+	struct _mmgui_speed_history_queue maxqueue[MMGUI_SPEED_HISTORY_DIRECTIONS];
+	/*Published state, odd sequence means update in progress*/
+	volatile gint sequence;
+	guint count;
+	guint64 head;
+	struct _mmgui_speed_stats stats[MMGUI_SPEED_HISTORY_DIRECTIONS];
+};
+
+typedef struct _mmgui_speed_history *mmgui_speed_history_t;
+
+/*Consistent copy of history*/
+struct _mmgui_speed_snapshot {
+	guint count;
+	struct _mmgui_speed_stats stats[MMGUI_SPEED_HISTORY_DIRECTIONS];
+};
+
+typedef struct _mmgui_speed_snapshot *mmgui_speed_snapshot_t;
+
+mmgui_speed_history_t mmgui_speed_history_new(guint length);
+void mmgui_speed_history_free(mmgui_speed_history_t history);
+guint mmgui_speed_history_get_length(mmgui_speed_history_t history);
+void mmgui_speed_history_append(mmgui_speed_history_t history, gfloat rxspeed, gfloat txspeed);
+void mmgui_speed_history_clear(mmgui_speed_history_t history);
+void mmgui_speed_history_set_current(mmgui_speed_history_t history, gfloat rxspeed, gfloat txspeed);
+guint mmgui_speed_history_snapshot(mmgui_speed_history_t history, mmgui_speed_snapshot_t snapshot, gfloat *rxvalues, gfloat *txvalues, guint maxvalues);
+
+#endif /* __SPEEDHISTORY_H__ */
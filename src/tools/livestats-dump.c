@@ -0,0 +1,176 @@
+/*
+ *      livestats-dump.c
+ *      
+ *      Copyright 2026 Alex <alex@linuxonly.ru>
+ *      
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "../livestats.h"
+
+static void livestats_dump_usage(const char *program)
+{
+	printf("Usage: %s [-j] [-a] [-u UID] [-w MILLISECONDS]\n", program);
+	printf("Print live modem statistics published by modem-manager-gui\n\n");
+	printf("  -j, --json       print one JSON object per device\n");
+	printf("  -a, --all        include devices that are not active\n");
+	printf("  -u, --uid=UID    read segment of another user\n");
+	printf("  -w, --watch=MS   repeat every MS milliseconds\n");
+	printf("  -h, --help       show this help\n");
+}
+
+static void livestats_dump_json_string(const char *value)
+{
+	const char *ch;
+	
+	putchar('"');
+	for (ch = value; *ch != '\0'; ch++) {
+		if ((*ch == '"') || (*ch == '\\')) {
+			printf("\\%c", *ch);
+		} else if ((unsigned char)*ch < 0x20) {
+			printf("\\u%04x", (unsigned char)*ch);
+		} else {
+			putchar(*ch);
+		}
+	}
+	putchar('"');
+}
+
+static void livestats_dump_device(const struct _mmgui_live_stats_device *device, int json)
+{
+	if (json) {
+		printf("{\"device\":");
+		livestats_dump_json_string(device->persistentid);
+		printf(",\"model\":");
+		livestats_dump_json_string(device->model);
+		printf(",\"operator\":");
+		livestats_dump_json_string(device->operatorname);
+		printf(",\"interface\":");
+		livestats_dump_json_string(device->interface);
+		printf(",\"active\":%s,\"enabled\":%s,\"registered\":%s,\"connected\":%s", (device->flags & MMGUI_LIVE_STATS_FLAG_ACTIVE) ? "true" : "false", (device->flags & MMGUI_LIVE_STATS_FLAG_ENABLED) ? "true" : "false", (device->flags & MMGUI_LIVE_STATS_FLAG_REGISTERED) ? "true" : "false", (device->flags & MMGUI_LIVE_STATS_FLAG_CONNECTED) ? "true" : "false");
+		printf(",\"regstatus\":\"%s\",\"mode\":\"%s\",\"siglevel\":%u", mmgui_live_stats_reg_status_name(device->regstatus), mmgui_live_stats_mode_name(device->mode), device->siglevel);
+		printf(",\"rxbytes\":%llu,\"txbytes\":%llu,\"sessiontime\":%llu", (unsigned long long)device->rxbytes, (unsigned long long)device->txbytes, (unsigned long long)device->sessiontime);
+		printf(",\"rxspeed\":%.3f,\"txspeed\":%.3f,\"updated\":%llu}\n", device->rxspeed, device->txspeed, (unsigned long long)device->updated);
+	} else {
+		printf("%s (%s)\n", device->persistentid, device->model);
+		printf("  state:     %s%s%s%s\n", (device->flags & MMGUI_LIVE_STATS_FLAG_ACTIVE) ? "active" : "inactive", (device->flags & MMGUI_LIVE_STATS_FLAG_ENABLED) ? ", enabled" : "", (device->flags & MMGUI_LIVE_STATS_FLAG_REGISTERED) ? ", registered" : "", (device->flags & MMGUI_LIVE_STATS_FLAG_CONNECTED) ? ", connected" : "");
+		printf("  network:   %s, %s, %s, signal %u%%\n", device->operatorname, mmgui_live_stats_reg_status_name(device->regstatus), mmgui_live_stats_mode_name(device->mode), device->siglevel);
+		printf("  traffic:   %s rx %llu bytes, tx %llu bytes, %llu s\n", device->interface, (unsigned long long)device->rxbytes, (unsigned long long)device->txbytes, (unsigned long long)device->sessiontime);
+		printf("  speed:     rx %.1f kbit/s, tx %.1f kbit/s\n", device->rxspeed, device->txspeed);
+	}
+}
+
+static int livestats_dump_segment(mmgui_live_stats_reader_t reader, int json, int all)
+{
+	struct _mmgui_live_stats_device device;
+	unsigned int slot, slots;
+	int status;
+	
+	slots = mmgui_live_stats_reader_get_slots(reader);
+	
+	for (slot = 0; slot < slots; slot++) {
+		status = mmgui_live_stats_read(reader, slot, &device);
+		if (status == -1) return -1;
+		if (device.persistentid[0] == '\0') continue;
+		if ((status == 0) && (!all)) continue;
+		livestats_dump_device(&device, json);
+	}
+	
+	fflush(stdout);
+	
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option options[] = {
+		{"json",  no_argument,       NULL, 'j'},
+		{"all",   no_argument,       NULL, 'a'},
+		{"uid",   required_argument, NULL, 'u'},
+		{"watch", required_argument, NULL, 'w'},
+		{"help",  no_argument,       NULL, 'h'},
+		{NULL,    0,                 NULL, 0}
+	};
+	mmgui_live_stats_reader_t reader;
+	struct timespec interval;
+	int option, json, all;
+	long watch;
+	uid_t uid;
+	
+	json = 0;
+	all = 0;
+	watch = 0;
+	uid = getuid();
+	
+	while ((option = getopt_long(argc, argv, "jau:w:h", options, NULL)) != -1) {
+		switch (option) {
+			case 'j':
+				json = 1;
+				break;
+			case 'a':
+				all = 1;
+				break;
+			case 'u':
+				uid = (uid_t)strtoul(optarg, NULL, 10);
+				break;
+			case 'w':
+				watch = strtol(optarg, NULL, 10);
+				break;
+			case 'h':
+				livestats_dump_usage(argv[0]);
+				return EXIT_SUCCESS;
+			default:
+				livestats_dump_usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+	
+	reader = mmgui_live_stats_reader_open(uid);
+	if (reader == NULL) {
+		fprintf(stderr, "No live statistics published, is modem-manager-gui running?\n");
+		return EXIT_FAILURE;
+	}
+	
+	interval.tv_sec = watch / 1000;
+	interval.tv_nsec = (watch % 1000) * 1000000;
+	
+	for (;;) {
+		if (livestats_dump_segment(reader, json, all) == -1) {
+			/*Segment was recreated by new writer*/
+			mmgui_live_stats_reader_close(reader);
+			reader = mmgui_live_stats_reader_open(uid);
+			if (reader == NULL) {
+				fprintf(stderr, "Live statistics segment closed\n");
+				return EXIT_FAILURE;
+			}
+			continue;
+		}
+		if (watch <= 0) break;
+		if (!json) {
+			printf("\n");
+		}
+		nanosleep(&interval, NULL);
+	}
+	
+	mmgui_live_stats_reader_close(reader);
+	
+	return EXIT_SUCCESS;
+}
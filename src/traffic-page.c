@@ -19,6 +19,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <gtk/gtk.h>
 #include <locale.h>
@@ -32,14 +33,42 @@
 #include "strformat.h"
 #include "mmguicore.h"
 #include "trafficdb.h"
+#include "speedhistory.h"
 #include "netlink.h"
 
 #include "traffic-page.h"
 #include "main.h"
 
+/*Applications section refresh limits, seconds*/
+#define MMGUI_MAIN_TRAFFIC_APPLICATIONS_INTERVAL  5
+#define MMGUI_MAIN_TRAFFIC_APPLICATIONS_MAX_AGE   60
+
 static void mmgui_main_traffic_limits_notification_show_window_callback(gpointer notification, gchar *action, gpointer userdata);
 static void mmgui_main_traffic_limits_dialog_traffic_section_disable_signal(GtkToggleButton *togglebutton, gpointer data);
 static gboolean mmgui_main_traffic_limits_dialog_open(mmgui_application_t mmguiapp);
+static gchar *mmgui_main_traffic_format_speed_stats(struct _mmgui_speed_stats *stats, gchar *buffer, gsize bufsize);
+static void mmgui_main_traffic_speed_plot_draw_series(cairo_t *cr, gfloat *values, guint count, guint length, gint graphlen, gint height, gfloat maxvalue, gboolean righttoleft, gdouble r, gdouble g, gdouble b);
+static void mmgui_main_traffic_applications_update(mmgui_application_t mmguiapp, GtkTreeModel *model, mmgui_trafficdb_t trafficdb);
+static void mmgui_main_traffic_statistics_dialog_append_row(GtkTreeModel *model, const gchar *caption, guint64 rxbytes, guint64 txbytes, guint64 duration, guint64 timestamp);
+static void mmgui_main_traffic_statistics_dialog_append_days(GtkTreeModel *model, GSList *statistics);
+static void mmgui_main_traffic_statistics_dialog_append_hours(GtkTreeModel *model, mmgui_trafficdb_t trafficdb, guint month, guint year);
+static gpointer mmgui_main_traffic_statistics_report_thread(gpointer data);
+static gboolean mmgui_main_traffic_statistics_report_from_thread(gpointer data);
+static void mmgui_main_traffic_connections_set_row(GtkTreeModel *model, GtkTreeIter *iter, mmgui_netlink_connection_t connection);
+static void mmgui_main_traffic_connections_append_row(mmgui_application_t mmguiapp, GtkTreeModel *model, mmgui_netlink_connection_t connection);
+static gboolean mmgui_main_traffic_connections_get_row(mmgui_application_t mmguiapp, GtkTreeModel *model, guint inode, GtkTreeIter *iter);
+
+/*Report of all devices built by separate thread*/
+struct _mmgui_main_traffic_report_request {
+	mmgui_application_t mmguiapp;
+	guint id;
+	guint month;
+	guint year;
+	gchar *currentid;
+	struct _mmgui_day_traffic liveday;
+	gboolean live;
+	mmgui_traffic_report_t report;
+};
 
 /*TRAFFIC*/
 static void mmgui_main_traffic_limits_notification_show_window_callback(gpointer notification, gchar *action, gpointer userdata)
@@ -71,12 +100,14 @@ gboolean mmgui_main_traffic_stats_history_update_from_thread(gpointer data)
 	
 	/*If dialog window is not visible - do not update connections list*/
 	if (!gtk_widget_get_visible(mmguiapp->window->trafficstatsdialog)) return FALSE;
+	/*Combined rows of all devices are not updated with values of opened one*/
+	if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(mmguiapp->window->trafficstatsalldevicescb))) return FALSE;
 	
 	trafficdb = (mmgui_trafficdb_t)mmguicore_devices_get_traffic_db(mmguiapp->core);
 	model = gtk_tree_view_get_model(GTK_TREE_VIEW(mmguiapp->window->trafficstatstreeview));
 	
 	if ((trafficdb != NULL) && (model != NULL)) {
-		if (mmgui_trafficdb_session_get_day_traffic(trafficdb, &traffic)) {
+		if (mmguicore_traffic_get_day_traffic(mmguiapp->core, &traffic)) {
 			valid = gtk_tree_model_get_iter_first(model, &iter);
 			while (valid) {
 				gtk_tree_model_get(model, &iter, MMGUI_MAIN_TRAFFICSTATSLIST_TIMESATMP, &curtimestamp, -1);
@@ -102,58 +133,210 @@ gboolean mmgui_main_traffic_stats_history_update_from_thread(gpointer data)
 	return FALSE;
 }
 
-void mmgui_main_traffic_statistics_dialog_fill_statistics(mmgui_application_t mmguiapp, guint month, guint year)
+static void mmgui_main_traffic_statistics_dialog_append_row(GtkTreeModel *model, const gchar *caption, guint64 rxbytes, guint64 txbytes, guint64 duration, guint64 timestamp)
 {
-	GtkTreeModel *model;
 	GtkTreeIter iter;
-	GSList *statistics, *iterator;
-	mmgui_trafficdb_t trafficdb;
+	gchar strformat[3][64];
+	
+	//RX bytes
+	mmgui_str_format_bytes(rxbytes, strformat[0], sizeof(strformat[0]), FALSE);
+	//TX bytes
+	mmgui_str_format_bytes(txbytes, strformat[1], sizeof(strformat[1]), FALSE);
+	//Session time
+	mmgui_str_format_time(duration, strformat[2], sizeof(strformat[2]), FALSE);
+	
+	gtk_list_store_append(GTK_LIST_STORE(model), &iter);
+	gtk_list_store_set(GTK_LIST_STORE(model), &iter, MMGUI_MAIN_TRAFFICSTATSLIST_DAY, caption,
+													MMGUI_MAIN_TRAFFICSTATSLIST_RXDATA, strformat[0],
+													MMGUI_MAIN_TRAFFICSTATSLIST_TXDATA, strformat[1],
+													MMGUI_MAIN_TRAFFICSTATSLIST_SESSIONTIME, strformat[2],
+													MMGUI_MAIN_TRAFFICSTATSLIST_TIMESATMP, timestamp,
+													-1);
+}
+
+static void mmgui_main_traffic_statistics_dialog_append_days(GtkTreeModel *model, GSList *statistics)
+{
+	GSList *iterator;
 	mmgui_day_traffic_t traffic;
 	struct tm *timespec;
-	gchar strformat[4][64];
+	gchar strformat[64];
+	
+	for (iterator=statistics; iterator; iterator=iterator->next) {
+		traffic = iterator->data;
+		//Date
+		timespec = localtime((const time_t *)&(traffic->daytime));
+		if (strftime(strformat, sizeof(strformat), "%d %B", timespec) == -1) {
+			snprintf(strformat, sizeof(strformat), _("Unknown"));
+		}
+		mmgui_main_traffic_statistics_dialog_append_row(model, strformat, traffic->dayrxbytes + traffic->sessrxbytes, traffic->daytxbytes + traffic->sesstxbytes, traffic->dayduration + traffic->sessduration, traffic->daytime);
+	}
+}
+
+static void mmgui_main_traffic_statistics_dialog_append_hours(GtkTreeModel *model, mmgui_trafficdb_t trafficdb, guint month, guint year)
+{
+	GArray *samples;
+	mmgui_traffic_sample_t sample;
+	GtkTreeIter iter;
+	struct tm timespec;
+	time_t currenttime, daystart, sampletime;
+	gchar strformat[3][64];
+	guint i;
+	
+	currenttime = time(NULL);
+	localtime_r(&currenttime, &timespec);
+	
+	/*Hourly series covers current day of shown month only*/
+	if ((timespec.tm_mon != month) || (timespec.tm_year + 1900 != year)) return;
+	
+	timespec.tm_hour = 0;
+	timespec.tm_min = 0;
+	timespec.tm_sec = 0;
+	daystart = mktime(&timespec);
+	
+	samples = mmgui_trafficdb_series_read(trafficdb, daystart, currenttime, 3600);
+	
+	if (samples == NULL) return;
+	
+	for (i=0; i<samples->len; i++) {
+		sample = &g_array_index(samples, struct _mmgui_traffic_sample, i);
+		if ((sample->rxbytes == 0) && (sample->txbytes == 0)) continue;
+		//Hour
+		sampletime = (time_t)sample->timestamp;
+		localtime_r(&sampletime, &timespec);
+		if (strftime(strformat[0], sizeof(strformat[0]), _("<small>Today, %H:00</small>"), &timespec) == 0) continue;
+		//RX bytes
+		mmgui_str_format_bytes(sample->rxbytes, strformat[1], sizeof(strformat[1]), FALSE);
+		//TX bytes
+		mmgui_str_format_bytes(sample->txbytes, strformat[2], sizeof(strformat[2]), FALSE);
+		//Hour rows have no timestamp, so live day update does not touch them
+		gtk_list_store_append(GTK_LIST_STORE(model), &iter);
+		gtk_list_store_set(GTK_LIST_STORE(model), &iter, MMGUI_MAIN_TRAFFICSTATSLIST_DAY, strformat[0],
+														MMGUI_MAIN_TRAFFICSTATSLIST_RXDATA, strformat[1],
+														MMGUI_MAIN_TRAFFICSTATSLIST_TXDATA, strformat[2],
+														MMGUI_MAIN_TRAFFICSTATSLIST_SESSIONTIME, "",
+														MMGUI_MAIN_TRAFFICSTATSLIST_TIMESATMP, (guint64)0,
+														-1);
+	}
+	
+	g_array_free(samples, TRUE);
+}
+
+static gpointer mmgui_main_traffic_statistics_report_thread(gpointer data)
+{
+	struct _mmgui_main_traffic_report_request *request;
+	
+	request = (struct _mmgui_main_traffic_report_request *)data;
+	
+	if (request == NULL) return NULL;
+	
+	/*Databases of all devices ever used are combined*/
+	request->report = mmgui_trafficdb_report_build(request->month, request->year, request->currentid, request->live ? &request->liveday : NULL);
+	
+	g_idle_add(mmgui_main_traffic_statistics_report_from_thread, request);
+	
+	return NULL;
+}
+
+static gboolean mmgui_main_traffic_statistics_report_from_thread(gpointer data)
+{
+	struct _mmgui_main_traffic_report_request *request;
+	mmgui_application_t mmguiapp;
+	GtkTreeModel *model;
+	GSList *iterator;
+	mmgui_traffic_device_report_t device;
+	
+	request = (struct _mmgui_main_traffic_report_request *)data;
+	
+	if (request == NULL) return FALSE;
+	
+	mmguiapp = request->mmguiapp;
+	
+	/*Report requested before month or mode was changed is dropped*/
+	if ((request->report != NULL) && (request->id == mmguiapp->window->trafficstatsreport) && (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(mmguiapp->window->trafficstatsalldevicescb)))) {
+		model = gtk_tree_view_get_model(GTK_TREE_VIEW(mmguiapp->window->trafficstatstreeview));
+		if (model != NULL) {
+			g_object_ref(model);
+			gtk_tree_view_set_model(GTK_TREE_VIEW(mmguiapp->window->trafficstatstreeview), NULL);
+			
+			mmgui_main_traffic_statistics_dialog_append_days(model, request->report->days);
+			
+			/*Device rollups have no day timestamp*/
+			for (iterator=request->report->devices; iterator; iterator=iterator->next) {
+				device = (mmgui_traffic_device_report_t)iterator->data;
+				if (device->days == 0) continue;
+				mmgui_main_traffic_statistics_dialog_append_row(model, device->persistentid, device->rxbytes, device->txbytes, device->duration, 0);
+			}
+			mmgui_main_traffic_statistics_dialog_append_row(model, _("Total"), request->report->rxbytes, request->report->txbytes, request->report->duration, 0);
+			
+			gtk_tree_view_set_model(GTK_TREE_VIEW(mmguiapp->window->trafficstatstreeview), model);
+			g_object_unref(model);
+		}
+	}
+	
+	mmgui_trafficdb_report_free(request->report);
+	g_free(request->currentid);
+	g_free(request);
+	
+	return FALSE;
+}
+
+void mmgui_main_traffic_statistics_dialog_fill_statistics(mmgui_application_t mmguiapp, guint month, guint year)
+{
+	GtkTreeModel *model;
+	GSList *statistics;
+	mmgui_trafficdb_t trafficdb;
+	struct _mmgui_main_traffic_report_request *request;
+	GThread *thread;
+	GError *error;
+	gboolean alldevices;
 			
 	if (mmguiapp == NULL) return;
 	
 	model = gtk_tree_view_get_model(GTK_TREE_VIEW(mmguiapp->window->trafficstatstreeview));
 	trafficdb = (mmgui_trafficdb_t)mmguicore_devices_get_traffic_db(mmguiapp->core);
+	alldevices = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(mmguiapp->window->trafficstatsalldevicescb));
+	
+	/*Results of report still being built are not shown anymore*/
+	mmguiapp->window->trafficstatsreport++;
 		
-	if ((model != NULL) && (trafficdb != NULL)) {
-		g_object_ref(model);
-		gtk_tree_view_set_model(GTK_TREE_VIEW(mmguiapp->window->trafficstatstreeview), NULL);
-		
+	if ((model != NULL) && ((trafficdb != NULL) || (alldevices))) {
 		gtk_list_store_clear(GTK_LIST_STORE(model));
 		
-		statistics = mmgui_trafficdb_get_traffic_list_for_month(trafficdb, month, year);
-		
-		if (statistics != NULL) {
-			for (iterator=statistics; iterator; iterator=iterator->next) {
-				traffic = iterator->data;
-				//Date
-				timespec = localtime((const time_t *)&(traffic->daytime));
-				if (strftime(strformat[0], sizeof(strformat[0]), "%d %B", timespec) == -1) {
-					snprintf(strformat[0], sizeof(strformat[0]), _("Unknown"));
+		if (alldevices) {
+			/*Reading many databases must not block interface, rows are added when report is ready*/
+			request = g_new0(struct _mmgui_main_traffic_report_request, 1);
+			request->mmguiapp = mmguiapp;
+			request->id = mmguiapp->window->trafficstatsreport;
+			request->month = month;
+			request->year = year;
+			if (trafficdb != NULL) {
+				request->currentid = g_strdup(mmguicore_devices_get_identifier(mmguiapp->core));
+				request->live = mmguicore_traffic_get_day_traffic(mmguiapp->core, &request->liveday);
+			}
+			error = NULL;
+			thread = g_thread_try_new("traffic-report", mmgui_main_traffic_statistics_report_thread, request, &error);
+			if (thread != NULL) {
+				g_thread_unref(thread);
+			} else {
+				if (error != NULL) {
+					g_debug("Unable to start traffic report thread: %s\n", error->message);
+					g_error_free(error);
 				}
-				//RX bytes
-				mmgui_str_format_bytes(traffic->dayrxbytes + traffic->sessrxbytes, strformat[1], sizeof(strformat[1]), FALSE);
-				//TX bytes
-				mmgui_str_format_bytes(traffic->daytxbytes + traffic->sesstxbytes, strformat[2], sizeof(strformat[2]), FALSE);
-				//Session time
-				mmgui_str_format_time(traffic->dayduration + traffic->sessduration, strformat[3], sizeof(strformat[3]), FALSE);
-				
-				gtk_list_store_append(GTK_LIST_STORE(model), &iter);
-				gtk_list_store_set(GTK_LIST_STORE(model), &iter, MMGUI_MAIN_TRAFFICSTATSLIST_DAY, strformat[0],
-																MMGUI_MAIN_TRAFFICSTATSLIST_RXDATA, strformat[1],
-																MMGUI_MAIN_TRAFFICSTATSLIST_TXDATA, strformat[2],
-																MMGUI_MAIN_TRAFFICSTATSLIST_SESSIONTIME, strformat[3],
-																MMGUI_MAIN_TRAFFICSTATSLIST_TIMESATMP, traffic->daytime,
-																-1);
+				g_free(request->currentid);
+				g_free(request);
 			}
+		} else {
+			g_object_ref(model);
+			gtk_tree_view_set_model(GTK_TREE_VIEW(mmguiapp->window->trafficstatstreeview), NULL);
+			
+			statistics = mmgui_trafficdb_get_traffic_list_for_month(trafficdb, month, year);
+			mmgui_main_traffic_statistics_dialog_append_days(model, statistics);
+			mmgui_trafficdb_free_traffic_list_for_month(statistics);
+			mmgui_main_traffic_statistics_dialog_append_hours(model, trafficdb, month, year);
+			
+			gtk_tree_view_set_model(GTK_TREE_VIEW(mmguiapp->window->trafficstatstreeview), model);
+			g_object_unref(model);
 		}
-				
-		gtk_tree_view_set_model(GTK_TREE_VIEW(mmguiapp->window->trafficstatstreeview), model);
-		g_object_unref(model);
-		
-		mmgui_trafficdb_free_traffic_list_for_month(statistics);
 	}
 	
 }
@@ -264,20 +447,67 @@ void mmgui_main_traffic_traffic_statistics_list_init(mmgui_application_t mmguiap
 	g_object_unref(store);
 }
 
+static void mmgui_main_traffic_connections_set_row(GtkTreeModel *model, GtkTreeIter *iter, mmgui_netlink_connection_t connection)
+{
+	gchar strbuf[32];
+	gchar addrbuf[INET6_ADDRSTRLEN + 8];
+	
+	mmgui_str_format_bytes((guint64)connection->dqueue, strbuf, sizeof(strbuf), FALSE);
+	gtk_list_store_set(GTK_LIST_STORE(model), iter, MMGUI_MAIN_CONNECTIONLIST_APPLICATION, connection->appname,
+													MMGUI_MAIN_CONNECTIONLIST_PID, connection->apppid,
+													MMGUI_MAIN_CONNECTIONLIST_PROTOCOL, mmgui_netlink_socket_protocol(connection->protocol),
+													MMGUI_MAIN_CONNECTIONLIST_STATE, mmgui_netlink_socket_state(connection->state),
+													MMGUI_MAIN_CONNECTIONLIST_BUFFER, strbuf,
+													MMGUI_MAIN_CONNECTIONLIST_LOCALADDR, connection->srcport,
+													MMGUI_MAIN_CONNECTIONLIST_DESTADDR, mmgui_netlink_connection_address(connection, TRUE, addrbuf, sizeof(addrbuf)),
+													MMGUI_MAIN_CONNECTIONLIST_INODE, connection->inode,
+													-1);
+}
+
+static void mmgui_main_traffic_connections_append_row(mmgui_application_t mmguiapp, GtkTreeModel *model, mmgui_netlink_connection_t connection)
+{
+	GtkTreeIter iter;
+	GtkTreePath *path;
+	
+	gtk_list_store_append(GTK_LIST_STORE(model), &iter);
+	mmgui_main_traffic_connections_set_row(model, &iter, connection);
+	
+	/*Rows are found by inode without walking the list*/
+	path = gtk_tree_model_get_path(model, &iter);
+	g_hash_table_insert(mmguiapp->window->connrows, GUINT_TO_POINTER(connection->inode), gtk_tree_row_reference_new(model, path));
+	gtk_tree_path_free(path);
+}
+
+static gboolean mmgui_main_traffic_connections_get_row(mmgui_application_t mmguiapp, GtkTreeModel *model, guint inode, GtkTreeIter *iter)
+{
+	GtkTreeRowReference *reference;
+	GtkTreePath *path;
+	gboolean valid;
+	
+	reference = g_hash_table_lookup(mmguiapp->window->connrows, GUINT_TO_POINTER(inode));
+	
+	if (reference == NULL) return FALSE;
+	
+	path = gtk_tree_row_reference_get_path(reference);
+	
+	if (path == NULL) {
+		g_hash_table_remove(mmguiapp->window->connrows, GUINT_TO_POINTER(inode));
+		return FALSE;
+	}
+	
+	valid = gtk_tree_model_get_iter(model, iter, path);
+	gtk_tree_path_free(path);
+	
+	return valid;
+}
+
 gboolean mmgui_main_traffic_connections_update_from_thread(gpointer data)
 {
 	mmgui_application_t mmguiapp;
-	mmgui_netlink_connection_change_t fullchange;
+	mmgui_netlink_connection_change_t change;
 	GSList *changes, *iterator;
-	gboolean add, remove, modify;
-	GHashTable *modconns;
 	GtkTreeModel *model;
 	GtkTreeIter iter;
-	gboolean valid;
-	guint inode;
-	GtkTreePath *path;
-	GtkTreeRowReference *reference;
-	GList *rmlist, *rmnode;
 	gchar strbuf[32];
 	
 	mmguiapp = (mmgui_application_t)data;
@@ -288,87 +518,41 @@ gboolean mmgui_main_traffic_connections_update_from_thread(gpointer data)
 	
 	if (model == NULL) return FALSE;
 	
+	/*Change set holds at most one change per connection*/
 	changes = mmguicore_get_connections_changes(mmguiapp->core);
 	
 	if (changes == NULL) return FALSE;
 	
-	modconns = g_hash_table_new(g_int_hash, g_int_equal);
-	
-	add = FALSE; remove = FALSE; modify = FALSE;
-	
-	for (iterator=changes; iterator; iterator=iterator->next) {
-		fullchange = (mmgui_netlink_connection_change_t)iterator->data;
-		if (fullchange != NULL) {
-			if (fullchange->event == MMGUI_NETLINK_CONNECTION_EVENT_ADD) {
-				add = TRUE;
-			} else if (fullchange->event == MMGUI_NETLINK_CONNECTION_EVENT_REMOVE) {
-				remove = TRUE;
-				g_hash_table_insert(modconns, &(fullchange->inode), fullchange);
-			} else if (fullchange->event == MMGUI_NETLINK_CONNECTION_EVENT_MODIFY) {
-				modify = TRUE;
-				g_hash_table_insert(modconns, &(fullchange->inode), fullchange);
-			}
-		}
-	}
-	
 	gtk_widget_freeze_child_notify(mmguiapp->window->conntreeview);
 	
-	if ((remove) || (modify)) {
-		rmlist = NULL;
-		valid = gtk_tree_model_get_iter_first(model, &iter);
-		while (valid) {
-			gtk_tree_model_get(model, &iter, MMGUI_MAIN_CONNECTIONLIST_INODE, &inode, -1);
-			fullchange = (mmgui_netlink_connection_change_t)g_hash_table_lookup(modconns, (gconstpointer)&inode);
-			if (fullchange != NULL) {
-				if (fullchange->event == MMGUI_NETLINK_CONNECTION_EVENT_MODIFY) {
-					/*update connection*/
-					mmgui_str_format_bytes((guint64)fullchange->data.params->dqueue, strbuf, sizeof(strbuf), FALSE);
-					gtk_list_store_set(GTK_LIST_STORE(model), &iter, MMGUI_MAIN_CONNECTIONLIST_STATE, mmgui_netlink_socket_state(fullchange->data.params->state),
-																	MMGUI_MAIN_CONNECTIONLIST_BUFFER, strbuf,
-																	-1); 
-				} else if (fullchange->event == MMGUI_NETLINK_CONNECTION_EVENT_REMOVE) {
-					/*save reference to remove*/
-					path = gtk_tree_model_get_path(model, &iter);
-					reference = gtk_tree_row_reference_new(model, path);
-					rmlist = g_list_prepend(rmlist, reference);
-					gtk_tree_path_free(path);
-				}
-			}
-			valid = gtk_tree_model_iter_next(model, &iter);
-		}
-		/*remove closed connections*/
-		if (rmlist != NULL) {
-			for (rmnode = rmlist; rmnode != NULL; rmnode = rmnode->next) {
-				path = gtk_tree_row_reference_get_path((GtkTreeRowReference *)rmnode->data);
-				if (path != NULL) {
-					if (gtk_tree_model_get_iter(GTK_TREE_MODEL(model), &iter, path)) {
-						gtk_list_store_remove(GTK_LIST_STORE(model), &iter);
-					}
+	for (iterator=changes; iterator; iterator=iterator->next) {
+		change = (mmgui_netlink_connection_change_t)iterator->data;
+		if (change == NULL) continue;
+		switch (change->event) {
+			case MMGUI_NETLINK_CONNECTION_EVENT_ADD:
+				if (mmgui_main_traffic_connections_get_row(mmguiapp, model, change->inode, &iter)) {
+					/*Socket inode reused*/
+					mmgui_main_traffic_connections_set_row(model, &iter, change->data.connection);
+				} else {
+					mmgui_main_traffic_connections_append_row(mmguiapp, model, change->data.connection);
 				}
-			}
-			g_list_foreach(rmlist, (GFunc)gtk_tree_row_reference_free, NULL);
-			g_list_free(rmlist);
-		}
-	}
-	
-	if (add) {
-		for (iterator=changes; iterator; iterator=iterator->next) {
-			fullchange = (mmgui_netlink_connection_change_t)iterator->data;
-			if (fullchange != NULL) {
-				if (fullchange->event == MMGUI_NETLINK_CONNECTION_EVENT_ADD) {
-					mmgui_str_format_bytes((guint64)fullchange->data.connection->dqueue, strbuf, sizeof(strbuf), FALSE);
-					gtk_list_store_append(GTK_LIST_STORE(model), &iter);
-					gtk_list_store_set(GTK_LIST_STORE(model), &iter, MMGUI_MAIN_CONNECTIONLIST_APPLICATION, fullchange->data.connection->appname,
-																	MMGUI_MAIN_CONNECTIONLIST_PID, fullchange->data.connection->apppid,
-																	MMGUI_MAIN_CONNECTIONLIST_PROTOCOL, "TCP",
-																	MMGUI_MAIN_CONNECTIONLIST_STATE, mmgui_netlink_socket_state(fullchange->data.connection->state),
+				break;
+			case MMGUI_NETLINK_CONNECTION_EVENT_MODIFY:
+				if (mmgui_main_traffic_connections_get_row(mmguiapp, model, change->inode, &iter)) {
+					mmgui_str_format_bytes((guint64)change->data.params->dqueue, strbuf, sizeof(strbuf), FALSE);
+					gtk_list_store_set(GTK_LIST_STORE(model), &iter, MMGUI_MAIN_CONNECTIONLIST_STATE, mmgui_netlink_socket_state(change->data.params->state),
 																	MMGUI_MAIN_CONNECTIONLIST_BUFFER, strbuf,
-																	MMGUI_MAIN_CONNECTIONLIST_LOCALADDR, fullchange->data.connection->srcport,
-																	MMGUI_MAIN_CONNECTIONLIST_DESTADDR, fullchange->data.connection->dsthostname,
-																	MMGUI_MAIN_CONNECTIONLIST_INODE, fullchange->data.connection->inode,
 																	-1);
 				}
-			}
+				break;
+			case MMGUI_NETLINK_CONNECTION_EVENT_REMOVE:
+				if (mmgui_main_traffic_connections_get_row(mmguiapp, model, change->inode, &iter)) {
+					gtk_list_store_remove(GTK_LIST_STORE(model), &iter);
+				}
+				g_hash_table_remove(mmguiapp->window->connrows, GUINT_TO_POINTER(change->inode));
+				break;
+			default:
+				break;
 		}
 	}
 	
@@ -409,14 +593,13 @@ void mmgui_main_traffic_connections_dialog(mmgui_application_t mmguiapp)
 	GtkTreeModel *model;
 	GSList *connections, *iterator;
 	mmgui_netlink_connection_t connection;
-	GtkTreeIter iter;
-	gchar strbuf[32];
 			
 	if (mmguiapp == NULL) return;
 	
 	model = gtk_tree_view_get_model(GTK_TREE_VIEW(mmguiapp->window->conntreeview));
 	
 	if (model != NULL) {
+		g_hash_table_remove_all(mmguiapp->window->connrows);
 		gtk_list_store_clear(GTK_LIST_STORE(model));
 		/*Fill list with initial connections*/
 		connections =  mmguicore_open_connections_list(mmguiapp->core);
@@ -424,17 +607,7 @@ void mmgui_main_traffic_connections_dialog(mmgui_application_t mmguiapp)
 			for (iterator=connections; iterator; iterator=iterator->next) {
 				connection = (mmgui_netlink_connection_t)iterator->data;
 				if (connection != NULL) {
-					mmgui_str_format_bytes((guint64)connection->dqueue, strbuf, sizeof(strbuf), FALSE);
-					gtk_list_store_append(GTK_LIST_STORE(model), &iter);
-					gtk_list_store_set(GTK_LIST_STORE(model), &iter, MMGUI_MAIN_CONNECTIONLIST_APPLICATION, connection->appname,
-																	MMGUI_MAIN_CONNECTIONLIST_PID, connection->apppid,
-																	MMGUI_MAIN_CONNECTIONLIST_PROTOCOL, "TCP",
-																	MMGUI_MAIN_CONNECTIONLIST_STATE, mmgui_netlink_socket_state(connection->state),
-																	MMGUI_MAIN_CONNECTIONLIST_BUFFER, strbuf,
-																	MMGUI_MAIN_CONNECTIONLIST_LOCALADDR, connection->srcport,
-																	MMGUI_MAIN_CONNECTIONLIST_DESTADDR, connection->dsthostname,
-																	MMGUI_MAIN_CONNECTIONLIST_INODE, connection->inode,
-																	-1);
+					mmgui_main_traffic_connections_append_row(mmguiapp, model, connection);
 				}
 			}
 			/*Free resources*/
@@ -510,20 +683,25 @@ void mmgui_main_traffic_connections_list_init(mmgui_application_t mmguiapp)
 	
 	gtk_tree_view_set_model(GTK_TREE_VIEW(mmguiapp->window->conntreeview), GTK_TREE_MODEL(store));
 	g_object_unref(store);
+	
+	/*Inode to row reference map*/
+	mmguiapp->window->connrows = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)gtk_tree_row_reference_free);
 }
 
 gboolean mmgui_main_traffic_limits_show_message_from_thread(gpointer data)
 {
 	mmgui_application_data_t mmguiappdata;
-	guint eventid;
-	gchar *notifycaption, *notifytext;
+	guint eventid, percent;
+	gchar *notifycaption, *notifytext, *warningtext;
 	enum _mmgui_notifications_sound soundmode;
 	
 	mmguiappdata = (mmgui_application_data_t)data;
 	
 	if (mmguiappdata == NULL) return FALSE;
 	
-	eventid = GPOINTER_TO_INT(mmguiappdata->data);
+	eventid = GPOINTER_TO_UINT(mmguiappdata->data) & 0xffff;
+	percent = GPOINTER_TO_UINT(mmguiappdata->data) >> 16;
+	warningtext = NULL;
 	
 	if (mmguiappdata->mmguiapp->coreoptions != NULL) {
 		//Various limits
@@ -536,6 +714,16 @@ gboolean mmgui_main_traffic_limits_show_message_from_thread(gpointer data)
 				notifycaption = _("Time limit exceeded");
 				notifytext = mmguiappdata->mmguiapp->coreoptions->timemessage;
 				break;
+			case MMGUI_EVENT_TRAFFIC_LIMIT_WARNING:
+				notifycaption = _("Traffic limit warning");
+				warningtext = g_strdup_printf(_("%u%% of traffic limit used"), percent);
+				notifytext = warningtext;
+				break;
+			case MMGUI_EVENT_TIME_LIMIT_WARNING:
+				notifycaption = _("Time limit warning");
+				warningtext = g_strdup_printf(_("%u%% of time limit used"), percent);
+				notifytext = warningtext;
+				break;
 			default:
 				g_debug("Unknown limit identifier");
 				return FALSE;
@@ -549,6 +737,8 @@ gboolean mmgui_main_traffic_limits_show_message_from_thread(gpointer data)
 		}
 		
 		mmgui_notifications_show(mmguiappdata->mmguiapp->notifications, notifycaption, notifytext, soundmode, mmgui_main_traffic_limits_notification_show_window_callback, mmguiappdata);
+		
+		g_free(warningtext);
 	}
 	
 	g_free(mmguiappdata);
@@ -629,12 +819,14 @@ void mmgui_main_traffic_limits_dialog(mmgui_application_t mmguiapp)
 	gtk_combo_box_set_active(GTK_COMBO_BOX(mmguiapp->window->trafficunits), mmguiapp->coreoptions->trafficunits);
 	gtk_entry_set_text(GTK_ENTRY(mmguiapp->window->trafficmessage), mmguiapp->coreoptions->trafficmessage);
 	gtk_combo_box_set_active(GTK_COMBO_BOX(mmguiapp->window->trafficaction), mmguiapp->coreoptions->trafficaction);
+	gtk_combo_box_set_active(GTK_COMBO_BOX(mmguiapp->window->trafficperiod), mmguiapp->coreoptions->trafficperiod);
 	
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(mmguiapp->window->timelimitcheckbutton), mmguiapp->coreoptions->timeenabled);
 	gtk_spin_button_set_value(GTK_SPIN_BUTTON(mmguiapp->window->timeamount), (gdouble)mmguiapp->coreoptions->timeamount);
 	gtk_combo_box_set_active(GTK_COMBO_BOX(mmguiapp->window->timeunits), mmguiapp->coreoptions->timeunits);
 	gtk_entry_set_text(GTK_ENTRY(mmguiapp->window->timemessage), mmguiapp->coreoptions->timemessage);
 	gtk_combo_box_set_active(GTK_COMBO_BOX(mmguiapp->window->timeaction), mmguiapp->coreoptions->timeaction);
+	gtk_combo_box_set_active(GTK_COMBO_BOX(mmguiapp->window->timeperiod), mmguiapp->coreoptions->timeperiod);
 	
 	if (mmgui_main_traffic_limits_dialog_open(mmguiapp)) {
 		if (mmguiapp->coreoptions != NULL) {
@@ -648,6 +840,7 @@ void mmgui_main_traffic_limits_dialog(mmgui_application_t mmguiapp)
 			mmguiapp->coreoptions->trafficunits = gtk_combo_box_get_active(GTK_COMBO_BOX(mmguiapp->window->trafficunits));
 			mmguiapp->coreoptions->trafficmessage = g_strdup(gtk_entry_get_text(GTK_ENTRY(mmguiapp->window->trafficmessage)));
 			mmguiapp->coreoptions->trafficaction = gtk_combo_box_get_active(GTK_COMBO_BOX(mmguiapp->window->trafficaction));
+			mmguiapp->coreoptions->trafficperiod = gtk_combo_box_get_active(GTK_COMBO_BOX(mmguiapp->window->trafficperiod));
 			
 			switch (mmguiapp->coreoptions->trafficunits) {
 				case 0:
@@ -666,7 +859,8 @@ void mmgui_main_traffic_limits_dialog(mmgui_application_t mmguiapp)
 			
 			mmguiapp->coreoptions->trafficexecuted = FALSE;
 			
-			if (device != NULL) {
+			/*Day and month usage is only known to core, exceeded limit fires there*/
+			if ((device != NULL) && (mmguiapp->coreoptions->trafficperiod == MMGUI_LIMIT_PERIOD_SESSION)) {
 				if ((device->connected) && (mmguiapp->coreoptions->trafficenabled) && (mmguiapp->coreoptions->trafficfull < (device->rxbytes + device->txbytes))) {
 					mmguiapp->coreoptions->trafficexecuted = TRUE;
 				}
@@ -682,6 +876,7 @@ void mmgui_main_traffic_limits_dialog(mmgui_application_t mmguiapp)
 			mmguiapp->coreoptions->timeunits = gtk_combo_box_get_active(GTK_COMBO_BOX(mmguiapp->window->timeunits));
 			mmguiapp->coreoptions->timemessage = g_strdup(gtk_entry_get_text(GTK_ENTRY(mmguiapp->window->timemessage)));
 			mmguiapp->coreoptions->timeaction = gtk_combo_box_get_active(GTK_COMBO_BOX(mmguiapp->window->timeaction));
+			mmguiapp->coreoptions->timeperiod = gtk_combo_box_get_active(GTK_COMBO_BOX(mmguiapp->window->timeperiod));
 			
 			switch (mmguiapp->coreoptions->timeunits) {
 				case 0:
@@ -697,7 +892,7 @@ void mmgui_main_traffic_limits_dialog(mmgui_application_t mmguiapp)
 			
 			mmguiapp->coreoptions->timeexecuted = FALSE;
 			
-			if (device != NULL) {
+			if ((device != NULL) && (mmguiapp->coreoptions->timeperiod == MMGUI_LIMIT_PERIOD_SESSION)) {
 				if ((device->connected) && (mmguiapp->coreoptions->timeenabled) && (mmguiapp->coreoptions->timefull < device->sessiontime)) {
 					mmguiapp->coreoptions->timeexecuted = TRUE;
 				}
@@ -710,12 +905,17 @@ void mmgui_main_traffic_limits_dialog(mmgui_application_t mmguiapp)
 			mmgui_modem_settings_set_int(mmguiapp->modemsettings, "limits_traffic_units", (guint)mmguiapp->coreoptions->trafficunits);
 			mmgui_modem_settings_set_string(mmguiapp->modemsettings, "limits_traffic_message", mmguiapp->coreoptions->trafficmessage);
 			mmgui_modem_settings_set_int(mmguiapp->modemsettings, "limits_traffic_action", (guint)mmguiapp->coreoptions->trafficaction);
+			mmgui_modem_settings_set_int(mmguiapp->modemsettings, "limits_traffic_period", (guint)mmguiapp->coreoptions->trafficperiod);
 			/*Time*/
 			mmgui_modem_settings_set_boolean(mmguiapp->modemsettings, "limits_time_enabled", mmguiapp->coreoptions->timeenabled);
 			mmgui_modem_settings_set_int(mmguiapp->modemsettings, "limits_time_amount", (guint)mmguiapp->coreoptions->timeamount);
 			mmgui_modem_settings_set_int(mmguiapp->modemsettings, "limits_time_units", (guint)mmguiapp->coreoptions->timeunits);
 			mmgui_modem_settings_set_string(mmguiapp->modemsettings, "limits_time_message", mmguiapp->coreoptions->timemessage);
 			mmgui_modem_settings_set_int(mmguiapp->modemsettings, "limits_time_action", (guint)mmguiapp->coreoptions->timeaction);
+			mmgui_modem_settings_set_int(mmguiapp->modemsettings, "limits_time_period", (guint)mmguiapp->coreoptions->timeperiod);
+			
+			/*Thresholds are recomputed by core*/
+			mmguicore_traffic_limits_update(mmguiapp->core);
 			
 			if (device != NULL) {
 				if ((mmguiapp->coreoptions->trafficexecuted) || (mmguiapp->coreoptions->timeexecuted)) {
@@ -757,6 +957,20 @@ void mmgui_main_traffic_limits_dialog_button_clicked_signal(GObject *object, gpo
 	mmgui_main_traffic_limits_dialog(mmguiapp);
 }
 
+static gchar *mmgui_main_traffic_format_speed_stats(struct _mmgui_speed_stats *stats, gchar *buffer, gsize bufsize)
+{
+	gchar meanstr[32], p95str[32], maxstr[32];
+	
+	if ((stats == NULL) || (buffer == NULL) || (bufsize == 0)) return NULL;
+	
+	g_snprintf(buffer, bufsize, "<small><b>%s / %s / %s</b></small>",
+				mmgui_str_format_speed(stats->mean, meanstr, sizeof(meanstr), FALSE),
+				mmgui_str_format_speed(stats->p95, p95str, sizeof(p95str), FALSE),
+				mmgui_str_format_speed(stats->max, maxstr, sizeof(maxstr), FALSE));
+	
+	return buffer;
+}
+
 gboolean mmgui_main_traffic_stats_update_from_thread(gpointer data)
 {
 	mmgui_application_t mmguiapp;
@@ -766,9 +980,9 @@ gboolean mmgui_main_traffic_stats_update_from_thread(gpointer data)
 	GtkTreeIter sectioniter, elementiter;
 	gboolean sectionvalid, elementvalid;
 	gint id;
-	gchar buffer[64];
-	gfloat speed;
-	guint64 limitleft;
+	gchar buffer[128];
+	struct _mmgui_speed_snapshot speedsnapshot;
+	guint64 limitleft, trafficused, timeused;
 	GdkWindow *window;
 	gboolean visible;
 	
@@ -780,6 +994,15 @@ gboolean mmgui_main_traffic_stats_update_from_thread(gpointer data)
 	
 	trafficdb = (mmgui_trafficdb_t)mmguicore_devices_get_traffic_db(mmguiapp->core);
 	
+	/*Consistent speed statistics without locking work thread*/
+	memset(&speedsnapshot, 0, sizeof(speedsnapshot));
+	mmgui_speed_history_snapshot(mmguiapp->core->device->speedhistory, &speedsnapshot, NULL, NULL, 0);
+	
+	/*Usage in current limit windows*/
+	trafficused = 0;
+	timeused = 0;
+	mmguicore_traffic_limits_get_usage(mmguiapp->core, &trafficused, &timeused);
+	
 	/*Update traffic statistics*/
 	model = gtk_tree_view_get_model(GTK_TREE_VIEW(mmguiapp->window->trafficparamslist));
 	if (model != NULL) {
@@ -804,28 +1027,16 @@ gboolean mmgui_main_traffic_stats_update_from_thread(gpointer data)
 									gtk_tree_store_set(GTK_TREE_STORE(model), &elementiter, MMGUI_MAIN_TRAFFICLIST_VALUE, mmgui_str_format_bytes(device->txbytes, buffer, sizeof(buffer), TRUE), -1);
 									break;
 								case MMGUI_MAIN_TRAFFICLIST_ID_RXSPEED:
-									if (device->speedindex < MMGUI_SPEED_VALUES_NUMBER) {
-										if (device->speedindex == 0) {
-											speed = device->speedvalues[0][device->speedindex];
-										} else {
-											speed = device->speedvalues[0][device->speedindex-1];
-										}
-									} else {
-										speed = device->speedvalues[0][MMGUI_SPEED_VALUES_NUMBER-1];
-									}
-									gtk_tree_store_set(GTK_TREE_STORE(model), &elementiter, MMGUI_MAIN_TRAFFICLIST_VALUE, mmgui_str_format_speed(speed, buffer, sizeof(buffer), TRUE), -1);
+									gtk_tree_store_set(GTK_TREE_STORE(model), &elementiter, MMGUI_MAIN_TRAFFICLIST_VALUE, mmgui_str_format_speed(speedsnapshot.stats[MMGUI_SPEED_HISTORY_RX].last, buffer, sizeof(buffer), TRUE), -1);
 									break;
 								case MMGUI_MAIN_TRAFFICLIST_ID_TXSPEED:
-									if (device->speedindex < MMGUI_SPEED_VALUES_NUMBER) {
-										if (device->speedindex == 0) {
-											speed = device->speedvalues[1][device->speedindex];
-										} else {
-											speed = device->speedvalues[1][device->speedindex-1];
-										}
-									} else {
-										speed = device->speedvalues[1][MMGUI_SPEED_VALUES_NUMBER-1];
-									}
-									gtk_tree_store_set(GTK_TREE_STORE(model), &elementiter, MMGUI_MAIN_TRAFFICLIST_VALUE, mmgui_str_format_speed(speed, buffer, sizeof(buffer), TRUE), -1);
+									gtk_tree_store_set(GTK_TREE_STORE(model), &elementiter, MMGUI_MAIN_TRAFFICLIST_VALUE, mmgui_str_format_speed(speedsnapshot.stats[MMGUI_SPEED_HISTORY_TX].last, buffer, sizeof(buffer), TRUE), -1);
+									break;
+								case MMGUI_MAIN_TRAFFICLIST_ID_RXSPEED_STATS:
+									gtk_tree_store_set(GTK_TREE_STORE(model), &elementiter, MMGUI_MAIN_TRAFFICLIST_VALUE, mmgui_main_traffic_format_speed_stats(&speedsnapshot.stats[MMGUI_SPEED_HISTORY_RX], buffer, sizeof(buffer)), -1);
+									break;
+								case MMGUI_MAIN_TRAFFICLIST_ID_TXSPEED_STATS:
+									gtk_tree_store_set(GTK_TREE_STORE(model), &elementiter, MMGUI_MAIN_TRAFFICLIST_VALUE, mmgui_main_traffic_format_speed_stats(&speedsnapshot.stats[MMGUI_SPEED_HISTORY_TX], buffer, sizeof(buffer)), -1);
 									break;
 								case MMGUI_MAIN_TRAFFICLIST_ID_TIME:
 									if (device->connected) {
@@ -839,8 +1050,8 @@ gboolean mmgui_main_traffic_stats_update_from_thread(gpointer data)
 										if (mmguiapp->coreoptions != NULL) {
 											if (!mmguiapp->coreoptions->trafficexecuted) {
 												if (mmguiapp->coreoptions->trafficenabled) {
-													limitleft = mmguiapp->coreoptions->trafficfull - (device->rxbytes + device->txbytes);
-													if (mmguiapp->coreoptions->trafficfull > (device->rxbytes + device->txbytes)) {
+													limitleft = mmguiapp->coreoptions->trafficfull - trafficused;
+													if (mmguiapp->coreoptions->trafficfull > trafficused) {
 														gtk_tree_store_set(GTK_TREE_STORE(model), &elementiter, MMGUI_MAIN_TRAFFICLIST_VALUE, mmgui_str_format_bytes(limitleft, buffer, sizeof(buffer), TRUE), -1);
 													} else {
 														gtk_tree_store_set(GTK_TREE_STORE(model), &elementiter, MMGUI_MAIN_TRAFFICLIST_VALUE, _("<small><b>Limit</b></small>"), -1);
@@ -863,8 +1074,8 @@ gboolean mmgui_main_traffic_stats_update_from_thread(gpointer data)
 										if (mmguiapp->coreoptions != NULL) {
 											if (!mmguiapp->coreoptions->timeexecuted) {
 												if (mmguiapp->coreoptions->timeenabled) {
-													limitleft = mmguiapp->coreoptions->timefull - device->sessiontime;
-													if (mmguiapp->coreoptions->timefull > device->sessiontime) {
+													limitleft = mmguiapp->coreoptions->timefull - timeused;
+													if (mmguiapp->coreoptions->timefull > timeused) {
 														gtk_tree_store_set(GTK_TREE_STORE(model), &elementiter, MMGUI_MAIN_TRAFFICLIST_VALUE, mmgui_str_format_time(limitleft, buffer, sizeof(buffer), TRUE), -1);
 													} else {
 														gtk_tree_store_set(GTK_TREE_STORE(model), &elementiter, MMGUI_MAIN_TRAFFICLIST_VALUE, _("<small><b>Limit</b></small>"), -1);
@@ -910,6 +1121,10 @@ gboolean mmgui_main_traffic_stats_update_from_thread(gpointer data)
 			}
 			sectionvalid = gtk_tree_model_iter_next(GTK_TREE_MODEL(model), &sectioniter);
 		}
+		/*Per-application breakdown is read from database, so only while page is shown*/
+		if (gtk_notebook_get_current_page(GTK_NOTEBOOK(mmguiapp->window->notebook)) == MMGUI_MAIN_PAGE_TRAFFIC) {
+			mmgui_main_traffic_applications_update(mmguiapp, model, trafficdb);
+		}
 	}
 	/*Update traffic graph*/
 	window = gtk_widget_get_window(mmguiapp->window->trafficdrawingarea);
@@ -923,16 +1138,125 @@ gboolean mmgui_main_traffic_stats_update_from_thread(gpointer data)
 	return FALSE;
 }
 
+static void mmgui_main_traffic_applications_update(mmgui_application_t mmguiapp, GtkTreeModel *model, mmgui_trafficdb_t trafficdb)
+{
+	GtkTreeIter sectioniter, elementiter;
+	GtkTreePath *sectionpath;
+	gboolean sectionvalid, expand;
+	gint id;
+	GSList *applist, *iterator;
+	mmgui_app_traffic_t apptraffic;
+	gchar *appcaption, *appvalue;
+	gchar rxbuffer[64], txbuffer[64];
+	guint generation;
+	time_t currenttime;
+	
+	if ((mmguiapp == NULL) || (model == NULL)) return;
+	
+	/*Database is read only when totals changed, at most once per interval, and rows are refreshed after day change*/
+	currenttime = time(NULL);
+	generation = mmgui_trafficdb_application_usage_generation(trafficdb);
+	if (((gpointer)trafficdb == mmguiapp->window->trafficappsdb) && (difftime(currenttime, mmguiapp->window->trafficappstime) < MMGUI_MAIN_TRAFFIC_APPLICATIONS_MAX_AGE)) {
+		if (generation == mmguiapp->window->trafficappsgeneration) return;
+		if (difftime(currenttime, mmguiapp->window->trafficappstime) < MMGUI_MAIN_TRAFFIC_APPLICATIONS_INTERVAL) return;
+	}
+	
+	mmguiapp->window->trafficappsdb = (gpointer)trafficdb;
+	mmguiapp->window->trafficappsgeneration = generation;
+	mmguiapp->window->trafficappstime = currenttime;
+	
+	/*Find applications section*/
+	sectionvalid = gtk_tree_model_get_iter_first(model, &sectioniter);
+	while (sectionvalid) {
+		gtk_tree_model_get(model, &sectioniter, MMGUI_MAIN_TRAFFICLIST_ID, &id, -1);
+		if (id == MMGUI_MAIN_TRAFFICLIST_ID_APPLICATIONS) break;
+		sectionvalid = gtk_tree_model_iter_next(model, &sectioniter);
+	}
+	
+	if (!sectionvalid) return;
+	
+	/*Section is expanded when first rows appear*/
+	expand = !gtk_tree_model_iter_has_child(model, &sectioniter);
+	
+	/*Rows are rebuilt because order changes with usage*/
+	while (gtk_tree_model_iter_children(model, &elementiter, &sectioniter)) {
+		gtk_tree_store_remove(GTK_TREE_STORE(model), &elementiter);
+	}
+	
+	applist = mmgui_trafficdb_application_usage_read(trafficdb, time(NULL));
+	
+	if (applist == NULL) return;
+	
+	for (iterator = applist; iterator != NULL; iterator = iterator->next) {
+		apptraffic = (mmgui_app_traffic_t)iterator->data;
+		appcaption = g_markup_printf_escaped("<small><b>%s</b></small>", apptraffic->appname);
+		appvalue = g_strdup_printf("%s / %s", mmgui_str_format_bytes(apptraffic->rxbytes, rxbuffer, sizeof(rxbuffer), TRUE), mmgui_str_format_bytes(apptraffic->txbytes, txbuffer, sizeof(txbuffer), TRUE));
+		gtk_tree_store_append(GTK_TREE_STORE(model), &elementiter, &sectioniter);
+		gtk_tree_store_set(GTK_TREE_STORE(model), &elementiter, MMGUI_MAIN_TRAFFICLIST_PARAMETER, appcaption, MMGUI_MAIN_TRAFFICLIST_VALUE, appvalue, MMGUI_MAIN_TRAFFICLIST_ID, MMGUI_MAIN_TRAFFICLIST_ID_APPLICATION, -1);
+		g_free(appcaption);
+		g_free(appvalue);
+	}
+	
+	mmgui_trafficdb_application_usage_free_list(applist);
+	
+	if (expand) {
+		sectionpath = gtk_tree_model_get_path(model, &sectioniter);
+		gtk_tree_view_expand_row(GTK_TREE_VIEW(mmguiapp->window->trafficparamslist), sectionpath, FALSE);
+		gtk_tree_path_free(sectionpath);
+	}
+}
+
+static void mmgui_main_traffic_speed_plot_draw_series(cairo_t *cr, gfloat *values, guint count, guint length, gint graphlen, gint height, gfloat maxvalue, gboolean righttoleft, gdouble r, gdouble g, gdouble b)
+{
+	guint i;
+	gdouble step, x, y;
+	gboolean points;
+	
+	if ((cr == NULL) || (values == NULL) || (count == 0) || (length < 2)) return;
+	
+	step = graphlen / (gdouble)(length - 1);
+	/*Point markers only make sense while they do not overlap*/
+	points = (step >= 6.0);
+	
+	cairo_set_source_rgba(cr, r, g, b, 1.0);
+	cairo_set_line_width(cr, 2.5);
+	cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
+	
+	/*Newest sample is drawn at graph origin*/
+	for (i=0; i<count; i++) {
+		if (righttoleft) {
+			x = graphlen + 30 - (count - 1 - i) * step;
+		} else {
+			x = 30 + (count - 1 - i) * step;
+		}
+		y = height - 30 - (gint)(values[i] * ((height - 60) / maxvalue));
+		if (i == 0) {
+			cairo_move_to(cr, x, y);
+		} else {
+			cairo_line_to(cr, x, y);
+		}
+		if (points) {
+			cairo_arc(cr, x, y, 2.0, 0*(3.14/180.0), 360*(3.14/180.0));
+			cairo_move_to(cr, x, y);
+		}
+	}
+	
+	cairo_stroke(cr);
+}
+
 void mmgui_main_traffic_speed_plot_draw(GtkWidget *widget, cairo_t *cr, gpointer data)
 {
 	gint width, height;
-	gint i, c, graphlen;
+	gint i, graphlen;
 	gfloat maxvalue;
 	gchar strbuffer[32];
 	const gdouble dashed[1] = {1.0};
 	mmgui_application_t mmguiapp;
 	mmguidevice_t device;
 	gdouble rxr, rxg, rxb, txr, txg, txb;
+	struct _mmgui_speed_snapshot snapshot;
+	gfloat *rxvalues, *txvalues;
+	guint length, count;
 	
 	mmguiapp = (mmgui_application_t)data;
 	if (mmguiapp == NULL) return;
@@ -961,15 +1285,22 @@ void mmgui_main_traffic_speed_plot_draw(GtkWidget *widget, cairo_t *cr, gpointer
 	#endif
 	
 	maxvalue = 100.0;
+	count = 0;
+	rxvalues = NULL;
+	txvalues = NULL;
+	
+	/*Consistent copy of speed history, maximum comes with it*/
+	length = mmgui_speed_history_get_length(device->speedhistory);
+	if (length < MMGUI_SPEED_HISTORY_MIN_LENGTH) {
+		length = MMGUI_SPEED_HISTORY_MIN_LENGTH;
+	}
 	
-	if ((device->connected) && (device->speedindex > 0)) {
-		for (i=device->speedindex-1; i>=0; i--) {
-			if (device->speedvalues[0][i] > maxvalue) {
-				maxvalue = device->speedvalues[0][i];
-			}
-			if (device->speedvalues[1][i] > maxvalue) {
-				maxvalue = device->speedvalues[1][i];
-			}
+	if ((device->connected) && (device->speedhistory != NULL)) {
+		rxvalues = g_new(gfloat, length);
+		txvalues = g_new(gfloat, length);
+		count = mmgui_speed_history_snapshot(device->speedhistory, &snapshot, rxvalues, txvalues, length);
+		if (count > 0) {
+			maxvalue = MAX(snapshot.stats[MMGUI_SPEED_HISTORY_RX].max, snapshot.stats[MMGUI_SPEED_HISTORY_TX].max);
 		}
 	}
 	
@@ -1025,9 +1356,9 @@ void mmgui_main_traffic_speed_plot_draw(GtkWidget *widget, cairo_t *cr, gpointer
 		cairo_move_to(cr, 30-5+(i*(gint)((width-60)/19.0)), height-8);
 		memset(strbuffer, 0, sizeof(strbuffer));
 		if (mmguiapp->options->graphrighttoleft) {
-			g_snprintf(strbuffer, sizeof(strbuffer), "%i", (19-i+1)*MMGUI_THREAD_SLEEP_PERIOD);
+			g_snprintf(strbuffer, sizeof(strbuffer), "%u", (length-(guint)(i*(length-1)/19.0+0.5))*MMGUI_THREAD_SLEEP_PERIOD);
 		} else {
-			g_snprintf(strbuffer, sizeof(strbuffer), "%i", (i+1)*MMGUI_THREAD_SLEEP_PERIOD);
+			g_snprintf(strbuffer, sizeof(strbuffer), "%u", ((guint)(i*(length-1)/19.0+0.5)+1)*MMGUI_THREAD_SLEEP_PERIOD);
 		}
 		cairo_show_text(cr, strbuffer);
 	}
@@ -1037,71 +1368,18 @@ void mmgui_main_traffic_speed_plot_draw(GtkWidget *widget, cairo_t *cr, gpointer
 	
 	cairo_stroke(cr);
 	
-	if ((device != NULL) && (device->connected) && (device->speedindex > 0)) {
-		cairo_set_source_rgba(cr, txr, txg, txb, 1.0);
-		cairo_set_line_width(cr, 2.5);
-		cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND); 
-		if (mmguiapp->options->graphrighttoleft) {
-			c = device->speedindex-1;
-			for (i=0; i<device->speedindex; i++) {
-				if (i == device->speedindex-1) {
-					cairo_arc(cr, graphlen+30, height-30-(gint)(device->speedvalues[1][i]*((height-60)/maxvalue)), 2.0, 0*(3.14/180.0), 360*(3.14/180.0));
-					cairo_move_to(cr, graphlen+30, height-30-(gint)(device->speedvalues[1][i]*((height-60)/maxvalue)));
-				} else {
-					cairo_line_to(cr, graphlen+30-(c*(gint)((width-60)/19.0)), height-30-(gint)(device->speedvalues[1][i]*((height-60)/maxvalue)));
-					cairo_arc(cr, graphlen+30-(c*(gint)((width-60)/19.0)), height-30-(gint)(device->speedvalues[1][i]*((height-60)/maxvalue)), 2.0, 0*(3.14/180.0), 360*(3.14/180.0));
-					cairo_move_to(cr, graphlen+30-(c*(gint)((width-60)/19.0)), height-30-(gint)(device->speedvalues[1][i]*((height-60)/maxvalue)));
-					c--;
-				}
-			}
-		} else {
-			c = device->speedindex-1;
-			for (i=0; i<device->speedindex; i++) {
-				if (i == device->speedindex-1) {
-					cairo_arc(cr, 30, height-30-(gint)(device->speedvalues[1][i]*((height-60)/maxvalue)), 2.0, 0*(3.14/180.0), 360*(3.14/180.0));
-					cairo_move_to(cr, 30, height-30-(gint)(device->speedvalues[1][i]*((height-60)/maxvalue)));
-				} else {
-					cairo_line_to(cr, 30+(c*(gint)((width-60)/19.0)), height-30-(gint)(device->speedvalues[1][i]*((height-60)/maxvalue)));
-					cairo_arc(cr, 30+(c*(gint)((width-60)/19.0)), height-30-(gint)(device->speedvalues[1][i]*((height-60)/maxvalue)), 2.0, 0*(3.14/180.0), 360*(3.14/180.0));
-					cairo_move_to(cr, 30+(c*(gint)((width-60)/19.0)), height-30-(gint)(device->speedvalues[1][i]*((height-60)/maxvalue)));
-					c--;
-				}
-			}
-		}
-		cairo_stroke(cr);
-		
-		cairo_set_source_rgba(cr, rxr, rxg, rxb, 1.0);
-		cairo_set_line_width(cr, 2.5);
-		cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND); 
-		if (mmguiapp->options->graphrighttoleft) {
-			c = device->speedindex-1;
-			for (i=0; i<device->speedindex; i++) {
-				if (i == device->speedindex-1) {
-					cairo_arc(cr, graphlen+30, height-30-(gint)(device->speedvalues[0][i]*((height-60)/maxvalue)), 2.0, 0*(3.14/180.0), 360*(3.14/180.0));
-					cairo_move_to(cr, graphlen+30, height-30-(gint)(device->speedvalues[0][i]*((height-60)/maxvalue)));
-				} else {
-					cairo_line_to(cr, graphlen+30-(c*(gint)((width-60)/19.0)), height-30-(gint)(device->speedvalues[0][i]*((height-60)/maxvalue)));
-					cairo_arc(cr, graphlen+30-(c*(gint)((width-60)/19.0)), height-30-(gint)(device->speedvalues[0][i]*((height-60)/maxvalue)), 2.0, 0*(3.14/180.0), 360*(3.14/180.0));
-					cairo_move_to(cr, graphlen+30-(c*(gint)((width-60)/19.0)), height-30-(gint)(device->speedvalues[0][i]*((height-60)/maxvalue)));
-					c--;
-				}
-			}
-		} else {
-			c = device->speedindex-1;
-			for (i=0; i<device->speedindex; i++) {
-				if (i == device->speedindex-1) {
-					cairo_arc(cr, 30, height-30-(gint)(device->speedvalues[0][i]*((height-60)/maxvalue)), 2.0, 0*(3.14/180.0), 360*(3.14/180.0));
-					cairo_move_to(cr, 30, height-30-(gint)(device->speedvalues[0][i]*((height-60)/maxvalue)));
-				} else {
-					cairo_line_to(cr, 30+(c*(gint)((width-60)/19.0)), height-30-(gint)(device->speedvalues[0][i]*((height-60)/maxvalue)));
-					cairo_arc(cr, 30+(c*(gint)((width-60)/19.0)), height-30-(gint)(device->speedvalues[0][i]*((height-60)/maxvalue)), 2.0, 0*(3.14/180.0), 360*(3.14/180.0));
-					cairo_move_to(cr, 30+(c*(gint)((width-60)/19.0)), height-30-(gint)(device->speedvalues[0][i]*((height-60)/maxvalue)));
-					c--;
-				}
-			}
-		}
-		cairo_stroke(cr);
+	if (count > 0) {
+		mmgui_main_traffic_speed_plot_draw_series(cr, txvalues, count, length, graphlen, height, maxvalue, mmguiapp->options->graphrighttoleft, txr, txg, txb);
+		mmgui_main_traffic_speed_plot_draw_series(cr, rxvalues, count, length, graphlen, height, maxvalue, mmguiapp->options->graphrighttoleft, rxr, rxg, rxb);
+	}
+	
+	if (rxvalues != NULL) {
+		g_free(rxvalues);
+	}
+	if (txvalues != NULL) {
+		g_free(txvalues);
 	}
+	
 	//RX speed
 	cairo_set_source_rgba(cr, rxr, rxg, rxb, 1.0);
 	cairo_set_line_width(cr, 2.5);
@@ -1141,6 +1419,28 @@ void mmgui_main_traffic_speed_plot_draw(GtkWidget *widget, cairo_t *cr, gpointer
 	cairo_stroke(cr);
 }
 
+void mmgui_main_traffic_speed_plot_map_signal(GtkWidget *widget, gpointer data)
+{
+	mmgui_application_t mmguiapp;
+	
+	mmguiapp = (mmgui_application_t)data;
+	if (mmguiapp == NULL) return;
+	
+	/*Graph is on screen - sample traffic often*/
+	mmguicore_traffic_set_live_sampling(mmguiapp->core, TRUE);
+}
+
+void mmgui_main_traffic_speed_plot_unmap_signal(GtkWidget *widget, gpointer data)
+{
+	mmgui_application_t mmguiapp;
+	
+	mmguiapp = (mmgui_application_t)data;
+	if (mmguiapp == NULL) return;
+	
+	/*Page switched or window hidden - back to slow sampling*/
+	mmguicore_traffic_set_live_sampling(mmguiapp->core, FALSE);
+}
+
 void mmgui_main_traffic_list_init(mmgui_application_t mmguiapp)
 {
 	GtkCellRenderer *renderer;
@@ -1177,6 +1477,12 @@ void mmgui_main_traffic_list_init(mmgui_application_t mmguiapp)
 	gtk_tree_store_append(store, &subiter, &iter);
 	gtk_tree_store_set(store, &subiter, MMGUI_MAIN_TRAFFICLIST_PARAMETER, _("<small><b>Transmit speed</b></small>"), MMGUI_MAIN_TRAFFICLIST_ID, MMGUI_MAIN_TRAFFICLIST_ID_TXSPEED, -1);
 	
+	gtk_tree_store_append(store, &subiter, &iter);
+	gtk_tree_store_set(store, &subiter, MMGUI_MAIN_TRAFFICLIST_PARAMETER, _("<small><b>Receive avg/95%/max</b></small>"), MMGUI_MAIN_TRAFFICLIST_ID, MMGUI_MAIN_TRAFFICLIST_ID_RXSPEED_STATS, -1);
+	
+	gtk_tree_store_append(store, &subiter, &iter);
+	gtk_tree_store_set(store, &subiter, MMGUI_MAIN_TRAFFICLIST_PARAMETER, _("<small><b>Transmit avg/95%/max</b></small>"), MMGUI_MAIN_TRAFFICLIST_ID, MMGUI_MAIN_TRAFFICLIST_ID_TXSPEED_STATS, -1);
+	
 	gtk_tree_store_append(store, &subiter, &iter);
 	gtk_tree_store_set(store, &subiter, MMGUI_MAIN_TRAFFICLIST_PARAMETER, _("<small><b>Session time</b></small>"), MMGUI_MAIN_TRAFFICLIST_ID, MMGUI_MAIN_TRAFFICLIST_ID_TIME, -1);
 	
@@ -1210,6 +1516,10 @@ void mmgui_main_traffic_list_init(mmgui_application_t mmguiapp)
 	gtk_tree_store_append(store, &subiter, &iter);
 	gtk_tree_store_set(store, &subiter, MMGUI_MAIN_TRAFFICLIST_PARAMETER, _("<small><b>Total time</b></small>"), MMGUI_MAIN_TRAFFICLIST_ID, MMGUI_MAIN_TRAFFICLIST_ID_TIME_YEAR, -1);
 	
+	/*Rows are filled from per-application usage of current day*/
+	gtk_tree_store_append(store, &iter, NULL);
+	gtk_tree_store_set(store, &iter, MMGUI_MAIN_TRAFFICLIST_PARAMETER, _("<small><b>Applications today (received / transmitted)</b></small>"), MMGUI_MAIN_TRAFFICLIST_ID, MMGUI_MAIN_TRAFFICLIST_ID_APPLICATIONS, -1);
+	
 	gtk_tree_view_set_model(GTK_TREE_VIEW(mmguiapp->window->trafficparamslist), GTK_TREE_MODEL(store));
 	
 	gtk_tree_view_expand_all(GTK_TREE_VIEW(mmguiapp->window->trafficparamslist));
@@ -1233,6 +1543,7 @@ void mmgui_main_traffic_restore_settings_for_modem(mmgui_application_t mmguiapp)
 	mmguiapp->coreoptions->trafficamount = (guint)mmgui_modem_settings_get_int(mmguiapp->modemsettings, "limits_traffic_amount", 150);
 	mmguiapp->coreoptions->trafficunits = (guint)mmgui_modem_settings_get_int(mmguiapp->modemsettings, "limits_traffic_units", 0);
 	mmguiapp->coreoptions->trafficaction = (guint)mmgui_modem_settings_get_int(mmguiapp->modemsettings, "limits_traffic_action", 0);
+	mmguiapp->coreoptions->trafficperiod = (guint)mmgui_modem_settings_get_int(mmguiapp->modemsettings, "limits_traffic_period", MMGUI_LIMIT_PERIOD_SESSION);
 	mmguiapp->coreoptions->trafficmessage = mmgui_modem_settings_get_string(mmguiapp->modemsettings, "limits_traffic_message", _("Traffic limit exceeded... It's time to take rest \\(^_^)/"));
 		
 	switch (mmguiapp->coreoptions->trafficunits) {
@@ -1263,6 +1574,7 @@ void mmgui_main_traffic_restore_settings_for_modem(mmgui_application_t mmguiapp)
 	mmguiapp->coreoptions->timeamount = (guint)mmgui_modem_settings_get_int(mmguiapp->modemsettings, "limits_time_amount", 60);
 	mmguiapp->coreoptions->timeunits = (guint)mmgui_modem_settings_get_int(mmguiapp->modemsettings, "limits_time_units", 0);
 	mmguiapp->coreoptions->timeaction = (guint)mmgui_modem_settings_get_int(mmguiapp->modemsettings, "limits_time_action", 0);
+	mmguiapp->coreoptions->timeperiod = (guint)mmgui_modem_settings_get_int(mmguiapp->modemsettings, "limits_time_period", MMGUI_LIMIT_PERIOD_SESSION);
 	
 	switch (mmguiapp->coreoptions->timeunits) {
 		case 0:
@@ -1277,4 +1589,7 @@ void mmgui_main_traffic_restore_settings_for_modem(mmgui_application_t mmguiapp)
 	}
 	
 	mmguiapp->coreoptions->timeexecuted = FALSE;
+	
+	/*Thresholds are recomputed by core*/
+	mmguicore_traffic_limits_update(mmguiapp->core);
 }
@@ -38,6 +38,8 @@ enum _mmgui_main_trafficlist_id {
 	MMGUI_MAIN_TRAFFICLIST_ID_TXDATA,
 	MMGUI_MAIN_TRAFFICLIST_ID_RXSPEED,
 	MMGUI_MAIN_TRAFFICLIST_ID_TXSPEED,
+	MMGUI_MAIN_TRAFFICLIST_ID_RXSPEED_STATS,
+	MMGUI_MAIN_TRAFFICLIST_ID_TXSPEED_STATS,
 	MMGUI_MAIN_TRAFFICLIST_ID_TIME,
 	MMGUI_MAIN_TRAFFICLIST_ID_DATALIMIT,
 	MMGUI_MAIN_TRAFFICLIST_ID_TIMELIMIT,
@@ -48,7 +50,10 @@ enum _mmgui_main_trafficlist_id {
 	
 	MMGUI_MAIN_TRAFFICLIST_ID_RXDATA_YEAR,
 	MMGUI_MAIN_TRAFFICLIST_ID_TXDATA_YEAR,
-	MMGUI_MAIN_TRAFFICLIST_ID_TIME_YEAR
+	MMGUI_MAIN_TRAFFICLIST_ID_TIME_YEAR,
+	
+	MMGUI_MAIN_TRAFFICLIST_ID_APPLICATIONS,
+	MMGUI_MAIN_TRAFFICLIST_ID_APPLICATION
 };
 
 enum _mmgui_main_connectionlist_columns {
@@ -99,6 +104,8 @@ void mmgui_main_traffic_limits_dialog_button_clicked_signal(GObject *object, gpo
 gboolean mmgui_main_traffic_stats_update_from_thread_foreach(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer data);
 gboolean mmgui_main_traffic_stats_update_from_thread(gpointer data);
 void mmgui_main_traffic_speed_plot_draw(GtkWidget *widget, cairo_t *cr, gpointer data);
+void mmgui_main_traffic_speed_plot_map_signal(GtkWidget *widget, gpointer data);
+void mmgui_main_traffic_speed_plot_unmap_signal(GtkWidget *widget, gpointer data);
 void mmgui_main_traffic_accelerators_init(mmgui_application_t mmguiapp);
 void mmgui_main_traffic_list_init(mmgui_application_t mmguiapp);
 void mmgui_main_traffic_restore_settings_for_modem(mmgui_application_t mmguiapp);
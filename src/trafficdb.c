@@ -17,6 +17,7 @@
  *      along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -26,6 +27,8 @@
 #include <ctype.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "trafficdb.h"
 
@@ -43,7 +46,95 @@ enum _mmgui_trafficdb_xml_elements {
 	TRAFFICDB_XML_PARAM_NULL
 };
 
-static gint mmgui_trafficdb_xml_parameter = TRAFFICDB_XML_PARAM_NULL;
+/*Journal of session counter deltas not yet written into day records*/
+#define TRAFFICDB_JOURNAL_MAGIC                 0x4a544d32
+#define TRAFFICDB_JOURNAL_INTERVAL              30
+#define TRAFFICDB_JOURNAL_MAGIC_OFFSET          0
+#define TRAFFICDB_JOURNAL_CHECKSUM_OFFSET       4
+#define TRAFFICDB_JOURNAL_DAY_TIME_OFFSET       8
+#define TRAFFICDB_JOURNAL_DAY_RX_OFFSET         16
+#define TRAFFICDB_JOURNAL_DAY_TX_OFFSET         24
+#define TRAFFICDB_JOURNAL_DAY_DURATION_OFFSET   32
+#define TRAFFICDB_JOURNAL_SESSION_TIME_OFFSET   40
+#define TRAFFICDB_JOURNAL_SESSION_RX_OFFSET     48
+#define TRAFFICDB_JOURNAL_SESSION_TX_OFFSET     56
+#define TRAFFICDB_JOURNAL_SESSION_DURATION_OFFSET 64
+#define TRAFFICDB_JOURNAL_RECORD_SIZE           72
+
+/*Time series ring file: header followed by fixed number of slots*/
+#define TRAFFICDB_SERIES_MAGIC                  0x534d544d
+#define TRAFFICDB_SERIES_VERSION                1
+#define TRAFFICDB_SERIES_MAGIC_OFFSET           0
+#define TRAFFICDB_SERIES_VERSION_OFFSET         4
+#define TRAFFICDB_SERIES_RESOLUTION_OFFSET      8
+#define TRAFFICDB_SERIES_SLOTS_OFFSET           12
+#define TRAFFICDB_SERIES_HEADER_SIZE            16
+#define TRAFFICDB_SERIES_SLOT_TIME_OFFSET       0
+#define TRAFFICDB_SERIES_SLOT_RX_OFFSET         8
+#define TRAFFICDB_SERIES_SLOT_TX_OFFSET         16
+#define TRAFFICDB_SERIES_SLOT_SIZE              24
+
+struct _mmgui_trafficdb_series_format {
+	const gchar *filename;
+	guint resolution;
+	guint slots;
+};
+
+static const struct _mmgui_trafficdb_series_format mmgui_trafficdb_series_formats[MMGUI_TRAFFICDB_SERIES_LEVELS] = {
+	{"traffic-seconds.ring", 1,    3600},
+	{"traffic-minutes.ring", 60,   7 * 24 * 60},
+	{"traffic-hours.ring",   3600, 366 * 24}
+};
+
+/*Day keys are grouped by month, totals are kept per month and year*/
+#define TRAFFICDB_INDEX_VERSION                 1
+#define TRAFFICDB_INDEX_VERSION_KEY             "index"
+#define TRAFFICDB_INDEX_MONTH_DAYS_KEY          "days:%04u-%02u"
+#define TRAFFICDB_INDEX_MONTH_TOTAL_KEY         "month:%04u-%02u"
+#define TRAFFICDB_INDEX_YEAR_TOTAL_KEY          "year:%04u"
+#define TRAFFICDB_INDEX_TOTAL_RX_OFFSET         0
+#define TRAFFICDB_INDEX_TOTAL_TX_OFFSET         8
+#define TRAFFICDB_INDEX_TOTAL_DURATION_OFFSET   16
+#define TRAFFICDB_INDEX_TOTAL_SIZE              24
+
+/*Application usage record: counters and name length followed by name*/
+#define TRAFFICDB_APPS_FILENAME                 "traffic-apps.gdbm"
+#define TRAFFICDB_APPS_RX_OFFSET                0
+#define TRAFFICDB_APPS_TX_OFFSET                8
+#define TRAFFICDB_APPS_NAME_LENGTH_OFFSET       16
+#define TRAFFICDB_APPS_HEADER_SIZE              20
+
+/*Cross-device reports*/
+#define TRAFFICDB_REPORT_MAX_THREADS            4
+#define TRAFFICDB_REPORT_OPEN_ATTEMPTS          5
+#define TRAFFICDB_REPORT_OPEN_DELAY             100000
+
+struct _mmgui_trafficdb_total {
+	gint64 rxbytes;
+	gint64 txbytes;
+	gint64 duration;
+};
+
+/*Days merged by report threads*/
+struct _mmgui_trafficdb_report_context {
+	guint month;
+	guint year;
+	GHashTable *days;
+	GMutex lock;
+};
+
+/*Database of one device read by report thread*/
+struct _mmgui_trafficdb_report_job {
+	gchar *filepath;
+	mmgui_traffic_device_report_t device;
+	mmgui_day_traffic_t liveday; /*running session of opened device*/
+};
+
+/*Parser state is kept per parse call*/
+struct _mmgui_trafficdb_xml_state {
+	mmgui_day_traffic_t traffic;
+	gint parameter;
+};
 
 static guint mmgui_trafficdb_get_month_days(guint month, guint year);
 static guint mmgui_trafficdb_get_year_days(guint year);
@@ -53,6 +144,44 @@ static time_t mmgui_trafficdb_get_month_end_timestamp(guint month, guint year);
 static time_t mmgui_trafficdb_get_year_begin_timestamp(guint year);
 static time_t mmgui_trafficdb_get_year_end_timestamp(guint year);
 
+static void mmgui_trafficdb_put_uint64(gchar *dest, guint64 value);
+static guint64 mmgui_trafficdb_get_uint64(const gchar *src);
+static guint32 mmgui_trafficdb_journal_checksum(const gchar *record);
+static gboolean mmgui_trafficdb_journal_record_decode(const gchar *record, mmgui_day_traffic_t traffic);
+static gboolean mmgui_trafficdb_journal_replay(mmgui_trafficdb_t trafficdb, time_t skipdaytime);
+static mmgui_day_traffic_t mmgui_trafficdb_journal_day_read(mmgui_trafficdb_t trafficdb, time_t daytime);
+static void mmgui_trafficdb_journal_checkpoint(mmgui_trafficdb_t trafficdb, time_t currenttime, gboolean force);
+static void mmgui_trafficdb_journal_reset(mmgui_trafficdb_t trafficdb, gboolean keepsession, time_t writtendaytime);
+
+static gint mmgui_trafficdb_series_open(const gchar *filepath, guint level);
+static gboolean mmgui_trafficdb_series_slot_read(gint fd, guint level, guint64 slottime, guint64 *rxbytes, guint64 *txbytes);
+static gboolean mmgui_trafficdb_series_slot_write(gint fd, guint level, guint64 slottime, guint64 rxbytes, guint64 txbytes);
+
+static gboolean mmgui_trafficdb_key_to_daytime(datum key, guint64 *daytime);
+static gboolean mmgui_trafficdb_key_is_index(datum key);
+static datum mmgui_trafficdb_key_from_daytime(guint64 daytime, gchar *buffer, gsize size);
+static void mmgui_trafficdb_day_month(guint64 daytime, guint *month, guint *year);
+static gboolean mmgui_trafficdb_total_read(GDBM_FILE db, const gchar *name, struct _mmgui_trafficdb_total *total);
+static void mmgui_trafficdb_total_add(GDBM_FILE db, const gchar *name, const struct _mmgui_trafficdb_total *delta);
+static GArray *mmgui_trafficdb_month_days_read(GDBM_FILE db, guint month, guint year);
+static GArray *mmgui_trafficdb_month_days_scan(GDBM_FILE db, guint month, guint year);
+static void mmgui_trafficdb_month_days_add(GDBM_FILE db, guint month, guint year, guint64 daytime);
+static gboolean mmgui_trafficdb_day_store(GDBM_FILE db, mmgui_day_traffic_t daytraffic, gboolean rebuild);
+static void mmgui_trafficdb_index_build(mmgui_trafficdb_t trafficdb);
+static gboolean mmgui_trafficdb_index_valid(GDBM_FILE db);
+static gboolean mmgui_trafficdb_index_first_month(GDBM_FILE db, guint *month, guint *year);
+static void mmgui_trafficdb_day_correct(mmgui_trafficdb_t trafficdb, mmgui_day_traffic_t daytraffic);
+/*Application usage*/
+static void mmgui_trafficdb_application_usage_flush(mmgui_trafficdb_t trafficdb);
+static GSList *mmgui_trafficdb_application_usage_decode(GDBM_FILE db, guint64 daytime, GHashTable *usage, GSList *applist);
+static gint mmgui_trafficdb_application_usage_compare(gconstpointer a, gconstpointer b);
+static void mmgui_trafficdb_application_usage_free(gpointer data);
+
+static void mmgui_trafficdb_report_worker(gpointer data, gpointer userdata);
+static void mmgui_trafficdb_report_merge(struct _mmgui_trafficdb_report_context *context, mmgui_traffic_device_report_t device, GSList *daylist);
+static gint mmgui_trafficdb_report_day_compare(gconstpointer a, gconstpointer b);
+static gint mmgui_trafficdb_report_device_compare(gconstpointer a, gconstpointer b);
+
 static mmgui_day_traffic_t mmgui_trafficdb_xml_parse(gchar *xml, gsize size);
 static void mmgui_trafficdb_xml_get_element(GMarkupParseContext *context, const gchar *element, const gchar **attr_names, const gchar **attr_values, gpointer data, GError **error);
 static void mmgui_trafficdb_xml_get_value(GMarkupParseContext *context, const gchar *text, gsize size, gpointer data, GError **error);
@@ -267,6 +396,7 @@ mmgui_trafficdb_t mmgui_trafficdb_open(const gchar *persistentid, const gchar *i
 	gchar filename[64];
 	const gchar *oldfilename;
 	time_t currenttime;
+	guint i;
 	
 	if (persistentid == NULL) return NULL;
 	
@@ -332,12 +462,48 @@ mmgui_trafficdb_t mmgui_trafficdb_open(const gchar *persistentid, const gchar *i
 	trafficdb->yearrxbytes = 0;
 	trafficdb->yeartxbytes = 0;
 	trafficdb->yearduration = 0;
+	trafficdb->journaltime = currenttime;
+	trafficdb->journalrxbytes = 0;
+	trafficdb->journaltxbytes = 0;
+	trafficdb->journalduration = 0;
+	
+	/*Journal lives next to database*/
+	trafficdb->journalpath = g_strconcat(newfilename, ".journal", NULL);
+	
+	/*Application usage is kept in its own database in the same directory*/
+	newfilepath = g_path_get_dirname(newfilename);
+	trafficdb->appspath = g_build_filename(newfilepath, TRAFFICDB_APPS_FILENAME, NULL);
+	g_free((gchar *)newfilepath);
+	trafficdb->apppending = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, mmgui_trafficdb_application_usage_free);
+	trafficdb->appdaytime = trafficdb->presdaytime;
+	trafficdb->appflushtime = currenttime;
+	trafficdb->appgeneration = 0;
+	g_mutex_init(&trafficdb->applock);
+	
+	/*Databases written before month index existed are indexed once*/
+	mmgui_trafficdb_index_build(trafficdb);
+	
+	/*Counters left by crashed session are moved into day records first*/
+	trafficdb->journalfd = -1;
+	trafficdb->journalpending = !mmgui_trafficdb_journal_replay(trafficdb, 0);
+	
+	trafficdb->journalfd = open(trafficdb->journalpath, O_WRONLY|O_CREAT|O_APPEND, S_IRUSR|S_IWUSR);
+	
+	if (trafficdb->journalfd == -1) {
+		g_warning("Unable to open traffic journal: %s", trafficdb->journalpath);
+	}
+	
+	for (i=0; i<MMGUI_TRAFFICDB_SERIES_LEVELS; i++) {
+		trafficdb->seriesfd[i] = mmgui_trafficdb_series_open(newfilename, i);
+	}
 	
 	return trafficdb;
 }
 
 gboolean mmgui_trafficdb_close(mmgui_trafficdb_t trafficdb)
 {
+	guint i;
+	
 	if (trafficdb == NULL) return FALSE;
 	
 	if (trafficdb->sessactive) {
@@ -350,6 +516,28 @@ gboolean mmgui_trafficdb_close(mmgui_trafficdb_t trafficdb)
 		g_free((gchar *)trafficdb->filepath);
 	}
 	
+	if (trafficdb->journalfd != -1) {
+		close(trafficdb->journalfd);
+	}
+	
+	if (trafficdb->journalpath != NULL) {
+		g_free((gchar *)trafficdb->journalpath);
+	}
+	
+	/*Write application usage collected since last flush*/
+	g_mutex_lock(&trafficdb->applock);
+	mmgui_trafficdb_application_usage_flush(trafficdb);
+	g_mutex_unlock(&trafficdb->applock);
+	g_hash_table_destroy(trafficdb->apppending);
+	g_free((gchar *)trafficdb->appspath);
+	g_mutex_clear(&trafficdb->applock);
+	
+	for (i=0; i<MMGUI_TRAFFICDB_SERIES_LEVELS; i++) {
+		if (trafficdb->seriesfd[i] != -1) {
+			close(trafficdb->seriesfd[i]);
+		}
+	}
+	
 	g_free(trafficdb);
 	
 	return TRUE;
@@ -435,20 +623,33 @@ gboolean mmgui_trafficdb_traffic_update(mmgui_trafficdb_t trafficdb, mmgui_traff
 			traffic.sesstxbytes = trafficdb->sesstxbytes;
 			traffic.sessduration = trafficdb->sessduration;
 			/*Write to database*/
-			if (!mmgui_trafficdb_day_traffic_write(trafficdb, &traffic)) {
+			if (mmgui_trafficdb_day_traffic_write(trafficdb, &traffic)) {
+				/*New day has no record yet*/
+				mmgui_trafficdb_journal_reset(trafficdb, FALSE, traffic.daytime);
+			} else {
+				/*Past day stays in journal until it is merged*/
+				trafficdb->journalpending = TRUE;
 				g_debug("Failed to write traffic statistics to database\n");
 			}
 			/*Correct values*/
 			/*Year and month statistics values*/
 			if (trafficdb->monthendstomorrow) {
 				trafficdb->monthrxbytes = update->deltarxbytes;
-				trafficdb->monthtxbytes = update->deltarxbytes;
-				trafficdb->monthduration = update->deltarxbytes;
+				trafficdb->monthtxbytes = update->deltatxbytes;
+				trafficdb->monthduration = update->deltaduration;
+			} else {
+				trafficdb->monthrxbytes += update->deltarxbytes;
+				trafficdb->monthtxbytes += update->deltatxbytes;
+				trafficdb->monthduration += update->deltaduration;
 			}
 			if (trafficdb->yearendstomorrow) {
 				trafficdb->yearrxbytes = update->deltarxbytes;
-				trafficdb->yeartxbytes = update->deltarxbytes;
-				trafficdb->yearduration = update->deltarxbytes;
+				trafficdb->yeartxbytes = update->deltatxbytes;
+				trafficdb->yearduration = update->deltaduration;
+			} else {
+				trafficdb->yearrxbytes += update->deltarxbytes;
+				trafficdb->yeartxbytes += update->deltatxbytes;
+				trafficdb->yearduration += update->deltaduration;
 			}
 			/*Current session*/
 			trafficdb->dayrxbytes = 0;
@@ -474,6 +675,9 @@ gboolean mmgui_trafficdb_traffic_update(mmgui_trafficdb_t trafficdb, mmgui_traff
 		}
 	}
 	
+	/*Bound data lost on crash by one checkpoint interval*/
+	mmgui_trafficdb_journal_checkpoint(trafficdb, currenttime, FALSE);
+	
 	return TRUE;
 }
 
@@ -483,10 +687,9 @@ gboolean mmgui_trafficdb_session_new(mmgui_trafficdb_t trafficdb, time_t startti
 	mmgui_day_traffic_t traffic;
 	GDBM_FILE db;
 	datum key, data;
-	gchar dayid[64];
-	time_t monthbegtime, monthendtime, yearbegtime, yearendtime, curdaytime;
+	gchar dayid[64], name[32];
+	struct _mmgui_trafficdb_total total;
 	struct tm timestruct;
-	guint64 currxbytes, curtxbytes, curduration;
 	
 	if (trafficdb == NULL) return FALSE;
 	
@@ -499,7 +702,21 @@ gboolean mmgui_trafficdb_session_new(mmgui_trafficdb_t trafficdb, time_t startti
 	
 	daytime = mmgui_trafficdb_truncate_day_timesatmp(currenttime);
 	
-	traffic = mmgui_trafficdb_day_traffic_read(trafficdb, daytime);
+	/*Counters of previous session that failed to close are merged first*/
+	if (trafficdb->journalpending) {
+		trafficdb->journalpending = !mmgui_trafficdb_journal_replay(trafficdb, 0);
+	}
+	
+	traffic = NULL;
+	
+	if (trafficdb->journalpending) {
+		/*Database is behind journal, so session continues from journal state*/
+		traffic = mmgui_trafficdb_journal_day_read(trafficdb, daytime);
+	}
+	
+	if (traffic == NULL) {
+		traffic = mmgui_trafficdb_day_traffic_read(trafficdb, daytime);
+	}
 	
 	if (traffic) {
 		/*Restore available session data*/
@@ -541,6 +758,9 @@ gboolean mmgui_trafficdb_session_new(mmgui_trafficdb_t trafficdb, time_t startti
 	trafficdb->sessactive = TRUE;
 	trafficdb->sessinitialized = FALSE;
 	
+	/*Restored session counters are already in database or journal*/
+	mmgui_trafficdb_journal_reset(trafficdb, trafficdb->sessstate == MMGUI_TRAFFICDB_SESSION_STATE_OLD, 0);
+	
 	/*Year and month values*/
 	trafficdb->yearrxbytes = 0;
 	trafficdb->yeartxbytes = 0;
@@ -551,57 +771,48 @@ gboolean mmgui_trafficdb_session_new(mmgui_trafficdb_t trafficdb, time_t startti
 	
 	localtime_r((const time_t *)&currenttime, &timestruct);
 	
-	monthbegtime = mmgui_trafficdb_get_month_begin_timestamp(timestruct.tm_mon, timestruct.tm_year + 1900);
-	monthendtime = mmgui_trafficdb_get_month_end_timestamp(timestruct.tm_mon, timestruct.tm_year + 1900);
-	
-	yearbegtime = mmgui_trafficdb_get_year_begin_timestamp(timestruct.tm_year + 1900);
-	yearendtime = mmgui_trafficdb_get_year_end_timestamp(timestruct.tm_year + 1900);
-	
 	db = gdbm_open((gchar *)trafficdb->filepath, 0, GDBM_READER, 0755, 0);
 	
 	if (db != NULL) {
-		/*Get data from database if possible*/
-		key = gdbm_firstkey(db);
-		if (key.dptr != NULL) {
-			do {
-				memset(dayid, 0, sizeof(dayid));
-				strncpy(dayid, key.dptr, key.dsize);
-				curdaytime = (time_t)strtoull(dayid, NULL, 10);
-				if ((difftime(yearendtime, curdaytime) >= 0.0) && (difftime(curdaytime, yearbegtime) > 0.0)) {
-					data = gdbm_fetch(db, key);
-					if (data.dptr != NULL) {
-						traffic = mmgui_trafficdb_xml_parse(data.dptr, data.dsize);
-						if (curdaytime == trafficdb->presdaytime) {
-							/*Active session correction*/
-							currxbytes = trafficdb->dayrxbytes + trafficdb->sessrxbytes;
-							curtxbytes = trafficdb->daytxbytes + trafficdb->sesstxbytes;
-							curduration = trafficdb->dayduration + trafficdb->sessduration;
-						} else {
-							/*Database values*/
-							currxbytes = traffic->dayrxbytes + traffic->sessrxbytes;
-							curtxbytes = traffic->daytxbytes + traffic->sesstxbytes;
-							curduration = traffic->dayduration + traffic->sessduration;
-						}
-						
-						/*Year statistics*/
-						trafficdb->yearrxbytes += currxbytes;
-						trafficdb->yeartxbytes += curtxbytes;
-						trafficdb->yearduration += curduration;
-						
-						/*Month statistics*/
-						if ((difftime(monthendtime, curdaytime) >= 0.0) && (difftime(curdaytime, monthbegtime) > 0.0)) {
-							trafficdb->monthrxbytes += currxbytes;
-							trafficdb->monthtxbytes += curtxbytes;
-							trafficdb->monthduration += curduration;
-						}
-					}
-				}
-				key = gdbm_nextkey(db, key);
-			} while (key.dptr != NULL);
+		/*Stored totals, today record is replaced with actual session values*/
+		g_snprintf(name, sizeof(name), TRAFFICDB_INDEX_YEAR_TOTAL_KEY, (guint)timestruct.tm_year + 1900);
+		if (mmgui_trafficdb_total_read(db, name, &total)) {
+			trafficdb->yearrxbytes = total.rxbytes;
+			trafficdb->yeartxbytes = total.txbytes;
+			trafficdb->yearduration = total.duration;
+		}
+		g_snprintf(name, sizeof(name), TRAFFICDB_INDEX_MONTH_TOTAL_KEY, (guint)timestruct.tm_year + 1900, (guint)timestruct.tm_mon + 1);
+		if (mmgui_trafficdb_total_read(db, name, &total)) {
+			trafficdb->monthrxbytes = total.rxbytes;
+			trafficdb->monthtxbytes = total.txbytes;
+			trafficdb->monthduration = total.duration;
+		}
+		key = mmgui_trafficdb_key_from_daytime((guint64)trafficdb->presdaytime, dayid, sizeof(dayid));
+		data = gdbm_fetch(db, key);
+		if (data.dptr != NULL) {
+			traffic = mmgui_trafficdb_xml_parse(data.dptr, data.dsize);
+			if (traffic != NULL) {
+				trafficdb->yearrxbytes -= traffic->dayrxbytes + traffic->sessrxbytes;
+				trafficdb->yeartxbytes -= traffic->daytxbytes + traffic->sesstxbytes;
+				trafficdb->yearduration -= traffic->dayduration + traffic->sessduration;
+				trafficdb->monthrxbytes -= traffic->dayrxbytes + traffic->sessrxbytes;
+				trafficdb->monthtxbytes -= traffic->daytxbytes + traffic->sesstxbytes;
+				trafficdb->monthduration -= traffic->dayduration + traffic->sessduration;
+				g_free(traffic);
+			}
+			free(data.dptr);
 		}
 		gdbm_close(db);
 	}
 	
+	/*Active session correction*/
+	trafficdb->yearrxbytes += trafficdb->dayrxbytes + trafficdb->sessrxbytes;
+	trafficdb->yeartxbytes += trafficdb->daytxbytes + trafficdb->sesstxbytes;
+	trafficdb->yearduration += trafficdb->dayduration + trafficdb->sessduration;
+	trafficdb->monthrxbytes += trafficdb->dayrxbytes + trafficdb->sessrxbytes;
+	trafficdb->monthtxbytes += trafficdb->daytxbytes + trafficdb->sesstxbytes;
+	trafficdb->monthduration += trafficdb->dayduration + trafficdb->sessduration;
+	
 	return TRUE;
 }
 
@@ -629,7 +840,12 @@ gboolean mmgui_trafficdb_session_close(mmgui_trafficdb_t trafficdb)
 	traffic.sessduration = trafficdb->sessduration;
 	
 	/*Write to database*/
-	if (!mmgui_trafficdb_day_traffic_write(trafficdb, &traffic)) {
+	if (mmgui_trafficdb_day_traffic_write(trafficdb, &traffic)) {
+		mmgui_trafficdb_journal_reset(trafficdb, FALSE, traffic.daytime);
+	} else {
+		/*Keep counters in journal until they are merged*/
+		mmgui_trafficdb_journal_checkpoint(trafficdb, currenttime, TRUE);
+		trafficdb->journalpending = TRUE;
 		g_debug("Failed to write traffic statistics to database\n");
 	}
 	
@@ -673,10 +889,6 @@ gboolean mmgui_trafficdb_session_get_day_traffic(mmgui_trafficdb_t trafficdb, mm
 gboolean mmgui_trafficdb_day_traffic_write(mmgui_trafficdb_t trafficdb, mmgui_day_traffic_t daytraffic)
 {
 	GDBM_FILE db;
-	gchar dayid[64];
-	gint idlen;
-	datum key, data;
-	gchar *daytrafficxml;
 	
 	if ((trafficdb == NULL) || (daytraffic == NULL)) return FALSE;
 	if (trafficdb->filepath == NULL) return FALSE;
@@ -685,73 +897,34 @@ gboolean mmgui_trafficdb_day_traffic_write(mmgui_trafficdb_t trafficdb, mmgui_da
 	
 	if (db == NULL) return FALSE;
 	
-	memset(dayid, 0, sizeof(dayid));
-	idlen = snprintf(dayid, sizeof(dayid), "%" G_GUINT64_FORMAT "", daytraffic->daytime);
-	key.dptr = (gchar *)dayid;
-	key.dsize = idlen;
-		
-	daytrafficxml = g_strdup_printf(TRAFFICDB_DAY_XML,
-									daytraffic->daytime,
-									daytraffic->dayrxbytes,
-									daytraffic->daytxbytes,
-									daytraffic->dayduration,
-									daytraffic->sesstime,
-									daytraffic->sessrxbytes,
-									daytraffic->sesstxbytes,
-									daytraffic->sessduration);
-	
-	data.dptr = daytrafficxml;
-	data.dsize = strlen(daytrafficxml);
-	
-	if (gdbm_store(db, key, data, GDBM_REPLACE) == -1) {
+	if (!mmgui_trafficdb_day_store(db, daytraffic, FALSE)) {
 		g_warning("Unable to write to database");
 		gdbm_close(db);
-		g_free(daytrafficxml);
 		return FALSE;
 	}
 	
 	gdbm_sync(db);
 	gdbm_close(db);
 	
-	g_free(daytrafficxml);
-	
 	return TRUE;
 }
 
-static gint mmgui_trafficdb_traffic_list_sort_compare(gconstpointer a, gconstpointer b)
-{
-	mmgui_day_traffic_t day1, day2;
-		
-	day1 = (mmgui_day_traffic_t)a;
-	day2 = (mmgui_day_traffic_t)b;
-	
-	if (day1->daytime < day2->daytime) {
-		return -1;
-	} else if (day1->daytime > day2->daytime) {
-		return 1;
-	} else {
-		return 0;
-	}
-}
-
 GSList *mmgui_trafficdb_get_traffic_list_for_month(mmgui_trafficdb_t trafficdb, guint month, guint year)
 {
 	GDBM_FILE db;
-	time_t begtime, endtime;
 	time_t daytime;
 	GSList *list;
+	GArray *days;
 	mmgui_day_traffic_t daytraffic;
 	datum key, data;
 	gchar dayid[64];
 	struct tm *timespec;
 	gboolean currentstatscorrected;
+	guint i;
 	
 	if (trafficdb == NULL) return NULL;
 	if (trafficdb->filepath == NULL) return NULL;
 	
-	begtime = mmgui_trafficdb_get_month_begin_timestamp(month, year);
-	endtime = mmgui_trafficdb_get_month_end_timestamp(month, year);
-	
 	list = NULL;
 	
 	currentstatscorrected = FALSE;
@@ -759,34 +932,30 @@ GSList *mmgui_trafficdb_get_traffic_list_for_month(mmgui_trafficdb_t trafficdb,
 	db = gdbm_open((gchar *)trafficdb->filepath, 0, GDBM_READER, 0755, 0);
 	
 	if (db != NULL) {
-		/*Get data from database if possible*/
-		key = gdbm_firstkey(db);
-		
-		if (key.dptr != NULL) {
-			do {
-				memset(dayid, 0, sizeof(dayid));
-				strncpy(dayid, key.dptr, key.dsize);
-				daytime = (time_t)strtoull(dayid, NULL, 10);
-				if ((difftime(endtime, daytime) >= 0.0) && (difftime(daytime, begtime) > 0.0)) {
-					data = gdbm_fetch(db, key);
-					if (data.dptr != NULL) {
-						daytraffic = mmgui_trafficdb_xml_parse(data.dptr, data.dsize);
-						if ((daytime == trafficdb->presdaytime) && (trafficdb->sessactive)) {
-							/*Today statistics correction*/
-							daytraffic->dayrxbytes = trafficdb->dayrxbytes;
-							daytraffic->daytxbytes = trafficdb->daytxbytes;
-							daytraffic->dayduration = trafficdb->dayduration;
-							daytraffic->sessrxbytes = trafficdb->sessrxbytes;
-							daytraffic->sesstxbytes = trafficdb->sesstxbytes;
-							daytraffic->sessduration = trafficdb->sessduration;
-							currentstatscorrected = TRUE;
-						}
-						list = g_slist_prepend(list, daytraffic);
-					}
+		/*Only days of requested month are fetched, newest first so list ends up sorted*/
+		days = mmgui_trafficdb_month_days_read(db, month, year);
+		for (i=days->len; i>0; i--) {
+			daytime = (time_t)g_array_index(days, guint64, i-1);
+			key = mmgui_trafficdb_key_from_daytime((guint64)daytime, dayid, sizeof(dayid));
+			data = gdbm_fetch(db, key);
+			if (data.dptr != NULL) {
+				daytraffic = mmgui_trafficdb_xml_parse(data.dptr, data.dsize);
+				free(data.dptr);
+				if (daytraffic == NULL) continue;
+				if ((daytime == trafficdb->presdaytime) && (trafficdb->sessactive)) {
+					/*Today statistics correction*/
+					daytraffic->dayrxbytes = trafficdb->dayrxbytes;
+					daytraffic->daytxbytes = trafficdb->daytxbytes;
+					daytraffic->dayduration = trafficdb->dayduration;
+					daytraffic->sessrxbytes = trafficdb->sessrxbytes;
+					daytraffic->sesstxbytes = trafficdb->sesstxbytes;
+					daytraffic->sessduration = trafficdb->sessduration;
+					currentstatscorrected = TRUE;
 				}
-				key = gdbm_nextkey(db, key);
-			} while (key.dptr != NULL);
+				list = g_slist_prepend(list, daytraffic);
+			}
 		}
+		g_array_free(days, TRUE);
 		gdbm_close(db);
 	}
 	
@@ -805,14 +974,11 @@ GSList *mmgui_trafficdb_get_traffic_list_for_month(mmgui_trafficdb_t trafficdb,
 			daytraffic->sessrxbytes = trafficdb->sessrxbytes;
 			daytraffic->sesstxbytes = trafficdb->sesstxbytes;
 			daytraffic->sessduration = trafficdb->sessduration;
-			list = g_slist_prepend(list, daytraffic);
+			/*Today is always the latest day*/
+			list = g_slist_append(list, daytraffic);
 		}
 	}
 	
-	if (list != NULL) {
-		list = g_slist_sort(list, mmgui_trafficdb_traffic_list_sort_compare);
-	} 
-	
 	return list;
 }
 
@@ -851,6 +1017,7 @@ mmgui_day_traffic_t mmgui_trafficdb_day_traffic_read(mmgui_trafficdb_t trafficdb
 		data = gdbm_fetch(db, key);
 		if (data.dptr != NULL) {
 			traffic = mmgui_trafficdb_xml_parse(data.dptr, data.dsize);
+			free(data.dptr);
 		}
 	}
 	
@@ -859,107 +1026,1501 @@ mmgui_day_traffic_t mmgui_trafficdb_day_traffic_read(mmgui_trafficdb_t trafficdb
 	return traffic;
 }
 
-static mmgui_day_traffic_t mmgui_trafficdb_xml_parse(gchar *xml, gsize size)
+guint mmgui_trafficdb_day_traffic_foreach(mmgui_trafficdb_t trafficdb, time_t from, mmgui_trafficdb_day_func func, gpointer userdata)
 {
-	mmgui_day_traffic_t traffic;
-	GMarkupParser mp;
-	GMarkupParseContext *mpc;
-	GError *error = NULL;
+	GDBM_FILE db;
+	GArray *days;
+	gchar dayid[64];
+	datum key, data;
+	guint64 firstday, daytime;
+	guint month, year, lastmonth, lastyear;
+	guint i, count;
+	gboolean proceed, todayfound;
+	mmgui_day_traffic_t daytraffic;
 	
-	traffic = g_new(struct _mmgui_day_traffic, 1);
+	if ((trafficdb == NULL) || (func == NULL)) return 0;
+	if (trafficdb->filepath == NULL) return 0;
 	
-	traffic->daytime = 0;
-	traffic->dayrxbytes = 0;
-	traffic->daytxbytes = 0;
-	traffic->dayduration = 0;
-	traffic->sesstime = 0;
-	traffic->sessrxbytes = 0;
-	traffic->sesstxbytes = 0;
-	traffic->sessduration = 0;
+	db = gdbm_open((gchar *)trafficdb->filepath, 0, GDBM_READER, 0755, 0);
 	
-	mp.start_element = mmgui_trafficdb_xml_get_element;
-	mp.end_element = mmgui_trafficdb_xml_end_element;
-	mp.text = mmgui_trafficdb_xml_get_value;
-	mp.passthrough = NULL;
-	mp.error = NULL;
+	if (db == NULL) return 0;
 	
-	mpc = g_markup_parse_context_new(&mp, 0, (gpointer)traffic, NULL);
-	g_markup_parse_context_parse(mpc, xml, size, &error);
-	if (error != NULL) {
-		g_free(traffic);
-		g_error_free(error);
-		g_markup_parse_context_free(mpc);
-		return NULL;
+	count = 0;
+	proceed = TRUE;
+	todayfound = FALSE;
+	firstday = (from > 0) ? (guint64)mmgui_trafficdb_truncate_day_timesatmp(from) : 0;
+	
+	mmgui_trafficdb_day_month((guint64)time(NULL), &lastmonth, &lastyear);
+	
+	/*Walk month index so only one month of day keys is held at once*/
+	if (from > 0) {
+		mmgui_trafficdb_day_month(firstday, &month, &year);
+	} else if (!mmgui_trafficdb_index_first_month(db, &month, &year)) {
+		month = lastmonth;
+		year = lastyear;
 	}
-	g_markup_parse_context_free(mpc);
 	
-	return traffic;
+	while ((proceed) && ((year < lastyear) || ((year == lastyear) && (month <= lastmonth)))) {
+		days = mmgui_trafficdb_month_days_read(db, month, year);
+		for (i=0; (i<days->len) && (proceed); i++) {
+			daytime = g_array_index(days, guint64, i);
+			if (daytime < firstday) continue;
+			key = mmgui_trafficdb_key_from_daytime(daytime, dayid, sizeof(dayid));
+			data = gdbm_fetch(db, key);
+			if (data.dptr == NULL) continue;
+			daytraffic = mmgui_trafficdb_xml_parse(data.dptr, data.dsize);
+			free(data.dptr);
+			if (daytraffic == NULL) continue;
+			if ((time_t)daytime == trafficdb->presdaytime) {
+				if (trafficdb->sessactive) {
+					mmgui_trafficdb_day_correct(trafficdb, daytraffic);
+				}
+				todayfound = TRUE;
+			}
+			proceed = (func)(daytraffic, userdata);
+			g_free(daytraffic);
+			count++;
+		}
+		g_array_free(days, TRUE);
+		if (++month == 12) {
+			month = 0;
+			year++;
+		}
+	}
+	
+	gdbm_close(db);
+	
+	/*Current day may not be written yet*/
+	if ((proceed) && (!todayfound) && ((guint64)trafficdb->presdaytime >= firstday) && ((trafficdb->dayduration + trafficdb->sessduration) > 0)) {
+		daytraffic = g_new0(struct _mmgui_day_traffic, 1);
+		daytraffic->daytime = trafficdb->presdaytime;
+		daytraffic->sesstime = trafficdb->sesstime;
+		mmgui_trafficdb_day_correct(trafficdb, daytraffic);
+		(func)(daytraffic, userdata);
+		g_free(daytraffic);
+		count++;
+	}
+	
+	return count;
 }
 
-static void mmgui_trafficdb_xml_get_element(GMarkupParseContext *context, const gchar *element, const gchar **attr_names, const gchar **attr_values, gpointer data, GError **error)
+static void mmgui_trafficdb_day_correct(mmgui_trafficdb_t trafficdb, mmgui_day_traffic_t daytraffic)
 {
-	if (g_str_equal(element, "daytime")) {
-		mmgui_trafficdb_xml_parameter = TRAFFICDB_XML_PARAM_DAY_TIME;
-	} else if (g_str_equal(element, "dayrxbytes")) {
-		mmgui_trafficdb_xml_parameter = TRAFFICDB_XML_PARAM_DAY_RX;
-	} else if (g_str_equal(element, "daytxbytes")) {
-		mmgui_trafficdb_xml_parameter = TRAFFICDB_XML_PARAM_DAY_TX;
-	} else if (g_str_equal(element, "dayduration")) {
-		mmgui_trafficdb_xml_parameter = TRAFFICDB_XML_PARAM_DAY_DURATION;
-	} else if (g_str_equal(element, "sesstime")) {
-		mmgui_trafficdb_xml_parameter = TRAFFICDB_XML_PARAM_SESSION_TIME;
-	} else if (g_str_equal(element, "sessrxbytes")) {
-		mmgui_trafficdb_xml_parameter = TRAFFICDB_XML_PARAM_SESSION_RX;
-	} else if (g_str_equal(element, "sesstxbytes")) {
-		mmgui_trafficdb_xml_parameter = TRAFFICDB_XML_PARAM_SESSION_TX;
-	} else if (g_str_equal(element, "sessduration")) {
-		mmgui_trafficdb_xml_parameter = TRAFFICDB_XML_PARAM_SESSION_DURATION;
-	} else {
-		mmgui_trafficdb_xml_parameter = TRAFFICDB_XML_PARAM_NULL;
+	/*Counters of running session are newer than stored record*/
+	daytraffic->dayrxbytes = trafficdb->dayrxbytes;
+	daytraffic->daytxbytes = trafficdb->daytxbytes;
+	daytraffic->dayduration = trafficdb->dayduration;
+	daytraffic->sessrxbytes = trafficdb->sessrxbytes;
+	daytraffic->sesstxbytes = trafficdb->sesstxbytes;
+	daytraffic->sessduration = trafficdb->sessduration;
+}
+
+gboolean mmgui_trafficdb_series_add(mmgui_trafficdb_t trafficdb, time_t timestamp, guint64 rxbytes, guint64 txbytes)
+{
+	guint64 slottime, slotrxbytes, slottxbytes;
+	gboolean res;
+	guint i;
+	
+	if (trafficdb == NULL) return FALSE;
+	
+	res = TRUE;
+	
+	/*Each level is rolled up as samples arrive, so no background aggregation is needed*/
+	for (i=0; i<MMGUI_TRAFFICDB_SERIES_LEVELS; i++) {
+		if (trafficdb->seriesfd[i] == -1) {
+			res = FALSE;
+			continue;
+		}
+		slottime = (guint64)timestamp - ((guint64)timestamp % mmgui_trafficdb_series_formats[i].resolution);
+		/*Slot left from previous ring cycle is overwritten*/
+		if (!mmgui_trafficdb_series_slot_read(trafficdb->seriesfd[i], i, slottime, &slotrxbytes, &slottxbytes)) {
+			slotrxbytes = 0;
+			slottxbytes = 0;
+		}
+		if (!mmgui_trafficdb_series_slot_write(trafficdb->seriesfd[i], i, slottime, slotrxbytes + rxbytes, slottxbytes + txbytes)) {
+			res = FALSE;
+		}
 	}
+	
+	return res;
 }
 
-static void mmgui_trafficdb_xml_get_value(GMarkupParseContext *context, const gchar *text, gsize size, gpointer data, GError **error)
+GArray *mmgui_trafficdb_series_read(mmgui_trafficdb_t trafficdb, time_t from, time_t to, guint resolution)
 {
-	mmgui_day_traffic_t daytraffic;
-		
-	daytraffic = (mmgui_day_traffic_t)data;
+	GArray *samples;
+	struct _mmgui_traffic_sample sample;
+	guint64 oldest, slottime, bucketend, rxbytes, txbytes;
+	time_t currenttime;
+	guint level, i;
 	
-	if (mmgui_trafficdb_xml_parameter == TRAFFICDB_XML_PARAM_NULL) return;
+	if (trafficdb == NULL) return NULL;
+	if (from > to) return NULL;
 	
-	switch (mmgui_trafficdb_xml_parameter) {
-		case TRAFFICDB_XML_PARAM_DAY_TIME:
-			daytraffic->daytime = (guint64)strtoull(text, NULL, 10);
-			break;
-		case TRAFFICDB_XML_PARAM_DAY_RX:
-			daytraffic->dayrxbytes = (guint64)strtoull(text, NULL, 10);
-			break;
-		case TRAFFICDB_XML_PARAM_DAY_TX:
-			daytraffic->daytxbytes = (guint64)strtoull(text, NULL, 10);
-			break;
-		case TRAFFICDB_XML_PARAM_DAY_DURATION:
-			daytraffic->dayduration = (guint)strtoul(text, NULL, 10);
-			break;
-		case TRAFFICDB_XML_PARAM_SESSION_TIME:
-			daytraffic->sesstime = (guint64)strtoull(text, NULL, 10);
-			break;
-		case TRAFFICDB_XML_PARAM_SESSION_RX:
-			daytraffic->sessrxbytes = (guint64)strtoull(text, NULL, 10);
-			break;
-		case TRAFFICDB_XML_PARAM_SESSION_TX:
-			daytraffic->sesstxbytes = (guint64)strtoull(text, NULL, 10);
-			break;
-		case TRAFFICDB_XML_PARAM_SESSION_DURATION:
-			daytraffic->sessduration = (guint)strtoul(text, NULL, 10);
-			break;
-		default:
-			break;
+	/*Coarsest level not exceeding requested resolution*/
+	level = MMGUI_TRAFFICDB_SERIES_LEVEL_SECOND;
+	for (i=0; i<MMGUI_TRAFFICDB_SERIES_LEVELS; i++) {
+		if (mmgui_trafficdb_series_formats[i].resolution <= resolution) {
+			level = i;
+		}
+	}
+	
+	if (trafficdb->seriesfd[level] == -1) return NULL;
+	
+	/*Buckets are multiples of level resolution*/
+	resolution = MAX(resolution, mmgui_trafficdb_series_formats[level].resolution);
+	resolution -= resolution % mmgui_trafficdb_series_formats[level].resolution;
+	
+	/*Older slots are already overwritten*/
+	currenttime = time(NULL);
+	oldest = (guint64)currenttime - (guint64)mmgui_trafficdb_series_formats[level].resolution * (mmgui_trafficdb_series_formats[level].slots - 1);
+	if ((guint64)from < oldest) {
+		from = (time_t)oldest;
+	}
+	if (to > currenttime) {
+		to = currenttime;
+	}
+	if (from > to) return NULL;
+	
+	samples = g_array_new(FALSE, FALSE, sizeof(struct _mmgui_traffic_sample));
+	
+	sample.timestamp = (guint64)from - ((guint64)from % resolution);
+	
+	while (sample.timestamp <= (guint64)to) {
+		sample.rxbytes = 0;
+		sample.txbytes = 0;
+		bucketend = sample.timestamp + resolution;
+		for (slottime=sample.timestamp; slottime<bucketend; slottime+=mmgui_trafficdb_series_formats[level].resolution) {
+			if (mmgui_trafficdb_series_slot_read(trafficdb->seriesfd[level], level, slottime, &rxbytes, &txbytes)) {
+				sample.rxbytes += rxbytes;
+				sample.txbytes += txbytes;
+			}
+		}
+		g_array_append_val(samples, sample);
+		sample.timestamp = bucketend;
 	}
+	
+	return samples;
 }
 
-static void mmgui_trafficdb_xml_end_element(GMarkupParseContext *context, const gchar *element, gpointer data, GError **error)
+gboolean mmgui_trafficdb_application_usage_add(mmgui_trafficdb_t trafficdb, const gchar *appname, guint64 rxbytes, guint64 txbytes)
+{
+	time_t currenttime, daytime;
+	mmgui_app_traffic_t apptraffic;
+	
+	if ((trafficdb == NULL) || (appname == NULL)) return FALSE;
+	if (trafficdb->apppending == NULL) return FALSE;
+	
+	currenttime = time(NULL);
+	daytime = mmgui_trafficdb_truncate_day_timesatmp(currenttime);
+	
+	g_mutex_lock(&trafficdb->applock);
+	
+	/*Usage of passed day goes into its own record*/
+	if (daytime != trafficdb->appdaytime) {
+		mmgui_trafficdb_application_usage_flush(trafficdb);
+		trafficdb->appdaytime = daytime;
+	}
+	
+	apptraffic = g_hash_table_lookup(trafficdb->apppending, appname);
+	if (apptraffic == NULL) {
+		apptraffic = g_new0(struct _mmgui_app_traffic, 1);
+		apptraffic->appname = g_strdup(appname);
+		g_hash_table_insert(trafficdb->apppending, apptraffic->appname, apptraffic);
+	}
+	
+	apptraffic->rxbytes += rxbytes;
+	apptraffic->txbytes += txbytes;
+	
+	/*Readers rebuild their views only when totals change*/
+	if ((rxbytes > 0) || (txbytes > 0)) {
+		trafficdb->appgeneration++;
+	}
+	
+	if (difftime(currenttime, trafficdb->appflushtime) >= TRAFFICDB_JOURNAL_INTERVAL) {
+		mmgui_trafficdb_application_usage_flush(trafficdb);
+		trafficdb->appflushtime = currenttime;
+	}
+	
+	g_mutex_unlock(&trafficdb->applock);
+	
+	return TRUE;
+}
+
+GSList *mmgui_trafficdb_application_usage_read(mmgui_trafficdb_t trafficdb, time_t daytime)
+{
+	GDBM_FILE db;
+	GHashTable *usage;
+	GHashTableIter iter;
+	gpointer key, value;
+	mmgui_app_traffic_t pending, apptraffic;
+	GSList *applist;
+	
+	if ((trafficdb == NULL) || (trafficdb->appspath == NULL)) return NULL;
+	
+	daytime = mmgui_trafficdb_truncate_day_timesatmp(daytime);
+	
+	usage = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, NULL);
+	applist = NULL;
+	
+	g_mutex_lock(&trafficdb->applock);
+	
+	db = gdbm_open((gchar *)trafficdb->appspath, 0, GDBM_READER, 0755, 0);
+	if (db != NULL) {
+		applist = mmgui_trafficdb_application_usage_decode(db, daytime, usage, applist);
+		gdbm_close(db);
+	}
+	
+	/*Today also has usage waiting to be written*/
+	if ((daytime == trafficdb->appdaytime) && (trafficdb->apppending != NULL)) {
+		g_hash_table_iter_init(&iter, trafficdb->apppending);
+		while (g_hash_table_iter_next(&iter, &key, &value)) {
+			pending = (mmgui_app_traffic_t)value;
+			apptraffic = g_hash_table_lookup(usage, pending->appname);
+			if (apptraffic == NULL) {
+				apptraffic = g_new0(struct _mmgui_app_traffic, 1);
+				apptraffic->appname = g_strdup(pending->appname);
+				g_hash_table_insert(usage, apptraffic->appname, apptraffic);
+				applist = g_slist_prepend(applist, apptraffic);
+			}
+			apptraffic->rxbytes += pending->rxbytes;
+			apptraffic->txbytes += pending->txbytes;
+		}
+	}
+	
+	g_mutex_unlock(&trafficdb->applock);
+	
+	g_hash_table_destroy(usage);
+	
+	return g_slist_sort(applist, mmgui_trafficdb_application_usage_compare);
+}
+
+guint mmgui_trafficdb_application_usage_generation(mmgui_trafficdb_t trafficdb)
 {
+	guint generation;
+	
+	if (trafficdb == NULL) return 0;
+	
+	g_mutex_lock(&trafficdb->applock);
+	generation = trafficdb->appgeneration;
+	g_mutex_unlock(&trafficdb->applock);
+	
+	return generation;
+}
+
+void mmgui_trafficdb_application_usage_free_list(GSList *applist)
+{
+	if (applist == NULL) return;
+	
+	g_slist_free_full(applist, mmgui_trafficdb_application_usage_free);
+}
+
+static void mmgui_trafficdb_application_usage_flush(mmgui_trafficdb_t trafficdb)
+{
+	GDBM_FILE db;
+	GHashTable *usage;
+	GHashTableIter iter;
+	gpointer key, value;
+	mmgui_app_traffic_t pending, apptraffic;
+	GSList *applist, *iterator;
+	GString *record;
+	gchar dayid[32], buffer[TRAFFICDB_APPS_HEADER_SIZE];
+	datum daykey, data;
+	guint32 namelen;
+	
+	if ((trafficdb->apppending == NULL) || (g_hash_table_size(trafficdb->apppending) == 0)) return;
+	if (trafficdb->appspath == NULL) return;
+	
+	db = gdbm_open((gchar *)trafficdb->appspath, 0, GDBM_WRCREAT, 0755, 0);
+	if (db == NULL) {
+		g_debug("Unable to open application traffic database\n");
+		return;
+	}
+	
+	/*Merge pending usage into stored day record*/
+	usage = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, NULL);
+	applist = mmgui_trafficdb_application_usage_decode(db, (guint64)trafficdb->appdaytime, usage, NULL);
+	
+	g_hash_table_iter_init(&iter, trafficdb->apppending);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		pending = (mmgui_app_traffic_t)value;
+		apptraffic = g_hash_table_lookup(usage, pending->appname);
+		if (apptraffic == NULL) {
+			apptraffic = g_new0(struct _mmgui_app_traffic, 1);
+			apptraffic->appname = g_strdup(pending->appname);
+			g_hash_table_insert(usage, apptraffic->appname, apptraffic);
+			applist = g_slist_prepend(applist, apptraffic);
+		}
+		apptraffic->rxbytes += pending->rxbytes;
+		apptraffic->txbytes += pending->txbytes;
+	}
+	
+	record = g_string_new(NULL);
+	for (iterator = applist; iterator != NULL; iterator = iterator->next) {
+		apptraffic = (mmgui_app_traffic_t)iterator->data;
+		namelen = strlen(apptraffic->appname);
+		mmgui_trafficdb_put_uint64(buffer + TRAFFICDB_APPS_RX_OFFSET, apptraffic->rxbytes);
+		mmgui_trafficdb_put_uint64(buffer + TRAFFICDB_APPS_TX_OFFSET, apptraffic->txbytes);
+		namelen = GUINT32_TO_LE(namelen);
+		memcpy(buffer + TRAFFICDB_APPS_NAME_LENGTH_OFFSET, &namelen, sizeof(namelen));
+		g_string_append_len(record, buffer, sizeof(buffer));
+		g_string_append_len(record, apptraffic->appname, GUINT32_FROM_LE(namelen));
+	}
+	
+	daykey = mmgui_trafficdb_key_from_daytime((guint64)trafficdb->appdaytime, dayid, sizeof(dayid));
+	data.dptr = record->str;
+	data.dsize = record->len;
+	
+	if (gdbm_store(db, daykey, data, GDBM_REPLACE) == -1) {
+		g_debug("Unable to write application traffic\n");
+	} else {
+		g_hash_table_remove_all(trafficdb->apppending);
+	}
+	
+	gdbm_close(db);
+	
+	g_string_free(record, TRUE);
+	g_hash_table_destroy(usage);
+	g_slist_free_full(applist, mmgui_trafficdb_application_usage_free);
+}
+
+static GSList *mmgui_trafficdb_application_usage_decode(GDBM_FILE db, guint64 daytime, GHashTable *usage, GSList *applist)
+{
+	gchar dayid[32];
+	datum daykey, data;
+	gsize offset;
+	guint32 namelen;
+	mmgui_app_traffic_t apptraffic;
+	
+	daykey = mmgui_trafficdb_key_from_daytime(daytime, dayid, sizeof(dayid));
+	
+	data = gdbm_fetch(db, daykey);
+	if (data.dptr == NULL) return applist;
+	
+	offset = 0;
+	while (offset + TRAFFICDB_APPS_HEADER_SIZE <= (gsize)data.dsize) {
+		memcpy(&namelen, data.dptr + offset + TRAFFICDB_APPS_NAME_LENGTH_OFFSET, sizeof(namelen));
+		namelen = GUINT32_FROM_LE(namelen);
+		if (offset + TRAFFICDB_APPS_HEADER_SIZE + namelen > (gsize)data.dsize) break;
+		apptraffic = g_new0(struct _mmgui_app_traffic, 1);
+		apptraffic->appname = g_strndup(data.dptr + offset + TRAFFICDB_APPS_HEADER_SIZE, namelen);
+		apptraffic->rxbytes = mmgui_trafficdb_get_uint64(data.dptr + offset + TRAFFICDB_APPS_RX_OFFSET);
+		apptraffic->txbytes = mmgui_trafficdb_get_uint64(data.dptr + offset + TRAFFICDB_APPS_TX_OFFSET);
+		g_hash_table_insert(usage, apptraffic->appname, apptraffic);
+		applist = g_slist_prepend(applist, apptraffic);
+		offset += TRAFFICDB_APPS_HEADER_SIZE + namelen;
+	}
+	
+	free(data.dptr);
+	
+	return applist;
+}
+
+static gint mmgui_trafficdb_application_usage_compare(gconstpointer a, gconstpointer b)
+{
+	mmgui_app_traffic_t appa, appb;
+	guint64 totala, totalb;
+	
+	appa = (mmgui_app_traffic_t)a;
+	appb = (mmgui_app_traffic_t)b;
+	
+	totala = appa->rxbytes + appa->txbytes;
+	totalb = appb->rxbytes + appb->txbytes;
+	
+	/*Heaviest users first*/
+	if (totala > totalb) {
+		return -1;
+	} else if (totala < totalb) {
+		return 1;
+	} else {
+		return g_strcmp0(appa->appname, appb->appname);
+	}
+}
+
+static void mmgui_trafficdb_application_usage_free(gpointer data)
+{
+	mmgui_app_traffic_t apptraffic;
+	
+	apptraffic = (mmgui_app_traffic_t)data;
+	
+	if (apptraffic == NULL) return;
+	
+	g_free(apptraffic->appname);
+	g_free(apptraffic);
+}
+
+static gint mmgui_trafficdb_series_open(const gchar *filepath, guint level)
+{
+	gchar *dirpath, *seriespath;
+	gchar header[TRAFFICDB_SERIES_HEADER_SIZE], stored[TRAFFICDB_SERIES_HEADER_SIZE];
+	guint32 value;
+	off_t size;
+	gint fd;
+	
+	dirpath = g_path_get_dirname(filepath);
+	seriespath = g_build_filename(dirpath, mmgui_trafficdb_series_formats[level].filename, NULL);
+	g_free(dirpath);
+	
+	fd = open(seriespath, O_RDWR|O_CREAT, S_IRUSR|S_IWUSR);
+	
+	if (fd == -1) {
+		g_warning("Unable to open traffic time series: %s", seriespath);
+		g_free(seriespath);
+		return -1;
+	}
+	
+	value = GUINT32_TO_LE(TRAFFICDB_SERIES_MAGIC);
+	memcpy(header + TRAFFICDB_SERIES_MAGIC_OFFSET, &value, sizeof(value));
+	value = GUINT32_TO_LE(TRAFFICDB_SERIES_VERSION);
+	memcpy(header + TRAFFICDB_SERIES_VERSION_OFFSET, &value, sizeof(value));
+	value = GUINT32_TO_LE(mmgui_trafficdb_series_formats[level].resolution);
+	memcpy(header + TRAFFICDB_SERIES_RESOLUTION_OFFSET, &value, sizeof(value));
+	value = GUINT32_TO_LE(mmgui_trafficdb_series_formats[level].slots);
+	memcpy(header + TRAFFICDB_SERIES_SLOTS_OFFSET, &value, sizeof(value));
+	
+	size = TRAFFICDB_SERIES_HEADER_SIZE + (off_t)mmgui_trafficdb_series_formats[level].slots * TRAFFICDB_SERIES_SLOT_SIZE;
+	
+	/*File with other layout is started over, whole ring is allocated at once*/
+	if ((pread(fd, stored, sizeof(stored), 0) != sizeof(stored)) || (memcmp(stored, header, sizeof(header)) != 0)) {
+		if ((ftruncate(fd, 0) == -1) || (ftruncate(fd, size) == -1) || (pwrite(fd, header, sizeof(header), 0) != sizeof(header))) {
+			g_warning("Unable to initialize traffic time series: %s", seriespath);
+			close(fd);
+			fd = -1;
+		}
+	}
+	
+	g_free(seriespath);
+	
+	return fd;
+}
+
+static gboolean mmgui_trafficdb_series_slot_read(gint fd, guint level, guint64 slottime, guint64 *rxbytes, guint64 *txbytes)
+{
+	gchar slot[TRAFFICDB_SERIES_SLOT_SIZE];
+	off_t offset;
+	
+	offset = TRAFFICDB_SERIES_HEADER_SIZE + (off_t)((slottime / mmgui_trafficdb_series_formats[level].resolution) % mmgui_trafficdb_series_formats[level].slots) * TRAFFICDB_SERIES_SLOT_SIZE;
+	
+	if (pread(fd, slot, sizeof(slot), offset) != sizeof(slot)) return FALSE;
+	
+	/*Slot belongs to other ring cycle or was never written*/
+	if (mmgui_trafficdb_get_uint64(slot + TRAFFICDB_SERIES_SLOT_TIME_OFFSET) != slottime) return FALSE;
+	
+	*rxbytes = mmgui_trafficdb_get_uint64(slot + TRAFFICDB_SERIES_SLOT_RX_OFFSET);
+	*txbytes = mmgui_trafficdb_get_uint64(slot + TRAFFICDB_SERIES_SLOT_TX_OFFSET);
+	
+	return TRUE;
+}
+
+static gboolean mmgui_trafficdb_series_slot_write(gint fd, guint level, guint64 slottime, guint64 rxbytes, guint64 txbytes)
+{
+	gchar slot[TRAFFICDB_SERIES_SLOT_SIZE];
+	off_t offset;
+	
+	offset = TRAFFICDB_SERIES_HEADER_SIZE + (off_t)((slottime / mmgui_trafficdb_series_formats[level].resolution) % mmgui_trafficdb_series_formats[level].slots) * TRAFFICDB_SERIES_SLOT_SIZE;
+	
+	mmgui_trafficdb_put_uint64(slot + TRAFFICDB_SERIES_SLOT_TIME_OFFSET, slottime);
+	mmgui_trafficdb_put_uint64(slot + TRAFFICDB_SERIES_SLOT_RX_OFFSET, rxbytes);
+	mmgui_trafficdb_put_uint64(slot + TRAFFICDB_SERIES_SLOT_TX_OFFSET, txbytes);
+	
+	return (pwrite(fd, slot, sizeof(slot), offset) == sizeof(slot));
+}
+
+static gboolean mmgui_trafficdb_key_to_daytime(datum key, guint64 *daytime)
+{
+	gchar dayid[64];
+	gint i;
+	
+	if ((key.dptr == NULL) || (key.dsize <= 0) || (key.dsize >= sizeof(dayid))) return FALSE;
+	
+	/*Day records have plain decimal timestamp keys*/
+	for (i=0; i<key.dsize; i++) {
+		if (!isdigit(key.dptr[i])) return FALSE;
+	}
+	
+	memcpy(dayid, key.dptr, key.dsize);
+	dayid[key.dsize] = '\0';
+	
+	*daytime = (guint64)strtoull(dayid, NULL, 10);
+	
+	return TRUE;
+}
+
+static gboolean mmgui_trafficdb_key_is_index(datum key)
+{
+	const gchar *prefixes[] = {"days:", "month:", "year:"};
+	guint i;
+	
+	if (key.dptr == NULL) return FALSE;
+	
+	for (i=0; i<G_N_ELEMENTS(prefixes); i++) {
+		if ((key.dsize > strlen(prefixes[i])) && (strncmp(key.dptr, prefixes[i], strlen(prefixes[i])) == 0)) {
+			return TRUE;
+		}
+	}
+	
+	return FALSE;
+}
+
+static datum mmgui_trafficdb_key_from_daytime(guint64 daytime, gchar *buffer, gsize size)
+{
+	datum key;
+	
+	key.dptr = buffer;
+	key.dsize = g_snprintf(buffer, size, "%" G_GUINT64_FORMAT "", daytime);
+	
+	return key;
+}
+
+static void mmgui_trafficdb_day_month(guint64 daytime, guint *month, guint *year)
+{
+	struct tm timestruct;
+	time_t timestamp;
+	
+	timestamp = (time_t)daytime;
+	localtime_r((const time_t *)&timestamp, &timestruct);
+	
+	*month = timestruct.tm_mon;
+	*year = timestruct.tm_year + 1900;
+}
+
+static gboolean mmgui_trafficdb_total_read(GDBM_FILE db, const gchar *name, struct _mmgui_trafficdb_total *total)
+{
+	datum key, data;
+	
+	memset(total, 0, sizeof(struct _mmgui_trafficdb_total));
+	
+	key.dptr = (gchar *)name;
+	key.dsize = strlen(name);
+	
+	data = gdbm_fetch(db, key);
+	
+	if (data.dptr == NULL) return FALSE;
+	
+	if (data.dsize >= TRAFFICDB_INDEX_TOTAL_SIZE) {
+		total->rxbytes = (gint64)mmgui_trafficdb_get_uint64(data.dptr + TRAFFICDB_INDEX_TOTAL_RX_OFFSET);
+		total->txbytes = (gint64)mmgui_trafficdb_get_uint64(data.dptr + TRAFFICDB_INDEX_TOTAL_TX_OFFSET);
+		total->duration = (gint64)mmgui_trafficdb_get_uint64(data.dptr + TRAFFICDB_INDEX_TOTAL_DURATION_OFFSET);
+	}
+	
+	free(data.dptr);
+	
+	return TRUE;
+}
+
+static void mmgui_trafficdb_total_add(GDBM_FILE db, const gchar *name, const struct _mmgui_trafficdb_total *delta)
+{
+	struct _mmgui_trafficdb_total total;
+	gchar buffer[TRAFFICDB_INDEX_TOTAL_SIZE];
+	datum key, data;
+	
+	mmgui_trafficdb_total_read(db, name, &total);
+	
+	mmgui_trafficdb_put_uint64(buffer + TRAFFICDB_INDEX_TOTAL_RX_OFFSET, (guint64)(total.rxbytes + delta->rxbytes));
+	mmgui_trafficdb_put_uint64(buffer + TRAFFICDB_INDEX_TOTAL_TX_OFFSET, (guint64)(total.txbytes + delta->txbytes));
+	mmgui_trafficdb_put_uint64(buffer + TRAFFICDB_INDEX_TOTAL_DURATION_OFFSET, (guint64)(total.duration + delta->duration));
+	
+	key.dptr = (gchar *)name;
+	key.dsize = strlen(name);
+	data.dptr = buffer;
+	data.dsize = sizeof(buffer);
+	
+	if (gdbm_store(db, key, data, GDBM_REPLACE) == -1) {
+		g_debug("Failed to write traffic totals: %s\n", name);
+	}
+}
+
+static GArray *mmgui_trafficdb_month_days_read(GDBM_FILE db, guint month, guint year)
+{
+	GArray *days;
+	gchar name[32];
+	datum key, data;
+	guint64 daytime;
+	gsize i;
+	
+	days = g_array_new(FALSE, FALSE, sizeof(guint64));
+	
+	g_snprintf(name, sizeof(name), TRAFFICDB_INDEX_MONTH_DAYS_KEY, year, month + 1);
+	key.dptr = name;
+	key.dsize = strlen(name);
+	
+	data = gdbm_fetch(db, key);
+	
+	if (data.dptr != NULL) {
+		for (i=0; i+sizeof(guint64)<=data.dsize; i+=sizeof(guint64)) {
+			daytime = mmgui_trafficdb_get_uint64(data.dptr + i);
+			g_array_append_val(days, daytime);
+		}
+		free(data.dptr);
+	}
+	
+	return days;
+}
+
+static GArray *mmgui_trafficdb_month_days_scan(GDBM_FILE db, guint month, guint year)
+{
+	GArray *days;
+	datum key, nextkey;
+	guint64 daytime;
+	guint daymonth, dayyear;
+	
+	days = g_array_new(FALSE, FALSE, sizeof(guint64));
+	
+	/*Database written before month index was added*/
+	key = gdbm_firstkey(db);
+	while (key.dptr != NULL) {
+		if (mmgui_trafficdb_key_to_daytime(key, &daytime)) {
+			mmgui_trafficdb_day_month(daytime, &daymonth, &dayyear);
+			if ((daymonth == month) && (dayyear == year)) {
+				g_array_append_val(days, daytime);
+			}
+		}
+		nextkey = gdbm_nextkey(db, key);
+		free(key.dptr);
+		key = nextkey;
+	}
+	
+	return days;
+}
+
+static gboolean mmgui_trafficdb_index_first_month(GDBM_FILE db, guint *month, guint *year)
+{
+	datum key, nextkey;
+	gchar name[32];
+	guint keymonth, keyyear, first, current;
+	gboolean found;
+	
+	found = FALSE;
+	first = G_MAXUINT;
+	
+	/*Only month day lists are inspected, so scan needs constant memory*/
+	key = gdbm_firstkey(db);
+	while (key.dptr != NULL) {
+		if ((key.dsize > 5) && (key.dsize < sizeof(name)) && (strncmp(key.dptr, "days:", 5) == 0)) {
+			memcpy(name, key.dptr, key.dsize);
+			name[key.dsize] = '\0';
+			if (sscanf(name, TRAFFICDB_INDEX_MONTH_DAYS_KEY, &keyyear, &keymonth) == 2) {
+				if ((keymonth >= 1) && (keymonth <= 12)) {
+					current = keyyear * 12 + keymonth - 1;
+					if (current < first) {
+						first = current;
+						found = TRUE;
+					}
+				}
+			}
+		}
+		nextkey = gdbm_nextkey(db, key);
+		free(key.dptr);
+		key = nextkey;
+	}
+	
+	if (found) {
+		*year = first / 12;
+		*month = first % 12;
+	}
+	
+	return found;
+}
+
+static void mmgui_trafficdb_month_days_add(GDBM_FILE db, guint month, guint year, guint64 daytime)
+{
+	GArray *days;
+	gchar name[32];
+	gchar *buffer;
+	datum key, data;
+	guint i, position;
+	
+	days = mmgui_trafficdb_month_days_read(db, month, year);
+	
+	/*Days are kept in ascending order*/
+	position = days->len;
+	for (i=0; i<days->len; i++) {
+		if (g_array_index(days, guint64, i) == daytime) {
+			g_array_free(days, TRUE);
+			return;
+		} else if (g_array_index(days, guint64, i) > daytime) {
+			position = i;
+			break;
+		}
+	}
+	
+	g_array_insert_val(days, position, daytime);
+	
+	buffer = g_malloc(days->len * sizeof(guint64));
+	for (i=0; i<days->len; i++) {
+		mmgui_trafficdb_put_uint64(buffer + i * sizeof(guint64), g_array_index(days, guint64, i));
+	}
+	
+	g_snprintf(name, sizeof(name), TRAFFICDB_INDEX_MONTH_DAYS_KEY, year, month + 1);
+	key.dptr = name;
+	key.dsize = strlen(name);
+	data.dptr = buffer;
+	data.dsize = days->len * sizeof(guint64);
+	
+	if (gdbm_store(db, key, data, GDBM_REPLACE) == -1) {
+		g_debug("Failed to write traffic month index: %s\n", name);
+	}
+	
+	g_free(buffer);
+	g_array_free(days, TRUE);
+}
+
+static gboolean mmgui_trafficdb_day_store(GDBM_FILE db, mmgui_day_traffic_t daytraffic, gboolean rebuild)
+{
+	gchar dayid[64], name[32];
+	datum key, data;
+	gchar *daytrafficxml;
+	mmgui_day_traffic_t oldtraffic;
+	struct _mmgui_trafficdb_total delta;
+	guint month, year;
+	
+	key = mmgui_trafficdb_key_from_daytime(daytraffic->daytime, dayid, sizeof(dayid));
+	
+	/*Totals are corrected by difference with previous day record*/
+	delta.rxbytes = daytraffic->dayrxbytes + daytraffic->sessrxbytes;
+	delta.txbytes = daytraffic->daytxbytes + daytraffic->sesstxbytes;
+	delta.duration = daytraffic->dayduration + daytraffic->sessduration;
+	
+	data.dptr = NULL;
+	if (!rebuild) {
+		data = gdbm_fetch(db, key);
+	}
+	if (data.dptr != NULL) {
+		oldtraffic = mmgui_trafficdb_xml_parse(data.dptr, data.dsize);
+		if (oldtraffic != NULL) {
+			delta.rxbytes -= oldtraffic->dayrxbytes + oldtraffic->sessrxbytes;
+			delta.txbytes -= oldtraffic->daytxbytes + oldtraffic->sesstxbytes;
+			delta.duration -= oldtraffic->dayduration + oldtraffic->sessduration;
+			g_free(oldtraffic);
+		}
+		free(data.dptr);
+	}
+	
+	daytrafficxml = g_strdup_printf(TRAFFICDB_DAY_XML,
+									daytraffic->daytime,
+									daytraffic->dayrxbytes,
+									daytraffic->daytxbytes,
+									daytraffic->dayduration,
+									daytraffic->sesstime,
+									daytraffic->sessrxbytes,
+									daytraffic->sesstxbytes,
+									daytraffic->sessduration);
+	
+	data.dptr = daytrafficxml;
+	data.dsize = strlen(daytrafficxml);
+	
+	if (gdbm_store(db, key, data, GDBM_REPLACE) == -1) {
+		g_free(daytrafficxml);
+		return FALSE;
+	}
+	
+	g_free(daytrafficxml);
+	
+	mmgui_trafficdb_day_month(daytraffic->daytime, &month, &year);
+	
+	mmgui_trafficdb_month_days_add(db, month, year, daytraffic->daytime);
+	
+	g_snprintf(name, sizeof(name), TRAFFICDB_INDEX_MONTH_TOTAL_KEY, year, month + 1);
+	mmgui_trafficdb_total_add(db, name, &delta);
+	
+	g_snprintf(name, sizeof(name), TRAFFICDB_INDEX_YEAR_TOTAL_KEY, year);
+	mmgui_trafficdb_total_add(db, name, &delta);
+	
+	return TRUE;
+}
+
+static void mmgui_trafficdb_index_build(mmgui_trafficdb_t trafficdb)
+{
+	GDBM_FILE db;
+	datum key, nextkey, data;
+	GSList *days, *stale, *iterator;
+	mmgui_day_traffic_t traffic;
+	guint64 daytime;
+	gchar version[4];
+	guint32 value;
+	guint count;
+	
+	db = gdbm_open((gchar *)trafficdb->filepath, 0, GDBM_WRCREAT, 0755, 0);
+	
+	if (db == NULL) return;
+	
+	if (mmgui_trafficdb_index_valid(db)) {
+		gdbm_close(db);
+		return;
+	}
+	
+	/*Day records are collected first, keys must not change during traversal*/
+	days = NULL;
+	stale = NULL;
+	key = gdbm_firstkey(db);
+	while (key.dptr != NULL) {
+		if (mmgui_trafficdb_key_is_index(key)) {
+			stale = g_slist_prepend(stale, g_strndup(key.dptr, key.dsize));
+		} else if (mmgui_trafficdb_key_to_daytime(key, &daytime)) {
+			data = gdbm_fetch(db, key);
+			if (data.dptr != NULL) {
+				traffic = mmgui_trafficdb_xml_parse(data.dptr, data.dsize);
+				if (traffic != NULL) {
+					traffic->daytime = daytime;
+					days = g_slist_prepend(days, traffic);
+				}
+				free(data.dptr);
+			}
+		}
+		nextkey = gdbm_nextkey(db, key);
+		free(key.dptr);
+		key = nextkey;
+	}
+	
+	/*Index left by interrupted build is started over*/
+	for (iterator=stale; iterator!=NULL; iterator=iterator->next) {
+		key.dptr = (gchar *)iterator->data;
+		key.dsize = strlen((gchar *)iterator->data);
+		gdbm_delete(db, key);
+	}
+	
+	g_slist_foreach(stale, (GFunc)g_free, NULL);
+	g_slist_free(stale);
+	
+	/*Every day is counted into totals as a whole*/
+	count = 0;
+	for (iterator=days; iterator!=NULL; iterator=iterator->next) {
+		traffic = (mmgui_day_traffic_t)iterator->data;
+		if (mmgui_trafficdb_day_store(db, traffic, TRUE)) {
+			count++;
+		}
+	}
+	
+	g_slist_foreach(days, (GFunc)g_free, NULL);
+	g_slist_free(days);
+	
+	value = GUINT32_TO_LE(TRAFFICDB_INDEX_VERSION);
+	memcpy(version, &value, sizeof(value));
+	key.dptr = TRAFFICDB_INDEX_VERSION_KEY;
+	key.dsize = strlen(TRAFFICDB_INDEX_VERSION_KEY);
+	data.dptr = version;
+	data.dsize = sizeof(version);
+	
+	if (gdbm_store(db, key, data, GDBM_REPLACE) == -1) {
+		g_warning("Unable to write traffic database index version");
+	}
+	
+	gdbm_sync(db);
+	gdbm_close(db);
+	
+	g_debug("Traffic database indexed, %u days\n", count);
+}
+
+static gboolean mmgui_trafficdb_index_valid(GDBM_FILE db)
+{
+	datum key, data;
+	guint32 value;
+	
+	key.dptr = TRAFFICDB_INDEX_VERSION_KEY;
+	key.dsize = strlen(TRAFFICDB_INDEX_VERSION_KEY);
+	
+	data = gdbm_fetch(db, key);
+	
+	if (data.dptr == NULL) return FALSE;
+	
+	value = 0;
+	if (data.dsize >= sizeof(value)) {
+		memcpy(&value, data.dptr, sizeof(value));
+	}
+	free(data.dptr);
+	
+	return (GUINT32_FROM_LE(value) == TRAFFICDB_INDEX_VERSION);
+}
+
+static void mmgui_trafficdb_put_uint64(gchar *dest, guint64 value)
+{
+	value = GUINT64_TO_LE(value);
+	memcpy(dest, &value, sizeof(value));
+}
+
+static guint64 mmgui_trafficdb_get_uint64(const gchar *src)
+{
+	guint64 value;
+	
+	memcpy(&value, src, sizeof(value));
+	
+	return GUINT64_FROM_LE(value);
+}
+
+static guint32 mmgui_trafficdb_journal_checksum(const gchar *record)
+{
+	guint32 hash;
+	guint i;
+	
+	/*FNV-1a over record payload, detects torn writes*/
+	hash = 2166136261U;
+	
+	for (i=TRAFFICDB_JOURNAL_DAY_TIME_OFFSET; i<TRAFFICDB_JOURNAL_RECORD_SIZE; i++) {
+		hash ^= (guint8)record[i];
+		hash *= 16777619U;
+	}
+	
+	return hash;
+}
+
+static gboolean mmgui_trafficdb_journal_record_decode(const gchar *record, mmgui_day_traffic_t traffic)
+{
+	guint32 value;
+	
+	memcpy(&value, record + TRAFFICDB_JOURNAL_MAGIC_OFFSET, sizeof(value));
+	if (GUINT32_FROM_LE(value) != TRAFFICDB_JOURNAL_MAGIC) return FALSE;
+	memcpy(&value, record + TRAFFICDB_JOURNAL_CHECKSUM_OFFSET, sizeof(value));
+	if (GUINT32_FROM_LE(value) != mmgui_trafficdb_journal_checksum(record)) return FALSE;
+	
+	traffic->daytime = mmgui_trafficdb_get_uint64(record + TRAFFICDB_JOURNAL_DAY_TIME_OFFSET);
+	traffic->dayrxbytes = mmgui_trafficdb_get_uint64(record + TRAFFICDB_JOURNAL_DAY_RX_OFFSET);
+	traffic->daytxbytes = mmgui_trafficdb_get_uint64(record + TRAFFICDB_JOURNAL_DAY_TX_OFFSET);
+	traffic->dayduration = (guint)mmgui_trafficdb_get_uint64(record + TRAFFICDB_JOURNAL_DAY_DURATION_OFFSET);
+	traffic->sesstime = mmgui_trafficdb_get_uint64(record + TRAFFICDB_JOURNAL_SESSION_TIME_OFFSET);
+	traffic->sessrxbytes = mmgui_trafficdb_get_uint64(record + TRAFFICDB_JOURNAL_SESSION_RX_OFFSET);
+	traffic->sesstxbytes = mmgui_trafficdb_get_uint64(record + TRAFFICDB_JOURNAL_SESSION_TX_OFFSET);
+	traffic->sessduration = (guint)mmgui_trafficdb_get_uint64(record + TRAFFICDB_JOURNAL_SESSION_DURATION_OFFSET);
+	
+	return TRUE;
+}
+
+static gboolean mmgui_trafficdb_journal_replay(mmgui_trafficdb_t trafficdb, time_t skipdaytime)
+{
+	gchar *contents;
+	gsize length, offset;
+	struct _mmgui_day_traffic traffic, lasttraffic;
+	gboolean haslast, res;
+	guint count;
+	
+	if (!g_file_get_contents(trafficdb->journalpath, &contents, &length, NULL)) return TRUE;
+	
+	haslast = FALSE;
+	res = TRUE;
+	count = 0;
+	
+	/*Records hold whole day state, so only last one of each day is stored and replay can be repeated safely*/
+	for (offset=0; offset+TRAFFICDB_JOURNAL_RECORD_SIZE<=length; offset+=TRAFFICDB_JOURNAL_RECORD_SIZE) {
+		/*Incomplete tail record is ignored*/
+		if (!mmgui_trafficdb_journal_record_decode(contents + offset, &traffic)) break;
+		if ((haslast) && (lasttraffic.daytime != traffic.daytime) && (lasttraffic.daytime != (guint64)skipdaytime)) {
+			if (!mmgui_trafficdb_day_traffic_write(trafficdb, &lasttraffic)) {
+				res = FALSE;
+			}
+		}
+		lasttraffic = traffic;
+		haslast = TRUE;
+		count++;
+	}
+	
+	g_free(contents);
+	
+	/*Day just written to database is newer than its journal records*/
+	if ((haslast) && (lasttraffic.daytime != (guint64)skipdaytime)) {
+		if (!mmgui_trafficdb_day_traffic_write(trafficdb, &lasttraffic)) {
+			res = FALSE;
+		}
+	}
+	
+	if (!res) {
+		/*Journal is kept for next attempt*/
+		g_debug("Failed to write traffic statistics to database\n");
+		return FALSE;
+	}
+	
+	/*Open journal is truncated, not removed, so appends go to same file*/
+	if (trafficdb->journalfd != -1) {
+		if (ftruncate(trafficdb->journalfd, 0) == -1) {
+			g_debug("Failed to truncate traffic journal\n");
+		}
+	} else if (g_unlink(trafficdb->journalpath) == -1) {
+		g_warning("Unable to remove traffic journal: %s", trafficdb->journalpath);
+	}
+	
+	g_debug("Traffic journal replayed, %u checkpoints\n", count);
+	
+	return TRUE;
+}
+
+static mmgui_day_traffic_t mmgui_trafficdb_journal_day_read(mmgui_trafficdb_t trafficdb, time_t daytime)
+{
+	gchar *contents;
+	gsize length, offset;
+	struct _mmgui_day_traffic traffic;
+	mmgui_day_traffic_t daytraffic;
+	
+	if (!g_file_get_contents(trafficdb->journalpath, &contents, &length, NULL)) return NULL;
+	
+	daytraffic = NULL;
+	
+	for (offset=0; offset+TRAFFICDB_JOURNAL_RECORD_SIZE<=length; offset+=TRAFFICDB_JOURNAL_RECORD_SIZE) {
+		if (!mmgui_trafficdb_journal_record_decode(contents + offset, &traffic)) break;
+		if (traffic.daytime != (guint64)daytime) continue;
+		if (daytraffic == NULL) {
+			daytraffic = g_new0(struct _mmgui_day_traffic, 1);
+		}
+		*daytraffic = traffic;
+	}
+	
+	g_free(contents);
+	
+	return daytraffic;
+}
+
+static void mmgui_trafficdb_journal_checkpoint(mmgui_trafficdb_t trafficdb, time_t currenttime, gboolean force)
+{
+	gchar record[TRAFFICDB_JOURNAL_RECORD_SIZE];
+	guint32 value;
+	
+	if (trafficdb->journalfd == -1) return;
+	if ((!force) && (difftime(currenttime, trafficdb->journaltime) < TRAFFICDB_JOURNAL_INTERVAL)) return;
+	
+	trafficdb->journaltime = currenttime;
+	
+	/*Day totals change only together with database writes, so session counters tell if record is needed*/
+	if ((trafficdb->sessrxbytes == trafficdb->journalrxbytes) && (trafficdb->sesstxbytes == trafficdb->journaltxbytes) && (trafficdb->sessduration == trafficdb->journalduration)) return;
+	
+	/*Same values session_close would store*/
+	value = GUINT32_TO_LE(TRAFFICDB_JOURNAL_MAGIC);
+	memcpy(record + TRAFFICDB_JOURNAL_MAGIC_OFFSET, &value, sizeof(value));
+	mmgui_trafficdb_put_uint64(record + TRAFFICDB_JOURNAL_DAY_TIME_OFFSET, (guint64)trafficdb->presdaytime);
+	mmgui_trafficdb_put_uint64(record + TRAFFICDB_JOURNAL_DAY_RX_OFFSET, trafficdb->dayrxbytes);
+	mmgui_trafficdb_put_uint64(record + TRAFFICDB_JOURNAL_DAY_TX_OFFSET, trafficdb->daytxbytes);
+	mmgui_trafficdb_put_uint64(record + TRAFFICDB_JOURNAL_DAY_DURATION_OFFSET, (guint64)trafficdb->dayduration);
+	mmgui_trafficdb_put_uint64(record + TRAFFICDB_JOURNAL_SESSION_TIME_OFFSET, (guint64)trafficdb->sesstime);
+	mmgui_trafficdb_put_uint64(record + TRAFFICDB_JOURNAL_SESSION_RX_OFFSET, trafficdb->sessrxbytes);
+	mmgui_trafficdb_put_uint64(record + TRAFFICDB_JOURNAL_SESSION_TX_OFFSET, trafficdb->sesstxbytes);
+	mmgui_trafficdb_put_uint64(record + TRAFFICDB_JOURNAL_SESSION_DURATION_OFFSET, trafficdb->sessduration);
+	value = GUINT32_TO_LE(mmgui_trafficdb_journal_checksum(record));
+	memcpy(record + TRAFFICDB_JOURNAL_CHECKSUM_OFFSET, &value, sizeof(value));
+	
+	if (write(trafficdb->journalfd, record, sizeof(record)) != sizeof(record)) {
+		g_debug("Failed to write traffic journal\n");
+		return;
+	}
+	
+	fdatasync(trafficdb->journalfd);
+	
+	trafficdb->journalrxbytes = trafficdb->sessrxbytes;
+	trafficdb->journaltxbytes = trafficdb->sesstxbytes;
+	trafficdb->journalduration = trafficdb->sessduration;
+}
+
+static void mmgui_trafficdb_journal_reset(mmgui_trafficdb_t trafficdb, gboolean keepsession, time_t writtendaytime)
+{
+	/*Counters are durable in database now*/
+	if (keepsession) {
+		trafficdb->journalrxbytes = trafficdb->sessrxbytes;
+		trafficdb->journaltxbytes = trafficdb->sesstxbytes;
+		trafficdb->journalduration = trafficdb->sessduration;
+	} else {
+		trafficdb->journalrxbytes = 0;
+		trafficdb->journaltxbytes = 0;
+		trafficdb->journalduration = 0;
+	}
+	
+	trafficdb->journaltime = time(NULL);
+	
+	if ((writtendaytime == 0) || (trafficdb->journalfd == -1)) return;
+	
+	if (trafficdb->journalpending) {
+		/*Other days in journal are merged before it is truncated*/
+		trafficdb->journalpending = !mmgui_trafficdb_journal_replay(trafficdb, writtendaytime);
+	} else if (ftruncate(trafficdb->journalfd, 0) == -1) {
+		g_debug("Failed to truncate traffic journal\n");
+	}
+}
+
+mmgui_traffic_report_t mmgui_trafficdb_report_build(guint month, guint year, const gchar *currentid, mmgui_day_traffic_t liveday)
+{
+	struct _mmgui_trafficdb_report_context context;
+	struct _mmgui_trafficdb_report_job job;
+	mmgui_traffic_report_t report;
+	mmgui_traffic_device_report_t device;
+	GHashTableIter hashiter;
+	gpointer value;
+	GThreadPool *pool;
+	GError *error;
+	GArray *jobs;
+	GDir *dir;
+	GSList *iterator;
+	gchar *devicespath, *filepath;
+	const gchar *name;
+	glong processors;
+	guint numthreads, i;
+	
+	/*Devices are found by their directories, no device has to be opened*/
+	devicespath = g_build_path(G_DIR_SEPARATOR_S, g_get_user_data_dir(), "modem-manager-gui", "devices", NULL);
+	
+	if (devicespath == NULL) return NULL;
+	
+	report = g_new0(struct _mmgui_traffic_report, 1);
+	report->month = month;
+	report->year = year;
+	
+	context.month = month;
+	context.year = year;
+	context.days = g_hash_table_new(g_int64_hash, g_int64_equal);
+	g_mutex_init(&context.lock);
+	
+	jobs = g_array_new(FALSE, TRUE, sizeof(struct _mmgui_trafficdb_report_job));
+	
+	error = NULL;
+	dir = g_dir_open(devicespath, 0, &error);
+	
+	if (dir != NULL) {
+		while ((name = g_dir_read_name(dir)) != NULL) {
+			filepath = g_build_filename(devicespath, name, "traffic.gdbm", NULL);
+			if (!g_file_test(filepath, G_FILE_TEST_IS_REGULAR)) {
+				g_free(filepath);
+				continue;
+			}
+			device = g_new0(struct _mmgui_traffic_device_report, 1);
+			device->persistentid = g_strdup(name);
+			report->devices = g_slist_prepend(report->devices, device);
+			job.filepath = filepath;
+			job.device = device;
+			/*Opened device is read with counters of running session copied by caller*/
+			job.liveday = ((currentid != NULL) && (g_str_equal(name, currentid))) ? liveday : NULL;
+			g_array_append_val(jobs, job);
+		}
+		g_dir_close(dir);
+	} else if (error != NULL) {
+		g_debug("Unable to list devices directory: %s\n", error->message);
+		g_error_free(error);
+	}
+	
+	pool = NULL;
+	
+	/*Single database is not worth starting threads*/
+	if (jobs->len > 1) {
+		processors = sysconf(_SC_NPROCESSORS_ONLN);
+		if (processors < 1) {
+			processors = 1;
+		}
+		numthreads = MIN(MIN((guint)processors, jobs->len), TRAFFICDB_REPORT_MAX_THREADS);
+		if (numthreads > 1) {
+			error = NULL;
+			pool = g_thread_pool_new(mmgui_trafficdb_report_worker, &context, (gint)numthreads, TRUE, &error);
+			if (pool == NULL) {
+				if (error != NULL) {
+					g_debug("Unable to start traffic report threads: %s\n", error->message);
+					g_error_free(error);
+				}
+			}
+		}
+	}
+	
+	if (pool != NULL) {
+		for (i=0; i<jobs->len; i++) {
+			g_thread_pool_push(pool, &g_array_index(jobs, struct _mmgui_trafficdb_report_job, i), NULL);
+		}
+	}
+	
+	if (pool != NULL) {
+		/*Wait for all databases to be read*/
+		g_thread_pool_free(pool, FALSE, TRUE);
+	} else {
+		for (i=0; i<jobs->len; i++) {
+			mmgui_trafficdb_report_worker(&g_array_index(jobs, struct _mmgui_trafficdb_report_job, i), &context);
+		}
+	}
+	
+	for (i=0; i<jobs->len; i++) {
+		g_free(g_array_index(jobs, struct _mmgui_trafficdb_report_job, i).filepath);
+	}
+	
+	g_array_free(jobs, TRUE);
+	
+	g_hash_table_iter_init(&hashiter, context.days);
+	while (g_hash_table_iter_next(&hashiter, NULL, &value)) {
+		report->days = g_slist_prepend(report->days, value);
+	}
+	
+	report->days = g_slist_sort(report->days, mmgui_trafficdb_report_day_compare);
+	
+	g_hash_table_destroy(context.days);
+	g_mutex_clear(&context.lock);
+	
+	report->devices = g_slist_sort(report->devices, mmgui_trafficdb_report_device_compare);
+	
+	for (iterator=report->devices; iterator; iterator=iterator->next) {
+		device = (mmgui_traffic_device_report_t)iterator->data;
+		report->rxbytes += device->rxbytes;
+		report->txbytes += device->txbytes;
+		report->duration += device->duration;
+	}
+	
+	g_free(devicespath);
+	
+	return report;
+}
+
+void mmgui_trafficdb_report_free(mmgui_traffic_report_t report)
+{
+	GSList *iterator;
+	mmgui_traffic_device_report_t device;
+	
+	if (report == NULL) return;
+	
+	for (iterator=report->devices; iterator; iterator=iterator->next) {
+		device = (mmgui_traffic_device_report_t)iterator->data;
+		g_free(device->persistentid);
+		g_free(device);
+	}
+	
+	g_slist_free(report->devices);
+	g_slist_free_full(report->days, g_free);
+	g_free(report);
+}
+
+static void mmgui_trafficdb_report_worker(gpointer data, gpointer userdata)
+{
+	struct _mmgui_trafficdb_report_job *job;
+	struct _mmgui_trafficdb_report_context *context;
+	GDBM_FILE db;
+	GArray *days;
+	GSList *daylist, *iterator;
+	mmgui_day_traffic_t daytraffic;
+	datum key, dbdata;
+	gchar dayid[64];
+	struct tm timespec;
+	time_t daytime;
+	guint i, attempt;
+	
+	job = (struct _mmgui_trafficdb_report_job *)data;
+	context = (struct _mmgui_trafficdb_report_context *)userdata;
+	
+	if ((job == NULL) || (context == NULL)) return;
+	
+	db = NULL;
+	
+	/*Database of device used by another instance may be locked for a moment*/
+	for (attempt=0; attempt<TRAFFICDB_REPORT_OPEN_ATTEMPTS; attempt++) {
+		db = gdbm_open(job->filepath, 0, GDBM_READER, 0755, 0);
+		if (db != NULL) break;
+		g_usleep(TRAFFICDB_REPORT_OPEN_DELAY);
+	}
+	
+	if (db == NULL) {
+		g_debug("Unable to open traffic database for report: %s\n", job->filepath);
+		return;
+	}
+	
+	daylist = NULL;
+	
+	/*Database not opened since month index was added is read with full scan*/
+	if (mmgui_trafficdb_index_valid(db)) {
+		days = mmgui_trafficdb_month_days_read(db, context->month, context->year);
+	} else {
+		days = mmgui_trafficdb_month_days_scan(db, context->month, context->year);
+	}
+	for (i=days->len; i>0; i--) {
+		key = mmgui_trafficdb_key_from_daytime(g_array_index(days, guint64, i-1), dayid, sizeof(dayid));
+		dbdata = gdbm_fetch(db, key);
+		if (dbdata.dptr == NULL) continue;
+		daytraffic = mmgui_trafficdb_xml_parse(dbdata.dptr, dbdata.dsize);
+		free(dbdata.dptr);
+		if (daytraffic != NULL) {
+			daylist = g_slist_prepend(daylist, daytraffic);
+		}
+	}
+	g_array_free(days, TRUE);
+	
+	gdbm_close(db);
+	
+	/*Stored record of today is replaced with running session counters*/
+	if (job->liveday != NULL) {
+		daytime = (time_t)job->liveday->daytime;
+		localtime_r(&daytime, &timespec);
+		if (((guint)timespec.tm_mon == context->month) && ((guint)timespec.tm_year + 1900 == context->year)) {
+			for (iterator=daylist; iterator; iterator=iterator->next) {
+				daytraffic = (mmgui_day_traffic_t)iterator->data;
+				if (daytraffic->daytime == job->liveday->daytime) break;
+			}
+			if (iterator != NULL) {
+				*daytraffic = *job->liveday;
+			} else if ((job->liveday->dayduration + job->liveday->sessduration) > 0) {
+				daytraffic = g_new(struct _mmgui_day_traffic, 1);
+				*daytraffic = *job->liveday;
+				daylist = g_slist_prepend(daylist, daytraffic);
+			}
+		}
+	}
+	
+	mmgui_trafficdb_report_merge(context, job->device, daylist);
+	
+	g_slist_free_full(daylist, g_free);
+}
+
+static void mmgui_trafficdb_report_merge(struct _mmgui_trafficdb_report_context *context, mmgui_traffic_device_report_t device, GSList *daylist)
+{
+	GSList *iterator;
+	mmgui_day_traffic_t daytraffic, total;
+	
+	if ((context == NULL) || (device == NULL)) return;
+	
+	g_mutex_lock(&context->lock);
+	
+	for (iterator=daylist; iterator; iterator=iterator->next) {
+		daytraffic = (mmgui_day_traffic_t)iterator->data;
+		total = (mmgui_day_traffic_t)g_hash_table_lookup(context->days, &daytraffic->daytime);
+		if (total == NULL) {
+			total = g_new0(struct _mmgui_day_traffic, 1);
+			total->daytime = daytraffic->daytime;
+			g_hash_table_insert(context->days, &total->daytime, total);
+		}
+		total->dayrxbytes += daytraffic->dayrxbytes;
+		total->daytxbytes += daytraffic->daytxbytes;
+		total->dayduration += daytraffic->dayduration;
+		total->sesstime = MAX(total->sesstime, daytraffic->sesstime);
+		total->sessrxbytes += daytraffic->sessrxbytes;
+		total->sesstxbytes += daytraffic->sesstxbytes;
+		total->sessduration += daytraffic->sessduration;
+		/*Device fields are only written by its own reader*/
+		device->rxbytes += daytraffic->dayrxbytes + daytraffic->sessrxbytes;
+		device->txbytes += daytraffic->daytxbytes + daytraffic->sesstxbytes;
+		device->duration += daytraffic->dayduration + daytraffic->sessduration;
+		device->days++;
+	}
+	
+	g_mutex_unlock(&context->lock);
+}
+
+static gint mmgui_trafficdb_report_day_compare(gconstpointer a, gconstpointer b)
+{
+	mmgui_day_traffic_t daya, dayb;
+	
+	daya = (mmgui_day_traffic_t)a;
+	dayb = (mmgui_day_traffic_t)b;
+	
+	if (daya->daytime < dayb->daytime) {
+		return -1;
+	} else if (daya->daytime > dayb->daytime) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+static gint mmgui_trafficdb_report_device_compare(gconstpointer a, gconstpointer b)
+{
+	return g_strcmp0(((mmgui_traffic_device_report_t)a)->persistentid, ((mmgui_traffic_device_report_t)b)->persistentid);
+}
+
+static mmgui_day_traffic_t mmgui_trafficdb_xml_parse(gchar *xml, gsize size)
+{
+	mmgui_day_traffic_t traffic;
+	struct _mmgui_trafficdb_xml_state state;
+	GMarkupParser mp;
+	GMarkupParseContext *mpc;
+	GError *error = NULL;
+	
+	traffic = g_new(struct _mmgui_day_traffic, 1);
+	
+	traffic->daytime = 0;
+	traffic->dayrxbytes = 0;
+	traffic->daytxbytes = 0;
+	traffic->dayduration = 0;
+	traffic->sesstime = 0;
+	traffic->sessrxbytes = 0;
+	traffic->sesstxbytes = 0;
+	traffic->sessduration = 0;
+	
+	mp.start_element = mmgui_trafficdb_xml_get_element;
+	mp.end_element = mmgui_trafficdb_xml_end_element;
+	mp.text = mmgui_trafficdb_xml_get_value;
+	mp.passthrough = NULL;
+	mp.error = NULL;
+	
+	state.traffic = traffic;
+	state.parameter = TRAFFICDB_XML_PARAM_NULL;
+	
+	mpc = g_markup_parse_context_new(&mp, 0, (gpointer)&state, NULL);
+	g_markup_parse_context_parse(mpc, xml, size, &error);
+	if (error != NULL) {
+		g_free(traffic);
+		g_error_free(error);
+		g_markup_parse_context_free(mpc);
+		return NULL;
+	}
+	g_markup_parse_context_free(mpc);
+	
+	return traffic;
+}
+
+static void mmgui_trafficdb_xml_get_element(GMarkupParseContext *context, const gchar *element, const gchar **attr_names, const gchar **attr_values, gpointer data, GError **error)
+{
+	struct _mmgui_trafficdb_xml_state *state;
+	
+	state = (struct _mmgui_trafficdb_xml_state *)data;
+	
+	if (g_str_equal(element, "daytime")) {
+		state->parameter = TRAFFICDB_XML_PARAM_DAY_TIME;
+	} else if (g_str_equal(element, "dayrxbytes")) {
+		state->parameter = TRAFFICDB_XML_PARAM_DAY_RX;
+	} else if (g_str_equal(element, "daytxbytes")) {
+		state->parameter = TRAFFICDB_XML_PARAM_DAY_TX;
+	} else if (g_str_equal(element, "dayduration")) {
+		state->parameter = TRAFFICDB_XML_PARAM_DAY_DURATION;
+	} else if (g_str_equal(element, "sesstime")) {
+		state->parameter = TRAFFICDB_XML_PARAM_SESSION_TIME;
+	} else if (g_str_equal(element, "sessrxbytes")) {
+		state->parameter = TRAFFICDB_XML_PARAM_SESSION_RX;
+	} else if (g_str_equal(element, "sesstxbytes")) {
+		state->parameter = TRAFFICDB_XML_PARAM_SESSION_TX;
+	} else if (g_str_equal(element, "sessduration")) {
+		state->parameter = TRAFFICDB_XML_PARAM_SESSION_DURATION;
+	} else {
+		state->parameter = TRAFFICDB_XML_PARAM_NULL;
+	}
+}
+
+static void mmgui_trafficdb_xml_get_value(GMarkupParseContext *context, const gchar *text, gsize size, gpointer data, GError **error)
+{
+	struct _mmgui_trafficdb_xml_state *state;
+	mmgui_day_traffic_t daytraffic;
+	
+	state = (struct _mmgui_trafficdb_xml_state *)data;
+	daytraffic = state->traffic;
+	
+	if (state->parameter == TRAFFICDB_XML_PARAM_NULL) return;
+	
+	switch (state->parameter) {
+		case TRAFFICDB_XML_PARAM_DAY_TIME:
+			daytraffic->daytime = (guint64)strtoull(text, NULL, 10);
+			break;
+		case TRAFFICDB_XML_PARAM_DAY_RX:
+			daytraffic->dayrxbytes = (guint64)strtoull(text, NULL, 10);
+			break;
+		case TRAFFICDB_XML_PARAM_DAY_TX:
+			daytraffic->daytxbytes = (guint64)strtoull(text, NULL, 10);
+			break;
+		case TRAFFICDB_XML_PARAM_DAY_DURATION:
+			daytraffic->dayduration = (guint)strtoul(text, NULL, 10);
+			break;
+		case TRAFFICDB_XML_PARAM_SESSION_TIME:
+			daytraffic->sesstime = (guint64)strtoull(text, NULL, 10);
+			break;
+		case TRAFFICDB_XML_PARAM_SESSION_RX:
+			daytraffic->sessrxbytes = (guint64)strtoull(text, NULL, 10);
+			break;
+		case TRAFFICDB_XML_PARAM_SESSION_TX:
+			daytraffic->sesstxbytes = (guint64)strtoull(text, NULL, 10);
+			break;
+		case TRAFFICDB_XML_PARAM_SESSION_DURATION:
+			daytraffic->sessduration = (guint)strtoul(text, NULL, 10);
+			break;
+		default:
+			break;
+	}
+}
+
+static void mmgui_trafficdb_xml_end_element(GMarkupParseContext *context, const gchar *element, gpointer data, GError **error)
+{
+	struct _mmgui_trafficdb_xml_state *state;
+	
+	state = (struct _mmgui_trafficdb_xml_state *)data;
+	
 	if (!g_str_equal(element, "traffic")) {
-		mmgui_trafficdb_xml_parameter = TRAFFICDB_XML_PARAM_NULL;
+		state->parameter = TRAFFICDB_XML_PARAM_NULL;
 	}
 }
@@ -20,6 +20,15 @@
 #ifndef __TRAFFICDB_H__
 #define __TRAFFICDB_H__
 
+/*Time series resolutions: seconds for an hour, minutes for a week, hours for a year*/
+enum _mmgui_trafficdb_series_level {
+	MMGUI_TRAFFICDB_SERIES_LEVEL_SECOND = 0,
+	MMGUI_TRAFFICDB_SERIES_LEVEL_MINUTE,
+	MMGUI_TRAFFICDB_SERIES_LEVEL_HOUR
+};
+
+#define MMGUI_TRAFFICDB_SERIES_LEVELS 3
+
 enum _mmgui_trafficdb_session_state {
 	MMGUI_TRAFFICDB_SESSION_STATE_UNKNOWN = 0,
 	MMGUI_TRAFFICDB_SESSION_STATE_NEW,
@@ -49,6 +58,23 @@ struct _mmgui_trafficdb {
 	guint64 yearrxbytes;
 	guint64 yeartxbytes;
 	guint64 yearduration;
+	/*Checkpoint journal*/
+	const gchar *journalpath;
+	gint journalfd;
+	gboolean journalpending;
+	time_t journaltime;
+	guint64 journalrxbytes;
+	guint64 journaltxbytes;
+	guint64 journalduration;
+	/*Fixed-size time series ring files*/
+	gint seriesfd[MMGUI_TRAFFICDB_SERIES_LEVELS];
+	/*Per-application usage not yet written*/
+	const gchar *appspath;
+	GHashTable *apppending;
+	time_t appdaytime;
+	time_t appflushtime;
+	guint appgeneration;
+	GMutex applock;
 };
 
 typedef struct _mmgui_trafficdb *mmgui_trafficdb_t;
@@ -79,6 +105,51 @@ struct _mmgui_traffic_update {
 
 typedef struct _mmgui_traffic_update *mmgui_traffic_update_t;
 
+/*Traffic transferred during one time series interval*/
+struct _mmgui_traffic_sample {
+	guint64 timestamp;
+	guint64 rxbytes;
+	guint64 txbytes;
+};
+
+typedef struct _mmgui_traffic_sample *mmgui_traffic_sample_t;
+
+/*Traffic of one application during a day*/
+struct _mmgui_app_traffic {
+	gchar *appname;
+	guint64 rxbytes;
+	guint64 txbytes;
+};
+
+typedef struct _mmgui_app_traffic *mmgui_app_traffic_t;
+
+/*Monthly traffic of one device found in data directory*/
+struct _mmgui_traffic_device_report {
+	gchar *persistentid;
+	guint64 rxbytes;
+	guint64 txbytes;
+	guint64 duration;
+	guint days;
+};
+
+typedef struct _mmgui_traffic_device_report *mmgui_traffic_device_report_t;
+
+/*Monthly traffic of all devices, days are merged and sorted by time*/
+struct _mmgui_traffic_report {
+	guint month;
+	guint year;
+	GSList *devices;
+	GSList *days;
+	guint64 rxbytes;
+	guint64 txbytes;
+	guint64 duration;
+};
+
+typedef struct _mmgui_traffic_report *mmgui_traffic_report_t;
+
+/*Called for every stored day in ascending order, FALSE stops iteration*/
+typedef gboolean (*mmgui_trafficdb_day_func)(mmgui_day_traffic_t daytraffic, gpointer userdata);
+
 time_t mmgui_trafficdb_get_new_day_timesatmp(time_t currenttime, gboolean *monthsend, gboolean *yearsend);
 mmgui_trafficdb_t mmgui_trafficdb_open(const gchar *persistentid, const gchar *internalid);
 gboolean mmgui_trafficdb_close(mmgui_trafficdb_t trafficdb);
@@ -90,5 +161,14 @@ gboolean mmgui_trafficdb_day_traffic_write(mmgui_trafficdb_t trafficdb, mmgui_da
 GSList *mmgui_trafficdb_get_traffic_list_for_month(mmgui_trafficdb_t trafficdb, guint month, guint year);
 void mmgui_trafficdb_free_traffic_list_for_month(GSList *trafficlist);
 mmgui_day_traffic_t mmgui_trafficdb_day_traffic_read(mmgui_trafficdb_t trafficdb, time_t daytime);
+guint mmgui_trafficdb_day_traffic_foreach(mmgui_trafficdb_t trafficdb, time_t from, mmgui_trafficdb_day_func func, gpointer userdata);
+gboolean mmgui_trafficdb_series_add(mmgui_trafficdb_t trafficdb, time_t timestamp, guint64 rxbytes, guint64 txbytes);
+GArray *mmgui_trafficdb_series_read(mmgui_trafficdb_t trafficdb, time_t from, time_t to, guint resolution);
+gboolean mmgui_trafficdb_application_usage_add(mmgui_trafficdb_t trafficdb, const gchar *appname, guint64 rxbytes, guint64 txbytes);
+GSList *mmgui_trafficdb_application_usage_read(mmgui_trafficdb_t trafficdb, time_t daytime);
+guint mmgui_trafficdb_application_usage_generation(mmgui_trafficdb_t trafficdb);
+void mmgui_trafficdb_application_usage_free_list(GSList *applist);
+mmgui_traffic_report_t mmgui_trafficdb_report_build(guint month, guint year, const gchar *currentid, mmgui_day_traffic_t liveday);
+void mmgui_trafficdb_report_free(mmgui_traffic_report_t report);
 
 #endif /* __SMSDB_H__ */
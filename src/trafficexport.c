@@ -0,0 +1,408 @@
+/*
+ *      trafficexport.c
+ *      
+ *      Copyright 2026 Alex <alex@linuxonly.ru>
+ *      
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "trafficexport.h"
+
+#define MMGUI_TRAFFIC_EXPORT_BUFFER_SIZE  65536
+
+#define MMGUI_TRAFFIC_EXPORT_DAY_CSV_HEADER "daytime,dayrxbytes,daytxbytes,dayduration,sesstime,sessrxbytes,sesstxbytes,sessduration\n"
+#define MMGUI_TRAFFIC_EXPORT_DAY_CSV "%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%u,%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%u\n"
+#define MMGUI_TRAFFIC_EXPORT_DAY_JSON "{\"daytime\":%" G_GUINT64_FORMAT ",\"dayrxbytes\":%" G_GUINT64_FORMAT ",\"daytxbytes\":%" G_GUINT64_FORMAT ",\"dayduration\":%u,\"sesstime\":%" G_GUINT64_FORMAT ",\"sessrxbytes\":%" G_GUINT64_FORMAT ",\"sesstxbytes\":%" G_GUINT64_FORMAT ",\"sessduration\":%u}\n"
+
+#define MMGUI_TRAFFIC_EXPORT_LIVE_CSV_HEADER "timestamp,device,connected,rxbytes,txbytes,sessionrxbytes,sessiontxbytes,sessiontime,rxspeed,txspeed,siglevel\n"
+#define MMGUI_TRAFFIC_EXPORT_LIVE_ROTATED_SUFFIX ".1"
+
+/*Streamed export state*/
+struct _mmgui_traffic_export_stream {
+	FILE *file;
+	enum _mmgui_traffic_export_format format;
+	gboolean failed;
+};
+
+static FILE *mmgui_traffic_export_file_begin(const gchar *filepath, gchar **tmppath);
+static gboolean mmgui_traffic_export_file_commit(FILE *file, gchar *tmppath, const gchar *filepath, gboolean failed);
+static gboolean mmgui_traffic_export_day_write(mmgui_day_traffic_t daytraffic, gpointer userdata);
+static gint mmgui_traffic_export_live_open(const gchar *filepath);
+static gchar *mmgui_traffic_export_escape_csv(const gchar *value);
+static gchar *mmgui_traffic_export_escape_json(const gchar *value);
+static gchar *mmgui_traffic_export_escape_label(const gchar *value);
+static void mmgui_traffic_export_prometheus_metric(FILE *file, const gchar *name, const gchar *type, const gchar *help, const gchar *labels, const gchar *value);
+
+
+enum _mmgui_traffic_export_format mmgui_traffic_export_format_from_string(const gchar *format)
+{
+	if (format == NULL) return MMGUI_TRAFFIC_EXPORT_FORMAT_NONE;
+	
+	if (g_ascii_strcasecmp(format, "csv") == 0) {
+		return MMGUI_TRAFFIC_EXPORT_FORMAT_CSV;
+	} else if ((g_ascii_strcasecmp(format, "jsonl") == 0) || (g_ascii_strcasecmp(format, "json") == 0)) {
+		return MMGUI_TRAFFIC_EXPORT_FORMAT_JSONL;
+	}
+	
+	return MMGUI_TRAFFIC_EXPORT_FORMAT_NONE;
+}
+
+const gchar *mmgui_traffic_export_format_extension(enum _mmgui_traffic_export_format format)
+{
+	switch (format) {
+		case MMGUI_TRAFFIC_EXPORT_FORMAT_CSV:
+			return "csv";
+		case MMGUI_TRAFFIC_EXPORT_FORMAT_JSONL:
+			return "jsonl";
+		default:
+			return NULL;
+	}
+}
+
+guint mmgui_traffic_export_days(mmgui_trafficdb_t trafficdb, const gchar *filepath, enum _mmgui_traffic_export_format format, time_t from)
+{
+	struct _mmgui_traffic_export_stream stream;
+	gchar *tmppath;
+	guint count;
+	
+	if ((trafficdb == NULL) || (filepath == NULL)) return 0;
+	if (format == MMGUI_TRAFFIC_EXPORT_FORMAT_NONE) return 0;
+	
+	stream.file = mmgui_traffic_export_file_begin(filepath, &tmppath);
+	if (stream.file == NULL) return 0;
+	
+	stream.format = format;
+	stream.failed = FALSE;
+	
+	if (format == MMGUI_TRAFFIC_EXPORT_FORMAT_CSV) {
+		if (fputs(MMGUI_TRAFFIC_EXPORT_DAY_CSV_HEADER, stream.file) == EOF) {
+			stream.failed = TRUE;
+		}
+	}
+	
+	/*Records go straight to file one day at a time*/
+	count = 0;
+	if (!stream.failed) {
+		count = mmgui_trafficdb_day_traffic_foreach(trafficdb, from, mmgui_traffic_export_day_write, &stream);
+	}
+	
+	if (!mmgui_traffic_export_file_commit(stream.file, tmppath, filepath, stream.failed)) {
+		return 0;
+	}
+	
+	return count;
+}
+
+gboolean mmgui_traffic_export_live_append(const gchar *filepath, enum _mmgui_traffic_export_format format, mmgui_traffic_export_live_t live)
+{
+	gint fd;
+	struct stat filestat;
+	GString *record;
+	gchar *device;
+	gchar rxspeed[G_ASCII_DTOSTR_BUF_SIZE], txspeed[G_ASCII_DTOSTR_BUF_SIZE];
+	gssize written;
+	
+	if ((filepath == NULL) || (live == NULL)) return FALSE;
+	if (format == MMGUI_TRAFFIC_EXPORT_FORMAT_NONE) return FALSE;
+	
+	fd = mmgui_traffic_export_live_open(filepath);
+	if (fd == -1) {
+		g_debug("Unable to open live traffic export: %s\n", filepath);
+		return FALSE;
+	}
+	
+	record = g_string_sized_new(256);
+	
+	/*Speed is printed with dot separator whatever locale is*/
+	g_ascii_formatd(rxspeed, sizeof(rxspeed), "%.3f", live->rxspeed);
+	g_ascii_formatd(txspeed, sizeof(txspeed), "%.3f", live->txspeed);
+	
+	if (format == MMGUI_TRAFFIC_EXPORT_FORMAT_CSV) {
+		if ((fstat(fd, &filestat) == 0) && (filestat.st_size == 0)) {
+			g_string_append(record, MMGUI_TRAFFIC_EXPORT_LIVE_CSV_HEADER);
+		}
+		device = mmgui_traffic_export_escape_csv(live->device);
+		g_string_append_printf(record, "%" G_GINT64_FORMAT ",%s,%u,%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%s,%s,%u\n", (gint64)live->timestamp, device, live->connected ? 1 : 0, live->rxbytes, live->txbytes, live->sessionrxbytes, live->sessiontxbytes, live->sessiontime, rxspeed, txspeed, live->siglevel);
+	} else {
+		device = mmgui_traffic_export_escape_json(live->device);
+		g_string_append_printf(record, "{\"timestamp\":%" G_GINT64_FORMAT ",\"device\":%s,\"connected\":%s,\"rxbytes\":%" G_GUINT64_FORMAT ",\"txbytes\":%" G_GUINT64_FORMAT ",\"sessionrxbytes\":%" G_GUINT64_FORMAT ",\"sessiontxbytes\":%" G_GUINT64_FORMAT ",\"sessiontime\":%" G_GUINT64_FORMAT ",\"rxspeed\":%s,\"txspeed\":%s,\"siglevel\":%u}\n", (gint64)live->timestamp, device, live->connected ? "true" : "false", live->rxbytes, live->txbytes, live->sessionrxbytes, live->sessiontxbytes, live->sessiontime, rxspeed, txspeed, live->siglevel);
+	}
+	
+	g_free(device);
+	
+	/*Single append keeps every line whole for concurrent readers*/
+	written = write(fd, record->str, record->len);
+	
+	close(fd);
+	
+	if (written != (gssize)record->len) {
+		g_debug("Unable to append live traffic export: %s\n", filepath);
+		g_string_free(record, TRUE);
+		return FALSE;
+	}
+	
+	g_string_free(record, TRUE);
+	
+	return TRUE;
+}
+
+gboolean mmgui_traffic_export_prometheus(const gchar *filepath, mmgui_traffic_export_live_t live)
+{
+	FILE *file;
+	gchar *tmppath, *device, *model, *labels;
+	gchar value[G_ASCII_DTOSTR_BUF_SIZE];
+	
+	if ((filepath == NULL) || (live == NULL)) return FALSE;
+	
+	file = mmgui_traffic_export_file_begin(filepath, &tmppath);
+	if (file == NULL) return FALSE;
+	
+	device = mmgui_traffic_export_escape_label(live->device);
+	model = mmgui_traffic_export_escape_label(live->model);
+	labels = g_strdup_printf("device=\"%s\",model=\"%s\"", device, model);
+	g_free(device);
+	g_free(model);
+	
+	g_snprintf(value, sizeof(value), "%u", live->connected ? 1 : 0);
+	mmgui_traffic_export_prometheus_metric(file, "mmgui_connected", "gauge", "Whether modem has active data connection.", labels, value);
+	
+	/*Byte totals only grow until reconnect, which Prometheus treats as counter reset*/
+	g_snprintf(value, sizeof(value), "%" G_GUINT64_FORMAT, live->sessionrxbytes);
+	mmgui_traffic_export_prometheus_metric(file, "mmgui_session_received_bytes_total", "counter", "Bytes received during current session.", labels, value);
+	
+	g_snprintf(value, sizeof(value), "%" G_GUINT64_FORMAT, live->sessiontxbytes);
+	mmgui_traffic_export_prometheus_metric(file, "mmgui_session_transmitted_bytes_total", "counter", "Bytes transmitted during current session.", labels, value);
+	
+	g_snprintf(value, sizeof(value), "%" G_GUINT64_FORMAT, live->rxbytes);
+	mmgui_traffic_export_prometheus_metric(file, "mmgui_interface_received_bytes_total", "counter", "Bytes received by network interface.", labels, value);
+	
+	g_snprintf(value, sizeof(value), "%" G_GUINT64_FORMAT, live->txbytes);
+	mmgui_traffic_export_prometheus_metric(file, "mmgui_interface_transmitted_bytes_total", "counter", "Bytes transmitted by network interface.", labels, value);
+	
+	g_snprintf(value, sizeof(value), "%" G_GUINT64_FORMAT, live->sessiontime);
+	mmgui_traffic_export_prometheus_metric(file, "mmgui_session_duration_seconds", "gauge", "Duration of current session.", labels, value);
+	
+	/*Prometheus expects base units*/
+	g_ascii_formatd(value, sizeof(value), "%.0f", (gdouble)live->rxspeed * 1024.0);
+	mmgui_traffic_export_prometheus_metric(file, "mmgui_receive_speed_bits_per_second", "gauge", "Current receive speed.", labels, value);
+	
+	g_ascii_formatd(value, sizeof(value), "%.0f", (gdouble)live->txspeed * 1024.0);
+	mmgui_traffic_export_prometheus_metric(file, "mmgui_transmit_speed_bits_per_second", "gauge", "Current transmit speed.", labels, value);
+	
+	g_snprintf(value, sizeof(value), "%u", live->siglevel);
+	mmgui_traffic_export_prometheus_metric(file, "mmgui_signal_level_percent", "gauge", "Signal level reported by modem.", labels, value);
+	
+	g_snprintf(value, sizeof(value), "%" G_GINT64_FORMAT, (gint64)live->timestamp);
+	mmgui_traffic_export_prometheus_metric(file, "mmgui_last_update_timestamp_seconds", "gauge", "Time of last export.", labels, value);
+	
+	g_free(labels);
+	
+	return mmgui_traffic_export_file_commit(file, tmppath, filepath, ferror(file) != 0);
+}
+
+static FILE *mmgui_traffic_export_file_begin(const gchar *filepath, gchar **tmppath)
+{
+	gint fd;
+	FILE *file;
+	
+	/*Temporary file must be on same filesystem to be renamed*/
+	*tmppath = g_strconcat(filepath, ".XXXXXX", NULL);
+	
+	fd = g_mkstemp(*tmppath);
+	if (fd == -1) {
+		g_debug("Unable to create export file: %s\n", *tmppath);
+		g_free(*tmppath);
+		*tmppath = NULL;
+		return NULL;
+	}
+	
+	fchmod(fd, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+	
+	file = fdopen(fd, "w");
+	if (file == NULL) {
+		close(fd);
+		g_unlink(*tmppath);
+		g_free(*tmppath);
+		*tmppath = NULL;
+		return NULL;
+	}
+	
+	setvbuf(file, NULL, _IOFBF, MMGUI_TRAFFIC_EXPORT_BUFFER_SIZE);
+	
+	return file;
+}
+
+static gboolean mmgui_traffic_export_file_commit(FILE *file, gchar *tmppath, const gchar *filepath, gboolean failed)
+{
+	if ((fflush(file) != 0) || (fsync(fileno(file)) != 0)) {
+		failed = TRUE;
+	}
+	
+	if (fclose(file) != 0) {
+		failed = TRUE;
+	}
+	
+	/*Readers see either previous or complete new file*/
+	if ((!failed) && (g_rename(tmppath, filepath) == -1)) {
+		g_debug("Unable to replace export file: %s\n", filepath);
+		failed = TRUE;
+	}
+	
+	if (failed) {
+		g_unlink(tmppath);
+	}
+	
+	g_free(tmppath);
+	
+	return !failed;
+}
+
+static gboolean mmgui_traffic_export_day_write(mmgui_day_traffic_t daytraffic, gpointer userdata)
+{
+	struct _mmgui_traffic_export_stream *stream;
+	gint written;
+	
+	stream = (struct _mmgui_traffic_export_stream *)userdata;
+	
+	if ((daytraffic == NULL) || (stream == NULL)) return FALSE;
+	
+	if (stream->format == MMGUI_TRAFFIC_EXPORT_FORMAT_CSV) {
+		written = fprintf(stream->file, MMGUI_TRAFFIC_EXPORT_DAY_CSV, daytraffic->daytime, daytraffic->dayrxbytes, daytraffic->daytxbytes, daytraffic->dayduration, daytraffic->sesstime, daytraffic->sessrxbytes, daytraffic->sesstxbytes, daytraffic->sessduration);
+	} else {
+		written = fprintf(stream->file, MMGUI_TRAFFIC_EXPORT_DAY_JSON, daytraffic->daytime, daytraffic->dayrxbytes, daytraffic->daytxbytes, daytraffic->dayduration, daytraffic->sesstime, daytraffic->sessrxbytes, daytraffic->sesstxbytes, daytraffic->sessduration);
+	}
+	
+	/*Stop reading database once file can not be written*/
+	if (written < 0) {
+		stream->failed = TRUE;
+		return FALSE;
+	}
+	
+	return TRUE;
+}
+
+static gint mmgui_traffic_export_live_open(const gchar *filepath)
+{
+	gint fd;
+	struct stat filestat;
+	gchar *rotatedpath;
+	
+	fd = open(filepath, O_WRONLY|O_CREAT|O_APPEND, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+	if (fd == -1) return -1;
+	
+	if ((fstat(fd, &filestat) != 0) || (filestat.st_size < MMGUI_TRAFFIC_EXPORT_LIVE_MAX_SIZE)) return fd;
+	
+	/*Full file replaces previous rotated one, so at most two files are kept*/
+	close(fd);
+	
+	rotatedpath = g_strconcat(filepath, MMGUI_TRAFFIC_EXPORT_LIVE_ROTATED_SUFFIX, NULL);
+	if (g_rename(filepath, rotatedpath) == -1) {
+		g_debug("Unable to rotate live traffic export: %s\n", filepath);
+	}
+	g_free(rotatedpath);
+	
+	return open(filepath, O_WRONLY|O_CREAT|O_APPEND, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+}
+
+static gchar *mmgui_traffic_export_escape_csv(const gchar *value)
+{
+	GString *field;
+	const gchar *ch;
+	
+	field = g_string_new("\"");
+	
+	/*RFC 4180: field is quoted and quotes inside are doubled*/
+	if (value != NULL) {
+		for (ch = value; *ch != '\0'; ch++) {
+			if (*ch == '"') {
+				g_string_append_c(field, '"');
+			}
+			g_string_append_c(field, *ch);
+		}
+	}
+	
+	g_string_append_c(field, '"');
+	
+	return g_string_free(field, FALSE);
+}
+
+static gchar *mmgui_traffic_export_escape_json(const gchar *value)
+{
+	GString *string;
+	const gchar *ch;
+	
+	string = g_string_new("\"");
+	
+	/*UTF-8 is passed as is, only quote, backslash and control characters are escaped*/
+	if (value != NULL) {
+		for (ch = value; *ch != '\0'; ch++) {
+			if ((*ch == '"') || (*ch == '\\')) {
+				g_string_append_c(string, '\\');
+				g_string_append_c(string, *ch);
+			} else if ((guchar)*ch < 0x20) {
+				g_string_append_printf(string, "\\u%04x", (guint)(guchar)*ch);
+			} else {
+				g_string_append_c(string, *ch);
+			}
+		}
+	}
+	
+	g_string_append_c(string, '"');
+	
+	return g_string_free(string, FALSE);
+}
+
+static gchar *mmgui_traffic_export_escape_label(const gchar *value)
+{
+	GString *label;
+	const gchar *ch;
+	
+	label = g_string_new(NULL);
+	
+	if (value == NULL) return g_string_free(label, FALSE);
+	
+	/*Label values only need backslash, quote and newline escaped*/
+	for (ch = value; *ch != '\0'; ch++) {
+		switch (*ch) {
+			case '\\':
+				g_string_append(label, "\\\\");
+				break;
+			case '"':
+				g_string_append(label, "\\\"");
+				break;
+			case '\n':
+				g_string_append(label, "\\n");
+				break;
+			default:
+				g_string_append_c(label, *ch);
+				break;
+		}
+	}
+	
+	return g_string_free(label, FALSE);
+}
+
+static void mmgui_traffic_export_prometheus_metric(FILE *file, const gchar *name, const gchar *type, const gchar *help, const gchar *labels, const gchar *value)
+{
+	fprintf(file, "# HELP %s %s\n# TYPE %s %s\n%s{%s} %s\n", name, help, name, type, name, labels, value);
+}
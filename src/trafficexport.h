@@ -0,0 +1,64 @@
+/*
+ *      trafficexport.h
+ *      
+ *      Copyright 2026 Alex <alex@linuxonly.ru>
+ *      
+ *      This program is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License, or
+ *      (at your option) any later version.
+ *      
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TRAFFICEXPORT_H__
+#define __TRAFFICEXPORT_H__
+
+#include <time.h>
+#include <glib.h>
+
+#include "trafficdb.h"
+
+enum _mmgui_traffic_export_format {
+	MMGUI_TRAFFIC_EXPORT_FORMAT_NONE = 0,
+	MMGUI_TRAFFIC_EXPORT_FORMAT_CSV,
+	MMGUI_TRAFFIC_EXPORT_FORMAT_JSONL
+};
+
+#define MMGUI_TRAFFIC_EXPORT_DEFAULT_INTERVAL  15
+#define MMGUI_TRAFFIC_EXPORT_MIN_INTERVAL      1
+#define MMGUI_TRAFFIC_EXPORT_MAX_INTERVAL      3600
+#define MMGUI_TRAFFIC_EXPORT_PROMETHEUS_FILE   "modem-manager-gui.prom"
+#define MMGUI_TRAFFIC_EXPORT_LIVE_MAX_SIZE     1048576
+
+/*Live device counters*/
+struct _mmgui_traffic_export_live {
+	const gchar *device;
+	const gchar *model;
+	time_t timestamp;
+	gboolean connected;
+	guint64 rxbytes; /*interface counters*/
+	guint64 txbytes;
+	guint64 sessionrxbytes; /*counted since connection*/
+	guint64 sessiontxbytes;
+	guint64 sessiontime;
+	gfloat rxspeed; /*kbit/s*/
+	gfloat txspeed; /*kbit/s*/
+	guint siglevel;
+};
+
+typedef struct _mmgui_traffic_export_live *mmgui_traffic_export_live_t;
+
+enum _mmgui_traffic_export_format mmgui_traffic_export_format_from_string(const gchar *format);
+const gchar *mmgui_traffic_export_format_extension(enum _mmgui_traffic_export_format format);
+guint mmgui_traffic_export_days(mmgui_trafficdb_t trafficdb, const gchar *filepath, enum _mmgui_traffic_export_format format, time_t from);
+gboolean mmgui_traffic_export_live_append(const gchar *filepath, enum _mmgui_traffic_export_format format, mmgui_traffic_export_live_t live);
+gboolean mmgui_traffic_export_prometheus(const gchar *filepath, mmgui_traffic_export_live_t live);
+
+#endif /* __TRAFFICEXPORT_H__ */